@@ -5,6 +5,9 @@
 #include <math.h>
 #include <corecrt_math_defines.h>
 
+#include "../common/core_renderer.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
@@ -15,9 +18,7 @@
 #define INITIAL_SPEED 0.1f
 
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
-
-Uint64 previousTime, currentTime;
+CoreRenderer renderer;
 
 float x = 0.0f;
 float y = 0.0f;
@@ -38,44 +39,46 @@ float tableTop = TABLE_HEIGHT / 2.0f;
 float tableBottom = -TABLE_HEIGHT / 2.0f;
 
 void drawBall() {
-    glColor3f(1.0f, 1.0f, 1.0f);
+    renderer.color(1.0f, 1.0f, 1.0f);
 
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(x, y);
+    renderer.begin(GL_TRIANGLE_FAN);
+    renderer.vertex(x, y);
 
     for (int i = 0; i <= 360; i += 10) {
         float angle_rad = i * M_PI / 180.0f;
         float px = x + BALL_RADIUS * cosf(angle_rad);
         float py = y + BALL_RADIUS * sinf(angle_rad);
-        glVertex2f(px, py);
+        renderer.vertex(px, py);
     }
-    glEnd();
+    renderer.end();
 }
 
 void drawTable() {
-    glColor3f(0.0f, 0.5f, 0.0f);
+    renderer.color(0.0f, 0.5f, 0.0f);
 
     //table surface
-    glBegin(GL_QUADS);
-    glVertex2f(tableLeft, tableBottom);
-    glVertex2f(tableRight, tableBottom);
-    glVertex2f(tableRight, tableTop);
-    glVertex2f(tableLeft, tableTop);
-    glEnd();
+    renderer.begin(GL_QUADS);
+    renderer.vertex(tableLeft, tableBottom);
+    renderer.vertex(tableRight, tableBottom);
+    renderer.vertex(tableRight, tableTop);
+    renderer.vertex(tableLeft, tableTop);
+    renderer.end();
 
     //table border
-    glColor3f(0.5f, 0.25f, 0.0f);  
-    glLineWidth(10.0f);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(tableLeft, tableBottom);
-    glVertex2f(tableRight, tableBottom);
-    glVertex2f(tableRight, tableTop);
-    glVertex2f(tableLeft, tableTop);
-    glEnd();
-    glLineWidth(1.0f);
+    renderer.color(0.5f, 0.25f, 0.0f);  
+    renderer.lineWidth(10.0f);
+    renderer.begin(GL_LINE_LOOP);
+    renderer.vertex(tableLeft, tableBottom);
+    renderer.vertex(tableRight, tableBottom);
+    renderer.vertex(tableRight, tableTop);
+    renderer.vertex(tableLeft, tableTop);
+    renderer.end();
+    renderer.lineWidth(1.0f);
 }
 
 void updateBall() {
+    TRACE_FUNCTION();
+    PerfCounterScope counters("updateBall");
     if (ballMoving) {
         x += dx;
         y += dy;
@@ -100,36 +103,35 @@ void updateBall() {
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    window = SDL_CreateWindow("Billiard Simulation", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    window = renderer.createWindow("Billiard Simulation", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
     if (!window) {
         SDL_Log("Couldn't create window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    glcontext = SDL_GL_CreateContext(window);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    renderer.setClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
         -WINDOW_HEIGHT / 2.0f, WINDOW_HEIGHT / 2.0f,
-        -1.0f, 1.0f);
-    glMatrixMode(GL_MODELVIEW);
+        -1.0f, 1.0f));
 
-    previousTime = SDL_GetTicks();
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
 
     if (event->type == SDL_EVENT_KEY_DOWN) {
         switch (event->key.key) {
@@ -148,25 +150,29 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    currentTime = SDL_GetTicks();
-    float deltaTime = (currentTime - previousTime) / 1000.0f;
-    previousTime = currentTime;
-
-    updateBall();
+    TRACE_FUNCTION();
+    {
+        PerfScope scope(renderer.perf(), "update");
+        updateBall();
+    }
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    glLoadIdentity();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(false);
+        renderer.model().loadIdentity();
 
-    drawTable();
-    drawBall();
+        drawTable();
+        drawBall();
+    }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
 
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
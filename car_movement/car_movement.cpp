@@ -5,15 +5,48 @@
 #include <math.h>
 #include <corecrt_math_defines.h>
 
+#include <stddef.h>
+#include <vector>
+
+#include "../common/core_renderer.h"
+#include "../common/input_latency.h"
+#include "../common/mesh.h"
+#include "../common/spatial_index.h"
+#include "../common/terrain.h"
+#include "../common/traffic.h"
+#include "../common/trace.h"
+#include "../common/transform.h"
+
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 
+#define TERRAIN_CHUNK_SIZE 32.0f
+#define TERRAIN_RESOLUTION 32
+#define TERRAIN_LOD_LEVELS 4
+#define TERRAIN_LOD_RING 2
+#define TERRAIN_VIEW_RADIUS 8
+#define TERRAIN_MAX_JOBS 16
+#define TERRAIN_UPLOADS_PER_FRAME 4
+#define TERRAIN_HILL_SCALE 60.0f
+#define TERRAIN_HILL_HEIGHT 4.0f
+
+#define TRAFFIC_BLOCK_SIZE 24.0f
+#define TRAFFIC_LANE_OFFSET 1.5f
+#define TRAFFIC_FOLLOW_DISTANCE 5.0f
+#define TRAFFIC_MIN_GAP 2.5f
+#define TRAFFIC_MAX_STEPS_PER_FRAME 4
+#define TRAFFIC_BENCH_STEPS 600
+#define TRAFFIC_REBUILD_FRAMES 120
+#define LATENCY_BENCH_FRAMES 600
+#define LATENCY_BENCH_PROBE 15 //frames between synthetic key changes unless --input-probe says otherwise
+
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
 
 Uint64 previousTime, currentTime;
 
 float posx = 0.0f;
+float posy = 0.0f;
 float posz = 0.0f;
 float angle = 0.0f;
 
@@ -25,121 +58,329 @@ bool keyDown = false;
 bool keyLeft = false;
 bool keyRight = false;
 
-void setPerspective(float fovY, float aspect, float zNear, float zFar) {
-    float ymax = zNear * tanf(fovY * M_PI / 360.0f);
-    float xmax = ymax * aspect;
-    glFrustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
-}
-
-void drawCar() {
-    glPushMatrix();
-    glTranslatef(posx, 0.0f, posz);
-    glRotatef(angle * 180.0f / (float)M_PI, 0.0f, 1.0f, 0.0f);
-
-    glBegin(GL_QUADS);
-
+//arrow key changes are timed from arrival to the swap that first shows them
+//by the renderer's latency tracker.
+//--latency-bench [frames]: the traffic and scaling benches never present a
+//frame, this one runs the windowed loop (with --traffic N when given), steers
+//with synthetic key presses and logs the input to present percentiles
+int latencyBenchFrames = 0;
+int frameCount = 0;
+
+ChunkedTerrain terrain;
+CullReport terrainReport("Terrain");
+
+//--traffic N: ai cars on a road grid around the player
+TrafficSim traffic;
+bool trafficEnabled = false;
+float trafficTime = 0.0f;
+std::vector<int> trafficVisible;
+std::vector<CoreInstance> trafficInstances;
+std::vector<float> trafficY;
+Bvh trafficIndex;
+int trafficFrames = 0;
+CullReport trafficReport("Traffic");
+
+//--car-model file.obj replaces the player's box, traffic stays boxes
+StaticMesh carModel;
+
+//the car box in a buffer, once with the player's face colors and once in
+//grey shades the traffic instances tint with their body color
+struct CarBoxVertex {
+    float x, y, z;
+    unsigned char color[4];
+};
+CoreMesh carBox;
+CoreMesh trafficBox;
+
+//the player as a small hierarchy: a node that follows the car's position,
+//the car turned to its heading below it and the body (the box, or the model
+//fitted into it) below that, the camera sits behind and above the follow
+//node looking down. the nodes are only set when the car moved
+TransformHierarchy carTransforms;
+uint32_t followNode, carNode, bodyNode, cameraNode;
+float placedAngle = 0.0f;
+
+//the car box, four corners per face
+const float carBoxVertices[24][3] = {
     //top
-    glColor3f(1.0f, 0.0f, 0.0f);
-    glVertex3f(-1.0f, 0.5f, -0.5f);
-    glVertex3f(-1.0f, 0.5f, 0.5f);
-    glVertex3f(1.0f, 0.5f, 0.5f);
-    glVertex3f(1.0f, 0.5f, -0.5f);
-
+    { -1.0f, 0.5f, -0.5f }, { -1.0f, 0.5f, 0.5f }, { 1.0f, 0.5f, 0.5f }, { 1.0f, 0.5f, -0.5f },
     //bottom
-    glColor3f(0.5f, 0.0f, 0.0f);
-    glVertex3f(-1.0f, -0.5f, -0.5f);
-    glVertex3f(1.0f, -0.5f, -0.5f);
-    glVertex3f(1.0f, -0.5f, 0.5f);
-    glVertex3f(-1.0f, -0.5f, 0.5f);
-
+    { -1.0f, -0.5f, -0.5f }, { 1.0f, -0.5f, -0.5f }, { 1.0f, -0.5f, 0.5f }, { -1.0f, -0.5f, 0.5f },
     //front
-    glColor3f(0.0f, 0.0f, 1.0f);
-    glVertex3f(1.0f, -0.5f, 0.5f);
-    glVertex3f(-1.0f, -0.5f, 0.5f);
-    glVertex3f(-1.0f, 0.5f, 0.5f);
-    glVertex3f(1.0f, 0.5f, 0.5f);
-
+    { 1.0f, -0.5f, 0.5f }, { -1.0f, -0.5f, 0.5f }, { -1.0f, 0.5f, 0.5f }, { 1.0f, 0.5f, 0.5f },
     //back
-    glColor3f(0.0f, 0.0f, 0.5f);
-    glVertex3f(-1.0f, -0.5f, -0.5f);
-    glVertex3f(1.0f, -0.5f, -0.5f);
-    glVertex3f(1.0f, 0.5f, -0.5f);
-    glVertex3f(-1.0f, 0.5f, -0.5f);
-
+    { -1.0f, -0.5f, -0.5f }, { 1.0f, -0.5f, -0.5f }, { 1.0f, 0.5f, -0.5f }, { -1.0f, 0.5f, -0.5f },
     //left
-    glColor3f(0.0f, 1.0f, 0.0f);
-    glVertex3f(-1.0f, -0.5f, -0.5f);
-    glVertex3f(-1.0f, -0.5f, 0.5f);
-    glVertex3f(-1.0f, 0.5f, 0.5f);
-    glVertex3f(-1.0f, 0.5f, -0.5f);
-
+    { -1.0f, -0.5f, -0.5f }, { -1.0f, -0.5f, 0.5f }, { -1.0f, 0.5f, 0.5f }, { -1.0f, 0.5f, -0.5f },
     //right
-    glColor3f(0.0f, 0.5f, 0.0f);
-    glVertex3f(1.0f, -0.5f, -0.5f);
-    glVertex3f(1.0f, 0.5f, -0.5f);
-    glVertex3f(1.0f, 0.5f, 0.5f);
-    glVertex3f(1.0f, -0.5f, 0.5f);
-
-    glEnd();
-    glPopMatrix();
+    { 1.0f, -0.5f, -0.5f }, { 1.0f, 0.5f, -0.5f }, { 1.0f, 0.5f, 0.5f }, { 1.0f, -0.5f, 0.5f },
+};
+
+const float carBoxColors[6][3] = {
+    { 1.0f, 0.0f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, 0.5f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.5f, 0.0f },
+};
+
+//ai cars get a body color each, faces keep the player's light/dark pattern
+const float trafficPalette[6][3] = {
+    { 0.9f, 0.9f, 0.9f }, { 0.9f, 0.8f, 0.1f }, { 0.2f, 0.3f, 0.8f },
+    { 0.1f, 0.6f, 0.3f }, { 0.6f, 0.6f, 0.65f }, { 0.2f, 0.2f, 0.2f },
+};
+const float trafficFaceShade[6] = { 1.0f, 0.5f, 0.85f, 0.6f, 0.75f, 0.65f };
+
+//two triangles per face of carBoxVertices, colored per face
+void createCarBox(CoreMesh* mesh, const float (*faceColors)[3]) {
+    CarBoxVertex vertices[24];
+    unsigned short indices[36];
+    for (int face = 0; face < 6; face++) {
+        for (int k = 0; k < 4; k++) {
+            CarBoxVertex& v = vertices[face * 4 + k];
+            v.x = carBoxVertices[face * 4 + k][0];
+            v.y = carBoxVertices[face * 4 + k][1];
+            v.z = carBoxVertices[face * 4 + k][2];
+            for (int c = 0; c < 3; c++) v.color[c] = (unsigned char)(faceColors[face][c] * 255.0f);
+            v.color[3] = 255;
+        }
+        static const unsigned short quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int k = 0; k < 6; k++) indices[face * 6 + k] = (unsigned short)(face * 4 + quad[k]);
+    }
+    static const CoreVertexLayout layout = { sizeof(CarBoxVertex), offsetof(CarBoxVertex, x), offsetof(CarBoxVertex, color), -1, -1 };
+    renderer.createMesh(mesh, layout, vertices, 24, indices, 36);
 }
 
-void drawGround() {
-    glBegin(GL_LINES);
-    glColor3f(0.5f, 0.5f, 0.5f);
+//the old flat floor sat at -0.5, the hills roll around it
+float groundHeight(float x, float z) {
+    return -0.5f + TerrainHills(x, z, TERRAIN_HILL_SCALE, TERRAIN_HILL_HEIGHT);
+}
 
-    //x lines
-    for (int i = -10; i <= 10; i++) {
-        glVertex3f(-10.0f, -0.5f, (GLfloat)i);
-        glVertex3f(10.0f, -0.5f, (GLfloat)i);
+void buildCarTransforms() {
+    followNode = carTransforms.create();
+    carNode = carTransforms.create(followNode);
+    bodyNode = carTransforms.create(carNode);
+    cameraNode = carTransforms.create(followNode);
+    carTransforms.setLocal(cameraNode, MakeVec3(0.0f, 3.0f, 10.0f),
+        QuatFromAxisAngle(MakeVec3(1.0f, 0.0f, 0.0f), -25.0f * 0.0174532925f), MakeVec3(1.0f, 1.0f, 1.0f));
+
+    //a loaded model fills the same 2 x 1 x 1 box, nose towards +x
+    if (carModel.isLoaded()) {
+        float scale[3], offset[3];
+        carModel.fitTransform(2.0f, 1.0f, 1.0f, scale, offset);
+        carTransforms.setLocal(bodyNode, MakeVec3(offset[0], offset[1] - 0.5f, offset[2]), QuatIdentity(),
+            MakeVec3(scale[0], scale[1], scale[2]));
     }
+}
 
-    //z lines
-    for (int i = -10; i <= 10; i++) {
-        glVertex3f((GLfloat)i, -0.5f, -10.0f);
-        glVertex3f((GLfloat)i, -0.5f, 10.0f);
+//moves the rig to the car and brings the matrices up to date
+void placeCar() {
+    Vec3 p = carTransforms.position(followNode);
+    if (p.x != posx || p.y != posy || p.z != posz) carTransforms.setPosition(followNode, MakeVec3(posx, posy, posz));
+    if (angle != placedAngle) {
+        carTransforms.setRotation(carNode, QuatFromAxisAngle(MakeVec3(0.0f, 1.0f, 0.0f), angle));
+        placedAngle = angle;
     }
-
-    glEnd();
+    carTransforms.update();
 }
 
-void processInput() {
-    currentTime = SDL_GetTicks();
-    float deltaTime = (currentTime - previousTime) / 1000.0f;
-    previousTime = currentTime;
+void drawCar() {
+    const Mat4& model = carTransforms.world(bodyNode);
+    if (carModel.isLoaded()) carModel.draw(model, carBoxColors[0]);
+    else renderer.drawMesh(carBox, model);
+}
 
-    float moveSpeed = speed * deltaTime * 60.0f;
-    float turnSpeed = rotation_speed * deltaTime * 60.0f;
+TrafficSettings trafficSettings(int cars) {
+    TrafficSettings settings = {};
+    settings.cars = cars;
+    settings.gridSize = 2;
+    while (settings.gridSize * settings.gridSize * 2 < cars) settings.gridSize++;
+    settings.blockSize = TRAFFIC_BLOCK_SIZE;
+    settings.laneOffset = TRAFFIC_LANE_OFFSET;
+    settings.moveSpeed = speed;
+    settings.turnSpeed = rotation_speed;
+    settings.followDistance = TRAFFIC_FOLLOW_DISTANCE;
+    settings.minGap = TRAFFIC_MIN_GAP;
+    settings.seed = 1234;
+    return settings;
+}
 
-    if (keyLeft) {
-        angle += turnSpeed;
-        if (angle >= 2.0f * M_PI) angle -= 2.0f * M_PI;
+//fixed 60 Hz steps, the same unit the kinematic model is tuned in
+void updateTraffic(float deltaTime) {
+    TRACE_FUNCTION();
+    trafficTime += deltaTime;
+    int steps = 0;
+    while (trafficTime >= 1.0f / 60.0f && steps < TRAFFIC_MAX_STEPS_PER_FRAME) {
+        traffic.step(&GlobalThreadPool());
+        trafficTime -= 1.0f / 60.0f;
+        steps++;
     }
-    if (keyRight) {
-        angle -= turnSpeed;
-        if (angle < 0.0f) angle += 2.0f * M_PI;
+    if (steps == TRAFFIC_MAX_STEPS_PER_FRAME) trafficTime = 0.0f;
+}
+
+//every car moves each step, so the whole tree is refit and rebuilt now and
+//then once the boxes have drifted far from where the split planes were chosen
+void updateTrafficBounds() {
+    int n = traffic.count();
+    trafficY.resize(n);
+    GlobalThreadPool().parallelFor(n, 1024, [](int begin, int end) {
+        for (int i = begin; i < end; i++) trafficY[i] = groundHeight(traffic.x(i), traffic.z(i)) + 0.5f;
+    });
+
+    //the box fits the car at any heading
+    for (int i = 0; i < n; i++) {
+        Aabb box = AabbFromCenter(traffic.x(i), trafficY[i], traffic.z(i), 1.12f, 0.5f, 1.12f);
+        if (trafficIndex.objectCount() < n) trafficIndex.add(box);
+        else trafficIndex.setBounds(i, box);
     }
+    if (trafficFrames++ % TRAFFIC_REBUILD_FRAMES == 0) trafficIndex.build();
+    else trafficIndex.refit();
+}
 
-    float dx = moveSpeed * cosf(angle);
-    float dz = moveSpeed * sinf(angle);
+//every visible car becomes an instance of the traffic box placed and tinted
+//in the vertex shader, so thousands of cars are a single draw call
+void cullTraffic(const Frustum& frustum) {
+    TRACE_FUNCTION();
+    CullStats stats;
+    trafficIndex.cull(frustum, trafficVisible, &stats);
+    trafficReport.add(stats);
+    trafficInstances.resize(trafficVisible.size());
+
+    GlobalThreadPool().parallelFor((int)trafficVisible.size(), 1024, [](int begin, int end) {
+        for (int v = begin; v < end; v++) {
+            int i = trafficVisible[v];
+            const float* body = trafficPalette[i % 6];
+            CoreInstance& out = trafficInstances[v];
+            out.position[0] = traffic.x(i);
+            out.position[1] = trafficY[i];
+            out.position[2] = traffic.z(i);
+            out.heading = traffic.heading(i);
+            for (int c = 0; c < 3; c++) out.color[c] = (unsigned char)(body[c] * 255.0f);
+            out.color[3] = 255;
+        }
+    });
+}
 
-    if (keyUp) {
-        posx += dx;
-        posz -= dz;
-    }
-    if (keyDown) {
-        posx -= dx;
-        posz += dz;
+void drawTraffic() {
+    if (trafficInstances.empty()) return;
+    renderer.drawMeshInstanced(trafficBox, trafficInstances.data(), (int)trafficInstances.size(), Mat4Identity());
+}
+
+//--traffic-bench N: cars updated per second, serial and on the pool, no window needed
+void runTrafficBenchmark(int cars) {
+    TrafficSim sim;
+    sim.init(trafficSettings(cars));
+    double serial = 0.0;
+    for (int pass = 0; pass < 2; pass++) {
+        ThreadPool* pool = pass ? &GlobalThreadPool() : nullptr;
+        int threads = pass ? GlobalThreadPool().threadCount() + 1 : 1;
+        for (int i = 0; i < 60; i++) sim.step(pool);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < TRAFFIC_BENCH_STEPS; i++) sim.step(pool);
+        double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        double rate = (double)cars * TRAFFIC_BENCH_STEPS / seconds;
+        if (pass == 0) serial = rate;
+        SDL_Log("Traffic: %d cars, %d threads: %.3f ms/step, %.2f M cars/s (x%.2f)",
+            cars, threads, seconds * 1000.0 / TRAFFIC_BENCH_STEPS, rate / 1e6, rate / serial);
     }
 }
 
+//--scaling-bench N: a synthetic parallelFor, a synthetic job graph and N cars
+//of traffic on 1, 2, 4 ... threads, no window needed
+void runScalingBenchmark(int cars) {
+    std::vector<float> values(1 << 20);
+    ThreadPoolScaling("synthetic parallelFor", [&](ThreadPool& pool) {
+        pool.parallelFor((int)values.size(), 0, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                float v = (float)i;
+                for (int k = 0; k < 16; k++) v = sqrtf(v * 1.0001f + 1.0f);
+                values[i] = v;
+            }
+        });
+    });
+
+    //each job fills its own slice, a continuation adds them up once all are done
+    const int jobs = 256;
+    float sums[jobs];
+    float total = 0.0f;
+    ThreadPoolScaling("synthetic jobs", [&](ThreadPool& pool) {
+        JobCounter slices, all;
+        pool.then(slices, [&] {
+            for (int j = 0; j < jobs; j++) total += sums[j];
+        }, &all);
+        for (int j = 0; j < jobs; j++) {
+            pool.submit([&, j] {
+                int n = (int)values.size() / jobs;
+                float sum = 0.0f;
+                for (int i = j * n; i < (j + 1) * n; i++) sum += sinf(values[i]);
+                sums[j] = sum;
+            }, &slices);
+        }
+        pool.wait(all);
+    });
+
+    TrafficSim sim;
+    sim.init(trafficSettings(cars));
+    char label[64];
+    SDL_snprintf(label, sizeof(label), "traffic, %d cars", cars);
+    ThreadPoolScaling(label, [&](ThreadPool& pool) {
+        for (int i = 0; i < 10; i++) sim.step(&pool);
+    });
+    SDL_Log("Scaling: checksum %.1f", total);
+}
+
+//the terrain culls its chunks as it draws them, terrainReport has that part
+void drawGround(const Frustum& frustum) {
+    CullStats stats;
+    terrain.draw(&frustum, &stats);
+    terrainReport.add(stats);
+}
+
+//moves the player's car by the keys held now
+void processInput(float deltaTime) {
+    TRACE_FUNCTION();
+    float moveSpeed = speed * deltaTime * 60.0f;
+    float turnSpeed = rotation_speed * deltaTime * 60.0f;
+
+    float throttle = (keyUp ? 1.0f : 0.0f) - (keyDown ? 1.0f : 0.0f);
+    float steer = (keyLeft ? 1.0f : 0.0f) - (keyRight ? 1.0f : 0.0f);
+    CarKinematicStep(&posx, &posz, &angle, throttle, steer, moveSpeed, turnSpeed);
+
+    //ride on the terrain, the box spans -0.5..0.5
+    posy = groundHeight(posx, posz) + 0.5f;
+}
+
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
+    MeshOptimizeConfigure(argc, argv);
+    int trafficCars = 0;
+    const char* carModelPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--traffic-bench") == 0) {
+            runTrafficBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 10000);
+            return SDL_APP_SUCCESS;
+        }
+        if (SDL_strcmp(argv[i], "--scaling-bench") == 0) {
+            runScalingBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 10000);
+            return SDL_APP_SUCCESS;
+        }
+        if (SDL_strcmp(argv[i], "--latency-bench") == 0) {
+            latencyBenchFrames = i + 1 < argc && SDL_atoi(argv[i + 1]) > 0 ? SDL_atoi(argv[i + 1]) : LATENCY_BENCH_FRAMES;
+            if (InputLatencyConfig().probe <= 0) InputLatencyConfig().probe = LATENCY_BENCH_PROBE;
+        }
+        if (SDL_strcmp(argv[i], "--traffic") == 0) {
+            trafficCars = i + 1 < argc ? SDL_atoi(argv[i + 1]) : 2000;
+        }
+        if (SDL_strcmp(argv[i], "--car-model") == 0 && i + 1 < argc) {
+            carModelPath = argv[i + 1];
+        }
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    window = SDL_CreateWindow("Car Movement", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+    window = renderer.createWindow("Car Movement", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_Log("Couldn't create window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -147,23 +388,59 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
 
     SDL_SetAppMetadata("Car Movement", "1.0", "com.bohdanstarunskyi.car");
 
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.5f, 0.7f, 1.0f, 1.0f);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    setPerspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 1.0f, 500.0f);
-
-    glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_DEPTH_TEST);
+    renderer.setClearColor(0.5f, 0.7f, 1.0f, 1.0f);
+    renderer.setDepthTest(true);
+
+    //fade the edge of the loaded terrain into the sky
+    const float fogColor[3] = { 0.5f, 0.7f, 1.0f };
+    renderer.setFog(fogColor, TERRAIN_CHUNK_SIZE * TERRAIN_VIEW_RADIUS * 0.5f, TERRAIN_CHUNK_SIZE * TERRAIN_VIEW_RADIUS * 0.95f);
+    createCarBox(&carBox, carBoxColors);
+    float trafficShades[6][3];
+    for (int face = 0; face < 6; face++)
+        for (int c = 0; c < 3; c++) trafficShades[face][c] = trafficFaceShade[face];
+    createCarBox(&trafficBox, trafficShades);
+
+    TerrainSettings settings = {};
+    settings.chunkSize = TERRAIN_CHUNK_SIZE;
+    settings.resolution = TERRAIN_RESOLUTION;
+    settings.lodLevels = TERRAIN_LOD_LEVELS;
+    settings.lodRing = TERRAIN_LOD_RING;
+    settings.viewRadius = TERRAIN_VIEW_RADIUS;
+    settings.maxJobs = TERRAIN_MAX_JOBS;
+    settings.maxUploads = TERRAIN_UPLOADS_PER_FRAME;
+    settings.skirtDepth = 1.0f;
+    terrain.open(&renderer, settings, groundHeight);
+    if (carModelPath && !carModel.load(renderer, carModelPath)) {
+        SDL_Log("Keeping the box car");
+    }
+    buildCarTransforms();
+
+    if (trafficCars > 0) {
+        TrafficSettings ts = trafficSettings(trafficCars);
+        traffic.init(ts);
+        trafficEnabled = true;
+        //start on a lane in the middle of the road grid
+        posx = (ts.gridSize / 2) * ts.blockSize + ts.blockSize * 0.5f;
+        posz = (ts.gridSize / 2) * ts.blockSize + ts.laneOffset;
+        posy = groundHeight(posx, posz) + 0.5f;
+    }
+    posy = groundHeight(posx, posz) + 0.5f;
 
     previousTime = SDL_GetTicks();
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) return SDL_APP_SUCCESS;
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
 
+    if ((event->type == SDL_EVENT_KEY_DOWN && !event->key.repeat) || event->type == SDL_EVENT_KEY_UP) {
+        switch (event->key.key) {
+        case SDLK_UP: case SDLK_DOWN: case SDLK_LEFT: case SDLK_RIGHT: renderer.latency().arrived(InputArrival(event)); break;
+        }
+    }
     if (event->type == SDL_EVENT_KEY_DOWN) {
         switch (event->key.key) {
         case SDLK_UP: keyUp = true; break;
@@ -185,23 +462,82 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    processInput();
+    TRACE_FUNCTION();
+    currentTime = SDL_GetTicks();
+    float deltaTime = renderer.frameTime((currentTime - previousTime) / 1000.0f);
+    previousTime = currentTime;
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-    glRotatef(25.0f, 1.0f, 0.0f, 0.0f);
-    glTranslatef(0.0f, -3.0f, -10.0f);
-    drawGround();
-    drawCar();
+    //late latching moves the car only once the terrain and traffic are
+    //updated and drawn, with the keys as they are right before it is drawn.
+    //the camera still follows where the car was when the frame began
+    bool late = InputLatencyConfig().lateLatch;
+    {
+        PerfScope scope(renderer.perf(), "update");
+        if (!late) {
+            renderer.latency().sampled(SDL_GetTicksNS());
+            processInput(deltaTime);
+        }
+        if (trafficEnabled) {
+            updateTraffic(deltaTime);
+            updateTrafficBounds();
+        }
+        terrain.update(posx, posz);
+
+        int width, height;
+        renderer.viewportSize(&width, &height);
+        Mat4 projection = Mat4Perspective(45.0f * 0.0174532925f, (float)width / (float)height, 1.0f, 500.0f);
+        //follow the car, the world has no edge anymore
+        placeCar();
+        renderer.setCamera(Mat4RigidInverse(carTransforms.world(cameraNode)), projection);
+    }
+    Frustum frustum = FrustumFromMatrix(renderer.cameraBlock().viewProjection.m);
+    if (trafficEnabled) {
+        PerfScope scope(renderer.perf(), "cull");
+        cullTraffic(frustum);
+    }
+
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(true);
+        drawGround(frustum);
+        if (trafficEnabled) drawTraffic();
+        //the late input and move land inside draw, right before the car
+        if (late) {
+            InputLatchEvents([](SDL_Event* e) { SDL_AppEvent(NULL, e); });
+            renderer.latency().sampled(SDL_GetTicksNS());
+            processInput(deltaTime);
+            placeCar();
+        }
+        drawCar();
+    }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     SDL_Delay(16);
 
+    //--input-probe holds left for a while and lets go, through the event queue like a real key
+    int probe = InputLatencyConfig().probe;
+    frameCount++;
+    if (probe > 0 && frameCount % probe == 0) {
+        SDL_Event e = {};
+        e.type = (frameCount / probe) % 2 ? SDL_EVENT_KEY_DOWN : SDL_EVENT_KEY_UP;
+        e.key.key = SDLK_LEFT;
+        SDL_PushEvent(&e);
+    }
+    if (frameCount == latencyBenchFrames) {
+        renderer.latency().report("Latency bench");
+        return SDL_APP_SUCCESS;
+    }
+
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    TraceShutdown();
+    terrain.close();
+    carModel.release();
+    renderer.destroyMesh(&carBox);
+    renderer.destroyMesh(&trafficBox);
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+#if defined(ALLOC_TRACKING)
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <crtdbg.h>
+#include <malloc.h>
+#elif defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+#endif
+
+//heap allocation counts, to keep the frame loop from allocating at all. with
+//ALLOC_TRACKING defined this header replaces the global operator new and
+//delete, and malloc and friends on glibc (the msvc debug crt reports malloc
+//through its alloc hook instead, release msvc builds only see new; c++17
+//builds also get the over-aligned new and delete), so it
+//may only be included from one translation unit per program, which every
+//demo is. each allocation is charged to the program total and to the
+//innermost trace zone of its thread; --alloc-stacks also keeps a call stack
+//per allocation site and the report names the sites that allocated most.
+//new is also counted on its own: malloc sees sdl and the gl driver too, which
+//allocate every frame whatever the demo does, new only sees our own code.
+//without ALLOC_TRACKING nothing is hooked and every count stays zero.
+//CoreRenderer reports allocations a frame for --headless and --bench, and
+//--alloc-check fails the run when any frame after the warm-up calls new. the
+//Instrumented|x64 configuration of every project is Debug with ALLOC_TRACKING
+//and /std:c++17, e.g. for `--headless --alloc-check` on each demo
+
+#define ALLOC_ZONES 128 //power of two
+#define ALLOC_SITES 1024 //power of two, stacks beyond that go uncounted
+#define ALLOC_STACK_DEPTH 12
+#define ALLOC_REPORT_TOP 8
+
+//only ever counts up; a reset marks where it stood instead of zeroing, so
+//an add racing with the reset is never lost or undone
+struct AllocCounter {
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint64_t> countMark{ 0 };
+    std::atomic<uint64_t> bytesMark{ 0 };
+
+    void add(size_t size) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    void mark() {
+        countMark.store(count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        bytesMark.store(bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    uint64_t countSinceMark() const { return count.load() - countMark.load(); }
+    uint64_t bytesSinceMark() const { return bytes.load() - bytesMark.load(); }
+};
+
+struct AllocZone {
+    std::atomic<const char*> name{ nullptr };
+    AllocCounter total;
+};
+
+//one call stack that allocated, keyed by a hash of its return addresses
+struct AllocSite {
+    std::atomic<uint64_t> hash{ 0 };
+    void* frames[ALLOC_STACK_DEPTH] = {};
+    int depth = 0;
+    AllocCounter total;
+};
+
+//plain zero-initialized statics, usable by allocations made before main
+struct AllocTrackerState {
+    AllocCounter total;
+    AllocCounter news;
+    std::atomic<uint64_t> frees{ 0 };
+    std::atomic<bool> stacks{ false };
+    AllocZone zones[ALLOC_ZONES];
+    AllocSite sites[ALLOC_SITES];
+};
+
+inline AllocTrackerState& AllocTracker()
+{
+    static AllocTrackerState state;
+    return state;
+}
+
+inline bool AllocTrackingBuilt()
+{
+#if defined(ALLOC_TRACKING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline AllocZone* AllocFindZone(const char* name)
+{
+    AllocTrackerState& t = AllocTracker();
+    size_t slot = ((uintptr_t)name >> 3) & (ALLOC_ZONES - 1);
+    for (int probe = 0; probe < ALLOC_ZONES; probe++, slot = (slot + 1) & (ALLOC_ZONES - 1)) {
+        const char* found = t.zones[slot].name.load(std::memory_order_acquire);
+        if (!found && t.zones[slot].name.compare_exchange_strong(found, name, std::memory_order_acq_rel)) return &t.zones[slot];
+        if (found == name) return &t.zones[slot];
+    }
+    return NULL;
+}
+
+inline void AllocCaptureSite(size_t size)
+{
+    void* frames[ALLOC_STACK_DEPTH + 2];
+    int depth = 0;
+#if defined(ALLOC_TRACKING) && defined(_WIN32)
+    depth = CaptureStackBackTrace(0, ALLOC_STACK_DEPTH + 2, frames, NULL);
+#elif defined(ALLOC_TRACKING) && defined(__GLIBC__)
+    depth = backtrace(frames, ALLOC_STACK_DEPTH + 2);
+#endif
+    //the first two are this function and AllocRecord
+    if (depth <= 2) return;
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 2; i < depth; i++) hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ull;
+    if (hash == 0) hash = 1;
+
+    AllocTrackerState& t = AllocTracker();
+    size_t slot = (size_t)(hash >> 7) & (ALLOC_SITES - 1);
+    for (int probe = 0; probe < ALLOC_SITES; probe++, slot = (slot + 1) & (ALLOC_SITES - 1)) {
+        AllocSite& site = t.sites[slot];
+        uint64_t found = site.hash.load(std::memory_order_acquire);
+        if (!found && site.hash.compare_exchange_strong(found, hash, std::memory_order_acq_rel)) {
+            site.depth = depth - 2;
+            std::copy(frames + 2, frames + depth, site.frames);
+            found = hash;
+        }
+        if (found == hash) {
+            site.total.add(size);
+            return;
+        }
+    }
+}
+
+//called by the hooks for every allocation
+inline void AllocRecord(size_t size)
+{
+    AllocTrackerState& t = AllocTracker();
+    t.total.add(size);
+    //capturing a stack may allocate itself
+    static thread_local bool inside = false;
+    if (inside) return;
+    inside = true;
+    const char* zone = TraceCurrentZone();
+    AllocZone* z = AllocFindZone(zone ? zone : "(no zone)");
+    if (z) z->total.add(size);
+    if (t.stacks.load(std::memory_order_relaxed)) AllocCaptureSite(size);
+    inside = false;
+}
+
+inline void AllocRecordFree()
+{
+    AllocTracker().frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if defined(ALLOC_TRACKING) && defined(_MSC_VER) && defined(_DEBUG)
+#define ALLOC_CRT_HOOK 1
+inline int __cdecl AllocCrtHook(int type, void*, size_t size, int blockType, long, const unsigned char*, int)
+{
+    if (blockType == _CRT_BLOCK) return TRUE;
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) AllocRecord(size);
+    else if (type == _HOOK_FREE) AllocRecordFree();
+    return TRUE;
+}
+#else
+#define ALLOC_CRT_HOOK 0
+#endif
+
+//--alloc-stacks keeps call stacks per allocation site, call first thing in SDL_AppInit
+inline void AllocTrackerConfigure(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+        if (SDL_strcmp(argv[i], "--alloc-stacks") == 0) AllocTracker().stacks.store(true);
+#if ALLOC_CRT_HOOK
+    _CrtSetAllocHook(AllocCrtHook);
+#endif
+}
+
+//zones and sites count from here on, the totals keep counting. e.g. after
+//warm-up frames. only the marks move and a site keeps its stack, so pool
+//workers may go on allocating while it runs; sites that stop allocating
+//just stay in the table and drop out of the report
+inline void AllocTrackerReset()
+{
+    AllocTrackerState& t = AllocTracker();
+    for (AllocZone& z : t.zones) z.total.mark();
+    for (AllocSite& s : t.sites) s.total.mark();
+}
+
+//the zones and, with --alloc-stacks, the call stacks that allocated most
+//since the last reset. sorts on the stack so the report doesn't show up in itself
+inline void AllocTrackerReport(const char* label)
+{
+    AllocTrackerState& t = AllocTracker();
+    const AllocZone* zones[ALLOC_ZONES];
+    int zoneCount = 0;
+    for (const AllocZone& z : t.zones)
+        if (z.total.countSinceMark() > 0) zones[zoneCount++] = &z;
+    std::sort(zones, zones + zoneCount, [](const AllocZone* a, const AllocZone* b) { return a->total.countSinceMark() > b->total.countSinceMark(); });
+    for (int i = 0; i < zoneCount && i < ALLOC_REPORT_TOP; i++)
+        SDL_Log("%s: zone %s allocated %d times, %llu bytes", label, zones[i]->name.load(), (int)zones[i]->total.countSinceMark(),
+            (unsigned long long)zones[i]->total.bytesSinceMark());
+
+    const AllocSite* sites[ALLOC_SITES];
+    int siteCount = 0;
+    for (const AllocSite& s : t.sites)
+        if (s.total.countSinceMark() > 0) sites[siteCount++] = &s;
+    std::sort(sites, sites + siteCount, [](const AllocSite* a, const AllocSite* b) { return a->total.countSinceMark() > b->total.countSinceMark(); });
+    for (int i = 0; i < siteCount && i < ALLOC_REPORT_TOP; i++) {
+        const AllocSite& s = *sites[i];
+        SDL_Log("%s: site %d allocated %d times, %llu bytes:", label, i + 1, (int)s.total.countSinceMark(),
+            (unsigned long long)s.total.bytesSinceMark());
+#if defined(ALLOC_TRACKING) && defined(__GLIBC__)
+        char** symbols = backtrace_symbols(s.frames, s.depth);
+        for (int f = 0; f < s.depth; f++) SDL_Log("    %s", symbols ? symbols[f] : "?");
+        free(symbols);
+#else
+        for (int f = 0; f < s.depth; f++) SDL_Log("    %p", s.frames[f]);
+#endif
+    }
+}
+
+#if defined(ALLOC_TRACKING)
+#if defined(__GLIBC__)
+//the real allocator behind malloc, so the hooks below don't call themselves
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+}
+
+extern "C" void* malloc(size_t size) __THROW
+{
+    AllocRecord(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) __THROW
+{
+    AllocRecord(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) __THROW
+{
+    AllocRecord(size);
+    return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p) __THROW
+{
+    if (p) AllocRecordFree();
+    __libc_free(p);
+}
+
+inline void* AllocNewRaw(size_t size) { return __libc_malloc(size ? size : 1); }
+inline void AllocDeleteRaw(void* p) { __libc_free(p); }
+#else
+inline void* AllocNewRaw(size_t size) { return malloc(size ? size : 1); }
+inline void AllocDeleteRaw(void* p) { free(p); }
+#endif
+
+#if defined(__cpp_aligned_new)
+//over-aligned new, freed by the aligned delete only. glibc's free takes
+//aligned_alloc memory, the msvc crt needs _aligned_free
+#if defined(_WIN32)
+inline void* AllocNewAlignedRaw(size_t size, size_t align) { return _aligned_malloc(size ? size : 1, align); }
+inline void AllocDeleteAlignedRaw(void* p) { _aligned_free(p); }
+#else
+inline void* AllocNewAlignedRaw(size_t size, size_t align) {
+    void* p = NULL;
+    return posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size ? size : 1) == 0 ? p : NULL;
+}
+inline void AllocDeleteAlignedRaw(void* p) { AllocDeleteRaw(p); }
+#endif
+#endif
+
+//new and delete count here unless the crt hook already sees the malloc under them
+inline void* AllocNew(size_t size)
+{
+    AllocTracker().news.add(size);
+    if (!ALLOC_CRT_HOOK) AllocRecord(size);
+    return AllocNewRaw(size);
+}
+
+inline void AllocDelete(void* p)
+{
+    if (!p) return;
+    if (!ALLOC_CRT_HOOK) AllocRecordFree();
+    AllocDeleteRaw(p);
+}
+
+#if defined(__cpp_aligned_new)
+inline void* AllocNewAligned(size_t size, std::align_val_t align)
+{
+    AllocTracker().news.add(size);
+    if (!ALLOC_CRT_HOOK) AllocRecord(size);
+    return AllocNewAlignedRaw(size, (size_t)align);
+}
+
+inline void AllocDeleteAligned(void* p)
+{
+    if (!p) return;
+    if (!ALLOC_CRT_HOOK) AllocRecordFree();
+    AllocDeleteAlignedRaw(p);
+}
+#endif
+
+void* operator new(size_t size)
+{
+    void* p = AllocNew(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    void* p = AllocNew(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return AllocNew(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return AllocNew(size); }
+void operator delete(void* p) noexcept { AllocDelete(p); }
+void operator delete[](void* p) noexcept { AllocDelete(p); }
+void operator delete(void* p, size_t) noexcept { AllocDelete(p); }
+void operator delete[](void* p, size_t) noexcept { AllocDelete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { AllocDelete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { AllocDelete(p); }
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t align)
+{
+    void* p = AllocNewAligned(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+    void* p = AllocNewAligned(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return AllocNewAligned(size, align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return AllocNewAligned(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { AllocDeleteAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { AllocDeleteAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { AllocDeleteAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { AllocDeleteAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { AllocDeleteAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { AllocDeleteAligned(p); }
+#endif
+#endif
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+//skyline bottom-left packer for texture atlases.
+//every image gets a gutter on all sides and its cell (image + gutters) is
+//aligned to the gutter size, so a box-filtered mip level n with 2^n <= gutter
+//never mixes texels of two different images.
+
+struct AtlasRect {
+    int page;
+    int x, y;          //image origin in the page, gutter excluded
+    int width, height;
+    float u0, v0, u1, v1;
+};
+
+struct AtlasPage {
+    int width;
+    int height;
+};
+
+//maps a 0..1 uv of the source image into its place in the atlas page
+inline void AtlasRemapUV(const AtlasRect& r, float u, float v, float* outU, float* outV)
+{
+    *outU = r.u0 + (r.u1 - r.u0) * u;
+    *outV = r.v0 + (r.v1 - r.v0) * v;
+}
+
+class AtlasPacker {
+public:
+    AtlasPacker(int pageSize, int gutter) : pageSize(pageSize), gutter(gutter) {}
+
+    int add(int width, int height) {
+        AtlasRect r = {};
+        r.page = -1;
+        r.width = width;
+        r.height = height;
+        rects.push_back(r);
+        return (int)rects.size() - 1;
+    }
+
+    //places every image, tallest first, opening a new page when nothing fits
+    bool pack() {
+        std::vector<int> order(rects.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+        std::sort(order.begin(), order.end(), [this](int a, int b) {
+            return rects[a].height != rects[b].height ? rects[a].height > rects[b].height : rects[a].width > rects[b].width;
+        });
+
+        pages.clear();
+        skylines.clear();
+        usedWidth.clear();
+        usedHeight.clear();
+        for (int id : order) {
+            int w = cellSize(rects[id].width), h = cellSize(rects[id].height);
+            if (w > pageSize || h > pageSize) return false;
+
+            int x = 0, y = 0;
+            int page = 0;
+            for (; page < (int)skylines.size(); page++) {
+                if (findPosition(skylines[page], w, h, &x, &y)) break;
+            }
+            if (page == (int)skylines.size()) {
+                skylines.push_back({ { 0, 0, pageSize } });
+                usedWidth.push_back(0);
+                usedHeight.push_back(0);
+                findPosition(skylines[page], w, h, &x, &y);
+            }
+            place(skylines[page], x, y, w, h);
+            usedWidth[page] = std::max(usedWidth[page], x + w);
+            usedHeight[page] = std::max(usedHeight[page], y + h);
+
+            rects[id].page = page;
+            rects[id].x = x + gutter;
+            rects[id].y = y + gutter;
+        }
+
+        //trim every page to the power of two size that holds its contents
+        for (size_t p = 0; p < skylines.size(); p++) {
+            int width = 1, height = 1;
+            while (width < usedWidth[p]) width *= 2;
+            while (height < usedHeight[p]) height *= 2;
+            pages.push_back({ std::min(width, pageSize), std::min(height, pageSize) });
+        }
+        for (auto& r : rects) {
+            const AtlasPage& page = pages[r.page];
+            r.u0 = (float)r.x / page.width;
+            r.v0 = (float)r.y / page.height;
+            r.u1 = (float)(r.x + r.width) / page.width;
+            r.v1 = (float)(r.y + r.height) / page.height;
+        }
+        return true;
+    }
+
+    const AtlasRect& rect(int id) const { return rects[id]; }
+    int pageCount() const { return (int)pages.size(); }
+    const AtlasPage& page(int index) const { return pages[index]; }
+
+    //image texels over all page texels
+    float efficiency() const {
+        double used = 0.0, total = 0.0;
+        for (const auto& r : rects) used += (double)r.width * r.height;
+        for (const auto& p : pages) total += (double)p.width * p.height;
+        return total > 0.0 ? (float)(used / total) : 0.0f;
+    }
+
+    //copies an image into its page and fills the gutter, either from the
+    //opposite edge (tiling images) or by stretching the edge texels
+    void blit(int id, const unsigned char* pixels, int srcChannels, bool wrap, unsigned char* pageData, int pageChannels) const {
+        const AtlasRect& r = rects[id];
+        int pageWidth = pages[r.page].width;
+        for (int y = -gutter; y < r.height + gutter; y++) {
+            int sy = wrap ? ((y % r.height) + r.height) % r.height : std::min(std::max(y, 0), r.height - 1);
+            for (int x = -gutter; x < r.width + gutter; x++) {
+                int sx = wrap ? ((x % r.width) + r.width) % r.width : std::min(std::max(x, 0), r.width - 1);
+                const unsigned char* src = pixels + ((size_t)sy * r.width + sx) * srcChannels;
+                unsigned char* dst = pageData + ((size_t)(r.y + y) * pageWidth + (r.x + x)) * pageChannels;
+                for (int c = 0; c < pageChannels; c++)
+                    dst[c] = c < srcChannels ? src[c] : 255;
+            }
+        }
+    }
+
+private:
+    struct SkylineNode {
+        int x, y, width;
+    };
+
+    int cellSize(int size) const {
+        int align = gutter > 0 ? gutter : 1;
+        int cell = size + 2 * gutter;
+        return (cell + align - 1) / align * align;
+    }
+
+    //lowest (then leftmost) spot where a w x h cell rests on the skyline
+    bool findPosition(const std::vector<SkylineNode>& sky, int w, int h, int* outX, int* outY) const {
+        int bestY = pageSize + 1, bestX = 0;
+        for (size_t i = 0; i < sky.size(); i++) {
+            int x = sky[i].x;
+            if (x + w > pageSize) break;
+            int y = 0, remaining = w;
+            for (size_t j = i; remaining > 0; j++) {
+                y = std::max(y, sky[j].y);
+                remaining -= sky[j].width;
+            }
+            if (y + h <= pageSize && y < bestY) {
+                bestY = y;
+                bestX = x;
+            }
+        }
+        if (bestY > pageSize) return false;
+        *outX = bestX;
+        *outY = bestY;
+        return true;
+    }
+
+    void place(std::vector<SkylineNode>& sky, int x, int y, int w, int h) {
+        SkylineNode node = { x, y + h, w };
+        size_t i = 0;
+        while (i < sky.size() && sky[i].x + sky[i].width <= x) i++;
+        sky.insert(sky.begin() + i, node);
+
+        //cut away whatever the new node now covers
+        for (size_t j = i + 1; j < sky.size();) {
+            int end = node.x + node.width;
+            if (sky[j].x >= end) break;
+            int overlap = end - sky[j].x;
+            if (overlap >= sky[j].width) {
+                sky.erase(sky.begin() + j);
+            }
+            else {
+                sky[j].x += overlap;
+                sky[j].width -= overlap;
+                break;
+            }
+        }
+        //merge neighbours at the same height
+        for (size_t j = 0; j + 1 < sky.size();) {
+            if (sky[j].y == sky[j + 1].y) {
+                sky[j].width += sky[j + 1].width;
+                sky.erase(sky.begin() + j + 1);
+            }
+            else {
+                j++;
+            }
+        }
+    }
+
+    int pageSize;
+    int gutter;
+    std::vector<AtlasRect> rects;
+    std::vector<AtlasPage> pages;
+    std::vector<std::vector<SkylineNode>> skylines;
+    std::vector<int> usedWidth;
+    std::vector<int> usedHeight;
+};
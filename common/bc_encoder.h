@@ -0,0 +1,419 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_SSE 1
+#include <immintrin.h>
+#endif
+
+#include "thread_pool.h"
+
+//bc1 (opaque, 8 bytes per 4x4 block) and bc3 (bc1 color + 8 byte alpha block)
+//encoder. rows of blocks go to the thread pool, palette matching is sse over
+//4 pixels at a time.
+
+enum BcQuality {
+    BC_QUALITY_FAST,   //bounding box endpoints
+    BC_QUALITY_NORMAL, //best of bounding box and principal axis endpoints
+    BC_QUALITY_HIGH,   //normal + least squares endpoint refinement
+};
+
+struct BcBlock {
+    float r[16], g[16], b[16], a[16];
+};
+
+inline int BcBlockBytes(bool alpha)
+{
+    return alpha ? 16 : 8;
+}
+
+inline size_t BcCompressedSize(int width, int height, bool alpha)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BcBlockBytes(alpha);
+}
+
+inline uint16_t BcPack565(float r, float g, float b)
+{
+    int r5 = (int)(r * 31.0f / 255.0f + 0.5f);
+    int g6 = (int)(g * 63.0f / 255.0f + 0.5f);
+    int b5 = (int)(b * 31.0f / 255.0f + 0.5f);
+    r5 = r5 < 0 ? 0 : (r5 > 31 ? 31 : r5);
+    g6 = g6 < 0 ? 0 : (g6 > 63 ? 63 : g6);
+    b5 = b5 < 0 ? 0 : (b5 > 31 ? 31 : b5);
+    return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+}
+
+inline void BcUnpack565(uint16_t c, float out[3])
+{
+    int r5 = (c >> 11) & 31, g6 = (c >> 5) & 63, b5 = c & 31;
+    out[0] = (float)((r5 << 3) | (r5 >> 2));
+    out[1] = (float)((g6 << 2) | (g6 >> 4));
+    out[2] = (float)((b5 << 3) | (b5 >> 2));
+}
+
+//4-color palette for c0 > c1
+inline void BcPalette(uint16_t c0, uint16_t c1, float palette[4][3])
+{
+    BcUnpack565(c0, palette[0]);
+    BcUnpack565(c1, palette[1]);
+    for (int i = 0; i < 3; i++) {
+        palette[2][i] = (2.0f * palette[0][i] + palette[1][i]) / 3.0f;
+        palette[3][i] = (palette[0][i] + 2.0f * palette[1][i]) / 3.0f;
+    }
+}
+
+//nearest palette entry for every pixel, returns the summed squared error
+inline float BcMatchIndices(const BcBlock& block, const float palette[4][3], int indices[16])
+{
+    float error = 0.0f;
+#if defined(BC_SSE)
+    for (int p = 0; p < 16; p += 4) {
+        __m128 r = _mm_loadu_ps(block.r + p);
+        __m128 g = _mm_loadu_ps(block.g + p);
+        __m128 b = _mm_loadu_ps(block.b + p);
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int k = 0; k < 4; k++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best = _mm_min_ps(d, best);
+            bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+        }
+        _mm_storeu_si128((__m128i*)(indices + p), bestIndex);
+        float e[4];
+        _mm_storeu_ps(e, best);
+        error += e[0] + e[1] + e[2] + e[3];
+    }
+#else
+    for (int p = 0; p < 16; p++) {
+        float best = 1e30f;
+        for (int k = 0; k < 4; k++) {
+            float dr = block.r[p] - palette[k][0], dg = block.g[p] - palette[k][1], db = block.b[p] - palette[k][2];
+            float d = dr * dr + dg * dg + db * db;
+            if (d < best) {
+                best = d;
+                indices[p] = k;
+            }
+        }
+        error += best;
+    }
+#endif
+    return error;
+}
+
+//endpoints along the block's main color direction or at its bounding box corners
+inline void BcFindEndpoints(const BcBlock& block, bool principalAxis, float hi[3], float lo[3])
+{
+    float mn[3] = { 255, 255, 255 }, mx[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; p++) {
+        float c[3] = { block.r[p], block.g[p], block.b[p] };
+        for (int i = 0; i < 3; i++) {
+            mn[i] = c[i] < mn[i] ? c[i] : mn[i];
+            mx[i] = c[i] > mx[i] ? c[i] : mx[i];
+            mean[i] += c[i] / 16.0f;
+        }
+    }
+
+    if (principalAxis) {
+        float cov[6] = { 0 };
+        for (int p = 0; p < 16; p++) {
+            float d[3] = { block.r[p] - mean[0], block.g[p] - mean[1], block.b[p] - mean[2] };
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+        }
+        //power iteration, seeded with the bbox diagonal
+        float axis[3] = { mx[0] - mn[0], mx[1] - mn[1], mx[2] - mn[2] };
+        for (int it = 0; it < 8; it++) {
+            float v[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+            };
+            float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (len < 1e-6f) break;
+            axis[0] = v[0] / len; axis[1] = v[1] / len; axis[2] = v[2] / len;
+        }
+        float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (len > 1e-6f) {
+            float tMin = 1e30f, tMax = -1e30f;
+            for (int p = 0; p < 16; p++) {
+                float t = ((block.r[p] - mean[0]) * axis[0] + (block.g[p] - mean[1]) * axis[1] +
+                    (block.b[p] - mean[2]) * axis[2]) / len;
+                tMin = t < tMin ? t : tMin;
+                tMax = t > tMax ? t : tMax;
+            }
+            for (int i = 0; i < 3; i++) {
+                mn[i] = mean[i] + axis[i] / len * tMin;
+                mx[i] = mean[i] + axis[i] / len * tMax;
+            }
+        }
+    }
+
+    //pull the endpoints in a bit, the extremes are rarely the best fit
+    for (int i = 0; i < 3; i++) {
+        float inset = (mx[i] - mn[i]) / 16.0f;
+        hi[i] = mx[i] - inset;
+        lo[i] = mn[i] + inset;
+    }
+}
+
+//least squares endpoints for fixed indices (weights 1, 0, 2/3, 1/3 on c0)
+inline bool BcRefineEndpoints(const BcBlock& block, const int indices[16], float hi[3], float lo[3])
+{
+    static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0, ab = 0, bb = 0;
+    float ax[3] = { 0 }, bx[3] = { 0 };
+    for (int p = 0; p < 16; p++) {
+        float a = weight[indices[p]], b = 1.0f - a;
+        float c[3] = { block.r[p], block.g[p], block.b[p] };
+        aa += a * a; ab += a * b; bb += b * b;
+        for (int i = 0; i < 3; i++) {
+            ax[i] += a * c[i];
+            bx[i] += b * c[i];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f) return false;
+    for (int i = 0; i < 3; i++) {
+        hi[i] = (ax[i] * bb - bx[i] * ab) / det;
+        lo[i] = (bx[i] * aa - ax[i] * ab) / det;
+    }
+    return true;
+}
+
+inline void BcWriteColorBlock(uint16_t c0, uint16_t c1, const int indices[16], unsigned char* out)
+{
+    uint32_t bits = 0;
+    for (int p = 0; p < 16; p++) bits |= (uint32_t)indices[p] << (p * 2);
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    out[4] = bits & 0xFF; out[5] = (bits >> 8) & 0xFF;
+    out[6] = (bits >> 16) & 0xFF; out[7] = bits >> 24;
+}
+
+//quantizes the endpoints and matches indices, keeps the result if it beats best
+inline void BcTryEndpoints(const BcBlock& block, const float hi[3], const float lo[3],
+    uint16_t& bestC0, uint16_t& bestC1, int bestIndices[16], float& bestError)
+{
+    uint16_t c0 = BcPack565(hi[0], hi[1], hi[2]);
+    uint16_t c1 = BcPack565(lo[0], lo[1], lo[2]);
+    if (c0 < c1) {
+        uint16_t t = c0; c0 = c1; c1 = t;
+    }
+
+    int indices[16];
+    float error;
+    if (c0 == c1) {
+        //flat block, decodes in 3-color mode where index 0 is still c0
+        float flat[3];
+        BcUnpack565(c0, flat);
+        memset(indices, 0, sizeof(indices));
+        error = 0.0f;
+        for (int p = 0; p < 16; p++) {
+            float dr = block.r[p] - flat[0], dg = block.g[p] - flat[1], db = block.b[p] - flat[2];
+            error += dr * dr + dg * dg + db * db;
+        }
+    }
+    else {
+        float palette[4][3];
+        BcPalette(c0, c1, palette);
+        error = BcMatchIndices(block, palette, indices);
+    }
+
+    if (error < bestError) {
+        bestError = error;
+        bestC0 = c0;
+        bestC1 = c1;
+        memcpy(bestIndices, indices, sizeof(indices));
+    }
+}
+
+inline void BcEncodeColor(const BcBlock& block, BcQuality quality, unsigned char* out)
+{
+    uint16_t c0 = 0, c1 = 0;
+    int indices[16] = { 0 };
+    float error = 1e30f;
+
+    float hi[3], lo[3];
+    BcFindEndpoints(block, false, hi, lo);
+    BcTryEndpoints(block, hi, lo, c0, c1, indices, error);
+    if (quality != BC_QUALITY_FAST) {
+        BcFindEndpoints(block, true, hi, lo);
+        BcTryEndpoints(block, hi, lo, c0, c1, indices, error);
+    }
+    if (quality == BC_QUALITY_HIGH) {
+        for (int pass = 0; pass < 2 && c0 != c1; pass++) {
+            if (!BcRefineEndpoints(block, indices, hi, lo)) break;
+            BcTryEndpoints(block, hi, lo, c0, c1, indices, error);
+        }
+    }
+    BcWriteColorBlock(c0, c1, indices, out);
+}
+
+//8-value alpha mode (a0 > a1), 3-bit indices
+inline void BcEncodeAlpha(const BcBlock& block, unsigned char* out)
+{
+    float mn = 255.0f, mx = 0.0f;
+    for (int p = 0; p < 16; p++) {
+        mn = block.a[p] < mn ? block.a[p] : mn;
+        mx = block.a[p] > mx ? block.a[p] : mx;
+    }
+    int a0 = (int)(mx + 0.5f), a1 = (int)(mn + 0.5f);
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+
+    uint64_t bits = 0;
+    if (a0 > a1) {
+        float palette[8];
+        palette[0] = (float)a0;
+        palette[1] = (float)a1;
+        for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7.0f;
+        for (int p = 0; p < 16; p++) {
+            int best = 0;
+            float bestD = 1e30f;
+            for (int k = 0; k < 8; k++) {
+                float d = fabsf(block.a[p] - palette[k]);
+                if (d < bestD) {
+                    bestD = d;
+                    best = k;
+                }
+            }
+            bits |= (uint64_t)best << (p * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+//gathers a 4x4 block, edges are clamped for sizes that are not multiples of 4
+inline void BcLoadBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by, BcBlock& block)
+{
+    for (int y = 0; y < 4; y++) {
+        int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+        for (int x = 0; x < 4; x++) {
+            int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            const unsigned char* p = pixels + ((size_t)sy * width + sx) * channels;
+            int i = y * 4 + x;
+            block.r[i] = p[0];
+            block.g[i] = p[1];
+            block.b[i] = p[2];
+            block.a[i] = channels == 4 ? p[3] : 255.0f;
+        }
+    }
+}
+
+//channels 4 -> bc3, channels 3 -> bc1, out needs BcCompressedSize bytes
+inline void BcCompressImage(const unsigned char* pixels, int width, int height, int channels, BcQuality quality, unsigned char* out)
+{
+    bool alpha = channels == 4;
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    int blockBytes = BcBlockBytes(alpha);
+
+    GlobalThreadPool().parallelFor(blocksY, 4, [&](int begin, int end) {
+        BcBlock block;
+        for (int by = begin; by < end; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                unsigned char* dst = out + ((size_t)by * blocksX + bx) * blockBytes;
+                BcLoadBlock(pixels, width, height, channels, bx, by, block);
+                if (alpha) {
+                    BcEncodeAlpha(block, dst);
+                    dst += 8;
+                }
+                BcEncodeColor(block, quality, dst);
+            }
+        }
+    });
+}
+
+//decodes to rgba8, only used to measure the encoder
+inline void BcDecompressImage(const unsigned char* data, int width, int height, bool alpha, unsigned char* rgba)
+{
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    int blockBytes = BcBlockBytes(alpha);
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            const unsigned char* src = data + ((size_t)by * blocksX + bx) * blockBytes;
+            float alphaPalette[8];
+            uint64_t alphaBits = 0;
+            if (alpha) {
+                int a0 = src[0], a1 = src[1];
+                alphaPalette[0] = (float)a0;
+                alphaPalette[1] = (float)a1;
+                for (int i = 1; i < 7; i++) {
+                    alphaPalette[i + 1] = a0 > a1 ? ((7 - i) * a0 + i * a1) / 7.0f :
+                        (i < 5 ? ((5 - i) * a0 + i * a1) / 5.0f : (i == 5 ? 0.0f : 255.0f));
+                }
+                for (int i = 0; i < 6; i++) alphaBits |= (uint64_t)src[2 + i] << (i * 8);
+                src += 8;
+            }
+
+            uint16_t c0 = (uint16_t)(src[0] | (src[1] << 8));
+            uint16_t c1 = (uint16_t)(src[2] | (src[3] << 8));
+            uint32_t bits = src[4] | (src[5] << 8) | (src[6] << 16) | ((uint32_t)src[7] << 24);
+            float palette[4][3];
+            BcPalette(c0, c1, palette);
+            if (c0 <= c1) {
+                for (int i = 0; i < 3; i++) {
+                    palette[2][i] = (palette[0][i] + palette[1][i]) / 2.0f;
+                    palette[3][i] = 0.0f;
+                }
+            }
+
+            for (int p = 0; p < 16; p++) {
+                int x = bx * 4 + p % 4, y = by * 4 + p / 4;
+                if (x >= width || y >= height) continue;
+                int k = (bits >> (p * 2)) & 3;
+                unsigned char* d = rgba + ((size_t)y * width + x) * 4;
+                d[0] = (unsigned char)(palette[k][0] + 0.5f);
+                d[1] = (unsigned char)(palette[k][1] + 0.5f);
+                d[2] = (unsigned char)(palette[k][2] + 0.5f);
+                d[3] = alpha ? (unsigned char)(alphaPalette[(alphaBits >> (p * 3)) & 7] + 0.5f) : 255;
+            }
+        }
+    }
+}
+
+//over the channels that were actually encoded
+inline double BcPsnr(const unsigned char* source, int width, int height, int channels, const unsigned char* rgba)
+{
+    double sum = 0.0;
+    size_t count = (size_t)width * height;
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < channels; c++) {
+            double d = (double)source[i * channels + c] - rgba[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / ((double)count * channels);
+    return mse <= 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+//encodes the image at every quality and logs throughput and psnr
+inline void BcBenchmark(const char* name, const unsigned char* pixels, int width, int height, int channels)
+{
+    static const char* qualityNames[] = { "fast", "normal", "high" };
+    bool alpha = channels == 4;
+    std::vector<unsigned char> compressed(BcCompressedSize(width, height, alpha));
+    std::vector<unsigned char> decoded((size_t)width * height * 4);
+
+    for (int q = BC_QUALITY_FAST; q <= BC_QUALITY_HIGH; q++) {
+        const int runs = 5;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < runs; i++)
+            BcCompressImage(pixels, width, height, channels, (BcQuality)q, compressed.data());
+        double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() / runs;
+
+        BcDecompressImage(compressed.data(), width, height, alpha, decoded.data());
+        SDL_Log("%s %dx%d %s %s: %.1f MPixels/s, PSNR %.2f dB", name, width, height, alpha ? "BC3" : "BC1",
+            qualityNames[q], width * (double)height / seconds / 1e6, BcPsnr(pixels, width, height, channels, decoded.data()));
+    }
+}
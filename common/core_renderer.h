@@ -0,0 +1,1238 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <algorithm>
+#include <stddef.h>
+#include <vector>
+
+#include "alloc_tracker.h"
+#include "gl_ext.h"
+#include "gl_offscreen.h"
+#include "gl_shader.h"
+#include "golden_image.h"
+#include "input_latency.h"
+#include "math3d.h"
+#include "perf_counters.h"
+#include "perf_hud.h"
+#include "soft_raster.h"
+#include "thread_pool.h"
+
+//gl 3.3 core profile stand-in for the fixed-function calls the demos use:
+//begin/color/vertex/end work like glBegin and friends (quads, fans, strips
+//and line loops included), the model matrix stack replaces glPushMatrix and
+//glTranslatef and the camera goes to a uniform block shared by every shader.
+//vertices are moved to world space on the cpu as they come in and collected
+//into one buffer, so consecutive primitives of the same kind (triangles or
+//lines) go out in a single draw no matter how many glBegin-style runs or
+//matrix changes they span. lines wider than a pixel are expanded into quads
+//since core contexts only have 1 pixel lines.
+//static geometry doesn't go through that path: createMesh puts it in buffer
+//objects once and drawMesh only binds them, the vertex shader applies the
+//model matrix. drawMeshInstanced places one mesh many times from a position,
+//heading and color per instance. meshes with normals are lit by a headlight
+//like fixed-function light 0, textures modulate the color (immediate draws
+//take bindTexture and texCoord) and setFog fades everything with view depth
+//like linear GL_FOG.
+//--headless [frames] swaps the gl context for the software rasterizer on a
+//window from the dummy video driver, so the demos run without a gpu and
+//report triangles and pixels per second when done. meshes and textures are
+//kept on the cpu then, drawMesh lights, fogs and projects the vertices per
+//draw like the vertex shader and the rasterizer samples the texture (nearest,
+//level 0 only); fog is mixed into the vertex color, before the texture.
+//--dump-frames prefix then saves every 60th frame and the last one as
+//prefixNNNNN.bmp.
+//--bench [frames] keeps the gl context but hides the window and draws into an
+//fbo without presenting, timing every frame on the cpu and with gpu timer
+//queries. both run at the window size or --frame-size WxH, step the demos at
+//a fixed 60 hz and can check the last frame against --golden ref.bmp
+//(--golden-tolerance per channel, a missing reference fails unless
+//--update-golden writes the frame as the reference). on machines without a
+//gpu or display, run the bench under mesa's llvmpipe with
+//SDL_VIDEO_DRIVER=offscreen; llvmpipe's timer queries miss its rasterizer
+//threads, so there frames/s is what counts.
+//both also turn on the hardware counters and report each PerfCounterScope
+//the demos put around their simulation kernels. in ALLOC_TRACKING builds they
+//report heap allocations a frame after the warm-up, and --alloc-check fails
+//the run when any of those frames called new.
+//perf() is the frame timing overlay, present() feeds it the present stage and
+//gpu time and draws it on top when shown. latency() measures input to present:
+//present() closes the frame's inputs once the swap returns (the flush
+//offscreen), and runs with --input-probe push the event setInputProbe gave
+
+#define CORE_CAMERA_BINDING 0
+#define CORE_RUN_FRAMES 300
+#define CORE_DUMP_INTERVAL 60
+#define CORE_BENCH_WARMUP 10
+#define CORE_VERTEX_RESERVE 4096 //per batch, so ordinary frames never grow them
+
+//attribute locations of the core program
+enum CoreAttribute {
+    CORE_ATTRIB_POSITION,
+    CORE_ATTRIB_COLOR,
+    CORE_ATTRIB_NORMAL,
+    CORE_ATTRIB_UV,
+    CORE_ATTRIB_PLACE,          //per instance: position and heading
+    CORE_ATTRIB_INSTANCE_COLOR, //per instance
+    CORE_ATTRIB_COUNT
+};
+
+struct CoreVertex {
+    float position[3];
+    unsigned char color[4];
+    float uv[2];
+};
+
+//std140 layout of the Camera uniform block
+struct CoreCameraBlock {
+    Mat4 view;
+    Mat4 projection;
+    Mat4 viewProjection;
+    float eye[4];
+    float fogColor[4];
+    float fogRange[4]; //start, end, on
+};
+
+//the block as every core shader declares it
+#define CORE_CAMERA_GLSL \
+    "layout(std140) uniform Camera {\n" \
+    "    mat4 view;\n" \
+    "    mat4 projection;\n" \
+    "    mat4 viewProjection;\n" \
+    "    vec4 eye;\n" \
+    "    vec4 fogColor;\n" \
+    "    vec4 fogRange;\n" \
+    "};\n"
+
+//byte offsets into a vertex, -1 for attributes the mesh doesn't have.
+//positions are 3 floats, colors 4 bytes, normals 3 floats, uvs 2 floats
+struct CoreVertexLayout {
+    int stride;
+    int position;
+    int color;
+    int normal;
+    int uv;
+};
+
+//static geometry in buffer objects, see createMesh
+struct CoreMesh {
+    GLuint vertexArray = 0;
+    GLuint buffers[2] = {}; //vertices, indices
+    CoreVertexLayout layout = {};
+    GLenum indexType = 0;   //0 when the vertices are drawn in order
+    int vertexCount = 0;
+    int indexCount = 0;
+};
+
+//one placement of an instanced mesh, turned around +y then moved
+struct CoreInstance {
+    float position[3];
+    float heading; //radians, like glRotatef around +y
+    unsigned char color[4];
+};
+
+struct CoreTexture {
+    GLuint id = 0;
+    int width = 0;
+    int height = 0;
+};
+
+//asks for a 3.3 core context, call before creating the window
+inline void CoreRequestContext()
+{
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+}
+
+//glPushMatrix-style stack, rotate takes degrees like glRotatef
+class MatrixStack {
+public:
+    MatrixStack() { stack.push_back(Mat4Identity()); }
+
+    void push() { stack.push_back(stack.back()); }
+    void pop() { if (stack.size() > 1) stack.pop_back(); }
+    void loadIdentity() { stack.back() = Mat4Identity(); }
+    void load(const Mat4& m) { stack.back() = m; }
+    void multiply(const Mat4& m) { stack.back() = Mat4Mul(stack.back(), m); }
+    void translate(float x, float y, float z) { multiply(Mat4Translate(x, y, z)); }
+    void scale(float x, float y, float z) { multiply(Mat4Scale(x, y, z)); }
+    void rotate(float degrees, float x, float y, float z) { multiply(Mat4Rotate(degrees * 0.0174532925f, MakeVec3(x, y, z))); }
+    const Mat4& top() const { return stack.back(); }
+
+private:
+    std::vector<Mat4> stack;
+};
+
+class CoreRenderer {
+public:
+    //reads the command line, before SDL_Init since headless picks the video driver
+    void configure(int argc, char* argv[]) {
+        for (int i = 1; i < argc; i++) {
+            bool headlessFlag = SDL_strcmp(argv[i], "--headless") == 0;
+            bool benchFlag = SDL_strcmp(argv[i], "--bench") == 0;
+            if (headlessFlag || benchFlag) {
+                headless = headlessFlag;
+                bench = benchFlag;
+                if (i + 1 < argc && SDL_atoi(argv[i + 1]) > 0) runFrames = SDL_atoi(argv[++i]);
+            }
+            else if (SDL_strcmp(argv[i], "--frame-size") == 0 && i + 1 < argc) {
+                if (SDL_sscanf(argv[++i], "%dx%d", &frameWidth, &frameHeight) != 2 || frameWidth <= 0 || frameHeight <= 0)
+                    frameWidth = frameHeight = 0;
+            }
+            else if (SDL_strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc) dumpPrefix = argv[++i];
+            else if (SDL_strcmp(argv[i], "--golden") == 0 && i + 1 < argc) goldenPath = argv[++i];
+            else if (SDL_strcmp(argv[i], "--golden-tolerance") == 0 && i + 1 < argc) goldenTolerance = SDL_atoi(argv[++i]);
+            else if (SDL_strcmp(argv[i], "--update-golden") == 0) updateGolden = true;
+            else if (SDL_strcmp(argv[i], "--alloc-check") == 0) allocCheck = true;
+        }
+        AllocTrackerConfigure(argc, argv);
+        ThreadPoolConfigure(argc, argv);
+        InputLatencyConfigure(argc, argv);
+        if (headless || bench) PerfCountersEnable();
+        if (headless) SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+        else if (!bench && (dumpPrefix || goldenPath || allocCheck)) SDL_Log("--dump-frames, --golden and --alloc-check need --headless or --bench");
+    }
+
+    //the window with a 3.3 core context, or a plain one and a framebuffer of its size when headless
+    SDL_Window* createWindow(const char* title, int width, int height, SDL_WindowFlags flags) {
+        if (frameWidth == 0) {
+            frameWidth = width;
+            frameHeight = height;
+        }
+        run.reserve(CORE_VERTEX_RESERVE);
+        pending.reserve(CORE_VERTEX_RESERVE);
+        if (headless) {
+            softVertices.reserve(CORE_VERTEX_RESERVE);
+            SDL_Window* w = SDL_CreateWindow(title, width, height, flags & ~(SDL_WindowFlags)SDL_WINDOW_OPENGL);
+            if (!w) return NULL;
+            raster.setThreadPool(&GlobalThreadPool());
+            setViewport(width, height);
+            runStart = SDL_GetPerformanceCounter();
+            return w;
+        }
+        CoreRequestContext();
+        if (bench) flags |= SDL_WINDOW_HIDDEN;
+        SDL_Window* w = SDL_CreateWindow(title, width, height, flags);
+        if (!w) return NULL;
+        context = SDL_GL_CreateContext(w);
+        if (!context || !init() || (bench && !initBench())) {
+            SDL_Log("Couldn't create a 3.3 core context: %s", SDL_GetError());
+            if (context) SDL_GL_DestroyContext(context);
+            context = NULL;
+            SDL_DestroyWindow(w);
+            return NULL;
+        }
+        window = w;
+        setViewport(width, height);
+        //bench frames are timed for the report, the others for the overlay
+        gpuTiming = bench || LoadGLQueryExt();
+        if (gpuTiming) {
+            gpuTimer.init();
+            gpuTimer.begin();
+        }
+        runStart = frameStart = SDL_GetPerformanceCounter();
+        return w;
+    }
+
+    bool isHeadless() const { return headless; }
+    //headless or bench, the runs that step a fixed 60 hz a frame
+    bool isOffscreen() const { return headless || bench; }
+    const SoftRasterizer& softwareFramebuffer() const { return raster; }
+
+    void setClearColor(float r, float g, float b, float a) {
+        clearColor[0] = r;
+        clearColor[1] = g;
+        clearColor[2] = b;
+        clearColor[3] = a;
+        if (!headless) glClearColor(r, g, b, a);
+    }
+
+    void clear(bool clearDepth) {
+        flush();
+        if (headless) raster.clear(clearColor, clearDepth);
+        else glClear(GL_COLOR_BUFFER_BIT | (clearDepth ? GL_DEPTH_BUFFER_BIT : 0));
+    }
+
+    void setDepthTest(bool enabled) {
+        flush();
+        depthTest = enabled;
+        if (headless) raster.setDepthTest(enabled);
+        else if (enabled) glEnable(GL_DEPTH_TEST);
+        else glDisable(GL_DEPTH_TEST);
+    }
+
+    //ends the frame, false once a headless or bench run has drawn all its frames
+    bool present() {
+        if (perfHud.visible()) drawPerfHud();
+        if (!headless && !bench) {
+            {
+                PerfScope scope(perfHud, "present");
+                flush();
+                if (gpuTiming) gpuTimer.end();
+                SDL_GL_SwapWindow(window);
+            }
+            inputLatency.presented();
+            if (gpuTiming) {
+                for (double ms : gpuTimer.milliseconds()) perfHud.addGpu(ms);
+                gpuTimer.clearResults();
+                gpuTimer.begin();
+            }
+            perfHud.endFrame();
+            return true;
+        }
+        flush();
+        perfHud.endFrame();
+        if (headless) {
+            raster.flush();
+            SoftRasterStats s = raster.takeStats();
+            runStats.triangles += s.triangles;
+            runStats.pixels += s.pixels;
+            runStats.milliseconds += s.milliseconds;
+        }
+        else {
+            //no swap to submit the frame, so flush like one would
+            gpuTimer.end();
+            glFlush();
+            cpuMilliseconds.push_back((double)(SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency());
+        }
+        inputLatency.presented();
+        frame++;
+        if (frame == CORE_BENCH_WARMUP) {
+            if (bench) PerfCountersReset();
+            AllocTrackerReset();
+        }
+        countFrameAllocations();
+        if (dumpPrefix && (frame % CORE_DUMP_INTERVAL == 1 || frame == runFrames)) {
+            char path[512];
+            SDL_snprintf(path, sizeof(path), "%s%05d.bmp", dumpPrefix, frame);
+            int w, h, stride;
+            const uint32_t* pixels = readFrame(&w, &h, &stride);
+            if (!SaveRgbaBmp(path, pixels, w, h, stride)) SDL_Log("Couldn't write %s: %s", path, SDL_GetError());
+        }
+        int probe = InputLatencyConfig().probe;
+        if (probe > 0 && probeEvent.type && frame % probe == 0) {
+            SDL_Event e = probeEvent;
+            e.common.timestamp = 0; //stamped when pushed
+            SDL_PushEvent(&e);
+        }
+        if (frame < runFrames) {
+            if (bench) {
+                frameStart = SDL_GetPerformanceCounter();
+                gpuTimer.begin();
+            }
+            return true;
+        }
+
+        if (headless) reportHeadless();
+        else reportBench();
+        if (goldenPath) checkGolden();
+        return false;
+    }
+
+    //what AppIterate returns once present() is done: failure if the golden or allocation check failed
+    SDL_AppResult runResult() const { return goldenFailed || allocFailed ? SDL_APP_FAILURE : SDL_APP_SUCCESS; }
+
+    //seconds to advance the simulation by: the measured frame time, or a fixed
+    //60 hz step offscreen so runs repeat exactly and golden images stay valid
+    float frameTime(float measured) const { return headless || bench ? 1.0f / 60.0f : measured; }
+
+    //the last frame as rgba8 rows top to bottom, reads the fbo back when benchmarking
+    const uint32_t* readFrame(int* w, int* h, int* stride) {
+        if (headless) {
+            raster.flush();
+            *w = raster.frameWidth();
+            *h = raster.frameHeight();
+            *stride = raster.rowStride();
+            return raster.pixels();
+        }
+        target.read(&readback);
+        *w = *stride = target.frameWidth();
+        *h = target.frameHeight();
+        return readback.data();
+    }
+
+    //needs a current 3.3 core context
+    bool init() {
+        if (!LoadGLCoreExt()) {
+            SDL_Log("Couldn't load the gl 3.3 core entry points");
+            return false;
+        }
+        static const char* const attributes[CORE_ATTRIB_COUNT] = { "position", "color", "normal", "uv", "place", "instanceColor" };
+        program = LinkProgram(vertexSource(), fragmentSource(), "core", attributes, CORE_ATTRIB_COUNT);
+        if (!program) return false;
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Camera"), CORE_CAMERA_BINDING);
+        modelUniform = glGetUniformLocation(program, "model");
+        tintUniform = glGetUniformLocation(program, "tint");
+        optionsUniform = glGetUniformLocation(program, "options");
+
+        GLuint buffers[3];
+        glGenBuffers(3, buffers);
+        vertexBuffer = buffers[0];
+        cameraBuffer = buffers[1];
+        instanceBuffer = buffers[2];
+
+        //untextured draws sample this, so one shader covers both
+        const unsigned char white[4] = { 255, 255, 255, 255 };
+        createTexture(&whiteTexture, 1, 1, 4, white, GL_REPEAT);
+        glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CoreCameraBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, CORE_CAMERA_BINDING, cameraBuffer);
+
+        //the attribute layout lives in the vao, the buffer is respecified every flush
+        glGenVertexArrays(1, &vertexArray);
+        setupVertexArray(vertexArray, vertexBuffer);
+
+        setCamera(Mat4Identity(), Mat4Identity());
+        return true;
+    }
+
+    //also destroys the context createWindow made
+    void shutdown() {
+        if (!headless && !bench && InputLatencyConfig().report) inputLatency.report("Latency");
+        gpuTimer.shutdown();
+        target.destroy();
+        if (program) glDeleteProgram(program);
+        if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+        if (vertexBuffer) {
+            GLuint buffers[3] = { vertexBuffer, cameraBuffer, instanceBuffer };
+            glDeleteBuffers(3, buffers);
+        }
+        destroyTexture(&whiteTexture);
+        if (hudVertexArrays[0]) {
+            glDeleteVertexArrays(2, hudVertexArrays);
+            glDeleteBuffers(2, hudBuffers);
+        }
+        program = vertexArray = vertexBuffer = cameraBuffer = instanceBuffer = 0;
+        hudVertexArrays[0] = hudVertexArrays[1] = hudBuffers[0] = hudBuffers[1] = 0;
+        if (context) SDL_GL_DestroyContext(context);
+        context = NULL;
+    }
+
+    //glViewport, the size is also what wide lines are measured against.
+    //headless or benchmarking it is always the frame size instead
+    void setViewport(int width, int height) {
+        flush();
+        if (headless || bench) {
+            width = frameWidth;
+            height = frameHeight;
+        }
+        viewportWidth = width;
+        viewportHeight = height;
+        if (headless) {
+            if (raster.frameWidth() != width || raster.frameHeight() != height) raster.resize(width, height);
+        }
+        else {
+            glViewport(0, 0, width, height);
+        }
+    }
+
+    //uploads the camera block, the eye assumes a view without scale
+    void setCamera(const Mat4& view, const Mat4& projection) {
+        flush();
+        camera.view = view;
+        camera.projection = projection;
+        camera.viewProjection = Mat4Mul(projection, view);
+        Mat4 inverse = Mat4RigidInverse(view);
+        camera.eye[0] = inverse.m[12];
+        camera.eye[1] = inverse.m[13];
+        camera.eye[2] = inverse.m[14];
+        camera.eye[3] = 1.0f;
+        uploadCamera();
+    }
+
+    //linear fog by view depth like GL_FOG_MODE GL_LINEAR, on every draw until disableFog
+    void setFog(const float color[3], float start, float end) {
+        flush();
+        for (int k = 0; k < 3; k++) camera.fogColor[k] = color[k];
+        camera.fogColor[3] = 1.0f;
+        camera.fogRange[0] = start;
+        camera.fogRange[1] = end > start ? end : start + 1.0f;
+        camera.fogRange[2] = 1.0f;
+        uploadCamera();
+    }
+
+    void disableFog() {
+        flush();
+        camera.fogRange[2] = 0.0f;
+        uploadCamera();
+    }
+
+    const CoreCameraBlock& cameraBlock() const { return camera; }
+    void viewportSize(int* width, int* height) const {
+        *width = viewportWidth;
+        *height = viewportHeight;
+    }
+    MatrixStack& model() { return modelStack; }
+    PerfHud& perf() { return perfHud; }
+    InputLatency& latency() { return inputLatency; }
+
+    //what --input-probe pushes offscreen, an input the demo reacts to visibly
+    void setInputProbe(const SDL_Event& event) { probeEvent = event; }
+
+    void begin(GLenum primitive) {
+        mode = primitive;
+        run.clear();
+    }
+
+    void color(float r, float g, float b, float a = 1.0f) {
+        current[0] = toByte(r);
+        current[1] = toByte(g);
+        current[2] = toByte(b);
+        current[3] = toByte(a);
+    }
+
+    void texCoord(float u, float v) {
+        currentUv[0] = u;
+        currentUv[1] = v;
+    }
+
+    void vertex(float x, float y, float z = 0.0f) {
+        Vec3 p = Mat4TransformPoint(modelStack.top(), MakeVec3(x, y, z));
+        CoreVertex v = { { p.x, p.y, p.z }, { current[0], current[1], current[2], current[3] }, { currentUv[0], currentUv[1] } };
+        run.push_back(v);
+    }
+
+    //the texture immediate draws sample from here on, null for none.
+    //switching flushes what was drawn with the previous one
+    void bindTexture(const CoreTexture* texture) {
+        if (texture == immediateTexture) return;
+        flush();
+        immediateTexture = texture;
+    }
+
+    //turns the run into triangles or lines
+    void end() {
+        size_t n = run.size();
+        switch (mode) {
+        case GL_TRIANGLES:
+            for (size_t i = 0; i + 2 < n; i += 3) triangle(run[i], run[i + 1], run[i + 2]);
+            break;
+        case GL_TRIANGLE_FAN:
+            for (size_t i = 1; i + 1 < n; i++) triangle(run[0], run[i], run[i + 1]);
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (size_t i = 0; i + 2 < n; i++) {
+                if (i & 1) triangle(run[i + 1], run[i], run[i + 2]);
+                else triangle(run[i], run[i + 1], run[i + 2]);
+            }
+            break;
+        case GL_QUADS:
+            for (size_t i = 0; i + 3 < n; i += 4) {
+                triangle(run[i], run[i + 1], run[i + 2]);
+                triangle(run[i], run[i + 2], run[i + 3]);
+            }
+            break;
+        case GL_LINES:
+            for (size_t i = 0; i + 1 < n; i += 2) line(run[i], run[i + 1]);
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (size_t i = 0; i + 1 < n; i++) line(run[i], run[i + 1]);
+            if (mode == GL_LINE_LOOP && n > 2) line(run[n - 1], run[0]);
+            break;
+        }
+        run.clear();
+    }
+
+    //in pixels like glLineWidth
+    void lineWidth(float pixels) { width = pixels; }
+
+    //draws everything collected so far, present() does it at the end of the frame.
+    //headless it is projected here and binned, the tiles are rasterized in present()
+    void flush() {
+        if (pending.empty()) return;
+        if (headless) {
+            softVertices.resize(pending.size());
+            bool fog = camera.fogRange[2] > 0.5f;
+            for (size_t i = 0; i < pending.size(); i++) {
+                const CoreVertex& v = pending[i];
+                SoftVertex& out = softVertices[i];
+                Mat4TransformPoint4(camera.viewProjection, MakeVec3(v.position[0], v.position[1], v.position[2]), out.clip);
+                for (int k = 0; k < 4; k++) out.color[k] = v.color[k] / 255.0f;
+                if (fog) applyFog(out.color, -Mat4TransformPoint(camera.view, MakeVec3(v.position[0], v.position[1], v.position[2])).z);
+                out.uv[0] = v.uv[0];
+                out.uv[1] = v.uv[1];
+            }
+            if (pendingLines) raster.drawLines(softVertices.data(), softVertices.size());
+            else raster.drawTriangles(softVertices.data(), softVertices.size(), softTexture(immediateTexture));
+            draws++;
+            vertices += (long long)pending.size();
+            pending.clear();
+            return;
+        }
+        useProgram(Mat4Identity(), nullptr, true, false, false, immediateTexture);
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, pending.size() * sizeof(CoreVertex), pending.data(), GL_STREAM_DRAW);
+        glDrawArrays(pendingLines ? GL_LINES : GL_TRIANGLES, 0, (GLsizei)pending.size());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        draws++;
+        vertices += (long long)pending.size();
+        pending.clear();
+    }
+
+    //draw calls and vertices since the last call
+    void takeStats(int* drawCalls, long long* vertexCount) {
+        *drawCalls = draws;
+        *vertexCount = vertices;
+        draws = 0;
+        vertices = 0;
+    }
+
+    //uploads static geometry once, drawing it only binds the buffers.
+    //indexSize is 2 or 4 bytes, indices null draws the vertices in order.
+    //a mesh that already exists keeps its buffers and gets the new contents.
+    //headless the vertices and indices are copied instead
+    void createMesh(CoreMesh* mesh, const CoreVertexLayout& layout, const void* vertexData, int vertexCount,
+        const void* indexData = nullptr, int indexCount = 0, int indexSize = 2) {
+        mesh->layout = layout;
+        mesh->vertexCount = vertexCount;
+        mesh->indexCount = indexData ? indexCount : 0;
+        mesh->indexType = !indexData ? 0 : indexSize == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        if (headless) {
+            if (!mesh->vertexArray) mesh->vertexArray = softSlot(softMeshes, freeSoftMeshes);
+            SoftMesh& copy = softMeshes[mesh->vertexArray - 1];
+            const unsigned char* bytes = (const unsigned char*)vertexData;
+            copy.vertices.assign(bytes, bytes + (size_t)vertexCount * layout.stride);
+            copy.indices.resize(mesh->indexCount);
+            for (int i = 0; i < mesh->indexCount; i++)
+                copy.indices[i] = indexSize == 4 ? ((const uint32_t*)indexData)[i] : ((const uint16_t*)indexData)[i];
+            return;
+        }
+        if (!mesh->vertexArray) {
+            glGenVertexArrays(1, &mesh->vertexArray);
+            glGenBuffers(2, mesh->buffers);
+        }
+        glBindVertexArray(mesh->vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)vertexCount * layout.stride, vertexData, GL_STATIC_DRAW);
+        const int offsets[4] = { layout.position, layout.color, layout.normal, layout.uv };
+        const GLint sizes[4] = { 3, 4, 3, 2 };
+        for (GLuint a = 0; a < 4; a++) {
+            if (offsets[a] < 0) {
+                glDisableVertexAttribArray(a);
+                continue;
+            }
+            GLenum type = a == CORE_ATTRIB_COLOR ? GL_UNSIGNED_BYTE : GL_FLOAT;
+            glEnableVertexAttribArray(a);
+            glVertexAttribPointer(a, sizes[a], type, type == GL_UNSIGNED_BYTE, layout.stride, (const void*)(size_t)offsets[a]);
+        }
+        //the element buffer binding belongs to the vao
+        if (indexData) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->buffers[1]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)indexCount * indexSize, indexData, GL_STATIC_DRAW);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void destroyMesh(CoreMesh* mesh) {
+        if (headless && mesh->vertexArray) {
+            //the slot keeps its capacity, streamed meshes like terrain chunks
+            //come back at the same size and don't allocate again
+            SoftMesh& copy = softMeshes[mesh->vertexArray - 1];
+            copy.vertices.clear();
+            copy.indices.clear();
+            freeSoftMeshes.push_back(mesh->vertexArray);
+        }
+        else if (mesh->vertexArray) {
+            glDeleteVertexArrays(1, &mesh->vertexArray);
+            glDeleteBuffers(2, mesh->buffers);
+        }
+        *mesh = CoreMesh();
+    }
+
+    //the whole mesh under model, tinted by color (white when null). meshes
+    //with colors multiply them in, meshes with normals are lit
+    void drawMesh(const CoreMesh& mesh, const Mat4& model, const float color[4] = nullptr, const CoreTexture* texture = nullptr) {
+        if (!mesh.vertexArray) return;
+        flush();
+        if (headless) {
+            drawSoftMesh(mesh, nullptr, 1, model, color, texture);
+            return;
+        }
+        useProgram(model, color, mesh.layout.color >= 0, mesh.layout.normal >= 0, false, texture);
+        glBindVertexArray(mesh.vertexArray);
+        drawElements(mesh, 1);
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    //count copies of the mesh in one draw, each under its instance's
+    //placement times model and tinted by its color
+    void drawMeshInstanced(const CoreMesh& mesh, const CoreInstance* instances, int count, const Mat4& model,
+        const CoreTexture* texture = nullptr) {
+        if (!mesh.vertexArray || count <= 0) return;
+        flush();
+        if (headless) {
+            drawSoftMesh(mesh, instances, count, model, nullptr, texture);
+            return;
+        }
+        useProgram(model, nullptr, mesh.layout.color >= 0, mesh.layout.normal >= 0, true, texture);
+        glBindVertexArray(mesh.vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)count * sizeof(CoreInstance), instances, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(CORE_ATTRIB_PLACE);
+        glEnableVertexAttribArray(CORE_ATTRIB_INSTANCE_COLOR);
+        glVertexAttribPointer(CORE_ATTRIB_PLACE, 4, GL_FLOAT, GL_FALSE, sizeof(CoreInstance), (const void*)offsetof(CoreInstance, position));
+        glVertexAttribPointer(CORE_ATTRIB_INSTANCE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CoreInstance), (const void*)offsetof(CoreInstance, color));
+        glVertexAttribDivisor(CORE_ATTRIB_PLACE, 1);
+        glVertexAttribDivisor(CORE_ATTRIB_INSTANCE_COLOR, 1);
+        drawElements(mesh, count);
+        //the mesh's vao draws uninstanced too, leave it as createMesh set it up
+        glDisableVertexAttribArray(CORE_ATTRIB_PLACE);
+        glDisableVertexAttribArray(CORE_ATTRIB_INSTANCE_COLOR);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+    }
+
+    //rgb or rgba8 texture with linear filtering, data may be null and filled in later with updateTexture
+    void createTexture(CoreTexture* texture, int width, int height, int channels, const void* data, GLint wrap) {
+        texture->width = width;
+        texture->height = height;
+        if (headless) {
+            //binned triangles point at the slots until the tiles are rasterized
+            raster.flush();
+            texture->id = softSlot(softTextures, freeSoftTextures);
+            SoftTextureCopy& copy = softTextures[texture->id - 1];
+            copy.pixels.assign((size_t)width * height, 0);
+            copy.texture = { width, height, copy.pixels.data() };
+            if (data) storeTexels(copy, 0, 0, width, height, channels, data);
+            return;
+        }
+        GLenum format = channels == 4 ? GL_RGBA : GL_RGB;
+        glGenTextures(1, &texture->id);
+        glBindTexture(GL_TEXTURE_2D, texture->id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_RGB8, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    //a tightly packed rectangle of texels
+    void updateTexture(CoreTexture* texture, int x, int y, int width, int height, int channels, const void* data) {
+        flush();
+        if (headless) {
+            raster.flush();
+            storeTexels(softTextures[texture->id - 1], x, y, width, height, channels, data);
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture->id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void destroyTexture(CoreTexture* texture) {
+        if (texture == immediateTexture) bindTexture(nullptr);
+        if (headless && texture->id) {
+            raster.flush();
+            softTextures[texture->id - 1] = SoftTextureCopy();
+            freeSoftTextures.push_back(texture->id);
+        }
+        else if (texture->id) glDeleteTextures(1, &texture->id);
+        *texture = CoreTexture();
+    }
+
+private:
+    //what headless keeps of a mesh and a texture
+    struct SoftMesh {
+        std::vector<unsigned char> vertices;
+        std::vector<uint32_t> indices;
+    };
+    struct SoftTextureCopy {
+        SoftTexture texture = {};
+        std::vector<uint32_t> pixels;
+    };
+
+    static void setupVertexArray(GLuint vao, GLuint buffer) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glEnableVertexAttribArray(CORE_ATTRIB_POSITION);
+        glEnableVertexAttribArray(CORE_ATTRIB_COLOR);
+        glEnableVertexAttribArray(CORE_ATTRIB_UV);
+        glVertexAttribPointer(CORE_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(CoreVertex), (const void*)offsetof(CoreVertex, position));
+        glVertexAttribPointer(CORE_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CoreVertex), (const void*)offsetof(CoreVertex, color));
+        glVertexAttribPointer(CORE_ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, sizeof(CoreVertex), (const void*)offsetof(CoreVertex, uv));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    //the per draw uniforms of the core program and its texture
+    void useProgram(const Mat4& model, const float color[4], bool vertexColors, bool lit, bool instanced, const CoreTexture* texture) {
+        static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        const float* tint = color ? color : white;
+        glUseProgram(program);
+        glUniformMatrix4fv(modelUniform, 1, GL_FALSE, model.m);
+        glUniform4f(tintUniform, tint[0], tint[1], tint[2], tint[3]);
+        glUniform4f(optionsUniform, vertexColors ? 1.0f : 0.0f, lit ? 1.0f : 0.0f, instanced ? 1.0f : 0.0f, 0.0f);
+        glBindTexture(GL_TEXTURE_2D, texture && texture->id ? texture->id : whiteTexture.id);
+    }
+
+    //with the mesh's vao bound
+    void drawElements(const CoreMesh& mesh, int instances) {
+        int count = mesh.indexType ? mesh.indexCount : mesh.vertexCount;
+        if (mesh.indexType) glDrawElementsInstanced(GL_TRIANGLES, count, mesh.indexType, nullptr, instances);
+        else glDrawArraysInstanced(GL_TRIANGLES, 0, count, instances);
+        draws++;
+        vertices += (long long)count * instances;
+    }
+
+    //a free slot of a headless mesh or texture table, its index plus one like a gl name
+    template <typename T>
+    static GLuint softSlot(std::vector<T>& slots, std::vector<GLuint>& free) {
+        if (free.empty()) {
+            slots.emplace_back();
+            return (GLuint)slots.size();
+        }
+        GLuint slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+
+    static void storeTexels(SoftTextureCopy& copy, int x, int y, int width, int height, int channels, const void* data) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (int row = 0; row < height; row++) {
+            uint32_t* out = copy.pixels.data() + (size_t)(y + row) * copy.texture.width + x;
+            for (int column = 0; column < width; column++, p += channels) {
+                uint32_t alpha = channels == 4 ? p[3] : 255;
+                out[column] = p[0] | p[1] << 8 | p[2] << 16 | alpha << 24;
+            }
+        }
+    }
+
+    const SoftTexture* softTexture(const CoreTexture* texture) const {
+        return texture && texture->id ? &softTextures[texture->id - 1].texture : nullptr;
+    }
+
+    //linear fog of the camera block at a view depth
+    void applyFog(float color[4], float depth) const {
+        float f = (depth - camera.fogRange[0]) / (camera.fogRange[1] - camera.fogRange[0]);
+        f = f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+        for (int k = 0; k < 3; k++) color[k] += (camera.fogColor[k] - color[k]) * f;
+    }
+
+    //what the core vertex shader does, on the cpu: every instance (or just
+    //model without instances) is transformed, tinted, lit and fogged, then
+    //the indexed triangles go to the rasterizer in one batch
+    void drawSoftMesh(const CoreMesh& mesh, const CoreInstance* instances, int count, const Mat4& model, const float color[4],
+        const CoreTexture* texture) {
+        static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        const SoftMesh& source = softMeshes[mesh.vertexArray - 1];
+        const CoreVertexLayout& layout = mesh.layout;
+        int elements = mesh.indexType ? mesh.indexCount : mesh.vertexCount;
+        bool fog = camera.fogRange[2] > 0.5f;
+        meshVertices.resize(mesh.vertexCount);
+        softVertices.resize((size_t)elements * count);
+        SoftVertex* out = softVertices.data();
+        for (int i = 0; i < count; i++) {
+            Mat4 world = model;
+            float tint[4];
+            for (int k = 0; k < 4; k++) tint[k] = color ? color[k] : white[k];
+            if (instances) {
+                const CoreInstance& instance = instances[i];
+                float c = cosf(instance.heading), s = sinf(instance.heading);
+                Mat4 place = { { c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f,
+                    instance.position[0], instance.position[1], instance.position[2], 1.0f } };
+                world = Mat4Mul(place, model);
+                for (int k = 0; k < 4; k++) tint[k] *= instance.color[k] / 255.0f;
+            }
+            Mat4 modelView = Mat4Mul(camera.view, world);
+            Mat4 clip = Mat4Mul(camera.projection, modelView);
+            //normals go through the inverse transpose, here as the cofactors
+            //of the upper 3x3 signed by its determinant
+            Vec3 a = MakeVec3(modelView.m[0], modelView.m[1], modelView.m[2]);
+            Vec3 b = MakeVec3(modelView.m[4], modelView.m[5], modelView.m[6]);
+            Vec3 c = MakeVec3(modelView.m[8], modelView.m[9], modelView.m[10]);
+            Vec3 bc = Vec3Cross(b, c), ca = Vec3Cross(c, a), ab = Vec3Cross(a, b);
+            float handedness = Vec3Dot(a, bc) < 0.0f ? -1.0f : 1.0f;
+
+            for (int v = 0; v < mesh.vertexCount; v++) {
+                const unsigned char* p = source.vertices.data() + (size_t)v * layout.stride;
+                SoftVertex& vertex = meshVertices[v];
+                float position[3];
+                memcpy(position, p + layout.position, sizeof(position));
+                Vec3 point = MakeVec3(position[0], position[1], position[2]);
+                Mat4TransformPoint4(clip, point, vertex.clip);
+                for (int k = 0; k < 4; k++) vertex.color[k] = tint[k] * (layout.color >= 0 ? p[layout.color + k] / 255.0f : 1.0f);
+                if (layout.normal >= 0) {
+                    float n[3];
+                    memcpy(n, p + layout.normal, sizeof(n));
+                    Vec3 normal = Vec3Add(Vec3Add(Vec3Scale(bc, n[0]), Vec3Scale(ca, n[1])), Vec3Scale(ab, n[2]));
+                    float length = Vec3Length(normal);
+                    float facing = length > 0.0f ? normal.z / length * handedness : 0.0f;
+                    float light = 0.2f + (facing > 0.0f ? facing : 0.0f);
+                    if (light > 1.0f) light = 1.0f;
+                    for (int k = 0; k < 3; k++) vertex.color[k] *= light;
+                }
+                if (fog) applyFog(vertex.color, -Mat4TransformPoint(modelView, point).z);
+                if (layout.uv >= 0) memcpy(vertex.uv, p + layout.uv, sizeof(vertex.uv));
+                else vertex.uv[0] = vertex.uv[1] = 0.0f;
+            }
+            for (int e = 0; e < elements; e++) *out++ = meshVertices[mesh.indexType ? source.indices[e] : e];
+        }
+        raster.drawTriangles(softVertices.data(), softVertices.size(), softTexture(texture));
+        draws++;
+        vertices += (long long)elements * count;
+    }
+
+    void uploadCamera() {
+        if (headless) return;
+        glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CoreCameraBlock), &camera);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    static unsigned char toByte(float c) {
+        return (unsigned char)(c <= 0.0f ? 0 : c >= 1.0f ? 255 : c * 255.0f + 0.5f);
+    }
+
+    //switching between triangles and lines flushes, so draw order stays as issued
+    void want(bool lines) {
+        if (pendingLines != lines) flush();
+        pendingLines = lines;
+    }
+
+    void triangle(const CoreVertex& a, const CoreVertex& b, const CoreVertex& c) {
+        want(false);
+        pending.push_back(a);
+        pending.push_back(b);
+        pending.push_back(c);
+    }
+
+    //wide lines become quads across the segment in the xy plane, sized for the
+    //projection's x scale (exact for the 2d ortho views)
+    void line(const CoreVertex& a, const CoreVertex& b) {
+        if (width <= 1.0f) {
+            want(true);
+            pending.push_back(a);
+            pending.push_back(b);
+            return;
+        }
+        float dx = b.position[0] - a.position[0], dy = b.position[1] - a.position[1];
+        float length = sqrtf(dx * dx + dy * dy);
+        if (length <= 0.0f) return;
+        float scale = camera.projection.m[0] * viewportWidth;
+        float half = scale != 0.0f ? width / fabsf(scale) : 0.0f;
+        float nx = -dy / length * half, ny = dx / length * half;
+        CoreVertex corners[4] = { a, b, b, a };
+        const float offsets[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+        for (int k = 0; k < 4; k++) {
+            corners[k].position[0] += nx * offsets[k];
+            corners[k].position[1] += ny * offsets[k];
+        }
+        triangle(corners[0], corners[1], corners[2]);
+        triangle(corners[0], corners[2], corners[3]);
+    }
+
+    //hidden window, frames go to an fbo of the frame size and get timed instead of shown
+    bool initBench() {
+        if (!LoadGLFramebufferExt() || !LoadGLQueryExt()) {
+            SDL_Log("Couldn't load the framebuffer and timer query entry points");
+            return false;
+        }
+        if (!target.create(frameWidth, frameHeight)) {
+            SDL_Log("Couldn't create a %dx%d framebuffer", frameWidth, frameHeight);
+            return false;
+        }
+        target.bind();
+        cpuMilliseconds.reserve(runFrames);
+        gpuTimer.reserve(runFrames);
+        SDL_Log("Bench: %s, %s", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+        return true;
+    }
+
+    void reportHeadless() {
+        double seconds = runStats.milliseconds / 1000.0;
+        SDL_Log("Headless: %d frames at %dx%d on %d threads in %.2f s, %.0f triangles and %.0f pixels a frame",
+            frame, raster.frameWidth(), raster.frameHeight(), GlobalThreadPool().threadCount() + 1,
+            (double)(SDL_GetPerformanceCounter() - runStart) / SDL_GetPerformanceFrequency(),
+            (double)runStats.triangles / frame, (double)runStats.pixels / frame);
+        SDL_Log("Headless: %.3f ms a frame rasterizing, %.2f M triangles/s, %.1f M pixels/s",
+            runStats.milliseconds / frame, seconds > 0.0 ? runStats.triangles / seconds / 1e6 : 0.0,
+            seconds > 0.0 ? runStats.pixels / seconds / 1e6 : 0.0);
+        PerfCountersReport("Headless");
+        inputLatency.report("Headless");
+        reportAllocations("Headless");
+    }
+
+    void reportBench() {
+        glFinish();
+        gpuTimer.finish();
+        double seconds = (double)(SDL_GetPerformanceCounter() - runStart) / SDL_GetPerformanceFrequency();
+        SDL_Log("Bench: %d frames at %dx%d in %.2f s, %.1f frames/s", frame, frameWidth, frameHeight,
+            seconds, seconds > 0.0 ? frame / seconds : 0.0);
+        logFrameTimes("cpu", cpuMilliseconds);
+        logFrameTimes("gpu", gpuTimer.milliseconds());
+        PerfCountersReport("Bench");
+        inputLatency.report("Bench");
+        reportAllocations("Bench");
+    }
+
+    //allocations since the previous frame ended, from the end of the warm-up on
+    void countFrameAllocations() {
+        uint64_t count = AllocTracker().total.count.load();
+        uint64_t bytes = AllocTracker().total.bytes.load();
+        uint64_t news = AllocTracker().news.count.load();
+        if (frame > CORE_BENCH_WARMUP) {
+            int newCalls = (int)(news - frameNewCount);
+            steadyAllocations += count - frameAllocCount;
+            steadyAllocatedBytes += bytes - frameAllocBytes;
+            steadyNews += newCalls;
+            if (newCalls > 0) allocatingFrames++;
+            mostFrameNews = std::max(mostFrameNews, newCalls);
+        }
+        frameAllocCount = count;
+        frameAllocBytes = bytes;
+        frameNewCount = news;
+    }
+
+    void reportAllocations(const char* label) {
+        if (!AllocTrackingBuilt()) {
+            if (allocCheck) SDL_Log("%s: --alloc-check needs a build with ALLOC_TRACKING defined", label);
+            allocFailed = allocCheck;
+            return;
+        }
+        int frames = frame - CORE_BENCH_WARMUP;
+        if (frames <= 0) return;
+        SDL_Log("%s: %.1f allocations and %.0f bytes a frame after warm-up, %.1f of them new; %d of %d frames called new, at most %d times",
+            label, (double)steadyAllocations / frames, (double)steadyAllocatedBytes / frames, (double)steadyNews / frames,
+            allocatingFrames, frames, mostFrameNews);
+        AllocTrackerReport(label);
+        allocFailed = allocCheck && allocatingFrames > 0;
+        if (allocCheck) SDL_Log("%s: allocation check %s", label, allocFailed ? "failed" : "passed");
+    }
+
+    //the first frames pay for shader compiles and driver warm-up, they are left out
+    static void logFrameTimes(const char* label, const std::vector<double>& all) {
+        size_t skip = all.size() > CORE_BENCH_WARMUP ? CORE_BENCH_WARMUP : 0;
+        std::vector<double> times(all.begin() + skip, all.end());
+        if (times.empty()) return;
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (double t : times) total += t;
+        SDL_Log("Bench: %s ms a frame over %d frames: mean %.3f, median %.3f, 95%% %.3f, max %.3f", label,
+            (int)times.size(), total / times.size(), times[times.size() / 2], times[times.size() * 95 / 100], times.back());
+    }
+
+    void checkGolden() {
+        int w, h, stride;
+        const uint32_t* pixels = readFrame(&w, &h, &stride);
+        GoldenResult result = GoldenCompare(goldenPath, pixels, w, h, stride, goldenTolerance, updateGolden);
+        goldenFailed = !result.passed;
+        if (result.created) SDL_Log("Golden: saved this frame as %s", goldenPath);
+        else if (updateGolden) SDL_Log("Golden: couldn't write %s: %s", goldenPath, SDL_GetError());
+        else if (result.missing) SDL_Log("Golden: FAILED, no reference at %s, --update-golden writes one", goldenPath);
+        else SDL_Log("Golden: %s %s, %d of %d pixels off by more than %d, largest difference %d", goldenPath,
+            result.passed ? "passed" : "FAILED", (int)result.differentPixels, (int)result.totalPixels,
+            goldenTolerance, result.maxDifference);
+    }
+
+    //the overlay in pixels over everything else, camera and depth test are put back after.
+    //on gl the text stays in a buffer of its own until the hud lays it out again
+    void drawPerfHud() {
+        PerfScope scope(perfHud, "hud");
+        perfHud.update();
+        CoreCameraBlock saved = camera;
+        bool savedDepthTest = depthTest;
+        const CoreTexture* savedTexture = immediateTexture;
+        camera.fogRange[2] = 0.0f;
+        setCamera(Mat4Identity(), Mat4Ortho(0.0f, (float)viewportWidth, (float)viewportHeight, 0.0f, -1.0f, 1.0f));
+        setDepthTest(false);
+        bindTexture(nullptr);
+        if (headless) {
+            want(false);
+            rectVertices(perfHud.text(), &pending);
+            rectVertices(perfHud.graph(), &pending);
+            flush();
+        }
+        else {
+            if (!hudVertexArrays[0]) {
+                glGenBuffers(2, hudBuffers);
+                glGenVertexArrays(2, hudVertexArrays);
+                for (int i = 0; i < 2; i++) setupVertexArray(hudVertexArrays[i], hudBuffers[i]);
+            }
+            //the graph buffer is respecified like the main one so the driver never waits on it
+            if (hudVersion != perfHud.textVersion()) {
+                hudVersion = perfHud.textVersion();
+                hudVertices.clear();
+                rectVertices(perfHud.text(), &hudVertices);
+                hudTextVertices = hudVertices.size();
+                glBindBuffer(GL_ARRAY_BUFFER, hudBuffers[0]);
+                glBufferData(GL_ARRAY_BUFFER, hudVertices.size() * sizeof(CoreVertex), hudVertices.data(), GL_STATIC_DRAW);
+            }
+            hudVertices.clear();
+            rectVertices(perfHud.graph(), &hudVertices);
+            glBindBuffer(GL_ARRAY_BUFFER, hudBuffers[1]);
+            glBufferData(GL_ARRAY_BUFFER, hudVertices.size() * sizeof(CoreVertex), hudVertices.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            useProgram(Mat4Identity(), nullptr, true, false, false, nullptr);
+            glBindVertexArray(hudVertexArrays[0]);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)hudTextVertices);
+            glBindVertexArray(hudVertexArrays[1]);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)hudVertices.size());
+            glBindVertexArray(0);
+            glUseProgram(0);
+            draws += 2;
+            vertices += (long long)(hudTextVertices + hudVertices.size());
+        }
+        bindTexture(savedTexture);
+        setDepthTest(savedDepthTest);
+        camera.fogRange[2] = saved.fogRange[2];
+        setCamera(saved.view, saved.projection);
+    }
+
+    static void rectVertices(const std::vector<PerfHudRect>& rects, std::vector<CoreVertex>* out) {
+        size_t base = out->size();
+        out->resize(base + rects.size() * 6);
+        CoreVertex* v = out->data() + base;
+        for (const PerfHudRect& r : rects) {
+            CoreVertex a = { { r.x0, r.y0, 0.0f }, { r.color[0], r.color[1], r.color[2], r.color[3] } };
+            CoreVertex b = a, c = a, d = a;
+            b.position[0] = c.position[0] = r.x1;
+            c.position[1] = d.position[1] = r.y1;
+            v[0] = a; v[1] = b; v[2] = c;
+            v[3] = a; v[4] = c; v[5] = d;
+            v += 6;
+        }
+    }
+
+    static const char* vertexSource() {
+        return
+            "#version 330 core\n"
+            CORE_CAMERA_GLSL
+            "uniform mat4 model;\n"
+            "uniform vec4 tint;\n"
+            "uniform vec4 options;\n" //vertex colors, lit, instanced
+            "in vec3 position;\n"
+            "in vec4 color;\n"
+            "in vec3 normal;\n"
+            "in vec2 uv;\n"
+            "in vec4 place;\n"
+            "in vec4 instanceColor;\n"
+            "out vec4 vertexColor;\n"
+            "out vec2 vertexUv;\n"
+            "out float fog;\n"
+            "void main() {\n"
+            "    mat4 world = model;\n"
+            "    vec4 c = tint;\n"
+            "    if (options.z > 0.5) {\n"
+            "        float co = cos(place.w), s = sin(place.w);\n"
+            "        world = mat4(co, 0.0, -s, 0.0, 0.0, 1.0, 0.0, 0.0, s, 0.0, co, 0.0, place.xyz, 1.0) * model;\n"
+            "        c *= instanceColor;\n"
+            "    }\n"
+            "    if (options.x > 0.5) c *= color;\n"
+            "    vec4 viewPosition = view * (world * vec4(position, 1.0));\n"
+            //headlight: light 0 at the eye, plus the default 0.2 ambient
+            "    if (options.y > 0.5) {\n"
+            "        vec3 n = normalize(transpose(inverse(mat3(view * world))) * normal);\n"
+            "        c.rgb *= min(0.2 + max(n.z, 0.0), 1.0);\n"
+            "    }\n"
+            "    gl_Position = projection * viewPosition;\n"
+            "    vertexColor = c;\n"
+            "    vertexUv = uv;\n"
+            "    fog = fogRange.z > 0.5 ? clamp((-viewPosition.z - fogRange.x) / (fogRange.y - fogRange.x), 0.0, 1.0) : 0.0;\n"
+            "}\n";
+    }
+
+    static const char* fragmentSource() {
+        return
+            "#version 330 core\n"
+            CORE_CAMERA_GLSL
+            "uniform sampler2D image;\n"
+            "in vec4 vertexColor;\n"
+            "in vec2 vertexUv;\n"
+            "in float fog;\n"
+            "out vec4 fragColor;\n"
+            "void main() {\n"
+            "    vec4 c = vertexColor * texture(image, vertexUv);\n"
+            "    fragColor = vec4(mix(c.rgb, fogColor.rgb, fog), c.a);\n"
+            "}\n";
+    }
+
+    bool headless = false;
+    bool bench = false;
+    int runFrames = CORE_RUN_FRAMES;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    const char* dumpPrefix = NULL;
+    const char* goldenPath = NULL;
+    int goldenTolerance = GOLDEN_TOLERANCE;
+    bool updateGolden = false;
+    bool goldenFailed = false;
+    bool allocCheck = false;
+    bool allocFailed = false;
+    uint64_t frameAllocCount = 0;
+    uint64_t frameAllocBytes = 0;
+    uint64_t frameNewCount = 0;
+    uint64_t steadyAllocations = 0;
+    uint64_t steadyAllocatedBytes = 0;
+    uint64_t steadyNews = 0;
+    int allocatingFrames = 0; //called new
+    int mostFrameNews = 0;
+    int frame = 0;
+    Uint64 runStart = 0;
+    SoftRasterizer raster;
+    SoftRasterStats runStats = {};
+    std::vector<SoftVertex> softVertices;
+    std::vector<SoftVertex> meshVertices; //one mesh instance, before the indices expand it
+    //the headless meshes and textures, CoreMesh::vertexArray and CoreTexture::id minus one index them
+    std::vector<SoftMesh> softMeshes;
+    std::vector<SoftTextureCopy> softTextures;
+    std::vector<GLuint> freeSoftMeshes;
+    std::vector<GLuint> freeSoftTextures;
+    OffscreenTarget target;
+    GpuTimer gpuTimer;
+    bool gpuTiming = false;
+    PerfHud perfHud;
+    InputLatency inputLatency;
+    SDL_Event probeEvent = {};
+    GLuint hudVertexArrays[2] = {};
+    GLuint hudBuffers[2] = {}; //text, graph
+    unsigned hudVersion = 0;
+    size_t hudTextVertices = 0;
+    std::vector<CoreVertex> hudVertices;
+    bool depthTest = false;
+    Uint64 frameStart = 0;
+    std::vector<double> cpuMilliseconds;
+    std::vector<uint32_t> readback;
+    float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    SDL_Window* window = NULL;
+    SDL_GLContext context = NULL;
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint cameraBuffer = 0;
+    GLuint instanceBuffer = 0;
+    GLint modelUniform = -1;
+    GLint tintUniform = -1;
+    GLint optionsUniform = -1;
+    CoreTexture whiteTexture;
+    const CoreTexture* immediateTexture = nullptr;
+    CoreCameraBlock camera = {};
+    MatrixStack modelStack;
+    int viewportWidth = 1;
+    int viewportHeight = 1;
+
+    GLenum mode = GL_TRIANGLES;
+    unsigned char current[4] = { 255, 255, 255, 255 };
+    float currentUv[2] = {};
+    float width = 1.0f;
+    std::vector<CoreVertex> run;
+    std::vector<CoreVertex> pending;
+    bool pendingLines = false;
+    int draws = 0;
+    long long vertices = 0;
+};
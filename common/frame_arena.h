@@ -0,0 +1,132 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//scratch memory that only lives for one frame. allocating bumps a pointer and
+//nothing is freed on its own, reset() at the top of SDL_AppIterate hands the
+//whole block back at once. a frame that needs more than the block gets extra
+//blocks from the heap, and the next reset replaces them with one block big
+//enough for that frame, so after the first frames the arena stops allocating.
+//ArenaAllocator puts standard containers on it: ArenaVector<float> scratch{
+//ArenaAllocator<float>(FrameScratch()) }. such a container must not outlive
+//the frame. one thread only, the main thread's arena is FrameScratch()
+
+#define FRAME_ARENA_SIZE (64 * 1024)
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity) : capacity(capacity) {
+        block = (char*)::operator new(capacity);
+    }
+    ~FrameArena() {
+        releaseOverflow();
+        ::operator delete(block);
+    }
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    //align has to be a power of two
+    void* allocate(size_t bytes, size_t align) {
+        char* p = alignUp(top ? top : block, align);
+        if (p + bytes > (current ? current : block) + currentCapacity()) p = grow(bytes, align);
+        top = p + bytes;
+        used += bytes;
+        if (used > highWater) highWater = used;
+        return p;
+    }
+
+    //gives the memory back when it was the last allocation, so scratch freed in
+    //reverse order is reused within the frame. anything else waits for reset
+    void release(void* p, size_t bytes) {
+        if ((char*)p + bytes != top) return;
+        top = (char*)p;
+        used -= bytes;
+    }
+
+    void reset() {
+        if (!overflow.empty()) {
+            //one block for everything the biggest frame so far needed
+            releaseOverflow();
+            ::operator delete(block);
+            capacity = capacity * 2 > highWater + highWater / 2 ? capacity * 2 : highWater + highWater / 2;
+            block = (char*)::operator new(capacity);
+        }
+        current = nullptr;
+        top = nullptr;
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t peakBytes() const { return highWater; }
+    size_t blockSize() const { return capacity; }
+
+private:
+    static char* alignUp(char* p, size_t align) {
+        return (char*)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    size_t currentCapacity() const {
+        return current ? overflowCapacity.back() : capacity;
+    }
+
+    char* grow(size_t bytes, size_t align) {
+        size_t size = bytes + align > capacity ? bytes + align : capacity;
+        current = (char*)::operator new(size);
+        overflow.push_back(current);
+        overflowCapacity.push_back(size);
+        return alignUp(current, align);
+    }
+
+    void releaseOverflow() {
+        for (char* b : overflow) ::operator delete(b);
+        overflow.clear();
+        overflowCapacity.clear();
+    }
+
+    char* block;
+    size_t capacity;
+    char* current = nullptr; //overflow block being filled, null while in the main block
+    char* top = nullptr;
+    size_t used = 0;
+    size_t highWater = 0;
+    std::vector<char*> overflow;
+    std::vector<size_t> overflowCapacity;
+};
+
+//the main thread's frame arena
+inline FrameArena& FrameScratch()
+{
+    static FrameArena arena(FRAME_ARENA_SIZE);
+    return arena;
+}
+
+//standard allocator on a FrameArena, deallocate only gives back the last allocation
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return (T*)arena->allocate(n * sizeof(T), alignof(T)); }
+    void deallocate(T* p, size_t n) { arena->release(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    FrameArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
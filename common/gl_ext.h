@@ -0,0 +1,239 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+
+//entry points past gl 1.1, opengl32.lib only exports 1.1 on windows so these
+//are fetched from the driver after the context is created (LoadGLExt)
+
+struct GLExtFunctions {
+    PFNGLCOMPRESSEDTEXIMAGE2DPROC compressedTexImage2D;
+    PFNGLGENBUFFERSPROC genBuffers;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBUFFERDATAPROC bufferData;
+
+    //shaders and instancing, LoadGLShaderExt
+    PFNGLCREATESHADERPROC createShader;
+    PFNGLDELETESHADERPROC deleteShader;
+    PFNGLSHADERSOURCEPROC shaderSource;
+    PFNGLCOMPILESHADERPROC compileShader;
+    PFNGLGETSHADERIVPROC getShaderiv;
+    PFNGLGETSHADERINFOLOGPROC getShaderInfoLog;
+    PFNGLCREATEPROGRAMPROC createProgram;
+    PFNGLDELETEPROGRAMPROC deleteProgram;
+    PFNGLATTACHSHADERPROC attachShader;
+    PFNGLBINDATTRIBLOCATIONPROC bindAttribLocation;
+    PFNGLLINKPROGRAMPROC linkProgram;
+    PFNGLGETPROGRAMIVPROC getProgramiv;
+    PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog;
+    PFNGLUSEPROGRAMPROC useProgram;
+    PFNGLGETUNIFORMLOCATIONPROC getUniformLocation;
+    PFNGLUNIFORM1FPROC uniform1f;
+    PFNGLUNIFORM4FPROC uniform4f;
+    PFNGLVERTEXATTRIBPOINTERPROC vertexAttribPointer;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray;
+    PFNGLDISABLEVERTEXATTRIBARRAYPROC disableVertexAttribArray;
+    PFNGLVERTEXATTRIBDIVISORPROC vertexAttribDivisor;
+    PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+
+    //render to texture, LoadGLFramebufferExt
+    PFNGLGENFRAMEBUFFERSPROC genFramebuffers;
+    PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+    PFNGLFRAMEBUFFERTEXTURE2DPROC framebufferTexture2D;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus;
+    PFNGLGENRENDERBUFFERSPROC genRenderbuffers;
+    PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers;
+    PFNGLBINDRENDERBUFFERPROC bindRenderbuffer;
+    PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer;
+
+    //vertex arrays and uniform buffers for core profile contexts, LoadGLCoreExt
+    PFNGLGENVERTEXARRAYSPROC genVertexArrays;
+    PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+    PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+    PFNGLBUFFERSUBDATAPROC bufferSubData;
+    PFNGLBINDBUFFERBASEPROC bindBufferBase;
+    PFNGLGETUNIFORMBLOCKINDEXPROC getUniformBlockIndex;
+    PFNGLUNIFORMBLOCKBINDINGPROC uniformBlockBinding;
+    PFNGLUNIFORMMATRIX4FVPROC uniformMatrix4fv;
+    PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+
+    //gpu timing (core 3.3 or arb_timer_query), LoadGLQueryExt
+    PFNGLGENQUERIESPROC genQueries;
+    PFNGLDELETEQUERIESPROC deleteQueries;
+    PFNGLBEGINQUERYPROC beginQuery;
+    PFNGLENDQUERYPROC endQuery;
+    PFNGLGETQUERYOBJECTIVPROC getQueryObjectiv;
+    PFNGLGETQUERYOBJECTUI64VPROC getQueryObjectui64v;
+};
+
+//what LoadGLExt found, each capability only needs its own entry points
+struct GLExtSupport {
+    bool compressedTextures; //glCompressedTexImage2D
+    bool buffers; //glGenBuffers, glDeleteBuffers, glBindBuffer, glBufferData
+};
+
+inline GLExtFunctions& GLExt()
+{
+    static GLExtFunctions functions = {};
+    return functions;
+}
+
+//needs a current context, a driver can lack one capability and still have the other
+inline GLExtSupport LoadGLExt()
+{
+    GLExtFunctions& f = GLExt();
+    f.compressedTexImage2D = (PFNGLCOMPRESSEDTEXIMAGE2DPROC)SDL_GL_GetProcAddress("glCompressedTexImage2D");
+    f.genBuffers = (PFNGLGENBUFFERSPROC)SDL_GL_GetProcAddress("glGenBuffers");
+    f.deleteBuffers = (PFNGLDELETEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteBuffers");
+    f.bindBuffer = (PFNGLBINDBUFFERPROC)SDL_GL_GetProcAddress("glBindBuffer");
+    f.bufferData = (PFNGLBUFFERDATAPROC)SDL_GL_GetProcAddress("glBufferData");
+    GLExtSupport support;
+    support.compressedTextures = f.compressedTexImage2D != nullptr;
+    support.buffers = f.genBuffers && f.deleteBuffers && f.bindBuffer && f.bufferData;
+    return support;
+}
+
+//gl 2.0 shaders plus instanced arrays (core 3.3 or the arb extensions),
+//loads the LoadGLExt set too and needs its buffer objects
+inline bool LoadGLShaderExt()
+{
+    if (!LoadGLExt().buffers) return false;
+    GLExtFunctions& f = GLExt();
+    f.createShader = (PFNGLCREATESHADERPROC)SDL_GL_GetProcAddress("glCreateShader");
+    f.deleteShader = (PFNGLDELETESHADERPROC)SDL_GL_GetProcAddress("glDeleteShader");
+    f.shaderSource = (PFNGLSHADERSOURCEPROC)SDL_GL_GetProcAddress("glShaderSource");
+    f.compileShader = (PFNGLCOMPILESHADERPROC)SDL_GL_GetProcAddress("glCompileShader");
+    f.getShaderiv = (PFNGLGETSHADERIVPROC)SDL_GL_GetProcAddress("glGetShaderiv");
+    f.getShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)SDL_GL_GetProcAddress("glGetShaderInfoLog");
+    f.createProgram = (PFNGLCREATEPROGRAMPROC)SDL_GL_GetProcAddress("glCreateProgram");
+    f.deleteProgram = (PFNGLDELETEPROGRAMPROC)SDL_GL_GetProcAddress("glDeleteProgram");
+    f.attachShader = (PFNGLATTACHSHADERPROC)SDL_GL_GetProcAddress("glAttachShader");
+    f.bindAttribLocation = (PFNGLBINDATTRIBLOCATIONPROC)SDL_GL_GetProcAddress("glBindAttribLocation");
+    f.linkProgram = (PFNGLLINKPROGRAMPROC)SDL_GL_GetProcAddress("glLinkProgram");
+    f.getProgramiv = (PFNGLGETPROGRAMIVPROC)SDL_GL_GetProcAddress("glGetProgramiv");
+    f.getProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)SDL_GL_GetProcAddress("glGetProgramInfoLog");
+    f.useProgram = (PFNGLUSEPROGRAMPROC)SDL_GL_GetProcAddress("glUseProgram");
+    f.getUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)SDL_GL_GetProcAddress("glGetUniformLocation");
+    f.uniform1f = (PFNGLUNIFORM1FPROC)SDL_GL_GetProcAddress("glUniform1f");
+    f.uniform4f = (PFNGLUNIFORM4FPROC)SDL_GL_GetProcAddress("glUniform4f");
+    f.vertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)SDL_GL_GetProcAddress("glVertexAttribPointer");
+    f.enableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)SDL_GL_GetProcAddress("glEnableVertexAttribArray");
+    f.disableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)SDL_GL_GetProcAddress("glDisableVertexAttribArray");
+    f.vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)SDL_GL_GetProcAddress("glVertexAttribDivisor");
+    if (!f.vertexAttribDivisor)
+        f.vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+    f.drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)SDL_GL_GetProcAddress("glDrawArraysInstanced");
+    if (!f.drawArraysInstanced)
+        f.drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)SDL_GL_GetProcAddress("glDrawArraysInstancedARB");
+    return f.createShader && f.deleteShader && f.shaderSource && f.compileShader && f.getShaderiv &&
+        f.getShaderInfoLog && f.createProgram && f.deleteProgram && f.attachShader && f.bindAttribLocation &&
+        f.linkProgram && f.getProgramiv && f.getProgramInfoLog && f.useProgram && f.getUniformLocation &&
+        f.uniform1f && f.uniform4f && f.vertexAttribPointer && f.enableVertexAttribArray &&
+        f.disableVertexAttribArray && f.vertexAttribDivisor && f.drawArraysInstanced;
+}
+
+//framebuffer objects (core 3.0 or arb_framebuffer_object, same names)
+inline bool LoadGLFramebufferExt()
+{
+    GLExtFunctions& f = GLExt();
+    f.genFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)SDL_GL_GetProcAddress("glGenFramebuffers");
+    f.deleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteFramebuffers");
+    f.bindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)SDL_GL_GetProcAddress("glBindFramebuffer");
+    f.framebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)SDL_GL_GetProcAddress("glFramebufferTexture2D");
+    f.checkFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)SDL_GL_GetProcAddress("glCheckFramebufferStatus");
+    f.genRenderbuffers = (PFNGLGENRENDERBUFFERSPROC)SDL_GL_GetProcAddress("glGenRenderbuffers");
+    f.deleteRenderbuffers = (PFNGLDELETERENDERBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteRenderbuffers");
+    f.bindRenderbuffer = (PFNGLBINDRENDERBUFFERPROC)SDL_GL_GetProcAddress("glBindRenderbuffer");
+    f.renderbufferStorage = (PFNGLRENDERBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glRenderbufferStorage");
+    f.framebufferRenderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)SDL_GL_GetProcAddress("glFramebufferRenderbuffer");
+    return f.genFramebuffers && f.deleteFramebuffers && f.bindFramebuffer && f.framebufferTexture2D &&
+        f.checkFramebufferStatus && f.genRenderbuffers && f.deleteRenderbuffers && f.bindRenderbuffer &&
+        f.renderbufferStorage && f.framebufferRenderbuffer;
+}
+
+//gl 3.3 core: the shader set plus vertex array objects and uniform blocks
+inline bool LoadGLCoreExt()
+{
+    if (!LoadGLShaderExt()) return false;
+    GLExtFunctions& f = GLExt();
+    f.genVertexArrays = (PFNGLGENVERTEXARRAYSPROC)SDL_GL_GetProcAddress("glGenVertexArrays");
+    f.deleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)SDL_GL_GetProcAddress("glDeleteVertexArrays");
+    f.bindVertexArray = (PFNGLBINDVERTEXARRAYPROC)SDL_GL_GetProcAddress("glBindVertexArray");
+    f.bufferSubData = (PFNGLBUFFERSUBDATAPROC)SDL_GL_GetProcAddress("glBufferSubData");
+    f.bindBufferBase = (PFNGLBINDBUFFERBASEPROC)SDL_GL_GetProcAddress("glBindBufferBase");
+    f.getUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)SDL_GL_GetProcAddress("glGetUniformBlockIndex");
+    f.uniformBlockBinding = (PFNGLUNIFORMBLOCKBINDINGPROC)SDL_GL_GetProcAddress("glUniformBlockBinding");
+    f.uniformMatrix4fv = (PFNGLUNIFORMMATRIX4FVPROC)SDL_GL_GetProcAddress("glUniformMatrix4fv");
+    f.drawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)SDL_GL_GetProcAddress("glDrawElementsInstanced");
+    return f.genVertexArrays && f.deleteVertexArrays && f.bindVertexArray && f.bufferSubData && f.bindBufferBase &&
+        f.getUniformBlockIndex && f.uniformBlockBinding && f.uniformMatrix4fv && f.drawElementsInstanced;
+}
+
+//occlusion and timer queries, glGetQueryObjectui64v is the part that needs 3.3
+inline bool LoadGLQueryExt()
+{
+    GLExtFunctions& f = GLExt();
+    f.genQueries = (PFNGLGENQUERIESPROC)SDL_GL_GetProcAddress("glGenQueries");
+    f.deleteQueries = (PFNGLDELETEQUERIESPROC)SDL_GL_GetProcAddress("glDeleteQueries");
+    f.beginQuery = (PFNGLBEGINQUERYPROC)SDL_GL_GetProcAddress("glBeginQuery");
+    f.endQuery = (PFNGLENDQUERYPROC)SDL_GL_GetProcAddress("glEndQuery");
+    f.getQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)SDL_GL_GetProcAddress("glGetQueryObjectiv");
+    f.getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)SDL_GL_GetProcAddress("glGetQueryObjectui64v");
+    return f.genQueries && f.deleteQueries && f.beginQuery && f.endQuery && f.getQueryObjectiv && f.getQueryObjectui64v;
+}
+
+#define glCompressedTexImage2D GLExt().compressedTexImage2D
+#define glGenBuffers GLExt().genBuffers
+#define glDeleteBuffers GLExt().deleteBuffers
+#define glBindBuffer GLExt().bindBuffer
+#define glBufferData GLExt().bufferData
+#define glCreateShader GLExt().createShader
+#define glDeleteShader GLExt().deleteShader
+#define glShaderSource GLExt().shaderSource
+#define glCompileShader GLExt().compileShader
+#define glGetShaderiv GLExt().getShaderiv
+#define glGetShaderInfoLog GLExt().getShaderInfoLog
+#define glCreateProgram GLExt().createProgram
+#define glDeleteProgram GLExt().deleteProgram
+#define glAttachShader GLExt().attachShader
+#define glBindAttribLocation GLExt().bindAttribLocation
+#define glLinkProgram GLExt().linkProgram
+#define glGetProgramiv GLExt().getProgramiv
+#define glGetProgramInfoLog GLExt().getProgramInfoLog
+#define glUseProgram GLExt().useProgram
+#define glGetUniformLocation GLExt().getUniformLocation
+#define glUniform1f GLExt().uniform1f
+#define glUniform4f GLExt().uniform4f
+#define glVertexAttribPointer GLExt().vertexAttribPointer
+#define glEnableVertexAttribArray GLExt().enableVertexAttribArray
+#define glDisableVertexAttribArray GLExt().disableVertexAttribArray
+#define glVertexAttribDivisor GLExt().vertexAttribDivisor
+#define glDrawArraysInstanced GLExt().drawArraysInstanced
+#define glGenFramebuffers GLExt().genFramebuffers
+#define glDeleteFramebuffers GLExt().deleteFramebuffers
+#define glBindFramebuffer GLExt().bindFramebuffer
+#define glFramebufferTexture2D GLExt().framebufferTexture2D
+#define glCheckFramebufferStatus GLExt().checkFramebufferStatus
+#define glGenRenderbuffers GLExt().genRenderbuffers
+#define glDeleteRenderbuffers GLExt().deleteRenderbuffers
+#define glBindRenderbuffer GLExt().bindRenderbuffer
+#define glRenderbufferStorage GLExt().renderbufferStorage
+#define glFramebufferRenderbuffer GLExt().framebufferRenderbuffer
+#define glGenVertexArrays GLExt().genVertexArrays
+#define glDeleteVertexArrays GLExt().deleteVertexArrays
+#define glBindVertexArray GLExt().bindVertexArray
+#define glBufferSubData GLExt().bufferSubData
+#define glBindBufferBase GLExt().bindBufferBase
+#define glGetUniformBlockIndex GLExt().getUniformBlockIndex
+#define glUniformBlockBinding GLExt().uniformBlockBinding
+#define glUniformMatrix4fv GLExt().uniformMatrix4fv
+#define glDrawElementsInstanced GLExt().drawElementsInstanced
+#define glGenQueries GLExt().genQueries
+#define glDeleteQueries GLExt().deleteQueries
+#define glBeginQuery GLExt().beginQuery
+#define glEndQuery GLExt().endQuery
+#define glGetQueryObjectiv GLExt().getQueryObjectiv
+#define glGetQueryObjectui64v GLExt().getQueryObjectui64v
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "gl_ext.h"
+
+#define GPU_TIMER_QUERIES 4
+
+//color + depth renderbuffers to draw into instead of the window, so frames
+//can be rendered and timed without presenting. needs LoadGLFramebufferExt
+class OffscreenTarget {
+public:
+    bool create(int w, int h) {
+        width = w;
+        height = h;
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) destroy();
+        return complete;
+    }
+
+    void destroy() {
+        if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+        if (renderbuffers[0]) glDeleteRenderbuffers(2, renderbuffers);
+        framebuffer = renderbuffers[0] = renderbuffers[1] = 0;
+    }
+
+    void bind() const { glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); }
+
+    //rgba8 rows top to bottom like the software framebuffer, waits for the gpu
+    void read(std::vector<uint32_t>* pixels) const {
+        pixels->resize((size_t)width * height);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        uint32_t* top = pixels->data();
+        uint32_t* bottom = top + (size_t)(height - 1) * width;
+        for (; top < bottom; top += width, bottom -= width) std::swap_ranges(top, top + width, bottom);
+    }
+
+    int frameWidth() const { return width; }
+    int frameHeight() const { return height; }
+
+private:
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[2] = {};
+    int width = 0;
+    int height = 0;
+};
+
+//GL_TIME_ELAPSED around each frame. the queries go round a small ring and
+//are read back a few frames late once the gpu has caught up, so timing does
+//not stall the pipeline; only a full ring waits. needs LoadGLQueryExt
+class GpuTimer {
+public:
+    void init() { glGenQueries(GPU_TIMER_QUERIES, queries); }
+
+    void shutdown() {
+        if (queries[0]) glDeleteQueries(GPU_TIMER_QUERIES, queries);
+        queries[0] = 0;
+    }
+
+    void begin() {
+        if (inFlight == GPU_TIMER_QUERIES) retire(true);
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        next = (next + 1) % GPU_TIMER_QUERIES;
+        inFlight++;
+        while (inFlight > 0 && retire(false)) {}
+    }
+
+    //waits for everything still in flight
+    void finish() {
+        while (inFlight > 0) retire(true);
+    }
+
+    //one entry per frame in issue order
+    const std::vector<double>& milliseconds() const { return results; }
+    void reserve(size_t frames) { results.reserve(frames); }
+    void clearResults() { results.clear(); }
+
+private:
+    bool retire(bool wait) {
+        GLuint query = queries[(next + GPU_TIMER_QUERIES - inFlight) % GPU_TIMER_QUERIES];
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return false;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        results.push_back(nanoseconds / 1e6);
+        inFlight--;
+        return true;
+    }
+
+    GLuint queries[GPU_TIMER_QUERIES] = {};
+    int next = 0;
+    int inFlight = 0;
+    std::vector<double> results;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+
+#include "gl_ext.h"
+
+//glsl helpers on top of LoadGLShaderExt, failures are logged with the
+//driver's info log and come back as 0
+
+inline GLuint CompileShaderStage(GLenum type, const char* source, const char* name)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        SDL_Log("Couldn't compile %s %s shader: %s", name, type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+//attribute i of attributes gets location i
+inline GLuint LinkProgram(const char* vertexSource, const char* fragmentSource, const char* name,
+    const char* const* attributes, int attributeCount)
+{
+    GLuint vs = CompileShaderStage(GL_VERTEX_SHADER, vertexSource, name);
+    GLuint fs = vs ? CompileShaderStage(GL_FRAGMENT_SHADER, fragmentSource, name) : 0;
+    if (!fs) {
+        if (vs) glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    for (int i = 0; i < attributeCount; i++) glBindAttribLocation(program, (GLuint)i, attributes[i]);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        SDL_Log("Couldn't link %s program: %s", name, log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
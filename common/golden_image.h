@@ -0,0 +1,84 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//checks a rendered frame against a stored reference bmp. frames are rgba8
+//rows top to bottom (SDL_PIXELFORMAT_RGBA32), stride in pixels. a pixel
+//counts as different when r, g or b is off by more than the tolerance, which
+//covers rounding between drivers, and a small share of different pixels is
+//let through for where rasterizers disagree on edge coverage. alpha is left
+//out since backends fill it differently.
+//the demos keep the last frame of a default headless run in
+//golden/headless.bmp, checked from the demo's folder with
+//--headless --frame-size 320x240 --golden golden/headless.bmp
+//and rewritten by adding --update-golden when a change to the picture is meant
+
+#define GOLDEN_TOLERANCE 8
+#define GOLDEN_MAX_DIFFERENT 0.002
+
+struct GoldenResult {
+    bool missing; //no reference to compare with
+    bool created; //the frame was stored as the new reference
+    bool passed;
+    int maxDifference;
+    size_t differentPixels;
+    size_t totalPixels;
+};
+
+inline bool SaveRgbaBmp(const char* path, const uint32_t* pixels, int width, int height, int stride)
+{
+    SDL_Surface* surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_RGBA32, (void*)pixels, stride * 4);
+    if (!surface) return false;
+    bool ok = SDL_SaveBMP(surface, path);
+    SDL_DestroySurface(surface);
+    return ok;
+}
+
+//update stores the frame as the reference instead of comparing. a missing
+//reference fails, so does a failed check, which leaves the frame next to the
+//reference as path.actual.bmp
+inline GoldenResult GoldenCompare(const char* path, const uint32_t* pixels, int width, int height, int stride, int tolerance,
+    bool update)
+{
+    GoldenResult result = {};
+    result.totalPixels = (size_t)width * height;
+    if (update) {
+        result.created = result.passed = SaveRgbaBmp(path, pixels, width, height, stride);
+        return result;
+    }
+    SDL_Surface* loaded = SDL_LoadBMP(path);
+    if (!loaded) {
+        result.missing = true;
+        return result;
+    }
+    SDL_Surface* reference = SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(loaded);
+
+    if (reference && reference->w == width && reference->h == height) {
+        for (int y = 0; y < height; y++) {
+            const unsigned char* a = (const unsigned char*)(pixels + (size_t)y * stride);
+            const unsigned char* b = (const unsigned char*)reference->pixels + (size_t)y * reference->pitch;
+            for (int x = 0; x < width * 4; x += 4) {
+                int d = 0;
+                for (int k = 0; k < 3; k++) d = SDL_max(d, SDL_abs(a[x + k] - b[x + k]));
+                result.maxDifference = SDL_max(result.maxDifference, d);
+                if (d > tolerance) result.differentPixels++;
+            }
+        }
+        result.passed = result.differentPixels <= (size_t)(result.totalPixels * GOLDEN_MAX_DIFFERENT);
+    }
+    else {
+        result.differentPixels = result.totalPixels;
+        result.maxDifference = 255;
+    }
+    if (reference) SDL_DestroySurface(reference);
+
+    if (!result.passed) {
+        char actualPath[512];
+        SDL_snprintf(actualPath, sizeof(actualPath), "%s.actual.bmp", path);
+        SaveRgbaBmp(actualPath, pixels, width, height, stride);
+    }
+    return result;
+}
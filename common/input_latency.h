@@ -0,0 +1,145 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+//input to present latency. every input is stamped when it arrives (the os
+//timestamp sdl puts on the event), the frame that first reflects it takes it
+//over when the frame samples its input, and once that frame's swap returns
+//each input it carried gets a sample: arrival to swap, and the part of it the
+//input spent waiting to be sampled. the swap returning is as close to the
+//photons as the cpu gets, scan-out adds up to a refresh on top. all calls
+//come from the main thread, nothing allocates after construction.
+//--late-latch makes the demos do the work input doesn't change first (the
+//update and drawing of everything but the player) and only then pump the os
+//queue, handle the keyboard and mouse events that came in meanwhile and move
+//and draw the player right before the frame is submitted.
+//--latency logs the percentiles when an interactive run quits, offscreen
+//CoreRenderer runs log them with the rest of the report. --input-probe N
+//posts the demo's probe event every N frames there, since nobody presses keys
+
+#define INPUT_LATENCY_PENDING 64 //power of two, inputs waiting for a frame before the oldest are dropped
+#define INPUT_LATENCY_SAMPLES 4096 //the newest ones make the percentiles
+#define INPUT_LATCH_BATCH 16
+
+struct InputLatencySettings {
+    bool report = false;
+    bool lateLatch = false;
+    int probe = 0; //frames between synthetic inputs offscreen, 0 for none
+};
+
+inline InputLatencySettings& InputLatencyConfig()
+{
+    static InputLatencySettings settings;
+    return settings;
+}
+
+//--latency, --late-latch and --input-probe N, call first thing in SDL_AppInit
+inline void InputLatencyConfigure(int argc, char* argv[])
+{
+    InputLatencySettings& s = InputLatencyConfig();
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--latency") == 0) s.report = true;
+        else if (SDL_strcmp(argv[i], "--late-latch") == 0) s.lateLatch = true;
+        else if (SDL_strcmp(argv[i], "--input-probe") == 0 && i + 1 < argc) s.probe = SDL_atoi(argv[++i]);
+    }
+}
+
+//when the event arrived, in SDL_GetTicksNS time
+inline Uint64 InputArrival(const SDL_Event* event)
+{
+    return event->common.timestamp ? event->common.timestamp : SDL_GetTicksNS();
+}
+
+//late latching: pumps the os queue and hands the keyboard and mouse events
+//that came in since the frame began to handler right away, instead of at the
+//start of the next frame. returns how many there were
+template <typename Handler>
+inline int InputLatchEvents(Handler handler)
+{
+    SDL_PumpEvents();
+    SDL_Event events[INPUT_LATCH_BATCH];
+    int total = 0;
+    for (;;) {
+        int n = SDL_PeepEvents(events, INPUT_LATCH_BATCH, SDL_GETEVENT, SDL_EVENT_KEY_DOWN, SDL_EVENT_MOUSE_WHEEL);
+        for (int i = 0; i < n; i++) handler(&events[i]);
+        if (n > 0) total += n;
+        if (n < INPUT_LATCH_BATCH) return total;
+    }
+}
+
+class InputLatency {
+public:
+    //an input that changes what the next frame shows
+    void arrived(Uint64 arrival) {
+        if (pendingCount == INPUT_LATENCY_PENDING) {
+            pendingFirst++;
+            pendingCount--;
+            dropped++;
+        }
+        pending[(pendingFirst + pendingCount++) & (INPUT_LATENCY_PENDING - 1)] = arrival;
+    }
+
+    //the frame being drawn reflects every input that arrived up to newest:
+    //SDL_GetTicksNS() when input is applied as the frame starts, or what the
+    //state it draws was built from. call once a frame, before present
+    void sampled(Uint64 newest) {
+        Uint64 now = SDL_GetTicksNS();
+        while (pendingCount > 0 && frameCount < INPUT_LATENCY_PENDING) {
+            Uint64 arrival = pending[pendingFirst & (INPUT_LATENCY_PENDING - 1)];
+            if (arrival > newest) break;
+            frameArrivals[frameCount] = arrival;
+            frameSampled[frameCount++] = now;
+            pendingFirst++;
+            pendingCount--;
+        }
+    }
+
+    //the swap of the frame that sampled returned
+    void presented() {
+        Uint64 now = SDL_GetTicksNS();
+        for (int i = 0; i < frameCount; i++) {
+            Sample& s = samples[total++ % INPUT_LATENCY_SAMPLES];
+            s.total = (double)(now - frameArrivals[i]) / 1e6;
+            s.waiting = (double)(frameSampled[i] - frameArrivals[i]) / 1e6;
+        }
+        frameCount = 0;
+    }
+
+    int sampleCount() const { return (int)std::min<uint64_t>(total, INPUT_LATENCY_SAMPLES); }
+
+    //percentiles in milliseconds, nothing when no input was presented
+    void report(const char* label) const {
+        int n = sampleCount();
+        if (n == 0) return;
+        std::vector<double> totals(n), waits(n);
+        for (int i = 0; i < n; i++) {
+            totals[i] = samples[i].total;
+            waits[i] = samples[i].waiting;
+        }
+        std::sort(totals.begin(), totals.end());
+        std::sort(waits.begin(), waits.end());
+        SDL_Log("%s: input to present ms over %d inputs%s: median %.3f, 95%% %.3f, 99%% %.3f, max %.3f", label, n,
+            InputLatencyConfig().lateLatch ? ", late latched" : "", totals[n / 2], totals[n * 95 / 100], totals[n * 99 / 100], totals.back());
+        SDL_Log("%s: waiting to be sampled ms: median %.3f, 95%% %.3f, max %.3f; %d inputs dropped", label,
+            waits[n / 2], waits[n * 95 / 100], waits.back(), dropped);
+    }
+
+private:
+    struct Sample {
+        double total;
+        double waiting;
+    };
+
+    Uint64 pending[INPUT_LATENCY_PENDING] = {}; //arrived, no frame reflects them yet
+    uint32_t pendingFirst = 0;
+    int pendingCount = 0;
+    Uint64 frameArrivals[INPUT_LATENCY_PENDING] = {}; //reflected by the frame being drawn
+    Uint64 frameSampled[INPUT_LATENCY_PENDING] = {};
+    int frameCount = 0;
+    Sample samples[INPUT_LATENCY_SAMPLES];
+    uint64_t total = 0;
+    int dropped = 0;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//read-only view of a whole file, the OS pages it in on demand
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+inline void UnmapFile(MappedFile* f)
+{
+#ifdef _WIN32
+    if (f->data) UnmapViewOfFile(f->data);
+    if (f->mapping) CloseHandle(f->mapping);
+    if (f->file != INVALID_HANDLE_VALUE) CloseHandle(f->file);
+    f->file = INVALID_HANDLE_VALUE;
+    f->mapping = NULL;
+#else
+    if (f->data) munmap((void*)f->data, f->size);
+#endif
+    f->data = nullptr;
+    f->size = 0;
+}
+
+inline bool MapFile(const char* path, MappedFile* f)
+{
+    *f = MappedFile();
+#ifdef _WIN32
+    f->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f->file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(f->file, &size) || size.QuadPart == 0) {
+        UnmapFile(f);
+        return false;
+    }
+    f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!f->mapping) {
+        UnmapFile(f);
+        return false;
+    }
+    f->data = (const unsigned char*)MapViewOfFile(f->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!f->data) {
+        UnmapFile(f);
+        return false;
+    }
+    f->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+
+    f->data = (const unsigned char*)p;
+    f->size = (size_t)st.st_size;
+#endif
+    return true;
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH3D_SSE 1
+#include <xmmintrin.h>
+#endif
+
+//small vector and matrix library for the core profile renderer. matrices are
+//column-major like opengl (m[column * 4 + row]) so they go to uniforms and
+//FrustumFromMatrix as they are, vectors are columns (matrix * vector).
+//angles are in radians, products and point transforms use sse when available
+
+struct Vec3 {
+    float x, y, z;
+};
+
+struct Quat {
+    float x, y, z, w;
+};
+
+struct Mat4 {
+    float m[16];
+};
+
+inline Vec3 MakeVec3(float x, float y, float z)
+{
+    Vec3 v = { x, y, z };
+    return v;
+}
+
+inline Vec3 Vec3Add(Vec3 a, Vec3 b) { return MakeVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 Vec3Sub(Vec3 a, Vec3 b) { return MakeVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 Vec3Scale(Vec3 a, float s) { return MakeVec3(a.x * s, a.y * s, a.z * s); }
+inline float Vec3Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float Vec3Length(Vec3 a) { return sqrtf(Vec3Dot(a, a)); }
+
+inline Vec3 Vec3Cross(Vec3 a, Vec3 b)
+{
+    return MakeVec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline Vec3 Vec3Normalize(Vec3 a)
+{
+    float length = Vec3Length(a);
+    return length > 0.0f ? Vec3Scale(a, 1.0f / length) : a;
+}
+
+inline Quat QuatIdentity()
+{
+    Quat q = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return q;
+}
+
+//rotation by angle around a unit axis, same sense as glRotatef
+inline Quat QuatFromAxisAngle(Vec3 axis, float angle)
+{
+    float s = sinf(angle * 0.5f);
+    Quat q = { axis.x * s, axis.y * s, axis.z * s, cosf(angle * 0.5f) };
+    return q;
+}
+
+//a then b applied to a vector is QuatMul(b, a)
+inline Quat QuatMul(Quat a, Quat b)
+{
+    Quat q = {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+    return q;
+}
+
+inline Mat4 Mat4Identity()
+{
+    Mat4 r = { { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 } };
+    return r;
+}
+
+//a * b, b applies first
+inline Mat4 Mat4Mul(const Mat4& a, const Mat4& b)
+{
+    Mat4 r;
+#if defined(MATH3D_SSE)
+    __m128 c0 = _mm_loadu_ps(a.m), c1 = _mm_loadu_ps(a.m + 4), c2 = _mm_loadu_ps(a.m + 8), c3 = _mm_loadu_ps(a.m + 12);
+    for (int c = 0; c < 4; c++) {
+        const float* col = b.m + c * 4;
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(col[0])), _mm_mul_ps(c1, _mm_set1_ps(col[1]))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(col[2])), _mm_mul_ps(c3, _mm_set1_ps(col[3]))));
+        _mm_storeu_ps(r.m + c * 4, v);
+    }
+#else
+    for (int c = 0; c < 4; c++)
+        for (int row = 0; row < 4; row++)
+            r.m[c * 4 + row] = a.m[row] * b.m[c * 4] + a.m[4 + row] * b.m[c * 4 + 1] +
+                a.m[8 + row] * b.m[c * 4 + 2] + a.m[12 + row] * b.m[c * 4 + 3];
+#endif
+    return r;
+}
+
+//m * (p, 1) without the divide
+inline Vec3 Mat4TransformPoint(const Mat4& m, Vec3 p)
+{
+#if defined(MATH3D_SSE)
+    __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.m), _mm_set1_ps(p.x)), _mm_mul_ps(_mm_loadu_ps(m.m + 4), _mm_set1_ps(p.y))),
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.m + 8), _mm_set1_ps(p.z)), _mm_loadu_ps(m.m + 12)));
+    float out[4];
+    _mm_storeu_ps(out, v);
+    return MakeVec3(out[0], out[1], out[2]);
+#else
+    return MakeVec3(m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12],
+        m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13],
+        m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14]);
+#endif
+}
+
+//m * (p, 1) with w, for clip coordinates
+inline void Mat4TransformPoint4(const Mat4& m, Vec3 p, float out[4])
+{
+    for (int row = 0; row < 4; row++)
+        out[row] = m.m[row] * p.x + m.m[4 + row] * p.y + m.m[8 + row] * p.z + m.m[12 + row];
+}
+
+//m * (d, 0)
+inline Vec3 Mat4TransformDirection(const Mat4& m, Vec3 d)
+{
+    return MakeVec3(m.m[0] * d.x + m.m[4] * d.y + m.m[8] * d.z,
+        m.m[1] * d.x + m.m[5] * d.y + m.m[9] * d.z,
+        m.m[2] * d.x + m.m[6] * d.y + m.m[10] * d.z);
+}
+
+inline Mat4 Mat4Translate(float x, float y, float z)
+{
+    Mat4 r = Mat4Identity();
+    r.m[12] = x;
+    r.m[13] = y;
+    r.m[14] = z;
+    return r;
+}
+
+inline Mat4 Mat4Scale(float x, float y, float z)
+{
+    Mat4 r = Mat4Identity();
+    r.m[0] = x;
+    r.m[5] = y;
+    r.m[10] = z;
+    return r;
+}
+
+inline Mat4 Mat4FromQuat(Quat q)
+{
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    Mat4 r = { {
+        1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f,
+        2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f,
+        2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    } };
+    return r;
+}
+
+//rotation by angle around axis (normalized here), same as glRotatef in radians
+inline Mat4 Mat4Rotate(float angle, Vec3 axis)
+{
+    return Mat4FromQuat(QuatFromAxisAngle(Vec3Normalize(axis), angle));
+}
+
+//translation * rotation * scale in one go
+inline Mat4 Mat4Trs(Vec3 t, Quat r, Vec3 s)
+{
+    Mat4 m = Mat4FromQuat(r);
+    for (int k = 0; k < 4; k++) {
+        m.m[k] *= s.x;
+        m.m[4 + k] *= s.y;
+        m.m[8 + k] *= s.z;
+    }
+    m.m[12] = t.x;
+    m.m[13] = t.y;
+    m.m[14] = t.z;
+    return m;
+}
+
+//glFrustum with the extents from a vertical field of view
+inline Mat4 Mat4Perspective(float fovY, float aspect, float zNear, float zFar)
+{
+    float f = 1.0f / tanf(fovY * 0.5f);
+    Mat4 r = {};
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (zFar + zNear) / (zNear - zFar);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+    return r;
+}
+
+//same as glOrtho
+inline Mat4 Mat4Ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    Mat4 r = Mat4Identity();
+    r.m[0] = 2.0f / (right - left);
+    r.m[5] = 2.0f / (top - bottom);
+    r.m[10] = -2.0f / (zFar - zNear);
+    r.m[12] = -(right + left) / (right - left);
+    r.m[13] = -(top + bottom) / (top - bottom);
+    r.m[14] = -(zFar + zNear) / (zFar - zNear);
+    return r;
+}
+
+//view matrix of an eye looking at target, like gluLookAt
+inline Mat4 Mat4LookAt(Vec3 eye, Vec3 target, Vec3 up)
+{
+    Vec3 f = Vec3Normalize(Vec3Sub(target, eye));
+    Vec3 s = Vec3Normalize(Vec3Cross(f, up));
+    Vec3 u = Vec3Cross(s, f);
+    Mat4 r = { {
+        s.x, u.x, -f.x, 0.0f,
+        s.y, u.y, -f.y, 0.0f,
+        s.z, u.z, -f.z, 0.0f,
+        -Vec3Dot(s, eye), -Vec3Dot(u, eye), Vec3Dot(f, eye), 1.0f,
+    } };
+    return r;
+}
+
+//inverse of a rotation + translation (no scale), cheaper than a general inverse
+inline Mat4 Mat4RigidInverse(const Mat4& m)
+{
+    Mat4 r = Mat4Identity();
+    for (int c = 0; c < 3; c++)
+        for (int row = 0; row < 3; row++) r.m[c * 4 + row] = m.m[row * 4 + c];
+    for (int row = 0; row < 3; row++)
+        r.m[12 + row] = -(r.m[row] * m.m[12] + r.m[4 + row] * m.m[13] + r.m[8 + row] * m.m[14]);
+    return r;
+}
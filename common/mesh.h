@@ -0,0 +1,128 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core_renderer.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "obj_loader.h"
+
+//indexed triangle mesh loaded from an obj through the mesh cache: a hit maps
+//the cache file and hands the arrays straight to the renderer's buffers, a
+//miss imports the obj, reorders it for the vertex cache and overdraw and
+//writes the cache for next time. neither is kept once uploaded
+class StaticMesh {
+public:
+    bool load(CoreRenderer& renderer, const char* path) {
+        release();
+        Uint64 start = SDL_GetPerformanceCounter();
+        SDL_PathInfo info;
+        if (!SDL_GetPathInfo(path, &info) || info.type != SDL_PATHTYPE_FILE) {
+            SDL_Log("Couldn't find %s", path);
+            return false;
+        }
+        float overdrawThreshold = MeshOptimizeConfig().overdrawThreshold;
+
+        char cachePath[512];
+        MeshCachePath(path, cachePath, sizeof(cachePath));
+        fromCache = MeshCacheOpen(cachePath, info.size, info.modify_time, overdrawThreshold, &cache);
+        const MeshVertex* vertices;
+        const uint32_t* indices;
+        if (fromCache) {
+            vertexCount = cache.header->vertexCount;
+            indexCount = cache.header->indexCount;
+            memcpy(boundsMin, cache.header->boundsMin, sizeof(boundsMin));
+            memcpy(boundsMax, cache.header->boundsMax, sizeof(boundsMax));
+            vertices = cache.vertices;
+            indices = cache.indices;
+        }
+        else {
+            if (!ObjLoad(path, &imported)) return false;
+            //optimized once here, every cache hit gets the reordered mesh for free
+            Uint64 optimizeStart = SDL_GetPerformanceCounter();
+            MeshOptimizeReport report = MeshOptimize(&imported, overdrawThreshold);
+            SDL_Log("Mesh %s optimized in %.1f ms: acmr %.3f -> %.3f, atvr %.3f -> %.3f, %d clusters", path,
+                (double)(SDL_GetPerformanceCounter() - optimizeStart) * 1000.0 / SDL_GetPerformanceFrequency(),
+                report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, (int)report.clusters);
+            if (!MeshCacheWrite(cachePath, imported, info.size, info.modify_time, overdrawThreshold)) SDL_Log("Couldn't write %s", cachePath);
+            vertexCount = (uint32_t)imported.vertices.size();
+            indexCount = (uint32_t)imported.indices.size();
+            memcpy(boundsMin, imported.boundsMin, sizeof(boundsMin));
+            memcpy(boundsMax, imported.boundsMax, sizeof(boundsMax));
+            vertices = imported.vertices.data();
+            indices = imported.indices.data();
+        }
+
+        static const CoreVertexLayout layout = { sizeof(MeshVertex), offsetof(MeshVertex, position), -1,
+            offsetof(MeshVertex, normal), offsetof(MeshVertex, uv) };
+        this->renderer = &renderer;
+        renderer.createMesh(&mesh, layout, vertices, (int)vertexCount, indices, (int)indexCount, sizeof(uint32_t));
+        MeshCacheClose(&cache);
+        imported = MeshData();
+
+        loadMilliseconds = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        SDL_Log("Mesh %s: %u vertices, %u triangles, %s in %.1f ms", path, vertexCount, indexCount / 3,
+            fromCache ? "cache hit" : "imported", loadMilliseconds);
+        return true;
+    }
+
+    //before the renderer it was loaded with shuts down
+    void release() {
+        if (renderer) renderer->destroyMesh(&mesh);
+        renderer = nullptr;
+        MeshCacheClose(&cache);
+        imported = MeshData();
+        vertexCount = indexCount = 0;
+    }
+
+    //flat color under model, lit by the renderer's headlight
+    void draw(const Mat4& model, const float color[3]) const {
+        if (indexCount == 0) return;
+        const float tint[4] = { color[0], color[1], color[2], 1.0f };
+        renderer->drawMesh(mesh, model, tint);
+    }
+
+    //scale, then offset, that make the bounds fill width x height x depth,
+    //centered on x and z and standing on y = 0
+    void fitTransform(float width, float height, float depth, float scale[3], float offset[3]) const {
+        const float extent[3] = { width, height, depth };
+        for (int k = 0; k < 3; k++) {
+            float size = boundsMax[k] - boundsMin[k] > 1e-6f ? boundsMax[k] - boundsMin[k] : 1.0f;
+            scale[k] = extent[k] / size;
+        }
+        offset[0] = -(boundsMin[0] + boundsMax[0]) * 0.5f * scale[0];
+        offset[1] = -boundsMin[1] * scale[1];
+        offset[2] = -(boundsMin[2] + boundsMax[2]) * 0.5f * scale[2];
+    }
+
+    //the same as a matrix
+    Mat4 fitMatrix(float width, float height, float depth) const {
+        float scale[3], offset[3];
+        fitTransform(width, height, depth, scale, offset);
+        return Mat4Mul(Mat4Translate(offset[0], offset[1], offset[2]), Mat4Scale(scale[0], scale[1], scale[2]));
+    }
+
+    bool isLoaded() const { return indexCount > 0; }
+    bool wasCacheHit() const { return fromCache; }
+    double loadTime() const { return loadMilliseconds; }
+    uint32_t vertices() const { return vertexCount; }
+    uint32_t triangles() const { return indexCount / 3; }
+    const float* minBounds() const { return boundsMin; }
+    const float* maxBounds() const { return boundsMax; }
+
+private:
+    bool fromCache = false;
+    CoreRenderer* renderer = nullptr;
+    CoreMesh mesh;
+    MeshCacheFile cache;
+    MeshData imported;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    float boundsMin[3] = {};
+    float boundsMax[3] = {};
+    double loadMilliseconds = 0.0;
+};
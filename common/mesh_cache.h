@@ -0,0 +1,127 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+//on-disk container for imported meshes:
+//  MeshCacheHeader | MeshVertex[vertexCount] | uint32_t[indexCount] (16-byte aligned)
+//the arrays are stored after MeshOptimize, the file is mapped and both go to
+//glBufferData as they are. entries are keyed on the source's size and
+//modification time and on the overdraw threshold they were optimized with,
+//so a hit never reads the obj at all
+
+#define MESHCACHE_MAGIC 0x3148534Du //"MSH1"
+#define MESHCACHE_VERSION 3u //2: meshes are stored optimized, 3: overdraw threshold in the key
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+    float overdrawThreshold;
+};
+
+struct MeshCacheFile {
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+    const MeshVertex* vertices = nullptr;
+    const uint32_t* indices = nullptr;
+};
+
+inline void MeshCachePath(const char* sourcePath, char* out, size_t outSize)
+{
+    SDL_snprintf(out, outSize, "%s.meshcache", sourcePath);
+}
+
+inline void MeshCacheClose(MeshCacheFile* cache)
+{
+    UnmapFile(&cache->file);
+    cache->header = nullptr;
+    cache->vertices = nullptr;
+    cache->indices = nullptr;
+}
+
+//maps the cache file and checks it still belongs to the current source, that
+//both arrays fit inside it and that every index points at a vertex, so a
+//corrupt or stale file never reaches glDrawElements
+inline bool MeshCacheOpen(const char* cachePath, uint64_t sourceSize, int64_t sourceTime, float overdrawThreshold, MeshCacheFile* cache)
+{
+    if (!MapFile(cachePath, &cache->file)) return false;
+
+    const MeshCacheHeader* h = (const MeshCacheHeader*)cache->file.data;
+    size_t size = cache->file.size;
+    bool valid = size >= sizeof(MeshCacheHeader) &&
+        h->magic == MESHCACHE_MAGIC && h->version == MESHCACHE_VERSION &&
+        h->sourceSize == sourceSize && h->sourceTime == sourceTime && h->overdrawThreshold == overdrawThreshold &&
+        h->vertexCount > 0 && h->indexCount > 0 &&
+        h->vertexOffset <= size && (uint64_t)h->vertexCount * sizeof(MeshVertex) <= size - h->vertexOffset &&
+        h->indexOffset <= size && (uint64_t)h->indexCount * sizeof(uint32_t) <= size - h->indexOffset &&
+        h->indexCount % 3 == 0 && h->vertexOffset % 4 == 0 && h->indexOffset % 4 == 0;
+
+    //one pass over the indices, cheap next to uploading them
+    if (valid) {
+        const uint32_t* indices = (const uint32_t*)(cache->file.data + h->indexOffset);
+        uint32_t largest = 0;
+        for (uint32_t i = 0; i < h->indexCount; i++) largest = indices[i] > largest ? indices[i] : largest;
+        valid = largest < h->vertexCount;
+    }
+    if (!valid) {
+        MeshCacheClose(cache);
+        return false;
+    }
+    cache->header = h;
+    cache->vertices = (const MeshVertex*)(cache->file.data + h->vertexOffset);
+    cache->indices = (const uint32_t*)(cache->file.data + h->indexOffset);
+    return true;
+}
+
+//writes to a temp file first so a crash never leaves a half-written entry
+inline bool MeshCacheWrite(const char* cachePath, const MeshData& mesh, uint64_t sourceSize, int64_t sourceTime, float overdrawThreshold)
+{
+    MeshCacheHeader header = {};
+    header.magic = MESHCACHE_MAGIC;
+    header.version = MESHCACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.overdrawThreshold = overdrawThreshold;
+    header.vertexCount = (uint32_t)mesh.vertices.size();
+    header.indexCount = (uint32_t)mesh.indices.size();
+    header.vertexOffset = (sizeof(MeshCacheHeader) + 15) & ~15ull;
+    header.indexOffset = (header.vertexOffset + mesh.vertices.size() * sizeof(MeshVertex) + 15) & ~15ull;
+    memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+
+    char tmpPath[512];
+    SDL_snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+    SDL_IOStream* io = SDL_IOFromFile(tmpPath, "wb");
+    if (!io) return false;
+
+    //padding up to each aligned offset
+    static const unsigned char zeros[16] = {};
+    size_t vertexBytes = mesh.vertices.size() * sizeof(MeshVertex), indexBytes = mesh.indices.size() * sizeof(uint32_t);
+    bool ok = SDL_WriteIO(io, &header, sizeof(header)) == sizeof(header);
+    ok = ok && SDL_WriteIO(io, zeros, (size_t)header.vertexOffset - sizeof(header)) == (size_t)header.vertexOffset - sizeof(header);
+    ok = ok && SDL_WriteIO(io, mesh.vertices.data(), vertexBytes) == vertexBytes;
+    size_t pad = (size_t)(header.indexOffset - header.vertexOffset) - vertexBytes;
+    ok = ok && SDL_WriteIO(io, zeros, pad) == pad;
+    ok = ok && SDL_WriteIO(io, mesh.indices.data(), indexBytes) == indexBytes;
+    ok = SDL_CloseIO(io) && ok;
+
+    if (ok) {
+        SDL_RemovePath(cachePath);
+        ok = SDL_RenamePath(tmpPath, cachePath);
+    }
+    if (!ok) SDL_RemovePath(tmpPath);
+    return ok;
+}
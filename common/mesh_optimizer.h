@@ -0,0 +1,289 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "obj_loader.h"
+
+//triangle and vertex reordering for indexed meshes, run once when a mesh
+//cache entry is built:
+//  - tipsify (sander, nehab and barczak 2007) reorders triangles so they
+//    reuse vertices still in the post-transform cache
+//  - the runs tipsify emits between dead ends are split further wherever the
+//    part emitted so far already has an acmr within the overdraw threshold of
+//    the whole run's, then the clusters are sorted so outward facing parts
+//    far from the center draw first (the view-independent ordering of the
+//    same paper). that cuts overdraw from most view directions and costs at
+//    most the threshold in acmr, --overdraw-threshold 0 keeps tipsify's order
+//  - vertices are renumbered in first-use order so fetches walk memory forward
+//acmr is cache misses per triangle (0.5 is the ideal for big regular grids,
+//3 means no reuse at all), atvr is misses per vertex (1 is ideal)
+
+#define MESH_VERTEX_CACHE_SIZE 16
+#define MESH_OVERDRAW_THRESHOLD 1.05f //acmr a split cluster may cost over its tipsify run
+
+struct MeshOptimizeSettings {
+    float overdrawThreshold = MESH_OVERDRAW_THRESHOLD; //0 skips the overdraw pass
+};
+
+inline MeshOptimizeSettings& MeshOptimizeConfig()
+{
+    static MeshOptimizeSettings settings;
+    return settings;
+}
+
+//--overdraw-threshold T, below 1 turns the overdraw pass off. the threshold is
+//part of the mesh cache key, call before loading meshes
+inline void MeshOptimizeConfigure(int argc, char* argv[])
+{
+    MeshOptimizeSettings& s = MeshOptimizeConfig();
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--overdraw-threshold") == 0 && i + 1 < argc) s.overdrawThreshold = (float)SDL_atof(argv[++i]);
+    }
+    if (s.overdrawThreshold < 1.0f) s.overdrawThreshold = 0.0f;
+}
+
+struct VertexCacheStats {
+    float acmr;
+    float atvr;
+};
+
+//simulates a fifo post-transform cache of cacheSize entries
+inline VertexCacheStats MeshAnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = MESH_VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats = {};
+    if (indices.empty() || vertexCount == 0) return stats;
+    //a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<uint32_t> loadedAt(vertexCount, 0);
+    uint32_t misses = 0;
+    for (uint32_t v : indices) {
+        if (loadedAt[v] == 0 || misses - (loadedAt[v] - 1) >= (uint32_t)cacheSize) {
+            misses++;
+            loadedAt[v] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (float)(indices.size() / 3);
+    stats.atvr = (float)misses / (float)vertexCount;
+    return stats;
+}
+
+//reorders the triangles of indices in place. clusterStarts (optional) gets the
+//first triangle of every run that started over from a dead end
+inline void MeshOptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = MESH_VERTEX_CACHE_SIZE,
+    std::vector<uint32_t>* clusterStarts = nullptr)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    //triangles around every vertex
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (uint32_t v : indices) live[v]++;
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    deadEnd.reserve(indices.size());
+    uint32_t timestamp = (uint32_t)cacheSize + 1;
+    size_t cursor = 0;
+    if (clusterStarts) clusterStarts->clear();
+
+    int64_t fan = 0;
+    bool restarted = true;
+    while (fan >= 0) {
+        if (restarted && clusterStarts) clusterStarts->push_back((uint32_t)(output.size() / 3));
+        candidates.clear();
+        for (uint32_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cacheTime[v] > (uint32_t)cacheSize) cacheTime[v] = timestamp++;
+            }
+        }
+
+        //the candidate that is still cached after emitting all its triangles, oldest first
+        int64_t best = -1;
+        int bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= (uint32_t)cacheSize) priority = (int)(timestamp - cacheTime[v]);
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        restarted = best < 0;
+        if (best < 0) {
+            while (!deadEnd.empty() && best < 0) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) best = v;
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) best = (int64_t)cursor;
+                cursor++;
+            }
+        }
+        fan = best;
+    }
+    indices.swap(output);
+}
+
+//splits every run of the tipsified indices that starts at one of hardStarts.
+//a cluster ends as soon as its own acmr, starting from an empty cache, drops
+//to threshold times the acmr of the whole run: a cluster drawn in any order
+//then costs the vertex cache at most that much. small runs stay whole
+inline void MeshSplitClusters(const std::vector<uint32_t>& indices, size_t vertexCount, const std::vector<uint32_t>& hardStarts,
+    float threshold, std::vector<uint32_t>& clusterStarts, int cacheSize = MESH_VERTEX_CACHE_SIZE)
+{
+    uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+    clusterStarts.clear();
+    //the fifo of MeshAnalyzeVertexCache, skipping cacheSize misses empties it
+    std::vector<uint32_t> loadedAt(vertexCount, 0);
+    uint32_t misses = 0;
+    auto load = [&](uint32_t t) {
+        uint32_t before = misses;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if (loadedAt[v] == 0 || misses - (loadedAt[v] - 1) >= (uint32_t)cacheSize) loadedAt[v] = ++misses;
+        }
+        return misses - before;
+    };
+
+    for (size_t c = 0; c < hardStarts.size(); c++) {
+        uint32_t start = hardStarts[c];
+        uint32_t end = c + 1 < hardStarts.size() ? hardStarts[c + 1] : triangleCount;
+        misses += (uint32_t)cacheSize;
+        uint32_t runMisses = 0;
+        for (uint32_t t = start; t < end; t++) runMisses += load(t);
+        float limit = threshold * (float)runMisses;
+
+        clusterStarts.push_back(start);
+        misses += (uint32_t)cacheSize;
+        uint32_t clusterStart = start, clusterMisses = 0;
+        for (uint32_t t = start; t + 1 < end; t++) {
+            clusterMisses += load(t);
+            //clusterMisses / clusterTriangles <= threshold * runMisses / runTriangles
+            if ((float)clusterMisses * (float)(end - start) <= limit * (float)(t + 1 - clusterStart)) {
+                clusterStarts.push_back(t + 1);
+                clusterStart = t + 1;
+                clusterMisses = 0;
+                misses += (uint32_t)cacheSize;
+            }
+        }
+    }
+}
+
+//sorts the clusters by how much they face away from the mesh center,
+//outermost first
+inline void MeshOptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices,
+    const std::vector<uint32_t>& clusterStarts)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (clusterStarts.size() < 2) return;
+
+    float center[3] = {};
+    float totalArea = 0.0f;
+    struct Cluster {
+        uint32_t start, end;
+        float score;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size());
+    std::vector<float> centroids(clusters.size() * 3, 0.0f), normals(clusters.size() * 3, 0.0f), areas(clusters.size(), 0.0f);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        clusters[c].start = clusterStarts[c];
+        clusters[c].end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : (uint32_t)triangleCount;
+        for (uint32_t t = clusters[c].start; t < clusters[c].end; t++) {
+            const float* p0 = vertices[indices[t * 3]].position;
+            const float* p1 = vertices[indices[t * 3 + 1]].position;
+            const float* p2 = vertices[indices[t * 3 + 2]].position;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5f;
+            for (int k = 0; k < 3; k++) {
+                float mid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                centroids[c * 3 + k] += mid * area;
+                normals[c * 3 + k] += n[k];
+                center[k] += mid * area;
+            }
+            areas[c] += area;
+            totalArea += area;
+        }
+    }
+    if (totalArea <= 0.0f) return;
+    for (int k = 0; k < 3; k++) center[k] /= totalArea;
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float* n = &normals[c * 3];
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float score = 0.0f;
+        if (length > 0.0f && areas[c] > 0.0f) {
+            for (int k = 0; k < 3; k++) score += (centroids[c * 3 + k] / areas[c] - center[k]) * n[k] / length;
+        }
+        clusters[c].score = score;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.score > b.score; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (const Cluster& c : clusters) sorted.insert(sorted.end(), indices.begin() + c.start * 3, indices.begin() + c.end * 3);
+    indices.swap(sorted);
+}
+
+//renumbers vertices in the order the indices first use them, unused ones are dropped
+inline void MeshOptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<MeshVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (uint32_t& v : indices) {
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = (uint32_t)ordered.size();
+            ordered.push_back(vertices[v]);
+        }
+        v = remap[v];
+    }
+    vertices.swap(ordered);
+}
+
+struct MeshOptimizeReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t clusters;
+};
+
+//the whole pass, triangle order first since vertex order follows from it.
+//overdrawThreshold is MeshOptimizeSettings::overdrawThreshold, 0 for none
+inline MeshOptimizeReport MeshOptimize(MeshData* mesh, float overdrawThreshold)
+{
+    MeshOptimizeReport report = {};
+    report.before = MeshAnalyzeVertexCache(mesh->indices, mesh->vertices.size());
+    std::vector<uint32_t> runStarts, clusterStarts;
+    MeshOptimizeVertexCache(mesh->indices, mesh->vertices.size(), MESH_VERTEX_CACHE_SIZE, &runStarts);
+    if (overdrawThreshold >= 1.0f) {
+        MeshSplitClusters(mesh->indices, mesh->vertices.size(), runStarts, overdrawThreshold, clusterStarts);
+        MeshOptimizeOverdraw(mesh->indices, mesh->vertices, clusterStarts);
+    }
+    report.clusters = overdrawThreshold >= 1.0f ? clusterStarts.size() : runStarts.size();
+    MeshOptimizeVertexFetch(mesh->vertices, mesh->indices);
+    report.after = MeshAnalyzeVertexCache(mesh->indices, mesh->vertices.size());
+    return report;
+}
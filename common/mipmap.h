@@ -0,0 +1,339 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+#include "thread_pool.h"
+
+//cpu mip chain builder for 8-bit rgb/rgba images.
+//color is filtered in linear light (srgb decode -> filter -> encode), alpha as is.
+//filters are separable and downsample by 2: vertical taps summed over whole rows
+//(avx/sse), then horizontal taps per rgba pixel (sse). no fma, so the result is
+//bit-identical whichever kernel runs.
+//the avx row kernel lives in mipmap_avx.cpp, the only file built with avx
+//enabled, and is picked at runtime when cpuid and the os say avx works, so
+//projects using this header have to compile that file too.
+//each job decodes a source row once and keeps it while the vertical taps of
+//the next output rows still need it.
+//--mip-bench [size] times the whole chain of a size x size image (4096 by
+//default) for both filters with every kernel the cpu has
+
+enum MipFilter {
+    MIP_FILTER_BOX,    //2 taps, cheap, slightly blurry
+    MIP_FILTER_KAISER, //8-tap kaiser windowed sinc, sharper
+};
+
+struct MipLevel {
+    int width;
+    int height;
+    unsigned char* pixels;
+};
+
+#define MIP_MAX_TAPS 8
+#define MIP_ENCODE_LUT_SIZE 16384
+
+struct MipKernel {
+    int taps;
+    int offset; //src index of tap 0 is 2 * dst - offset
+    float weights[MIP_MAX_TAPS];
+};
+
+enum MipIsa {
+    MIP_ISA_SCALAR,
+    MIP_ISA_SSE,
+    MIP_ISA_AVX,
+};
+
+struct MipTables {
+    float decode[256];
+    unsigned char encode[MIP_ENCODE_LUT_SIZE];
+};
+
+inline const MipTables& GetMipTables()
+{
+    static MipTables tables = [] {
+        MipTables t;
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            t.decode[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < MIP_ENCODE_LUT_SIZE; i++) {
+            float l = i / (float)(MIP_ENCODE_LUT_SIZE - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+            t.encode[i] = (unsigned char)(c * 255.0f + 0.5f);
+        }
+        return t;
+    }();
+    return tables;
+}
+
+inline double MipBesselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+inline MipKernel MakeMipKernel(MipFilter filter)
+{
+    MipKernel k = {};
+    if (filter == MIP_FILTER_BOX) {
+        k.taps = 2;
+        k.offset = 0;
+        k.weights[0] = k.weights[1] = 0.5f;
+        return k;
+    }
+
+    //taps sit at distance (i - 3.5) from the centre between the two source
+    //pixels, cutoff at half the source nyquist
+    const double beta = 4.0;
+    const double radius = MIP_MAX_TAPS / 2.0;
+    k.taps = MIP_MAX_TAPS;
+    k.offset = MIP_MAX_TAPS / 2 - 1;
+    double sum = 0.0;
+    double w[MIP_MAX_TAPS];
+    for (int i = 0; i < k.taps; i++) {
+        double d = i - (k.taps - 1) / 2.0;
+        double x = d * 0.5 * 3.14159265358979323846;
+        double sinc = x == 0.0 ? 1.0 : sin(x) / x;
+        double r = d / radius;
+        double window = MipBesselI0(beta * sqrt(1.0 - r * r)) / MipBesselI0(beta);
+        w[i] = sinc * window;
+        sum += w[i];
+    }
+    for (int i = 0; i < k.taps; i++) k.weights[i] = (float)(w[i] / sum);
+    return k;
+}
+
+inline int MipWrapIndex(int i, int size, bool wrap)
+{
+    if (i >= 0 && i < size) return i;
+    if (wrap) return ((i % size) + size) % size;
+    return i < 0 ? 0 : size - 1;
+}
+
+//src row -> linear rgba floats
+inline void MipDecodeRow(const unsigned char* src, int width, int channels, float* out, const MipTables& t)
+{
+    for (int x = 0; x < width; x++) {
+        out[x * 4 + 0] = t.decode[src[x * channels + 0]];
+        out[x * 4 + 1] = t.decode[src[x * channels + 1]];
+        out[x * 4 + 2] = t.decode[src[x * channels + 2]];
+        out[x * 4 + 3] = channels == 4 ? src[x * channels + 3] / 255.0f : 1.0f;
+    }
+}
+
+//cpu supports avx and the os saves the ymm registers
+inline bool MipCpuHasAvx()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    bool avx = (info[2] & (1 << 28)) != 0, osxsave = (info[2] & (1 << 27)) != 0;
+    return avx && osxsave && (_xgetbv(0) & 6) == 6;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_AVX) || !(c & bit_OSXSAVE)) return false;
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (lo & 6) == 6;
+#else
+    return false;
+#endif
+}
+
+inline MipIsa MipBestIsa()
+{
+    if (MipCpuHasAvx()) return MIP_ISA_AVX;
+#if defined(MIPMAP_SSE)
+    return MIP_ISA_SSE;
+#else
+    return MIP_ISA_SCALAR;
+#endif
+}
+
+//kernel the chains are built with, detected once, the benchmark switches it
+inline MipIsa& MipActiveIsa()
+{
+    static MipIsa isa = MipBestIsa();
+    return isa;
+}
+
+//acc[i] += row[i] * w, mipmap_avx.cpp
+void MipAccumulateRowAvx(float* acc, const float* row, float w, int count);
+
+inline void MipAccumulateRow(float* acc, const float* row, float w, int count)
+{
+    int i = 0;
+    MipIsa isa = MipActiveIsa();
+    if (isa == MIP_ISA_AVX) {
+        MipAccumulateRowAvx(acc, row, w, count);
+        return;
+    }
+#if defined(MIPMAP_SSE)
+    if (isa == MIP_ISA_SSE) {
+        __m128 w4 = _mm_set1_ps(w);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(row + i), w4)));
+    }
+#endif
+    for (; i < count; i++) acc[i] += row[i] * w;
+}
+
+inline unsigned char MipEncodeLinear(float v, const MipTables& t)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return t.encode[(int)(v * (MIP_ENCODE_LUT_SIZE - 1) + 0.5f)];
+}
+
+inline unsigned char MipEncodeAlpha(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+//horizontal taps over the vertically filtered row, then back to 8-bit srgb
+inline void MipFilterRow(const float* acc, int srcWidth, unsigned char* dst, int dstWidth, int channels,
+    const MipKernel& k, bool wrap, const MipTables& t)
+{
+    bool simd = MipActiveIsa() != MIP_ISA_SCALAR;
+    for (int x = 0; x < dstWidth; x++) {
+        int first = 2 * x - k.offset;
+        bool inside = first >= 0 && first + k.taps <= srcWidth;
+        float out[4];
+#if defined(MIPMAP_SSE)
+        if (simd) {
+            __m128 sum = _mm_setzero_ps();
+            for (int i = 0; i < k.taps; i++) {
+                int sx = inside ? first + i : MipWrapIndex(first + i, srcWidth, wrap);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(acc + sx * 4), _mm_set1_ps(k.weights[i])));
+            }
+            _mm_storeu_ps(out, sum);
+        }
+        else
+#endif
+        {
+            out[0] = out[1] = out[2] = out[3] = 0.0f;
+            for (int i = 0; i < k.taps; i++) {
+                int sx = inside ? first + i : MipWrapIndex(first + i, srcWidth, wrap);
+                for (int c = 0; c < 4; c++) out[c] += acc[sx * 4 + c] * k.weights[i];
+            }
+        }
+        unsigned char* p = dst + x * channels;
+        p[0] = MipEncodeLinear(out[0], t);
+        p[1] = MipEncodeLinear(out[1], t);
+        p[2] = MipEncodeLinear(out[2], t);
+        if (channels == 4) p[3] = MipEncodeAlpha(out[3]);
+    }
+}
+
+//one level from the previous one, rows split across the thread pool
+inline void MipDownsample(const MipLevel& src, const MipLevel& dst, int channels, const MipKernel& kernel, bool wrap)
+{
+    //a 1-pixel dimension is just copied through instead of filtered
+    MipKernel kx = kernel, ky = kernel;
+    MipKernel single = { 1, 0, { 1.0f } };
+    if (src.width == 1) kx = single;
+    if (src.height == 1) ky = single;
+    int stepY = src.height == 1 ? 0 : 2;
+
+    const MipTables& t = GetMipTables();
+    GlobalThreadPool().parallelFor(dst.height, 8, [&](int begin, int end) {
+        //decoded rows by unwrapped source row, row j sits in slot j % taps.
+        //the taps of one output row hit distinct slots and the next output
+        //row only replaces the two it no longer needs
+        size_t rowFloats = (size_t)src.width * 4;
+        std::vector<float> rows(rowFloats * ky.taps);
+        int tags[MIP_MAX_TAPS];
+        std::fill(tags, tags + MIP_MAX_TAPS, INT32_MIN);
+        std::vector<float> acc(rowFloats);
+        for (int y = begin; y < end; y++) {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            int first = stepY * y - ky.offset;
+            for (int i = 0; i < ky.taps; i++) {
+                int j = first + i;
+                int slot = ((j % ky.taps) + ky.taps) % ky.taps;
+                float* row = rows.data() + rowFloats * slot;
+                if (tags[slot] != j) {
+                    int sy = MipWrapIndex(j, src.height, wrap);
+                    MipDecodeRow(src.pixels + (size_t)sy * src.width * channels, src.width, channels, row, t);
+                    tags[slot] = j;
+                }
+                MipAccumulateRow(acc.data(), row, ky.weights[i], src.width * 4);
+            }
+            MipFilterRow(acc.data(), src.width, dst.pixels + (size_t)y * dst.width * channels, dst.width, channels, kx, wrap, t);
+        }
+    });
+}
+
+//fills levels[1..count-1] from levels[0], sizes and buffers are set by the caller
+//(each level is max(1, previous / 2) in both directions)
+inline void GenerateMipChain(MipLevel* levels, int count, int channels, MipFilter filter, bool wrap)
+{
+    MipKernel kernel = MakeMipKernel(filter);
+    for (int i = 1; i < count; i++)
+        MipDownsample(levels[i - 1], levels[i], channels, kernel, wrap);
+}
+
+//--mip-bench: full chains of a synthetic size x size rgba image, both filters,
+//each kernel the cpu runs. also checks the kernels agree to the bit
+inline void MipBenchmark(int size)
+{
+    static const char* filterNames[] = { "box", "kaiser" };
+    static const char* isaNames[] = { "scalar", "sse", "avx" };
+    const int channels = 4;
+    int count = 1;
+    while ((size >> (count - 1)) > 1) count++;
+
+    std::vector<std::vector<unsigned char>> buffers(count);
+    std::vector<MipLevel> levels(count);
+    for (int i = 0, w = size, h = size; i < count; i++) {
+        buffers[i].resize((size_t)w * h * channels);
+        levels[i] = { w, h, buffers[i].data() };
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    uint32_t seed = 1;
+    for (size_t i = 0; i < buffers[0].size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        size_t p = i / channels;
+        buffers[0][i] = (unsigned char)(((p % size) ^ (p / size)) + (seed >> 28));
+    }
+
+    MipIsa best = MipBestIsa();
+    for (int f = MIP_FILTER_BOX; f <= MIP_FILTER_KAISER; f++) {
+        std::vector<unsigned char> reference;
+        for (int isa = MIP_ISA_SCALAR; isa <= best; isa++) {
+            MipActiveIsa() = (MipIsa)isa;
+            GenerateMipChain(levels.data(), count, channels, (MipFilter)f, true); //warm-up
+            const int runs = 3;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int r = 0; r < runs; r++) GenerateMipChain(levels.data(), count, channels, (MipFilter)f, true);
+            double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() / runs;
+
+            bool same = true;
+            if (reference.empty()) reference = buffers[1];
+            else same = reference == buffers[1];
+            SDL_Log("Mip chain %dx%d %s %s: %.2f ms, %.1f MPixels/s%s", size, size, filterNames[f], isaNames[isa],
+                seconds * 1000.0, size * (double)size / seconds / 1e6, same ? "" : ", output differs from scalar");
+        }
+    }
+    MipActiveIsa() = best;
+}
@@ -0,0 +1,18 @@
+//the avx kernels of mipmap.h. this is the only file compiled with avx
+//enabled (/arch:AVX in the project), mipmap.h calls into it only after
+//cpuid said the cpu and os support it
+#if defined(__GNUC__) && !defined(__AVX__)
+#pragma GCC target("avx")
+#endif
+
+#include <immintrin.h>
+
+//acc[i] += row[i] * w, mul and add kept apart so it matches the sse and scalar kernels bit for bit
+void MipAccumulateRowAvx(float* acc, const float* row, float w, int count)
+{
+    int i = 0;
+    __m256 w8 = _mm256_set1_ps(w);
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(row + i), w8)));
+    for (; i < count; i++) acc[i] += row[i] * w;
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "mapped_file.h"
+
+//wavefront obj import: the file is mapped and scanned in place, positions,
+//normals and texcoords go into flat arrays sized by a first counting pass,
+//and every distinct v/vt/vn corner becomes one vertex of an indexed
+//triangle list (polygons are fanned). only geometry is read, materials,
+//groups and smoothing groups are skipped. corners without vn get the area
+//weighted average of the faces around them.
+
+struct MeshVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct MeshData {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+//float parser for the plain decimal forms obj writers emit (optional sign,
+//digits, fraction, exponent), no locale and no allocation
+inline const char* ObjParseFloat(const char* p, const char* end, float* out)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else exponent++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExp = false;
+        if (q < end && (*q == '-' || *q == '+')) negativeExp = *q++ == '-';
+        int e = 0;
+        if (q < end && *q >= '0' && *q <= '9') {
+            for (; q < end && *q >= '0' && *q <= '9'; q++) e = e < 10000 ? e * 10 + (*q - '0') : e;
+            exponent += negativeExp ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = (double)mantissa;
+    while (exponent > 22) { value *= 1e22; exponent -= 22; }
+    while (exponent < -22) { value /= 1e22; exponent += 22; }
+    value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+    *out = (float)(negative ? -value : value);
+    return p;
+}
+
+//one v, v/vt, v//vn or v/vt/vn corner, indices come back 0-based or -1
+inline const char* ObjParseCorner(const char* p, const char* end, int positions, int uvs, int normals, int out[3])
+{
+    int counts[3] = { positions, uvs, normals };
+    for (int k = 0; k < 3; k++) {
+        out[k] = -1;
+        if (k > 0) {
+            if (p >= end || *p != '/') continue;
+            p++;
+        }
+        bool negative = false;
+        if (p < end && *p == '-') {
+            negative = true;
+            p++;
+        }
+        if (p >= end || *p < '0' || *p > '9') continue;
+        int value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) value = value * 10 + (*p - '0');
+        //negative indices count back from the last element read so far
+        out[k] = negative ? counts[k] - value : value - 1;
+        if (out[k] < 0 || out[k] >= counts[k]) out[k] = -1;
+    }
+    return p;
+}
+
+//open addressing map from a v/vt/vn triple to its vertex index
+class ObjCornerMap {
+public:
+    explicit ObjCornerMap(size_t expected) {
+        size_t capacity = 1024;
+        while (capacity < expected * 2) capacity *= 2;
+        slots.assign(capacity, Slot{ { 0, 0, 0 }, UINT32_MAX });
+    }
+
+    //index of the corner, inserting next when it is new
+    uint32_t find(const int key[3], uint32_t next, bool* inserted) {
+        if ((count + 1) * 2 > slots.size()) grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            Slot& s = slots[i];
+            if (s.index == UINT32_MAX) {
+                memcpy(s.key, key, sizeof(s.key));
+                s.index = next;
+                count++;
+                *inserted = true;
+                return next;
+            }
+            if (s.key[0] == key[0] && s.key[1] == key[1] && s.key[2] == key[2]) {
+                *inserted = false;
+                return s.index;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        int key[3];
+        uint32_t index;
+    };
+
+    static size_t hash(const int key[3]) {
+        uint64_t h = (uint32_t)key[0] * 0x9E3779B97F4A7C15ull;
+        h ^= ((uint32_t)key[1] + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+        h ^= ((uint32_t)key[2] + 0x165667B19E3779F9ull) * 0x27D4EB2F165667C5ull;
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(old.size() * 2, Slot{ { 0, 0, 0 }, UINT32_MAX });
+        size_t mask = slots.size() - 1;
+        for (const Slot& s : old) {
+            if (s.index == UINT32_MAX) continue;
+            size_t i = hash(s.key) & mask;
+            while (slots[i].index != UINT32_MAX) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+inline const char* ObjNextLine(const char* p, const char* end)
+{
+    const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline + 1 : end;
+}
+
+inline bool ObjImport(const unsigned char* data, size_t size, MeshData* mesh)
+{
+    const char* begin = (const char*)data;
+    const char* end = begin + size;
+
+    //count first so nothing reallocates while parsing
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, faceLines = 0, cornerEstimate = 0;
+    for (const char* p = begin; p < end;) {
+        const char* next = ObjNextLine(p, end);
+        if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) positionCount++;
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 't') uvCount++;
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 'n') normalCount++;
+        else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            faceLines++;
+            for (const char* q = p + 2; q < next; q++) cornerEstimate += q[-1] <= ' ' && q[0] > ' ';
+        }
+        p = next;
+    }
+
+    std::vector<float> positions, uvs, normals;
+    positions.reserve(positionCount * 3);
+    uvs.reserve(uvCount * 2);
+    normals.reserve(normalCount * 3);
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    //seams in uvs or normals add some vertices on top of the positions
+    mesh->vertices.reserve(positionCount + positionCount / 4);
+    mesh->indices.reserve((cornerEstimate > faceLines * 2 ? cornerEstimate - faceLines * 2 : 0) * 3);
+
+    ObjCornerMap corners(positionCount + positionCount / 4);
+    std::vector<uint32_t> polygon;
+    std::vector<uint8_t> noNormal; //corners without a vn, filled in at the end
+    noNormal.reserve(positionCount + positionCount / 4);
+    bool missingNormals = false;
+    for (const char* p = begin; p < end;) {
+        const char* next = ObjNextLine(p, end);
+        if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            float v[3] = {};
+            const char* q = p + 1;
+            for (int k = 0; k < 3; k++) q = ObjParseFloat(q, next, &v[k]);
+            positions.insert(positions.end(), v, v + 3);
+        }
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 't') {
+            float v[2] = {};
+            const char* q = p + 2;
+            for (int k = 0; k < 2; k++) q = ObjParseFloat(q, next, &v[k]);
+            uvs.insert(uvs.end(), v, v + 2);
+        }
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 'n') {
+            float v[3] = {};
+            const char* q = p + 2;
+            for (int k = 0; k < 3; k++) q = ObjParseFloat(q, next, &v[k]);
+            normals.insert(normals.end(), v, v + 3);
+        }
+        else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            polygon.clear();
+            const char* q = p + 1;
+            int np = (int)(positions.size() / 3), nt = (int)(uvs.size() / 2), nn = (int)(normals.size() / 3);
+            while (q < next) {
+                while (q < next && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+                if (q >= next || *q == '\n' || *q == '#') break;
+                int key[3];
+                const char* after = ObjParseCorner(q, next, np, nt, nn, key);
+                if (after == q) break;
+                q = after;
+                if (key[0] < 0) continue;
+
+                bool inserted;
+                uint32_t index = corners.find(key, (uint32_t)mesh->vertices.size(), &inserted);
+                if (inserted) {
+                    MeshVertex v = {};
+                    memcpy(v.position, &positions[key[0] * 3], sizeof(v.position));
+                    if (key[1] >= 0) memcpy(v.uv, &uvs[key[1] * 2], sizeof(v.uv));
+                    if (key[2] >= 0) memcpy(v.normal, &normals[key[2] * 3], sizeof(v.normal));
+                    mesh->vertices.push_back(v);
+                    noNormal.push_back(key[2] < 0);
+                    missingNormals |= key[2] < 0;
+                }
+                polygon.push_back(index);
+            }
+            for (size_t k = 2; k < polygon.size(); k++) {
+                mesh->indices.push_back(polygon[0]);
+                mesh->indices.push_back(polygon[k - 1]);
+                mesh->indices.push_back(polygon[k]);
+            }
+        }
+        p = next;
+    }
+    if (mesh->indices.empty()) return false;
+
+    //fill in the normals the file did not have
+    if (missingNormals) {
+        for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3) {
+            MeshVertex* v[3] = { &mesh->vertices[mesh->indices[i]], &mesh->vertices[mesh->indices[i + 1]], &mesh->vertices[mesh->indices[i + 2]] };
+            float e1[3], e2[3];
+            for (int k = 0; k < 3; k++) {
+                e1[k] = v[1]->position[k] - v[0]->position[k];
+                e2[k] = v[2]->position[k] - v[0]->position[k];
+            }
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (int c = 0; c < 3; c++) {
+                if (!noNormal[mesh->indices[i + c]]) continue;
+                for (int k = 0; k < 3; k++) v[c]->normal[k] += n[k];
+            }
+        }
+        for (size_t i = 0; i < mesh->vertices.size(); i++) {
+            if (!noNormal[i]) continue;
+            MeshVertex& v = mesh->vertices[i];
+            float length = sqrtf(v.normal[0] * v.normal[0] + v.normal[1] * v.normal[1] + v.normal[2] * v.normal[2]);
+            if (length > 0.0f)
+                for (int k = 0; k < 3; k++) v.normal[k] /= length;
+        }
+    }
+
+    for (int k = 0; k < 3; k++) {
+        mesh->boundsMin[k] = FLT_MAX;
+        mesh->boundsMax[k] = -FLT_MAX;
+    }
+    for (const MeshVertex& v : mesh->vertices) {
+        for (int k = 0; k < 3; k++) {
+            if (v.position[k] < mesh->boundsMin[k]) mesh->boundsMin[k] = v.position[k];
+            if (v.position[k] > mesh->boundsMax[k]) mesh->boundsMax[k] = v.position[k];
+        }
+    }
+    return true;
+}
+
+inline bool ObjLoad(const char* path, MeshData* mesh)
+{
+    MappedFile file;
+    if (!MapFile(path, &file)) {
+        SDL_Log("Couldn't open %s", path);
+        return false;
+    }
+    bool ok = ObjImport(file.data, file.size, mesh);
+    UnmapFile(&file);
+    if (!ok) SDL_Log("No triangles in %s", path);
+    return ok;
+}
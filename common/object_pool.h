@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+//fixed capacity storage for game entities that come and go. all the memory is
+//taken up front, spawning and despawning never allocate. live objects stay
+//packed at the front so iterating them is a plain array walk; despawning moves
+//the last one into the hole, so the order changes and pointers into the pool
+//only hold until the next despawn. a PoolHandle stays valid for as long as its
+//object lives and a despawned object's handle never resolves again, even once
+//the slot is reused: each slot counts its generations
+
+struct PoolHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0; //0 is never handed out
+
+    bool valid() const { return generation != 0; }
+    bool operator==(const PoolHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(int capacity) {
+        objects.reserve(capacity);
+        owners.reserve(capacity);
+        dense.resize(capacity);
+        generations.assign(capacity, 1);
+        freeSlots.reserve(capacity);
+        for (int i = capacity - 1; i >= 0; i--) freeSlots.push_back((uint32_t)i);
+    }
+
+    //an invalid handle when the pool is full
+    PoolHandle spawn(const T& value = T()) {
+        if (freeSlots.empty()) return PoolHandle();
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        dense[slot] = (uint32_t)objects.size();
+        objects.push_back(value);
+        owners.push_back(slot);
+        PoolHandle handle;
+        handle.slot = slot;
+        handle.generation = generations[slot];
+        return handle;
+    }
+
+    //false when the handle was already despawned
+    bool despawn(PoolHandle handle) {
+        if (!get(handle)) return false;
+        removeAt(dense[handle.slot]);
+        return true;
+    }
+
+    //despawns every object the predicate picks, returns how many
+    template <typename Pred>
+    int despawnIf(Pred pred) {
+        int removed = 0;
+        for (size_t i = 0; i < objects.size();) {
+            if (pred(objects[i])) {
+                removeAt((uint32_t)i);
+                removed++;
+            } else {
+                i++;
+            }
+        }
+        return removed;
+    }
+
+    //null when the object is gone
+    T* get(PoolHandle handle) {
+        if (handle.slot >= generations.size() || generations[handle.slot] != handle.generation) return nullptr;
+        return &objects[dense[handle.slot]];
+    }
+    const T* get(PoolHandle handle) const {
+        if (handle.slot >= generations.size() || generations[handle.slot] != handle.generation) return nullptr;
+        return &objects[dense[handle.slot]];
+    }
+
+    //the handle of the i-th live object
+    PoolHandle handleAt(int index) const {
+        PoolHandle handle;
+        handle.slot = owners[index];
+        handle.generation = generations[handle.slot];
+        return handle;
+    }
+
+    void clear() {
+        while (!objects.empty()) removeAt((uint32_t)objects.size() - 1);
+    }
+
+    int size() const { return (int)objects.size(); }
+    int capacity() const { return (int)generations.size(); }
+    bool full() const { return freeSlots.empty(); }
+
+    T* begin() { return objects.data(); }
+    T* end() { return objects.data() + objects.size(); }
+    const T* begin() const { return objects.data(); }
+    const T* end() const { return objects.data() + objects.size(); }
+
+private:
+    void removeAt(uint32_t index) {
+        uint32_t slot = owners[index];
+        uint32_t last = (uint32_t)objects.size() - 1;
+        if (index != last) {
+            objects[index] = objects[last];
+            owners[index] = owners[last];
+            dense[owners[index]] = index;
+        }
+        objects.pop_back();
+        owners.pop_back();
+        if (++generations[slot] == 0) generations[slot] = 1;
+        freeSlots.push_back(slot);
+    }
+
+    std::vector<T> objects; //live objects, packed
+    std::vector<uint32_t> owners; //slot of each live object
+    std::vector<uint32_t> dense; //index into objects for each slot
+    std::vector<uint32_t> generations; //current generation of each slot
+    std::vector<uint32_t> freeSlots;
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <math.h>
+#include <vector>
+
+#include "spatial_index.h"
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+//software occlusion culling: a few big occluder boxes are rasterized into a
+//small depth buffer on the cpu, then object boxes are tested against it
+//before any draw is issued.
+//occluder triangles are binned into screen tiles and the tiles rasterized in
+//parallel, four pixels at a time. depth is ndc z in 0..1 (nearest occluder
+//per pixel), and every 8x8 block also keeps its farthest depth so most
+//occluded boxes are rejected without touching single pixels.
+//occluders that cross the near plane are skipped and occludees that cross
+//it are always visible, both errors only ever keep things visible.
+
+#define OCCLUSION_BLOCK 8
+
+class OcclusionBuffer {
+public:
+    //width, height and tileSize multiples of OCCLUSION_BLOCK
+    OcclusionBuffer(int width, int height, int tileSize = 32)
+        : width(width), height(height), tileSize(tileSize),
+        tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize),
+        blocksX(width / OCCLUSION_BLOCK), blocksY(height / OCCLUSION_BLOCK),
+        depth((size_t)width * height), blockMax((size_t)blocksX * blocksY), bins((size_t)tilesX * tilesY) {}
+
+    //clip is projection * modelview (column-major) for the space boxes are given in
+    void begin(const float clip[16]) {
+        for (int i = 0; i < 16; i++) matrix[i] = clip[i];
+        triangles.clear();
+        occluders = 0;
+        tested.store(0);
+        occluded.store(0);
+    }
+
+    void addOccluder(const Aabb& box) {
+        float sx[8], sy[8], sz[8];
+        for (int c = 0; c < 8; c++) {
+            float p[3] = { (c & 1) ? box.max[0] : box.min[0], (c & 2) ? box.max[1] : box.min[1], (c & 4) ? box.max[2] : box.min[2] };
+            float w;
+            project(p, &sx[c], &sy[c], &sz[c], &w);
+            if (w < 1e-3f) return;
+        }
+        //two triangles per face, corners indexed by their min/max bits
+        static const int faces[6][4] = {
+            { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 },
+            { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+        };
+        for (int f = 0; f < 6; f++) {
+            const int* q = faces[f];
+            addTriangle(sx, sy, sz, q[0], q[1], q[2]);
+            addTriangle(sx, sy, sz, q[0], q[2], q[3]);
+        }
+        occluders++;
+    }
+
+    //fills the depth buffer from every occluder added since begin()
+    void rasterize(ThreadPool* pool) {
+        for (auto& bin : bins) bin.clear();
+        for (int t = 0; t < (int)triangles.size(); t++) {
+            const Triangle& tri = triangles[t];
+            int x0 = std::max((int)tri.minX / tileSize, 0), x1 = std::min((int)tri.maxX / tileSize, tilesX - 1);
+            int y0 = std::max((int)tri.minY / tileSize, 0), y1 = std::min((int)tri.maxY / tileSize, tilesY - 1);
+            for (int ty = y0; ty <= y1; ty++)
+                for (int tx = x0; tx <= x1; tx++) bins[(size_t)ty * tilesX + tx].push_back(t);
+        }
+
+        auto work = [this](int begin, int end) {
+            for (int tile = begin; tile < end; tile++) rasterizeTile(tile);
+        };
+        if (pool) pool->parallelFor(tilesX * tilesY, 1, work);
+        else work(0, tilesX * tilesY);
+    }
+
+    //false when every pixel the box covers has an occluder in front of it.
+    //safe to call from several threads at once after rasterize
+    bool isVisible(const Aabb& box) {
+        tested.fetch_add(1, std::memory_order_relaxed);
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+        for (int c = 0; c < 8; c++) {
+            float p[3] = { (c & 1) ? box.max[0] : box.min[0], (c & 2) ? box.max[1] : box.min[1], (c & 4) ? box.max[2] : box.min[2] };
+            float x, y, z, w;
+            project(p, &x, &y, &z, &w);
+            if (w < 1e-3f) return true;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            nearest = std::min(nearest, z);
+        }
+        int x0 = std::max((int)floorf(minX), 0), x1 = std::min((int)ceilf(maxX), width) - 1;
+        int y0 = std::max((int)floorf(minY), 0), y1 = std::min((int)ceilf(maxY), height) - 1;
+        if (x0 > x1 || y0 > y1) return true; //off screen, the frustum test decides
+
+        for (int by = y0 / OCCLUSION_BLOCK; by <= y1 / OCCLUSION_BLOCK; by++) {
+            for (int bx = x0 / OCCLUSION_BLOCK; bx <= x1 / OCCLUSION_BLOCK; bx++) {
+                if (blockMax[(size_t)by * blocksX + bx] < nearest) continue;
+                int px0 = std::max(bx * OCCLUSION_BLOCK, x0), px1 = std::min(bx * OCCLUSION_BLOCK + OCCLUSION_BLOCK - 1, x1);
+                int py0 = std::max(by * OCCLUSION_BLOCK, y0), py1 = std::min(by * OCCLUSION_BLOCK + OCCLUSION_BLOCK - 1, y1);
+                for (int y = py0; y <= py1; y++) {
+                    const float* row = &depth[(size_t)y * width];
+                    for (int x = px0; x <= px1; x++)
+                        if (row[x] >= nearest) return true;
+                }
+            }
+        }
+        occluded.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    int bufferWidth() const { return width; }
+    int bufferHeight() const { return height; }
+    const float* depthData() const { return depth.data(); }
+    int occluderCount() const { return occluders; }
+    int triangleCount() const { return (int)triangles.size(); }
+    int testedCount() const { return tested.load(); }
+    int occludedCount() const { return occluded.load(); }
+
+private:
+    struct Triangle {
+        float x[3], y[3];
+        float z0, dzdx, dzdy; //depth plane at the origin
+        float minX, minY, maxX, maxY;
+    };
+
+    void project(const float p[3], float* x, float* y, float* z, float* w) const {
+        const float* m = matrix;
+        float cx = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+        float cy = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+        float cz = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+        *w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+        float inv = *w != 0.0f ? 1.0f / *w : 0.0f;
+        *x = (cx * inv * 0.5f + 0.5f) * width;
+        *y = (cy * inv * 0.5f + 0.5f) * height;
+        *z = cz * inv * 0.5f + 0.5f;
+    }
+
+    void addTriangle(const float* sx, const float* sy, const float* sz, int a, int b, int c) {
+        float area = (sx[b] - sx[a]) * (sy[c] - sy[a]) - (sx[c] - sx[a]) * (sy[b] - sy[a]);
+        if (fabsf(area) < 1e-6f) return;
+        //counter-clockwise so all three edge functions are positive inside
+        if (area < 0.0f) std::swap(b, c), area = -area;
+
+        Triangle t;
+        int idx[3] = { a, b, c };
+        for (int i = 0; i < 3; i++) {
+            t.x[i] = sx[idx[i]];
+            t.y[i] = sy[idx[i]];
+        }
+        float z1 = sz[b] - sz[a], z2 = sz[c] - sz[a];
+        float x1 = sx[b] - sx[a], x2 = sx[c] - sx[a];
+        float y1 = sy[b] - sy[a], y2 = sy[c] - sy[a];
+        t.dzdx = (z1 * y2 - z2 * y1) / area;
+        t.dzdy = (z2 * x1 - z1 * x2) / area;
+        t.z0 = sz[a] - t.dzdx * sx[a] - t.dzdy * sy[a];
+        t.minX = std::min(t.x[0], std::min(t.x[1], t.x[2]));
+        t.maxX = std::max(t.x[0], std::max(t.x[1], t.x[2]));
+        t.minY = std::min(t.y[0], std::min(t.y[1], t.y[2]));
+        t.maxY = std::max(t.y[0], std::max(t.y[1], t.y[2]));
+        if (t.maxX < 0.0f || t.maxY < 0.0f || t.minX >= width || t.minY >= height) return;
+        triangles.push_back(t);
+    }
+
+    void rasterizeTile(int tile) {
+        int tx0 = (tile % tilesX) * tileSize, ty0 = (tile / tilesX) * tileSize;
+        int tx1 = std::min(tx0 + tileSize, width), ty1 = std::min(ty0 + tileSize, height);
+        for (int y = ty0; y < ty1; y++)
+            std::fill(depth.begin() + (size_t)y * width + tx0, depth.begin() + (size_t)y * width + tx1, 1.0f);
+
+        for (int t : bins[tile]) {
+            const Triangle& tri = triangles[t];
+            int x0 = std::max((int)tri.minX, tx0) & ~3, x1 = std::min((int)ceilf(tri.maxX), tx1);
+            int y0 = std::max((int)tri.minY, ty0), y1 = std::min((int)ceilf(tri.maxY), ty1);
+
+            //edge i runs from vertex i to i + 1, e = a * px + b * py + c at pixel centers
+            float ea[3], eb[3], ec[3];
+            for (int i = 0; i < 3; i++) {
+                int j = (i + 1) % 3;
+                ea[i] = tri.y[i] - tri.y[j];
+                eb[i] = tri.x[j] - tri.x[i];
+                ec[i] = tri.x[i] * tri.y[j] - tri.x[j] * tri.y[i];
+            }
+            for (int y = y0; y < y1; y++) {
+                float py = y + 0.5f;
+                float* row = &depth[(size_t)y * width];
+#if defined(OCCLUSION_SSE)
+                const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                __m128 e0 = _mm_set1_ps(eb[0] * py + ec[0]), e1 = _mm_set1_ps(eb[1] * py + ec[1]), e2 = _mm_set1_ps(eb[2] * py + ec[2]);
+                __m128 a0 = _mm_set1_ps(ea[0]), a1 = _mm_set1_ps(ea[1]), a2 = _mm_set1_ps(ea[2]);
+                __m128 zRow = _mm_set1_ps(tri.z0 + tri.dzdy * py), dz = _mm_set1_ps(tri.dzdx);
+                for (int x = x0; x < x1; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 in = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), _mm_setzero_ps()),
+                        _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), _mm_setzero_ps()),
+                            _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), _mm_setzero_ps())));
+                    if (!_mm_movemask_ps(in)) continue;
+                    __m128 z = _mm_add_ps(zRow, _mm_mul_ps(dz, px));
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_and_ps(in, _mm_cmplt_ps(z, old));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(nearer, z), _mm_andnot_ps(nearer, old)));
+                }
+#else
+                for (int x = x0; x < x1; x++) {
+                    float px = x + 0.5f;
+                    if (ea[0] * px + eb[0] * py + ec[0] < 0.0f || ea[1] * px + eb[1] * py + ec[1] < 0.0f ||
+                        ea[2] * px + eb[2] * py + ec[2] < 0.0f) continue;
+                    float z = tri.z0 + tri.dzdx * px + tri.dzdy * py;
+                    if (z < row[x]) row[x] = z;
+                }
+#endif
+            }
+        }
+
+        //farthest depth per block, tiles are made of whole blocks
+        for (int by = ty0 / OCCLUSION_BLOCK; by < ty1 / OCCLUSION_BLOCK; by++) {
+            for (int bx = tx0 / OCCLUSION_BLOCK; bx < tx1 / OCCLUSION_BLOCK; bx++) {
+                float farthest = 0.0f;
+                for (int y = by * OCCLUSION_BLOCK; y < (by + 1) * OCCLUSION_BLOCK; y++) {
+                    const float* row = &depth[(size_t)y * width + bx * OCCLUSION_BLOCK];
+                    for (int x = 0; x < OCCLUSION_BLOCK; x++) farthest = std::max(farthest, row[x]);
+                }
+                blockMax[(size_t)by * blocksX + bx] = farthest;
+            }
+        }
+    }
+
+    int width, height, tileSize;
+    int tilesX, tilesY;
+    int blocksX, blocksY;
+    float matrix[16] = {};
+    std::vector<float> depth;
+    std::vector<float> blockMax;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<int>> bins;
+    int occluders = 0;
+    std::atomic<int> tested{ 0 };
+    std::atomic<int> occluded{ 0 };
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//hardware counters around named regions of the simulation step, for when wall
+//time alone doesn't say whether a kernel waits on memory or on mispredicted
+//branches. linux only, through perf_event_open: each thread opens one counter
+//group of its own on its first region and reads the whole group with a single
+//read() at both ends of a region. only user space is counted, which
+//perf_event_paranoid 2 still allows. counters the cpu or vm doesn't expose
+//are left out, and with none at all the regions are only timed. off until
+//PerfCountersEnable, a region costs one branch until then; CoreRenderer turns
+//them on for --bench and --headless and adds the regions to its report.
+//regions are kept per thread, the report covers the calling thread
+
+#define PERF_COUNTER_REGIONS 16
+
+enum PerfCounterKind {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_KINDS
+};
+
+inline const char* PerfCounterName(int kind)
+{
+    static const char* names[PERF_COUNTER_KINDS] = { "cycles", "instructions", "L1d misses", "LLC misses", "branch misses" };
+    return names[kind];
+}
+
+struct PerfCounterSample {
+    Uint64 ticks;
+    uint64_t counts[PERF_COUNTER_KINDS];
+    uint64_t enabled; //ns the group was enabled and actually counting,
+    uint64_t running; //less running than enabled means it was multiplexed
+};
+
+struct PerfRegion {
+    const char* name;
+    uint64_t calls;
+    Uint64 ticks;
+    double counts[PERF_COUNTER_KINDS];
+};
+
+struct PerfCounterThread {
+    bool opened = false;
+    int leader = -1;
+    int fds[PERF_COUNTER_KINDS] = { -1, -1, -1, -1, -1 };
+    int groupOrder[PERF_COUNTER_KINDS] = {}; //kinds in the order read() returns them
+    int groupSize = 0;
+    PerfRegion regions[PERF_COUNTER_REGIONS] = {};
+    int regionCount = 0;
+
+    ~PerfCounterThread() {
+#ifdef __linux__
+        for (int fd : fds)
+            if (fd >= 0) close(fd);
+#endif
+    }
+};
+
+inline std::atomic<bool>& PerfCountersFlag()
+{
+    static std::atomic<bool> enabled{ false };
+    return enabled;
+}
+
+inline bool PerfCountersEnabled() { return PerfCountersFlag().load(std::memory_order_relaxed); }
+
+#ifdef __linux__
+inline int PerfCounterOpen(int kind, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (kind) {
+    case PERF_COUNTER_CYCLES: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case PERF_COUNTER_INSTRUCTIONS: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case PERF_COUNTER_L1D_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case PERF_COUNTER_LLC_MISSES: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    case PERF_COUNTER_BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    }
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+#endif
+
+//the calling thread's group, opened on first use
+inline PerfCounterThread& PerfCounterThreadState()
+{
+    static thread_local PerfCounterThread state;
+    if (state.opened) return state;
+    state.opened = true;
+#ifdef __linux__
+    int error = 0;
+    char missing[128] = "";
+    for (int kind = 0; kind < PERF_COUNTER_KINDS; kind++) {
+        int fd = PerfCounterOpen(kind, state.leader);
+        if (fd < 0) {
+            error = errno;
+            SDL_snprintf(missing + SDL_strlen(missing), sizeof(missing) - SDL_strlen(missing), "%s%s", missing[0] ? ", " : "", PerfCounterName(kind));
+            continue;
+        }
+        if (state.leader < 0) state.leader = fd;
+        state.fds[kind] = fd;
+        state.groupOrder[state.groupSize++] = kind;
+    }
+    if (state.groupSize == 0) SDL_Log("Counters: perf_event_open failed (%s), timing only", strerror(error));
+    else if (missing[0]) SDL_Log("Counters: no %s on this machine (%s)", missing, strerror(error));
+#else
+    SDL_Log("Counters: hardware counters need linux perf_event_open, timing only");
+#endif
+    return state;
+}
+
+//also opens the calling thread's group right away, so its first region doesn't pay for that
+inline void PerfCountersEnable()
+{
+    PerfCountersFlag().store(true);
+    PerfCounterThreadState();
+}
+
+inline void PerfCountersRead(const PerfCounterThread& state, PerfCounterSample* sample)
+{
+    *sample = PerfCounterSample();
+#ifdef __linux__
+    if (state.groupSize > 0) {
+        uint64_t buffer[3 + PERF_COUNTER_KINDS];
+        if (read(state.leader, buffer, sizeof(buffer)) >= (ssize_t)(sizeof(uint64_t) * (3 + state.groupSize))) {
+            sample->enabled = buffer[1];
+            sample->running = buffer[2];
+            for (int i = 0; i < state.groupSize; i++) sample->counts[state.groupOrder[i]] = buffer[3 + i];
+        }
+    }
+#endif
+    sample->ticks = SDL_GetPerformanceCounter();
+}
+
+//regions are looked up by name pointer first, the names are literals
+inline PerfRegion* PerfCounterRegion(PerfCounterThread& state, const char* name)
+{
+    for (int i = 0; i < state.regionCount; i++)
+        if (state.regions[i].name == name || SDL_strcmp(state.regions[i].name, name) == 0) return &state.regions[i];
+    if (state.regionCount == PERF_COUNTER_REGIONS) return NULL;
+    PerfRegion* region = &state.regions[state.regionCount++];
+    *region = PerfRegion();
+    region->name = name;
+    return region;
+}
+
+inline void PerfCountersAdd(PerfCounterThread& state, const char* name, const PerfCounterSample& start, const PerfCounterSample& end)
+{
+    PerfRegion* region = PerfCounterRegion(state, name);
+    if (!region) return;
+    region->calls++;
+    region->ticks += end.ticks - start.ticks;
+    //scale up what was counted while the group was multiplexed with other perf users
+    uint64_t running = end.running - start.running;
+    double scale = running > 0 ? (double)(end.enabled - start.enabled) / running : 0.0;
+    for (int kind = 0; kind < PERF_COUNTER_KINDS; kind++) region->counts[kind] += (end.counts[kind] - start.counts[kind]) * scale;
+}
+
+//drops what the calling thread has measured so far, e.g. after warm-up frames
+inline void PerfCountersReset()
+{
+    if (!PerfCountersEnabled()) return;
+    PerfCounterThreadState().regionCount = 0;
+}
+
+//one line per region of the calling thread: time, ipc and misses a call
+inline void PerfCountersReport(const char* label)
+{
+    if (!PerfCountersEnabled()) return;
+    const PerfCounterThread& state = PerfCounterThreadState();
+    for (int i = 0; i < state.regionCount; i++) {
+        const PerfRegion& r = state.regions[i];
+        double calls = (double)(r.calls > 0 ? r.calls : 1);
+        char line[256];
+        int n = SDL_snprintf(line, sizeof(line), "%s: %s %d calls, %.3f us", label, r.name, (int)r.calls,
+            (double)r.ticks * 1e6 / SDL_GetPerformanceFrequency() / calls);
+        if (state.fds[PERF_COUNTER_CYCLES] >= 0 && state.fds[PERF_COUNTER_INSTRUCTIONS] >= 0 && r.counts[PERF_COUNTER_CYCLES] > 0.0)
+            n += SDL_snprintf(line + n, sizeof(line) - n, ", IPC %.2f", r.counts[PERF_COUNTER_INSTRUCTIONS] / r.counts[PERF_COUNTER_CYCLES]);
+        for (int kind = 0; kind < PERF_COUNTER_KINDS; kind++)
+            if (state.fds[kind] >= 0 && n < (int)sizeof(line))
+                n += SDL_snprintf(line + n, sizeof(line) - n, ", %.1f %s", r.counts[kind] / calls, PerfCounterName(kind));
+        SDL_Log("%s%s", line, state.groupSize > 0 ? " a call" : " a call, no hardware counters");
+    }
+}
+
+class PerfCounterScope {
+public:
+    explicit PerfCounterScope(const char* name) : name(name), active(PerfCountersEnabled()) {
+        if (active) PerfCountersRead(PerfCounterThreadState(), &start);
+    }
+    ~PerfCounterScope() {
+        if (!active) return;
+        PerfCounterThread& state = PerfCounterThreadState();
+        PerfCounterSample end;
+        PerfCountersRead(state, &end);
+        PerfCountersAdd(state, name, start, end);
+    }
+
+private:
+    const char* name;
+    bool active;
+    PerfCounterSample start;
+};
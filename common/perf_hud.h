@@ -0,0 +1,250 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "trace.h"
+
+//frame timing overlay. PerfScope times a named stage of the frame on the cpu
+//(the demos wrap their update and draw code, the renderer adds present, the
+//gpu time and the overlay itself) and F3 shows averages over the last
+//PERF_HUD_HISTORY frames, frame time percentiles and a frame time graph.
+//timing is two counter reads per scope and always on; the text is laid out
+//again only a few times a second, so the overlay stays far under 0.1 ms a
+//frame and can be left in release builds. the renderer keeps the text in
+//its own vertex buffer and only uploads it again when textVersion() changes.
+//each scope is also a trace zone of the same name
+
+#define PERF_HUD_STAGES 8
+#define PERF_HUD_HISTORY 128
+#define PERF_HUD_REFRESH 0.25 //seconds between text updates
+#define PERF_HUD_KEY SDLK_F3
+#define PERF_HUD_BUDGET_MS (1000.0 / 60.0)
+#define PERF_HUD_GRAPH_HEIGHT 64
+#define PERF_HUD_BAR_WIDTH 2
+#define PERF_HUD_LINE_HEIGHT 10
+#define PERF_HUD_MARGIN 6
+
+//overlay rectangle in pixels from the top left corner
+struct PerfHudRect {
+    float x0, y0, x1, y1;
+    unsigned char color[4];
+};
+
+class PerfHud {
+public:
+    //registered on first use, string literals are found by pointer without comparing
+    int stage(const char* name) {
+        for (int i = 0; i < stageCount; i++)
+            if (stages[i].name == name) return i;
+        for (int i = 0; i < stageCount; i++)
+            if (SDL_strcmp(stages[i].name, name) == 0) return i;
+        if (stageCount == PERF_HUD_STAGES) return -1;
+        stages[stageCount] = Stage();
+        stages[stageCount].name = name;
+        return stageCount++;
+    }
+
+    void addTicks(int id, Uint64 ticks) {
+        if (id >= 0) stages[id].ticks += ticks;
+    }
+
+    //gpu results arrive a few frames late, they get a history of their own
+    void addGpu(double milliseconds) { gpu.push(milliseconds); }
+
+    //closes the frame: frame time since the last call plus each stage's share
+    void endFrame() {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (lastFrame) frames.push((now - lastFrame) * msPerTick);
+        lastFrame = now;
+        for (int i = 0; i < stageCount; i++) {
+            stages[i].history.push(stages[i].ticks * msPerTick);
+            stages[i].ticks = 0;
+        }
+    }
+
+    //toggles on PERF_HUD_KEY, true when the event was used
+    bool handleEvent(const SDL_Event* event) {
+        if (event->type != SDL_EVENT_KEY_DOWN || event->key.key != PERF_HUD_KEY || event->key.repeat) return false;
+        shown = !shown;
+        textTime = 0;
+        return true;
+    }
+
+    bool visible() const { return shown; }
+
+    //lays the text out again when it is due and the graph every time
+    void update() {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (!textTime || (now - textTime) * msPerTick >= PERF_HUD_REFRESH * 1000.0) {
+            textTime = now;
+            layoutText();
+            version++;
+        }
+        graphRects.clear();
+
+        //oldest frame on the left, the line is the 60 hz budget at half height
+        static const unsigned char good[4] = { 80, 200, 80, 255 }, late[4] = { 230, 200, 60, 255 }, missed[4] = { 230, 70, 60, 255 };
+        static const unsigned char budget[4] = { 160, 160, 160, 255 };
+        float x = graphX, bottom = graphY + PERF_HUD_GRAPH_HEIGHT, perMs = PERF_HUD_GRAPH_HEIGHT / (2.0f * PERF_HUD_BUDGET_MS);
+        for (int i = 0; i < frames.count; i++, x += PERF_HUD_BAR_WIDTH) {
+            double ms = frames.at(i);
+            float h = SDL_min((float)ms * perMs, (float)PERF_HUD_GRAPH_HEIGHT);
+            const unsigned char* c = ms <= PERF_HUD_BUDGET_MS * 1.05 ? good : ms <= PERF_HUD_BUDGET_MS * 2.05 ? late : missed;
+            rect(&graphRects, x, bottom - h, x + PERF_HUD_BAR_WIDTH - 1, bottom, c);
+        }
+        rect(&graphRects, graphX, bottom - PERF_HUD_GRAPH_HEIGHT / 2.0f, graphX + PERF_HUD_HISTORY * PERF_HUD_BAR_WIDTH, bottom - PERF_HUD_GRAPH_HEIGHT / 2.0f + 1, budget);
+    }
+
+    //background and text, then the graph on top of it, at most PERF_HUD_HISTORY + 1 rectangles
+    const std::vector<PerfHudRect>& text() const { return textRects; }
+    const std::vector<PerfHudRect>& graph() const { return graphRects; }
+    unsigned textVersion() const { return version; }
+
+private:
+    struct History {
+        double values[PERF_HUD_HISTORY];
+        double sum = 0.0;
+        int count = 0;
+        int next = 0;
+
+        void push(double v) {
+            if (count == PERF_HUD_HISTORY) sum -= values[next];
+            else count++;
+            values[next] = v;
+            sum += v;
+            next = (next + 1) % PERF_HUD_HISTORY;
+        }
+
+        double mean() const { return count ? sum / count : 0.0; }
+        //i = 0 is the oldest
+        double at(int i) const { return values[(next - count + i + PERF_HUD_HISTORY) % PERF_HUD_HISTORY]; }
+    };
+
+    struct Stage {
+        const char* name = "";
+        Uint64 ticks = 0;
+        History history;
+    };
+
+    void layoutText() {
+        static const unsigned char background[4] = { 16, 16, 24, 255 }, white[4] = { 240, 240, 240, 255 }, grey[4] = { 150, 150, 160, 255 };
+        int lines = 3 + stageCount;
+        float width = PERF_HUD_HISTORY * PERF_HUD_BAR_WIDTH + 2 * PERF_HUD_MARGIN;
+        float height = PERF_HUD_MARGIN + lines * PERF_HUD_LINE_HEIGHT + PERF_HUD_GRAPH_HEIGHT + 2 * PERF_HUD_MARGIN;
+        textRects.clear();
+        rect(&textRects, 0.0f, 0.0f, width, height, background);
+
+        double sorted[PERF_HUD_HISTORY];
+        for (int i = 0; i < frames.count; i++) sorted[i] = frames.at(i);
+        std::sort(sorted, sorted + frames.count);
+        auto percentile = [&](int p) { return frames.count ? sorted[(frames.count - 1) * p / 100] : 0.0; };
+
+        char line[64];
+        float y = PERF_HUD_MARGIN;
+        double mean = frames.mean();
+        SDL_snprintf(line, sizeof(line), "FRAME %6.2f MS %5.0f FPS", mean, mean > 0.0 ? 1000.0 / mean : 0.0);
+        text(PERF_HUD_MARGIN, y, line, white);
+        y += PERF_HUD_LINE_HEIGHT;
+        SDL_snprintf(line, sizeof(line), "P50 %.2f P95 %.2f P99 %.2f", percentile(50), percentile(95), percentile(99));
+        text(PERF_HUD_MARGIN, y, line, grey);
+        y += PERF_HUD_LINE_HEIGHT;
+        if (gpu.count) SDL_snprintf(line, sizeof(line), "GPU   %6.3f MS", gpu.mean());
+        else SDL_snprintf(line, sizeof(line), "GPU   -");
+        text(PERF_HUD_MARGIN, y, line, white);
+        y += PERF_HUD_LINE_HEIGHT;
+        for (int i = 0; i < stageCount; i++, y += PERF_HUD_LINE_HEIGHT) {
+            SDL_snprintf(line, sizeof(line), "%-8.8s%6.3f MS", stages[i].name, stages[i].history.mean());
+            text(PERF_HUD_MARGIN, y, line, grey);
+        }
+        graphX = PERF_HUD_MARGIN;
+        graphY = y + PERF_HUD_MARGIN;
+    }
+
+    static void rect(std::vector<PerfHudRect>* out, float x0, float y0, float x1, float y1, const unsigned char color[4]) {
+        PerfHudRect r = { x0, y0, x1, y1, { color[0], color[1], color[2], color[3] } };
+        out->push_back(r);
+    }
+
+    //5x7 glyphs, a byte per column with the top row in bit 0; each run of set
+    //bits down a column becomes one rectangle, as wide as the run repeats
+    void text(float x, float y, const char* s, const unsigned char color[4]) {
+        static const char chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:%-/()";
+        static const unsigned char glyphs[][5] = {
+            { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 },
+            { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+            { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 }, { 0x36, 0x49, 0x49, 0x49, 0x36 },
+            { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 },
+            { 0x3E, 0x41, 0x41, 0x41, 0x22 }, { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 },
+            { 0x7F, 0x09, 0x09, 0x09, 0x01 }, { 0x3E, 0x41, 0x49, 0x49, 0x7A }, { 0x7F, 0x08, 0x08, 0x08, 0x7F },
+            { 0x00, 0x41, 0x7F, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+            { 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F },
+            { 0x3E, 0x41, 0x41, 0x41, 0x3E }, { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E },
+            { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 },
+            { 0x3F, 0x40, 0x40, 0x40, 0x3F }, { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+            { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 },
+            { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+            { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+            { 0x00, 0x41, 0x22, 0x1C, 0x00 },
+        };
+        for (; *s; s++, x += 6) {
+            const char* found = *s != ' ' ? SDL_strchr(chars, SDL_toupper((unsigned char)*s)) : NULL;
+            if (!found) continue;
+            const unsigned char* glyph = glyphs[found - chars];
+            unsigned char covered[5] = {};
+            for (int column = 0; column < 5; column++) {
+                for (int row = 0; row < 7;) {
+                    if (!(glyph[column] >> row & 1)) {
+                        row++;
+                        continue;
+                    }
+                    int end = row;
+                    while (end < 7 && (glyph[column] >> end & 1)) end++;
+                    //widened over the next columns that have the same pixels set
+                    unsigned char run = (unsigned char)((1 << end) - (1 << row));
+                    if ((covered[column] & run) != run) {
+                        int last = column;
+                        while (last < 4 && (glyph[last + 1] & run) == run) covered[++last] |= run;
+                        rect(&textRects, x + column, y + row, x + last + 1, y + end, color);
+                    }
+                    row = end;
+                }
+            }
+        }
+    }
+
+    Stage stages[PERF_HUD_STAGES];
+    int stageCount = 0;
+    History frames;
+    History gpu;
+    Uint64 lastFrame = 0;
+    double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+    bool shown = false;
+    Uint64 textTime = 0;
+    float graphX = 0.0f;
+    float graphY = 0.0f;
+    unsigned version = 0;
+    std::vector<PerfHudRect> textRects;
+    std::vector<PerfHudRect> graphRects;
+};
+
+//adds the time until the end of the block to a stage of the current frame
+class PerfScope {
+public:
+    PerfScope(PerfHud& hud, const char* name) : hud(hud), id(hud.stage(name)), start(SDL_GetPerformanceCounter())
+#if !defined(TRACE_DISABLED)
+        , zone(name)
+#endif
+    {}
+    ~PerfScope() { hud.addTicks(id, SDL_GetPerformanceCounter() - start); }
+
+private:
+    PerfHud& hud;
+    int id;
+    Uint64 start;
+#if !defined(TRACE_DISABLED)
+    TraceZone zone;
+#endif
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+
+#include "input_latency.h"
+#include "trace.h"
+
+//simulation on a thread of its own at a fixed rate, decoupled from drawing.
+//SDL_AppEvent posts input into a single producer single consumer ring, the sim
+//thread applies it before its next step and publishes a copy of its state
+//through a triple buffer after every step. the render thread draws the newest
+//complete copy and never waits: a slow frame doesn't hold up the simulation
+//and a long step doesn't hold up presenting. the state is copied once a step,
+//so keep it small and free of pointers into itself. offscreen runs step in
+//lockstep with the frames instead, on the calling thread, so they repeat exactly.
+//each copy remembers the arrival of the newest input it reflects, for InputLatency
+
+#define SIM_INPUT_QUEUE 256 //power of two, events posted between two steps before more are dropped
+#define SIM_MAX_CATCHUP 5 //steps a late sim thread runs back to back before it lets the time go
+
+//one writer and one reader, neither ever waits. the writer fills back() and
+//publish() makes it the newest; newest() gives the reader the newest published
+//copy and keeps it untouched until the reader's next call. the three copies
+//trade places through one atomic index
+template <typename T>
+class TripleBuffer {
+public:
+    //not thread safe, before either side starts
+    void reset(const T& value) {
+        for (T& b : buffers) b = value;
+        middle.store(1);
+        backIndex = 0;
+        frontIndex = 2;
+    }
+
+    T& back() { return buffers[backIndex]; }
+
+    void publish() {
+        int old = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+        backIndex = old & INDEX;
+    }
+
+    const T& newest() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            int old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = old & INDEX;
+        }
+        return buffers[frontIndex];
+    }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+    T buffers[3];
+    std::atomic<int> middle{ 1 }; //the copy in between, FRESH until the reader took it
+    int backIndex = 0; //writer only
+    int frontIndex = 2; //reader only
+};
+
+//fixed size ring for one producer thread and one consumer thread
+template <typename T, size_t N>
+class SpscQueue {
+public:
+    //false when full
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) return false;
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    //false when empty
+    bool pop(T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    std::atomic<size_t> head{ 0 };
+    std::atomic<size_t> tail{ 0 };
+};
+
+//an event and when it arrived, in SDL_GetTicksNS time
+struct SimInput {
+    Uint64 arrival;
+    SDL_Event event;
+};
+
+template <typename State>
+class SimThread {
+public:
+    typedef std::function<void(State&, const SimInput&)> InputFn;
+    typedef std::function<void(State&, float)> StepFn;
+
+    ~SimThread() { stop(); }
+
+    //input applies one posted event, step advances by stepSeconds, both on the
+    //sim thread only. threaded false leaves the stepping to advance()
+    void start(const State& initial, float stepSeconds, InputFn input, StepFn step, bool threaded) {
+        state = initial;
+        newestInput = 0;
+        Snapshot first;
+        first.state = initial;
+        first.input = 0;
+        snapshots.reset(first);
+        shown = nullptr;
+        seconds = stepSeconds;
+        stepNs = (Uint64)(stepSeconds * 1e9);
+        applyInput = std::move(input);
+        advanceState = std::move(step);
+        stopping.store(false);
+        if (threaded) thread = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        stopping.store(true);
+        if (thread.joinable()) thread.join();
+    }
+
+    //from SDL_AppEvent, false when the queue was full and the event is lost.
+    //arrival is InputArrival(event), the same stamp the caller's InputLatency got
+    bool post(const SDL_Event* event, Uint64 arrival) {
+        SimInput in;
+        in.arrival = arrival;
+        in.event = *event;
+        return inputs.push(in);
+    }
+
+    //one step on the calling thread, for offscreen runs started unthreaded
+    void advance() { stepOnce(); }
+
+    //newest complete state, stays valid until the next call. render thread only
+    const State& newest() {
+        shown = &snapshots.newest();
+        return shown->state;
+    }
+
+    //arrival of the newest input the state newest() gave has seen, 0 for none
+    Uint64 newestInputArrival() const { return shown ? shown->input : 0; }
+
+    uint64_t stepCount() const { return steps.load(std::memory_order_relaxed); }
+
+private:
+    void run() {
+        TraceSetThreadName("sim");
+        Uint64 next = SDL_GetTicksNS();
+        while (!stopping.load(std::memory_order_relaxed)) {
+            Uint64 now = SDL_GetTicksNS();
+            int ran = 0;
+            while (now >= next && ran < SIM_MAX_CATCHUP) {
+                stepOnce();
+                next += stepNs;
+                ran++;
+            }
+            //too far behind to catch up, a pause would otherwise end in a burst of steps
+            if (now >= next) next = now + stepNs;
+            now = SDL_GetTicksNS();
+            if (next > now) SDL_DelayNS(next - now);
+        }
+    }
+
+    void stepOnce() {
+        TRACE_ZONE("sim step");
+        SimInput in;
+        while (inputs.pop(in)) {
+            applyInput(state, in);
+            newestInput = in.arrival;
+        }
+        advanceState(state, seconds);
+        snapshots.back().state = state;
+        snapshots.back().input = newestInput;
+        snapshots.publish();
+        steps.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct Snapshot {
+        State state;
+        Uint64 input;
+    };
+
+    State state; //sim thread only
+    Uint64 newestInput = 0; //sim thread only
+    TripleBuffer<Snapshot> snapshots;
+    const Snapshot* shown = nullptr; //render thread only
+    SpscQueue<SimInput, SIM_INPUT_QUEUE> inputs;
+    InputFn applyInput;
+    StepFn advanceState;
+    float seconds = 0.0f;
+    Uint64 stepNs = 0;
+    std::atomic<uint64_t> steps{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::thread thread;
+};
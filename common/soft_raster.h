@@ -0,0 +1,413 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTRASTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+//tile-based software rasterizer for the subset the demos draw: colored or
+//textured triangles and one pixel lines, depth test, no blending. draws are
+//clipped against the near plane, set up and binned into 64x64 tiles as they
+//come in, flush() then rasterizes the tiles in parallel, each tile walking
+//its bin in submission order so the result matches drawing one by one.
+//coverage is four pixels at a time from the edge functions, colors and uvs
+//are interpolated perspective-correct and textures are sampled nearest with
+//wrapping. edges are inclusive, without blending a pixel shared by two
+//triangles just gets written twice. the framebuffer is rgba8, top row first
+
+#define SOFTRASTER_TILE 64
+#define SOFTRASTER_BIN_RESERVE 256 //triangles a tile holds before its bin has to grow
+
+struct SoftVertex {
+    float clip[4];
+    float color[4];
+    float uv[2];
+};
+
+//rgba8 pixels, rows top to bottom
+struct SoftTexture {
+    int width;
+    int height;
+    const uint32_t* pixels;
+};
+
+struct SoftRasterStats {
+    long long triangles;
+    long long pixels;
+    double milliseconds;
+};
+
+class SoftRasterizer {
+public:
+    void resize(int w, int h) {
+        width = w > 0 ? w : 1;
+        height = h > 0 ? h : 1;
+        stride = (width + 3) & ~3;
+        color.assign((size_t)stride * height, 0);
+        depth.assign((size_t)stride * height, 1.0f);
+        tilesX = (width + SOFTRASTER_TILE - 1) / SOFTRASTER_TILE;
+        tilesY = (height + SOFTRASTER_TILE - 1) / SOFTRASTER_TILE;
+        bins.assign((size_t)tilesX * tilesY, std::vector<uint32_t>());
+        for (std::vector<uint32_t>& bin : bins) bin.reserve(SOFTRASTER_BIN_RESERVE);
+        tilePixels.assign(bins.size(), 0);
+        setups.clear();
+        setups.reserve(SOFTRASTER_BIN_RESERVE * 4);
+    }
+
+    int frameWidth() const { return width; }
+    int frameHeight() const { return height; }
+    int rowStride() const { return stride; }
+    const uint32_t* pixels() const { return color.data(); }
+
+    void setDepthTest(bool enabled) { depthTest = enabled; }
+    void setThreadPool(ThreadPool* threads) { pool = threads; }
+
+    //anything queued is drawn first so a clear keeps its place in the frame
+    void clear(const float rgba[4], bool clearDepth) {
+        flush();
+        uint32_t c = pack(rgba[0], rgba[1], rgba[2], rgba[3]);
+        std::fill(color.begin(), color.end(), c);
+        if (clearDepth) std::fill(depth.begin(), depth.end(), 1.0f);
+    }
+
+    void drawTriangles(const SoftVertex* v, size_t count, const SoftTexture* texture = nullptr) {
+        for (size_t i = 0; i + 2 < count; i += 3) {
+            SoftVertex polygon[4];
+            int n = clipNear(v + i, polygon);
+            ScreenVertex s[4];
+            for (int k = 0; k < n; k++) s[k] = project(polygon[k]);
+            for (int k = 1; k + 1 < n; k++) setup(s[0], s[k], s[k + 1], texture);
+        }
+    }
+
+    //one pixel wide, as quads across the projected segment
+    void drawLines(const SoftVertex* v, size_t count) {
+        for (size_t i = 0; i + 1 < count; i += 2) {
+            SoftVertex a = v[i], b = v[i + 1];
+            if (!clipNearSegment(&a, &b)) continue;
+            ScreenVertex sa = project(a), sb = project(b);
+            float dx = sb.x - sa.x, dy = sb.y - sa.y;
+            float length = sqrtf(dx * dx + dy * dy);
+            if (length <= 0.0f) continue;
+            float nx = -dy / length * 0.5f, ny = dx / length * 0.5f;
+            ScreenVertex q[4] = { sa, sb, sb, sa };
+            q[0].x -= nx; q[0].y -= ny;
+            q[1].x -= nx; q[1].y -= ny;
+            q[2].x += nx; q[2].y += ny;
+            q[3].x += nx; q[3].y += ny;
+            setup(q[0], q[1], q[2], nullptr);
+            setup(q[0], q[2], q[3], nullptr);
+        }
+    }
+
+    //rasterizes everything binned since the last flush
+    void flush() {
+        if (setups.empty()) return;
+        Uint64 start = SDL_GetPerformanceCounter();
+        int tileCount = tilesX * tilesY;
+        auto rasterTiles = [this](int begin, int end) {
+            for (int t = begin; t < end; t++) rasterTile(t);
+        };
+        if (pool) pool->parallelFor(tileCount, 1, rasterTiles);
+        else rasterTiles(0, tileCount);
+
+        for (int t = 0; t < tileCount; t++) {
+            stats.pixels += tilePixels[t];
+            tilePixels[t] = 0;
+            bins[t].clear();
+        }
+        stats.triangles += (long long)setups.size();
+        setups.clear();
+        stats.milliseconds += (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    //triangles after clipping (lines count two each), pixels written and time spent
+    SoftRasterStats takeStats() {
+        SoftRasterStats s = stats;
+        stats = SoftRasterStats();
+        return s;
+    }
+
+    bool saveBmp(const char* path) {
+        flush();
+        SDL_Surface* surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_RGBA32, color.data(), stride * 4);
+        if (!surface) return false;
+        bool ok = SDL_SaveBMP(surface, path);
+        SDL_DestroySurface(surface);
+        return ok;
+    }
+
+private:
+    struct ScreenVertex {
+        float x, y, z, invW;
+        float attributes[6]; //rgba and uv, all divided by w
+    };
+
+    //plane a * x + b * y + c in pixel coordinates
+    struct Plane {
+        float a, b, c;
+    };
+
+    struct Setup {
+        int x0, y0, x1, y1;
+        Plane edges[3];
+        Plane z, invW;
+        Plane attributes[6];
+        const SoftTexture* texture;
+        bool depthTest;
+    };
+
+    static uint32_t pack(float r, float g, float b, float a) {
+        auto byte = [](float c) { return (uint32_t)(c <= 0.0f ? 0 : c >= 1.0f ? 255 : c * 255.0f + 0.5f); };
+        return byte(r) | byte(g) << 8 | byte(b) << 16 | byte(a) << 24;
+    }
+
+    static SoftVertex lerp(const SoftVertex& a, const SoftVertex& b, float t) {
+        SoftVertex r;
+        for (int k = 0; k < 4; k++) r.clip[k] = a.clip[k] + (b.clip[k] - a.clip[k]) * t;
+        for (int k = 0; k < 4; k++) r.color[k] = a.color[k] + (b.color[k] - a.color[k]) * t;
+        for (int k = 0; k < 2; k++) r.uv[k] = a.uv[k] + (b.uv[k] - a.uv[k]) * t;
+        return r;
+    }
+
+    //distance inside the near plane z = -w
+    static float nearDistance(const SoftVertex& v) { return v.clip[2] + v.clip[3]; }
+
+    //a triangle clipped to the near plane is at most a quad
+    static int clipNear(const SoftVertex* in, SoftVertex* out) {
+        int n = 0;
+        for (int k = 0; k < 3; k++) {
+            const SoftVertex& a = in[k];
+            const SoftVertex& b = in[(k + 1) % 3];
+            float da = nearDistance(a), db = nearDistance(b);
+            if (da >= 0.0f) out[n++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) out[n++] = lerp(a, b, da / (da - db));
+        }
+        return n;
+    }
+
+    static bool clipNearSegment(SoftVertex* a, SoftVertex* b) {
+        float da = nearDistance(*a), db = nearDistance(*b);
+        if (da < 0.0f && db < 0.0f) return false;
+        if (da < 0.0f) *a = lerp(*a, *b, da / (da - db));
+        else if (db < 0.0f) *b = lerp(*a, *b, da / (da - db));
+        return true;
+    }
+
+    ScreenVertex project(const SoftVertex& v) const {
+        ScreenVertex s;
+        float w = v.clip[3] > 1e-6f ? v.clip[3] : 1e-6f;
+        s.invW = 1.0f / w;
+        s.x = (v.clip[0] * s.invW * 0.5f + 0.5f) * width;
+        s.y = (0.5f - v.clip[1] * s.invW * 0.5f) * height;
+        s.z = v.clip[2] * s.invW * 0.5f + 0.5f;
+        for (int k = 0; k < 4; k++) s.attributes[k] = v.color[k] * s.invW;
+        s.attributes[4] = v.uv[0] * s.invW;
+        s.attributes[5] = v.uv[1] * s.invW;
+        return s;
+    }
+
+    //edge functions oriented so inside is positive whatever the winding,
+    //attributes become planes through the barycentric weights
+    void setup(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const SoftTexture* texture) {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (fabsf(area) < 1e-8f) return;
+        Setup s;
+        float minX = SDL_min(v0.x, SDL_min(v1.x, v2.x)), maxX = SDL_max(v0.x, SDL_max(v1.x, v2.x));
+        float minY = SDL_min(v0.y, SDL_min(v1.y, v2.y)), maxY = SDL_max(v0.y, SDL_max(v1.y, v2.y));
+        //pixel centers at +0.5 inside the bounds
+        s.x0 = SDL_max(0, (int)ceilf(minX - 0.5f));
+        s.y0 = SDL_max(0, (int)ceilf(minY - 0.5f));
+        s.x1 = SDL_min(width - 1, (int)floorf(maxX - 0.5f));
+        s.y1 = SDL_min(height - 1, (int)floorf(maxY - 0.5f));
+        if (s.x0 > s.x1 || s.y0 > s.y1) return;
+
+        const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+        float sign = area > 0.0f ? 1.0f : -1.0f, invArea = 1.0f / fabsf(area);
+        for (int k = 0; k < 3; k++) {
+            //edge opposite vertex k, zero on it and area at vertex k
+            const ScreenVertex& a = *v[(k + 1) % 3];
+            const ScreenVertex& b = *v[(k + 2) % 3];
+            s.edges[k].a = (a.y - b.y) * sign;
+            s.edges[k].b = (b.x - a.x) * sign;
+            s.edges[k].c = (a.x * b.y - b.x * a.y) * sign;
+        }
+        auto plane = [&s, invArea](float f0, float f1, float f2) {
+            Plane p;
+            p.a = (s.edges[0].a * f0 + s.edges[1].a * f1 + s.edges[2].a * f2) * invArea;
+            p.b = (s.edges[0].b * f0 + s.edges[1].b * f1 + s.edges[2].b * f2) * invArea;
+            p.c = (s.edges[0].c * f0 + s.edges[1].c * f1 + s.edges[2].c * f2) * invArea;
+            return p;
+        };
+        s.z = plane(v0.z, v1.z, v2.z);
+        s.invW = plane(v0.invW, v1.invW, v2.invW);
+        for (int k = 0; k < 6; k++) s.attributes[k] = plane(v0.attributes[k], v1.attributes[k], v2.attributes[k]);
+        s.texture = texture && texture->pixels && texture->width > 0 && texture->height > 0 ? texture : nullptr;
+        s.depthTest = depthTest;
+
+        uint32_t id = (uint32_t)setups.size();
+        setups.push_back(s);
+        for (int ty = s.y0 / SOFTRASTER_TILE; ty <= s.y1 / SOFTRASTER_TILE; ty++)
+            for (int tx = s.x0 / SOFTRASTER_TILE; tx <= s.x1 / SOFTRASTER_TILE; tx++) bins[ty * tilesX + tx].push_back(id);
+    }
+
+    void rasterTile(int tile) {
+        const std::vector<uint32_t>& bin = bins[tile];
+        if (bin.empty()) return;
+        int tileX = (tile % tilesX) * SOFTRASTER_TILE, tileY = (tile / tilesX) * SOFTRASTER_TILE;
+        long long written = 0;
+        for (uint32_t id : bin) {
+            const Setup& s = setups[id];
+            int xStart = SDL_max(s.x0, tileX), xEnd = SDL_min(s.x1, tileX + SOFTRASTER_TILE - 1);
+            int y0 = SDL_max(s.y0, tileY), y1 = SDL_min(s.y1, tileY + SOFTRASTER_TILE - 1);
+            //blocks of four start aligned, the lanes outside the span are masked off
+            int x0 = xStart & ~3;
+            int firstMask = 15 & (15 << (xStart - x0)), lastMask = 15 >> (3 - ((xEnd - x0) & 3));
+            int lastBlock = (xEnd - x0) >> 2;
+            for (int y = y0; y <= y1; y++) written += rasterRow(s, x0, y, lastBlock, firstMask, lastMask);
+        }
+        tilePixels[tile] = written;
+    }
+
+    //edges and depth stepped across the row four pixels at a time, bit k of a
+    //block's mask is pixel x + k passing the edges and (if on) the depth test
+    int rasterRow(const Setup& s, int x0, int y, int lastBlock, int firstMask, int lastMask) {
+        float px = x0 + 0.5f, py = y + 0.5f;
+        const float* depthRow = &depth[(size_t)y * stride];
+        int written = 0;
+#if defined(SOFTRASTER_SSE)
+        __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), zero = _mm_setzero_ps();
+        __m128 e[3], step[3];
+        for (int k = 0; k < 3; k++) {
+            const Plane& p = s.edges[k];
+            e[k] = _mm_add_ps(_mm_set1_ps(p.a * px + p.b * py + p.c), _mm_mul_ps(_mm_set1_ps(p.a), lanes));
+            step[k] = _mm_set1_ps(p.a * 4.0f);
+        }
+        __m128 z = _mm_add_ps(_mm_set1_ps(s.z.a * px + s.z.b * py + s.z.c), _mm_mul_ps(_mm_set1_ps(s.z.a), lanes));
+        __m128 zStep = _mm_set1_ps(s.z.a * 4.0f);
+        bool entered = false;
+        for (int block = 0; block <= lastBlock; block++) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+            int x = x0 + block * 4;
+            //a row crosses a convex triangle once, an empty block after covered ones ends it
+            if (_mm_movemask_ps(inside) == 0) {
+                if (entered) break;
+            }
+            else {
+                entered = true;
+                if (s.depthTest) inside = _mm_and_ps(inside, _mm_cmplt_ps(z, _mm_loadu_ps(depthRow + x)));
+                int mask = _mm_movemask_ps(inside);
+                if (block == 0) mask &= firstMask;
+                if (block == lastBlock) mask &= lastMask;
+                if (mask) written += shade(s, x, y, mask);
+            }
+            for (int k = 0; k < 3; k++) e[k] = _mm_add_ps(e[k], step[k]);
+            z = _mm_add_ps(z, zStep);
+        }
+#else
+        for (int block = 0; block <= lastBlock; block++) {
+            int x = x0 + block * 4, mask = 0;
+            for (int k = 0; k < 4; k++) {
+                float fx = px + block * 4 + k;
+                bool inside = true;
+                for (int e = 0; e < 3; e++) inside = inside && s.edges[e].a * fx + s.edges[e].b * py + s.edges[e].c >= 0.0f;
+                if (inside && s.depthTest) inside = s.z.a * fx + s.z.b * py + s.z.c < depthRow[x + k];
+                if (inside) mask |= 1 << k;
+            }
+            if (block == 0) mask &= firstMask;
+            if (block == lastBlock) mask &= lastMask;
+            if (mask) written += shade(s, x, y, mask);
+        }
+#endif
+        return written;
+    }
+
+    int shade(const Setup& s, int x, int y, int mask) {
+        float py = y + 0.5f;
+        size_t row = (size_t)y * stride;
+#if defined(SOFTRASTER_SSE)
+        //the four lanes at once, covered or not, then a masked store
+        __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        auto plane = [px, py](const Plane& p) {
+            return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.a), px), _mm_set1_ps(p.b * py + p.c));
+        };
+        __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), plane(s.invW));
+        __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+        __m128i packed = _mm_setzero_si128();
+        for (int i = 0; i < 4; i++) {
+            __m128 c = _mm_mul_ps(_mm_mul_ps(plane(s.attributes[i]), w), scale);
+            c = _mm_min_ps(_mm_max_ps(c, zero), scale);
+            packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(c, half)), i * 8));
+        }
+        uint32_t c[4];
+        _mm_storeu_si128((__m128i*)c, packed);
+        if (s.texture) {
+            float u[4], v[4];
+            _mm_storeu_ps(u, _mm_mul_ps(plane(s.attributes[4]), w));
+            _mm_storeu_ps(v, _mm_mul_ps(plane(s.attributes[5]), w));
+            for (int k = 0; k < 4; k++)
+                if (mask & (1 << k)) c[k] = modulate(c[k], sample(*s.texture, u[k], v[k]));
+        }
+        float z[4];
+        _mm_storeu_ps(z, plane(s.z));
+#else
+        uint32_t c[4];
+        float z[4];
+        for (int k = 0; k < 4; k++) {
+            if (!(mask & (1 << k))) continue;
+            float px = x + k + 0.5f;
+            float w = 1.0f / (s.invW.a * px + s.invW.b * py + s.invW.c);
+            float a[6];
+            for (int i = 0; i < 6; i++) a[i] = (s.attributes[i].a * px + s.attributes[i].b * py + s.attributes[i].c) * w;
+            c[k] = pack(a[0], a[1], a[2], a[3]);
+            if (s.texture) c[k] = modulate(c[k], sample(*s.texture, a[4], a[5]));
+            z[k] = s.z.a * px + s.z.b * py + s.z.c;
+        }
+#endif
+        int written = 0;
+        for (int k = 0; k < 4; k++) {
+            if (!(mask & (1 << k))) continue;
+            color[row + x + k] = c[k];
+            if (s.depthTest) depth[row + x + k] = z[k];
+            written++;
+        }
+        return written;
+    }
+
+    static uint32_t sample(const SoftTexture& t, float u, float v) {
+        int tx = (int)floorf(u * t.width) % t.width, ty = (int)floorf(v * t.height) % t.height;
+        if (tx < 0) tx += t.width;
+        if (ty < 0) ty += t.height;
+        return t.pixels[(size_t)ty * t.width + tx];
+    }
+
+    //like GL_MODULATE, channel by channel
+    static uint32_t modulate(uint32_t a, uint32_t b) {
+        uint32_t r = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t product = ((a >> shift) & 255) * ((b >> shift) & 255);
+            r |= ((product + 127) / 255) << shift;
+        }
+        return r;
+    }
+
+    int width = 0, height = 0, stride = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    std::vector<Setup> setups;
+    std::vector<std::vector<uint32_t>> bins;
+    std::vector<long long> tilePixels;
+    bool depthTest = false;
+    ThreadPool* pool = nullptr;
+    SoftRasterStats stats = {};
+};
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPATIAL_SSE 1
+#include <emmintrin.h>
+#endif
+
+//bounding volume hierarchy over object boxes with frustum culling, ray and
+//box queries. objects that move only refit the nodes above them, the tree
+//keeps its topology until build() is called again.
+
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+inline Aabb AabbEmpty()
+{
+    Aabb box = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+    return box;
+}
+
+inline Aabb AabbFromCenter(float x, float y, float z, float halfX, float halfY, float halfZ)
+{
+    Aabb box = { { x - halfX, y - halfY, z - halfZ }, { x + halfX, y + halfY, z + halfZ } };
+    return box;
+}
+
+inline void AabbGrow(Aabb* box, const Aabb& other)
+{
+    for (int a = 0; a < 3; a++) {
+        box->min[a] = std::min(box->min[a], other.min[a]);
+        box->max[a] = std::max(box->max[a], other.max[a]);
+    }
+}
+
+inline bool AabbOverlap(const Aabb& a, const Aabb& b)
+{
+    return a.min[0] <= b.max[0] && a.max[0] >= b.min[0] &&
+        a.min[1] <= b.max[1] && a.max[1] >= b.min[1] &&
+        a.min[2] <= b.max[2] && a.max[2] >= b.min[2];
+}
+
+inline bool AabbEqual(const Aabb& a, const Aabb& b)
+{
+    for (int i = 0; i < 3; i++)
+        if (a.min[i] != b.min[i] || a.max[i] != b.max[i]) return false;
+    return true;
+}
+
+//slab test, entry distance in *t (0 when the origin is inside)
+inline bool AabbRay(const Aabb& box, const float origin[3], const float invDir[3], float maxT, float* t)
+{
+    float t0 = 0.0f, t1 = maxT;
+    for (int a = 0; a < 3; a++) {
+        float n = (box.min[a] - origin[a]) * invDir[a];
+        float f = (box.max[a] - origin[a]) * invDir[a];
+        if (n > f) std::swap(n, f);
+        t0 = n > t0 ? n : t0;
+        t1 = f < t1 ? f : t1;
+        if (t0 > t1) return false;
+    }
+    *t = t0;
+    return true;
+}
+
+enum FrustumResult {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECT,
+    FRUSTUM_INSIDE,
+};
+
+//the six planes (left, right, bottom, top, near, far) stored across lanes,
+//two unused lanes never reject anything
+struct Frustum {
+    alignas(16) float nx[8];
+    alignas(16) float ny[8];
+    alignas(16) float nz[8];
+    alignas(16) float d[8];
+};
+
+//planes of a column-major clip matrix (projection * view * model), in the
+//space the matrix maps from
+inline Frustum FrustumFromMatrix(const float m[16])
+{
+    Frustum f = {};
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p & 1) ? -1.0f : 1.0f;
+        float a = m[3] + sign * m[row];
+        float b = m[7] + sign * m[4 + row];
+        float c = m[11] + sign * m[8 + row];
+        float w = m[15] + sign * m[12 + row];
+        float len = sqrtf(a * a + b * b + c * c);
+        f.nx[p] = a / len;
+        f.ny[p] = b / len;
+        f.nz[p] = c / len;
+        f.d[p] = w / len;
+    }
+    for (int p = 6; p < 8; p++) f.d[p] = FLT_MAX;
+    return f;
+}
+
+//center/extent form: the box is out if it is fully behind any plane
+inline FrustumResult FrustumTestAabb(const Frustum& f, const Aabb& box)
+{
+    float cx = (box.min[0] + box.max[0]) * 0.5f, ex = (box.max[0] - box.min[0]) * 0.5f;
+    float cy = (box.min[1] + box.max[1]) * 0.5f, ey = (box.max[1] - box.min[1]) * 0.5f;
+    float cz = (box.min[2] + box.max[2]) * 0.5f, ez = (box.max[2] - box.min[2]) * 0.5f;
+#if defined(SPATIAL_SSE)
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    int outside = 0, straddle = 0;
+    for (int g = 0; g < 8; g += 4) {
+        __m128 nx = _mm_load_ps(f.nx + g), ny = _mm_load_ps(f.ny + g), nz = _mm_load_ps(f.nz + g);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(cx)), _mm_mul_ps(ny, _mm_set1_ps(cy))),
+            _mm_add_ps(_mm_mul_ps(nz, _mm_set1_ps(cz)), _mm_load_ps(f.d + g)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, absMask), _mm_set1_ps(ex)),
+            _mm_mul_ps(_mm_and_ps(ny, absMask), _mm_set1_ps(ey))), _mm_mul_ps(_mm_and_ps(nz, absMask), _mm_set1_ps(ez)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        straddle |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), _mm_setzero_ps()));
+    }
+    if (outside) return FRUSTUM_OUTSIDE;
+    return straddle ? FRUSTUM_INTERSECT : FRUSTUM_INSIDE;
+#else
+    FrustumResult result = FRUSTUM_INSIDE;
+    for (int p = 0; p < 6; p++) {
+        float dist = f.nx[p] * cx + f.ny[p] * cy + f.nz[p] * cz + f.d[p];
+        float radius = fabsf(f.nx[p]) * ex + fabsf(f.ny[p]) * ey + fabsf(f.nz[p]) * ez;
+        if (dist + radius < 0.0f) return FRUSTUM_OUTSIDE;
+        if (dist - radius < 0.0f) result = FRUSTUM_INTERSECT;
+    }
+    return result;
+#endif
+}
+
+struct CullStats {
+    int objects;
+    int visible;
+    int nodesTested;
+    double milliseconds;
+};
+
+//logs averaged cull stats about once a second
+class CullReport {
+public:
+    explicit CullReport(const char* name) : name(name) {}
+
+    void add(const CullStats& stats) {
+        frames++;
+        objects += stats.objects;
+        visible += stats.visible;
+        milliseconds += stats.milliseconds;
+        Uint64 now = SDL_GetTicks();
+        if (start == 0) start = now;
+        if (now - start < 1000) return;
+        SDL_Log("%s: %.0f objects, %.0f visible, %.0f culled, %.3f ms culling", name,
+            (double)objects / frames, (double)visible / frames, (double)(objects - visible) / frames, milliseconds / frames);
+        start = now;
+        frames = 0;
+        objects = visible = 0;
+        milliseconds = 0.0;
+    }
+
+private:
+    const char* name;
+    Uint64 start = 0;
+    int frames = 0;
+    long long objects = 0, visible = 0;
+    double milliseconds = 0.0;
+};
+
+class Bvh {
+public:
+    //ids are handed out in order, build() has to run before any query
+    int add(const Aabb& box) {
+        bounds.push_back(box);
+        leafOf.push_back(-1);
+        return (int)bounds.size() - 1;
+    }
+
+    void clear() {
+        bounds.clear();
+        leafOf.clear();
+        nodes.clear();
+        order.clear();
+        dirty.clear();
+    }
+
+    int objectCount() const { return (int)bounds.size(); }
+    const Aabb& objectBounds(int id) const { return bounds[id]; }
+
+    //the box of a moved object, its nodes catch up in refit()
+    void setBounds(int id, const Aabb& box) {
+        bounds[id] = box;
+        int leaf = leafOf[id];
+        if (leaf >= 0 && !nodes[leaf].dirty) {
+            nodes[leaf].dirty = true;
+            dirty.push_back(leaf);
+        }
+    }
+
+    //top-down median split on the longest axis of the centers
+    void build() {
+        int n = (int)bounds.size();
+        nodes.clear();
+        dirty.clear();
+        order.resize(n);
+        for (int i = 0; i < n; i++) order[i] = i;
+        if (n == 0) return;
+        nodes.reserve((size_t)n * 2 / BVH_LEAF_SIZE + 2);
+        nodes.push_back(Node());
+        nodes[0].parent = -1;
+        buildNode(0, 0, n);
+    }
+
+    //grows or shrinks the nodes above every moved object
+    void refit() {
+        if (dirty.empty()) return;
+        //a lot of movement: one bottom-up pass (children always sit after their parent)
+        if (dirty.size() * 4 > nodes.size()) {
+            for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+                fitNode(i);
+                nodes[i].dirty = false;
+            }
+        }
+        else {
+            for (int leaf : dirty) {
+                nodes[leaf].dirty = false;
+                fitNode(leaf);
+                for (int p = nodes[leaf].parent; p >= 0; p = nodes[p].parent) {
+                    Aabb old = nodes[p].box;
+                    fitNode(p);
+                    if (AabbEqual(old, nodes[p].box)) break;
+                }
+            }
+        }
+        dirty.clear();
+    }
+
+    //ids of every object whose box touches the frustum, whole subtrees
+    //inside it are taken without testing their objects
+    void cull(const Frustum& frustum, std::vector<int>& visible, CullStats* stats = nullptr) const {
+        Uint64 start = SDL_GetPerformanceCounter();
+        visible.clear();
+        int tested = 0;
+        if (!nodes.empty()) {
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = nodes[stack[--top]];
+                tested++;
+                FrustumResult r = FrustumTestAabb(frustum, node.box);
+                if (r == FRUSTUM_OUTSIDE) continue;
+                if (r == FRUSTUM_INSIDE || node.left < 0) {
+                    for (int i = node.first; i < node.first + node.count; i++) {
+                        if (r == FRUSTUM_INSIDE || FrustumTestAabb(frustum, bounds[order[i]]) != FRUSTUM_OUTSIDE)
+                            visible.push_back(order[i]);
+                    }
+                    continue;
+                }
+                stack[top++] = node.left;
+                stack[top++] = node.left + 1;
+            }
+        }
+        if (stats) {
+            stats->objects = (int)bounds.size();
+            stats->visible = (int)visible.size();
+            stats->nodesTested = tested;
+            stats->milliseconds = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        }
+    }
+
+    //closest object box hit by the ray within maxT, -1 if none
+    int raycast(const float origin[3], const float dir[3], float maxT, float* outT) const {
+        if (nodes.empty()) return -1;
+        float inv[3];
+        for (int a = 0; a < 3; a++) inv[a] = dir[a] != 0.0f ? 1.0f / dir[a] : FLT_MAX;
+
+        int best = -1;
+        float bestT = maxT;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            float t;
+            if (!AabbRay(node.box, origin, inv, bestT, &t)) continue;
+            if (node.left < 0) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    if (AabbRay(bounds[order[i]], origin, inv, bestT, &t) && t <= bestT) {
+                        best = order[i];
+                        bestT = t;
+                    }
+                }
+                continue;
+            }
+            //visit the nearer child first so the far one is usually pruned
+            float tl, tr;
+            bool hitL = AabbRay(nodes[node.left].box, origin, inv, bestT, &tl);
+            bool hitR = AabbRay(nodes[node.left + 1].box, origin, inv, bestT, &tr);
+            if (hitL && hitR) {
+                stack[top++] = tl < tr ? node.left + 1 : node.left;
+                stack[top++] = tl < tr ? node.left : node.left + 1;
+            }
+            else if (hitL) {
+                stack[top++] = node.left;
+            }
+            else if (hitR) {
+                stack[top++] = node.left + 1;
+            }
+        }
+        if (best >= 0 && outT) *outT = bestT;
+        return best;
+    }
+
+    //ids of every object whose box overlaps box
+    void query(const Aabb& box, std::vector<int>& out) const {
+        out.clear();
+        if (nodes.empty()) return;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!AabbOverlap(node.box, box)) continue;
+            if (node.left < 0) {
+                for (int i = node.first; i < node.first + node.count; i++)
+                    if (AabbOverlap(bounds[order[i]], box)) out.push_back(order[i]);
+                continue;
+            }
+            stack[top++] = node.left;
+            stack[top++] = node.left + 1;
+        }
+    }
+
+private:
+    static const int BVH_LEAF_SIZE = 4;
+
+    struct Node {
+        Aabb box;
+        int first = 0, count = 0; //objects of the whole subtree in order[]
+        int left = -1;            //children at left and left + 1, -1 for leaves
+        int parent = -1;
+        bool dirty = false;
+    };
+
+    void fitNode(int index) {
+        Node& node = nodes[index];
+        node.box = AabbEmpty();
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) AabbGrow(&node.box, bounds[order[i]]);
+        }
+        else {
+            AabbGrow(&node.box, nodes[node.left].box);
+            AabbGrow(&node.box, nodes[node.left + 1].box);
+        }
+    }
+
+    //median splits keep the depth at log2(n / leaf size), well inside the query stacks
+    void buildNode(int index, int first, int count) {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        nodes[index].left = -1;
+        if (count <= BVH_LEAF_SIZE) {
+            for (int i = first; i < first + count; i++) leafOf[order[i]] = index;
+            fitNode(index);
+            return;
+        }
+
+        Aabb centers = AabbEmpty();
+        for (int i = first; i < first + count; i++) {
+            const Aabb& b = bounds[order[i]];
+            for (int a = 0; a < 3; a++) {
+                float c = (b.min[a] + b.max[a]) * 0.5f;
+                centers.min[a] = std::min(centers.min[a], c);
+                centers.max[a] = std::max(centers.max[a], c);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; a++)
+            if (centers.max[a] - centers.min[a] > centers.max[axis] - centers.min[axis]) axis = a;
+
+        int half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [this, axis](int a, int b) {
+            return bounds[a].min[axis] + bounds[a].max[axis] < bounds[b].min[axis] + bounds[b].max[axis];
+        });
+
+        int left = (int)nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[index].left = left;
+        nodes[left].parent = index;
+        nodes[left + 1].parent = index;
+        buildNode(left, first, half);
+        buildNode(left + 1, first + half, count - half);
+        fitNode(index);
+    }
+
+    std::vector<Aabb> bounds;
+    std::vector<int> leafOf;
+    std::vector<Node> nodes;
+    std::vector<int> order;
+    std::vector<int> dirty;
+};
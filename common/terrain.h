@@ -0,0 +1,373 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <functional>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "core_renderer.h"
+#include "spatial_index.h"
+#include "thread_pool.h"
+
+//endless heightmap terrain cut into square chunks around a focus point.
+//chunk meshes are built on the shared thread pool and handed back through an
+//inbox that update() only try-locks, so a frame never waits on generation.
+//the vertex count halves per side with every lod ring away from the focus,
+//and each chunk hangs a skirt from its border so the cracks between
+//neighbours of different lod stay covered. a chunk keeps drawing its old mesh
+//until the one for its new lod arrives, chunks one ring past the view radius
+//are evicted. every chunk is a CoreMesh of its own drawn under the
+//translation to its corner.
+
+struct TerrainSettings {
+    float chunkSize;  //world units per chunk side
+    int resolution;   //quads per chunk side at lod 0, power of two, at most 128
+    int lodLevels;
+    int lodRing;      //chunks per lod ring
+    int viewRadius;   //in chunks
+    int maxJobs;      //chunks in flight on the pool
+    int maxUploads;   //meshes uploaded per update
+    float skirtDepth; //at lod 0, doubles per lod
+};
+
+typedef std::function<float(float x, float z)> TerrainHeightFn;
+
+//chunk-local position, baked color (no lighting in the demos)
+struct TerrainVertex {
+    float x, y, z;
+    unsigned char color[4];
+};
+
+struct TerrainMesh {
+    std::vector<TerrainVertex> vertices;
+    std::vector<unsigned short> indices;
+};
+
+inline float TerrainHash(int x, int z)
+{
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (h ^ (h >> 16)) / 4294967295.0f;
+}
+
+//smooth value noise in 0..1, one lattice cell per unit
+inline float TerrainValueNoise(float x, float z)
+{
+    int ix = (int)floorf(x), iz = (int)floorf(z);
+    float fx = x - ix, fz = z - iz;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float a = TerrainHash(ix, iz) + (TerrainHash(ix + 1, iz) - TerrainHash(ix, iz)) * fx;
+    float b = TerrainHash(ix, iz + 1) + (TerrainHash(ix + 1, iz + 1) - TerrainHash(ix, iz + 1)) * fx;
+    return a + (b - a) * fz;
+}
+
+//rolling hills in -amplitude..amplitude, features about scale units wide
+inline float TerrainHills(float x, float z, float scale, float amplitude)
+{
+    float sum = 0.0f, weight = 1.0f, total = 0.0f;
+    float fx = x / scale, fz = z / scale;
+    for (int octave = 0; octave < 5; octave++) {
+        sum += (TerrainValueNoise(fx, fz) * 2.0f - 1.0f) * weight;
+        total += weight;
+        weight *= 0.45f;
+        fx = fx * 2.03f + 17.0f;
+        fz = fz * 2.03f + 31.0f;
+    }
+    return sum / total * amplitude;
+}
+
+//mesh of one chunk at one lod, safe to run on any thread
+inline void TerrainBuildChunk(int cx, int cz, int lod, const TerrainSettings& s, const TerrainHeightFn& height, TerrainMesh* mesh)
+{
+    int n = std::max(s.resolution >> lod, 1);
+    float step = s.chunkSize / n;
+    float originX = cx * s.chunkSize, originZ = cz * s.chunkSize;
+
+    //one extra ring so normals on the border match the neighbour's
+    int side = n + 3;
+    std::vector<float> h((size_t)side * side);
+    for (int j = 0; j < side; j++)
+        for (int i = 0; i < side; i++)
+            h[(size_t)j * side + i] = height(originX + (i - 1) * step, originZ + (j - 1) * step);
+
+    const float light[3] = { 0.42f, 0.82f, 0.39f };
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    mesh->vertices.reserve((size_t)(n + 1) * (n + 1) + 4 * (n + 1));
+    mesh->indices.reserve((size_t)n * n * 6 + 4 * n * 6);
+    for (int j = 0; j <= n; j++) {
+        for (int i = 0; i <= n; i++) {
+            const float* row = &h[(size_t)(j + 1) * side + (i + 1)];
+            float nx = row[-1] - row[1], ny = 2.0f * step, nz = row[-side] - row[side];
+            float len = sqrtf(nx * nx + ny * ny + nz * nz);
+            nx /= len; ny /= len; nz /= len;
+
+            //grass on the flats, rock on the slopes, a little darker in the hollows
+            float rock = std::min(std::max((0.9f - ny) * 5.0f, 0.0f), 1.0f);
+            float low = std::min(std::max(-row[0] * 0.15f, 0.0f), 0.3f);
+            float shade = 0.35f + 0.65f * std::max(nx * light[0] + ny * light[1] + nz * light[2], 0.0f);
+            float r = (0.30f + (0.46f - 0.30f) * rock) * (1.0f - low) * shade;
+            float g = (0.52f + (0.43f - 0.52f) * rock) * (1.0f - low) * shade;
+            float b = (0.20f + (0.38f - 0.20f) * rock) * (1.0f - low) * shade;
+
+            TerrainVertex v = { i * step, row[0], j * step, {
+                (unsigned char)(r * 255.0f), (unsigned char)(g * 255.0f), (unsigned char)(b * 255.0f), 255 } };
+            mesh->vertices.push_back(v);
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            unsigned short a = (unsigned short)(j * (n + 1) + i), b = (unsigned short)(a + 1);
+            unsigned short c = (unsigned short)(a + n + 1), d = (unsigned short)(c + 1);
+            unsigned short quad[6] = { a, c, b, b, c, d };
+            mesh->indices.insert(mesh->indices.end(), quad, quad + 6);
+        }
+    }
+
+    //skirts, one strip of border vertices pushed straight down per edge
+    float depth = s.skirtDepth * (float)(1 << lod);
+    for (int edge = 0; edge < 4; edge++) {
+        unsigned short first = (unsigned short)mesh->vertices.size();
+        for (int k = 0; k <= n; k++) {
+            int i = edge == 0 ? k : edge == 1 ? n : edge == 2 ? n - k : 0;
+            int j = edge == 0 ? 0 : edge == 1 ? k : edge == 2 ? n : n - k;
+            TerrainVertex v = mesh->vertices[(size_t)j * (n + 1) + i];
+            v.y -= depth;
+            mesh->vertices.push_back(v);
+        }
+        for (int k = 0; k < n; k++) {
+            int i0 = edge == 0 ? k : edge == 1 ? n : edge == 2 ? n - k : 0;
+            int j0 = edge == 0 ? 0 : edge == 1 ? k : edge == 2 ? n : n - k;
+            int i1 = edge == 0 ? k + 1 : edge == 1 ? n : edge == 2 ? n - k - 1 : 0;
+            int j1 = edge == 0 ? 0 : edge == 1 ? k + 1 : edge == 2 ? n : n - k - 1;
+            unsigned short top0 = (unsigned short)(j0 * (n + 1) + i0), top1 = (unsigned short)(j1 * (n + 1) + i1);
+            unsigned short bottom0 = (unsigned short)(first + k), bottom1 = (unsigned short)(first + k + 1);
+            unsigned short quad[6] = { top0, bottom0, top1, top1, bottom0, bottom1 };
+            mesh->indices.insert(mesh->indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+class ChunkedTerrain {
+public:
+    ChunkedTerrain() : inbox(std::make_shared<Inbox>()) {}
+    ~ChunkedTerrain() { cancelAll(); }
+
+    //chunks are uploaded to and drawn by renderer
+    void open(CoreRenderer* renderer, const TerrainSettings& settings, TerrainHeightFn height) {
+        this->renderer = renderer;
+        this->settings = settings;
+        this->height = std::make_shared<TerrainHeightFn>(std::move(height));
+
+        //ring offsets nearest first, so the chunks under the car are asked for first
+        offsets.clear();
+        int r = settings.viewRadius;
+        for (int z = -r; z <= r; z++)
+            for (int x = -r; x <= r; x++)
+                offsets.push_back({ x, z, std::max(abs(x), abs(z)), x * x + z * z });
+        std::sort(offsets.begin(), offsets.end(), [](const Offset& a, const Offset& b) {
+            return a.distanceSq < b.distanceSq;
+        });
+    }
+
+    //drops every chunk, jobs still on the pool finish into the old inbox
+    void close() {
+        cancelAll();
+        for (auto& entry : chunks) release(entry.second);
+        chunks.clear();
+        ready.clear();
+        inbox = std::make_shared<Inbox>();
+        inFlight = 0;
+    }
+
+    //collects finished chunks, uploads a few, evicts far ones and queues what is missing
+    void update(float focusX, float focusZ) {
+        int fx = (int)floorf(focusX / settings.chunkSize), fz = (int)floorf(focusZ / settings.chunkSize);
+
+        if (inbox->mutex.try_lock()) {
+            arrived.swap(inbox->done);
+            inbox->mutex.unlock();
+        }
+        for (auto& job : arrived) {
+            inFlight--;
+            auto it = chunks.find(key(job->cx, job->cz));
+            if (it == chunks.end() || it->second.job != job) continue;
+            it->second.job = nullptr;
+            ready.push_back(job);
+        }
+        arrived.clear();
+
+        //nearest first, the rest waits for the next frame
+        std::sort(ready.begin(), ready.end(), [fx, fz](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+            return std::max(abs(a->cx - fx), abs(a->cz - fz)) < std::max(abs(b->cx - fx), abs(b->cz - fz));
+        });
+        uploadsLastUpdate = 0;
+        size_t used = 0;
+        for (; used < ready.size() && uploadsLastUpdate < settings.maxUploads; used++) {
+            auto it = chunks.find(key(ready[used]->cx, ready[used]->cz));
+            if (it == chunks.end()) continue;
+            upload(it->second, *ready[used]);
+            uploadsLastUpdate++;
+        }
+        ready.erase(ready.begin(), ready.begin() + used);
+
+        for (auto it = chunks.begin(); it != chunks.end();) {
+            int distance = std::max(abs(it->second.cx - fx), abs(it->second.cz - fz));
+            if (distance > settings.viewRadius + 1) {
+                if (it->second.job) it->second.job->cancelled = true;
+                release(it->second);
+                it = chunks.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        for (const Offset& o : offsets) {
+            if (inFlight >= settings.maxJobs) break;
+            int cx = fx + o.x, cz = fz + o.z;
+            int lod = std::min(o.ring / std::max(settings.lodRing, 1), settings.lodLevels - 1);
+            Chunk& chunk = chunks[key(cx, cz)];
+            chunk.cx = cx;
+            chunk.cz = cz;
+            if (chunk.job && chunk.job->lod == lod) continue;
+            if (chunk.job) {
+                chunk.job->cancelled = true;
+                chunk.job = nullptr;
+            }
+            if (chunk.lod == lod) continue;
+            //a stale mesh of the right lod may still sit in the upload queue
+            bool queued = false;
+            for (auto& job : ready) queued = queued || (job->cx == cx && job->cz == cz && job->lod == lod);
+            if (queued) continue;
+            submit(chunk, lod);
+        }
+    }
+
+    //frustum in world space, chunks completely outside it are skipped
+    void draw(const Frustum* frustum = nullptr, CullStats* stats = nullptr) {
+        double cullTicks = 0.0;
+        int loaded = 0;
+        trianglesLastDraw = 0;
+        chunksLastDraw = 0;
+        for (auto& entry : chunks) {
+            const Chunk& chunk = entry.second;
+            if (chunk.lod < 0) continue;
+            loaded++;
+            if (frustum) {
+                Uint64 cullStart = SDL_GetPerformanceCounter();
+                bool outside = FrustumTestAabb(*frustum, chunk.bounds) == FRUSTUM_OUTSIDE;
+                cullTicks += (double)(SDL_GetPerformanceCounter() - cullStart);
+                if (outside) continue;
+            }
+            //chunk-local vertices keep their precision however far the car drives
+            renderer->drawMesh(chunk.mesh, Mat4Translate(chunk.cx * settings.chunkSize, 0.0f, chunk.cz * settings.chunkSize));
+            trianglesLastDraw += chunk.mesh.indexCount / 3;
+            chunksLastDraw++;
+        }
+        if (stats) {
+            stats->objects = loaded;
+            stats->visible = chunksLastDraw;
+            stats->nodesTested = frustum ? loaded : 0;
+            stats->milliseconds = cullTicks * 1000.0 / SDL_GetPerformanceFrequency();
+        }
+    }
+
+    int chunkCount() const { return (int)chunks.size(); }
+    int jobsInFlight() const { return inFlight; }
+    int uploadsLastUpdateCount() const { return uploadsLastUpdate; }
+    int chunksLastDrawCount() const { return chunksLastDraw; }
+    int trianglesLastDrawCount() const { return trianglesLastDraw; }
+
+private:
+    struct Job {
+        int cx, cz, lod;
+        std::atomic<bool> cancelled{ false };
+        TerrainMesh mesh;
+    };
+    struct Inbox {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Job>> done;
+    };
+    struct Chunk {
+        int cx = 0, cz = 0;
+        int lod = -1; //of the mesh on the gpu, -1 while there is none
+        CoreMesh mesh;
+        Aabb bounds; //world space, skirts included
+        std::shared_ptr<Job> job;
+    };
+    struct Offset {
+        int x, z;
+        int ring;
+        int distanceSq;
+    };
+
+    static uint64_t key(int cx, int cz) { return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cz; }
+
+    void submit(Chunk& chunk, int lod) {
+        auto job = std::make_shared<Job>();
+        job->cx = chunk.cx;
+        job->cz = chunk.cz;
+        job->lod = lod;
+        chunk.job = job;
+        inFlight++;
+
+        //the job only holds shared state, the terrain may be gone when it runs
+        std::shared_ptr<Inbox> box = inbox;
+        std::shared_ptr<TerrainHeightFn> fn = height;
+        TerrainSettings s = settings;
+        GlobalThreadPool().submit([job, box, fn, s] {
+            if (!job->cancelled) TerrainBuildChunk(job->cx, job->cz, job->lod, s, *fn, &job->mesh);
+            std::lock_guard<std::mutex> lock(box->mutex);
+            box->done.push_back(job);
+        });
+    }
+
+    //a chunk that changes lod keeps its buffers
+    void upload(Chunk& chunk, Job& job) {
+        static const CoreVertexLayout layout = { sizeof(TerrainVertex), offsetof(TerrainVertex, x), offsetof(TerrainVertex, color), -1, -1 };
+        renderer->createMesh(&chunk.mesh, layout, job.mesh.vertices.data(), (int)job.mesh.vertices.size(),
+            job.mesh.indices.data(), (int)job.mesh.indices.size(), sizeof(unsigned short));
+        chunk.lod = job.lod;
+        float low = FLT_MAX, high = -FLT_MAX;
+        for (const TerrainVertex& v : job.mesh.vertices) {
+            low = std::min(low, v.y);
+            high = std::max(high, v.y);
+        }
+        float x0 = chunk.cx * settings.chunkSize, z0 = chunk.cz * settings.chunkSize;
+        chunk.bounds = { { x0, low, z0 }, { x0 + settings.chunkSize, high, z0 + settings.chunkSize } };
+    }
+
+    void release(Chunk& chunk) {
+        renderer->destroyMesh(&chunk.mesh);
+        chunk.lod = -1;
+    }
+
+    void cancelAll() {
+        for (auto& entry : chunks)
+            if (entry.second.job) entry.second.job->cancelled = true;
+    }
+
+    TerrainSettings settings = {};
+    std::shared_ptr<TerrainHeightFn> height;
+    CoreRenderer* renderer = nullptr;
+    std::shared_ptr<Inbox> inbox;
+    std::unordered_map<uint64_t, Chunk> chunks;
+    std::vector<Offset> offsets;
+    std::vector<std::shared_ptr<Job>> arrived;
+    std::vector<std::shared_ptr<Job>> ready;
+    int inFlight = 0;
+    int uploadsLastUpdate = 0;
+    int chunksLastDraw = 0;
+    int trianglesLastDraw = 0;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "bc_encoder.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+
+//on-disk container for decoded textures with their full mip chain:
+//  TexCacheHeader | level 0 | level 1 | ... (every level 16-byte aligned)
+//the file is mapped and the levels are handed to glTexImage2D as they are
+
+#define TEXCACHE_MAGIC 0x31435854u //"TXC1"
+#define TEXCACHE_VERSION 2u
+#define TEXCACHE_MAX_LEVELS 16
+
+enum TexCacheFormat {
+    TEXCACHE_RGB8 = 0,
+    TEXCACHE_RGBA8 = 1,
+    TEXCACHE_BC1 = 2,
+    TEXCACHE_BC3 = 3,
+};
+
+struct TexCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset; //from the start of the file
+    uint64_t size;
+};
+
+struct TexCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash; //hash of the encoded source file, not of the pixels
+    uint64_t sourceSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t mipFilter; //MipFilter the chain was built with
+    uint32_t levelCount;
+    uint32_t compression; //0 = raw, otherwise BcQuality + 1
+    TexCacheLevel levels[TEXCACHE_MAX_LEVELS];
+};
+
+struct TexCacheImage {
+    MappedFile file;
+    const TexCacheHeader* header = nullptr;
+};
+
+inline uint32_t TexCacheChannels(uint32_t format)
+{
+    return format == TEXCACHE_RGBA8 ? 4 : 3;
+}
+
+inline bool TexCacheIsCompressed(uint32_t format)
+{
+    return format == TEXCACHE_BC1 || format == TEXCACHE_BC3;
+}
+
+//bytes of one level in the given format
+inline uint64_t TexCacheLevelSize(uint32_t format, uint32_t width, uint32_t height)
+{
+    if (TexCacheIsCompressed(format)) return BcCompressedSize((int)width, (int)height, format == TEXCACHE_BC3);
+    return (uint64_t)width * height * TexCacheChannels(format);
+}
+
+//64-bit multiply/xorshift hash, eats 8 bytes per step so hashing a jpg is
+//far cheaper than decoding it
+inline uint64_t TexCacheHash(const unsigned char* data, size_t size)
+{
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = 0xCBF29CE484222325ull ^ (size * k);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        h = (h ^ v) * k;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h = (h ^ tail) * k;
+    h ^= h >> 32;
+    return h;
+}
+
+inline void TexCachePath(const char* sourcePath, char* out, size_t outSize)
+{
+    SDL_snprintf(out, outSize, "%s.texcache", sourcePath);
+}
+
+inline int TexCacheLevelCount(uint32_t width, uint32_t height)
+{
+    int levels = 1;
+    while ((width > 1 || height > 1) && levels < TEXCACHE_MAX_LEVELS) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels++;
+    }
+    return levels;
+}
+
+inline void TexCacheClose(TexCacheImage* image)
+{
+    UnmapFile(&image->file);
+    image->header = nullptr;
+}
+
+//maps the cache file and checks it still belongs to the current source,
+//a changed source (different hash or size), mip filter or compression setting
+//makes the entry stale. every level has to have the size its place in the
+//chain and the format give it and lie inside the file, anything else
+//(truncated or foreign file) is a miss and gets rebuilt
+inline bool TexCacheOpen(const char* cachePath, uint64_t sourceHash, uint64_t sourceSize, MipFilter filter,
+    uint32_t compression, TexCacheImage* image)
+{
+    if (!MapFile(cachePath, &image->file)) return false;
+
+    const TexCacheHeader* h = (const TexCacheHeader*)image->file.data;
+    bool valid = image->file.size >= sizeof(TexCacheHeader) &&
+        h->magic == TEXCACHE_MAGIC && h->version == TEXCACHE_VERSION &&
+        h->sourceHash == sourceHash && h->sourceSize == sourceSize && h->mipFilter == (uint32_t)filter &&
+        h->compression == compression && h->format <= TEXCACHE_BC3 &&
+        TexCacheIsCompressed(h->format) == (compression != 0) &&
+        h->width > 0 && h->height > 0 &&
+        h->levelCount > 0 && h->levelCount <= (uint32_t)TexCacheLevelCount(h->width, h->height);
+
+    uint32_t w = valid ? h->width : 0, ht = valid ? h->height : 0;
+    for (uint32_t i = 0; valid && i < h->levelCount; i++) {
+        const TexCacheLevel& l = h->levels[i];
+        valid = l.width == w && l.height == ht && l.size == TexCacheLevelSize(h->format, w, ht) &&
+            l.offset <= image->file.size && l.size <= image->file.size - l.offset;
+        w = w > 1 ? w / 2 : 1;
+        ht = ht > 1 ? ht / 2 : 1;
+    }
+
+    if (!valid) {
+        TexCacheClose(image);
+        return false;
+    }
+    image->header = h;
+    return true;
+}
+
+//lays out header + all mip levels in one blob, the same bytes are written to
+//disk and uploaded, so a freshly built entry and a mapped one look identical.
+//maxLevels caps the chain (atlases stop where texels would cross the gutters), 0 = full chain
+inline void TexCacheBuild(uint64_t sourceHash, uint64_t sourceSize, uint32_t width, uint32_t height,
+    uint32_t format, MipFilter filter, bool wrap, uint32_t maxLevels, const unsigned char* pixels, std::vector<unsigned char>& blob)
+{
+    uint32_t channels = TexCacheChannels(format);
+    TexCacheHeader header = {};
+    header.magic = TEXCACHE_MAGIC;
+    header.version = TEXCACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.width = width;
+    header.height = height;
+    header.format = format;
+    header.mipFilter = (uint32_t)filter;
+    header.levelCount = (uint32_t)TexCacheLevelCount(width, height);
+    if (maxLevels > 0 && header.levelCount > maxLevels) header.levelCount = maxLevels;
+
+    uint64_t offset = (sizeof(TexCacheHeader) + 15) & ~15ull;
+    uint32_t w = width, h = height;
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        header.levels[i].width = w;
+        header.levels[i].height = h;
+        header.levels[i].offset = offset;
+        header.levels[i].size = TexCacheLevelSize(format, w, h);
+        offset = (offset + header.levels[i].size + 15) & ~15ull;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    blob.assign((size_t)offset, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + header.levels[0].offset, pixels, (size_t)header.levels[0].size);
+
+    MipLevel mips[TEXCACHE_MAX_LEVELS];
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        mips[i].width = (int)header.levels[i].width;
+        mips[i].height = (int)header.levels[i].height;
+        mips[i].pixels = blob.data() + header.levels[i].offset;
+    }
+    GenerateMipChain(mips, (int)header.levelCount, (int)channels, filter, wrap);
+}
+
+//re-encodes every level of a raw blob as bc1 (rgb) or bc3 (rgba)
+inline void TexCacheCompress(const std::vector<unsigned char>& raw, BcQuality quality, std::vector<unsigned char>& blob)
+{
+    TexCacheHeader header;
+    memcpy(&header, raw.data(), sizeof(header));
+    uint32_t channels = TexCacheChannels(header.format);
+    bool alpha = channels == 4;
+    header.format = alpha ? TEXCACHE_BC3 : TEXCACHE_BC1;
+    header.compression = (uint32_t)quality + 1;
+
+    uint64_t offset = (sizeof(TexCacheHeader) + 15) & ~15ull;
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        header.levels[i].offset = offset;
+        header.levels[i].size = TexCacheLevelSize(header.format, header.levels[i].width, header.levels[i].height);
+        offset = (offset + header.levels[i].size + 15) & ~15ull;
+    }
+
+    const TexCacheHeader* src = (const TexCacheHeader*)raw.data();
+    blob.assign((size_t)offset, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        const TexCacheLevel& level = header.levels[i];
+        BcCompressImage(raw.data() + src->levels[i].offset, level.width, level.height, channels, quality,
+            blob.data() + level.offset);
+    }
+}
+
+//writes to a temp file first so a crash never leaves a half-written entry
+inline bool TexCacheWrite(const char* cachePath, const std::vector<unsigned char>& blob)
+{
+    char tmpPath[512];
+    SDL_snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+
+    SDL_IOStream* io = SDL_IOFromFile(tmpPath, "wb");
+    if (!io) return false;
+    bool ok = SDL_WriteIO(io, blob.data(), blob.size()) == blob.size();
+    ok = SDL_CloseIO(io) && ok;
+
+    if (ok) {
+        SDL_RemovePath(cachePath);
+        ok = SDL_RenamePath(tmpPath, cachePath);
+    }
+    if (!ok) SDL_RemovePath(tmpPath);
+    return ok;
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "trace.h"
+
+#define THREAD_POOL_DEQUE 1024 //jobs a thread can have queued, power of two. past that they go to the shared ring
+#define THREAD_POOL_QUEUE 64 //jobs from other threads the shared ring holds before it grows
+#define THREAD_POOL_FOR_STATES 8 //parallelFor calls in flight before more bookkeeping is allocated
+#define THREAD_POOL_SPINS 64 //times an idle worker looks for work before it sleeps
+#define THREAD_POOL_SCALING_REPS 20
+#define JOB_COUNTER_CHAINED (1 << 30) //flag in the count while a continuation waits on it
+
+//work stealing job system. every worker, and the thread that made the pool,
+//owns a chase-lev deque: it pushes and pops its own jobs at the bottom without
+//a lock while idle threads steal from the top of the others. jobs from any
+//other thread go through a shared ring under a mutex. job records are made up
+//front and recycled, so once the parallelFor bookkeeping and the shared ring
+//have grown to the busiest frame nothing allocates. jobs can be counted on a
+//JobCounter, and wait() runs queued jobs until the counter is done, so the
+//waiting thread works instead of blocking. a counter can also carry one
+//continuation that is queued when its last job finishes. parallelFor hands
+//out shrinking chunks: big ones while there is plenty left, down to the
+//minimum grain at the end, so threads that finish early pick up the rest.
+//a pool without workers runs everything on the calling thread
+
+class JobCounter {
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+    std::atomic<int> pending{ 0 };
+    std::function<void()> continuation;
+    JobCounter* continuationCounter = nullptr;
+};
+
+class ThreadPool {
+public:
+    //threads below zero means one worker per core besides the caller's.
+    //pin puts worker i on core i + 1, leaving core 0 to the caller
+    explicit ThreadPool(int threads = -1, bool pin = false) : owner(std::this_thread::get_id()) {
+        if (threads < 0) threads = SDL_GetNumLogicalCPUCores() - 1;
+        if (threads < 0) threads = 0;
+        for (int i = 0; i <= threads; i++) queues.emplace_back(new WorkQueue());
+        shared.resize(THREAD_POOL_QUEUE);
+        freeStates.reserve(THREAD_POOL_FOR_STATES * 4);
+        for (int i = 0; i < THREAD_POOL_FOR_STATES; i++) {
+            states.emplace_back(new ForState());
+            freeStates.push_back(states.back().get());
+        }
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this, i] { workerLoop(i + 1); });
+            if (pin) pinThread(workers.back(), (i + 1) % SDL_GetNumLogicalCPUCores());
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    int threadCount() const { return (int)workers.size(); }
+
+    //runs job on some thread later. with a counter, the counter is done once
+    //it has run; otherwise the caller has to sync on its own
+    void submit(std::function<void()> job, JobCounter* counter = nullptr) {
+        if (counter) counter->pending.fetch_add(1);
+        schedule(std::move(job), counter);
+    }
+
+    //queues job once every job counted on counter has finished, right away
+    //when they all have. call it after submitting them, one continuation a
+    //counter. with next, next counts the continuation, so waiting on next
+    //covers the whole chain
+    void then(JobCounter& counter, std::function<void()> job, JobCounter* next = nullptr) {
+        if (next) next->pending.fetch_add(1);
+        //held while the continuation is stored, so the last job can't miss it
+        counter.pending.fetch_add(1);
+        counter.continuation = std::move(job);
+        counter.continuationCounter = next;
+        counter.pending.fetch_or(JOB_COUNTER_CHAINED);
+        finish(&counter);
+    }
+
+    //runs queued jobs, any of them, until counter is done
+    void wait(JobCounter& counter) {
+        TRACE_ZONE("wait");
+        while (!counter.done())
+            if (!runOne()) std::this_thread::yield();
+    }
+
+    //calls fn(begin, end) over [0, count), blocks until all are done. chunks
+    //shrink towards grain, grain 0 picks one from count and the thread count
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& fn) {
+        if (count <= 0) return;
+        int participants = threadCount() + 1;
+        if (grain < 1) grain = count / (participants * 32) > 1 ? count / (participants * 32) : 1;
+        int chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || threadCount() == 0) {
+            fn(0, count);
+            return;
+        }
+
+        //helpers may start after we return (stolen late), so the counters live
+        //in a block that goes back to the pool once the last of them is done
+        //with it, and fn is only touched for claimed ranges
+        int helpers = chunks - 1 < threadCount() ? chunks - 1 : threadCount();
+        ForState* state = acquireState();
+        state->body = &fn;
+        state->grain = grain;
+        state->count = count;
+        state->participants = helpers + 1;
+        state->next.store(0);
+        state->done.store(0);
+        state->users.store(helpers + 1);
+        for (int i = 0; i < helpers; i++) schedule([this, state] { runChunks(state); leaveState(state); }, nullptr, state);
+        runChunks(state);
+        reclaimHelpers(state);
+        //nothing is left to claim by now, only ranges other threads are still on,
+        //so this doesn't pick up unrelated jobs that could hold the caller up
+        while (state->done.load() < count) std::this_thread::yield();
+        leaveState(state);
+    }
+
+private:
+    struct ForState;
+
+    struct Job {
+        std::function<void()> fn;
+        JobCounter* counter = nullptr;
+        ForState* helps = nullptr; //parallelFor helpers only
+        std::atomic<bool> busy{ false };
+    };
+
+    //chase-lev deque of job pointers (le et al., "correct and efficient
+    //work-stealing for weak memory models"), fixed size. the records it
+    //points to belong to the same thread and are handed out round robin
+    struct WorkQueue {
+        std::atomic<int64_t> top{ 0 };
+        std::atomic<int64_t> bottom{ 0 };
+        std::atomic<Job*> slots[THREAD_POOL_DEQUE];
+        Job records[THREAD_POOL_DEQUE];
+        unsigned cursor = 0;
+
+        WorkQueue() {
+            for (auto& s : slots) s.store(nullptr, std::memory_order_relaxed);
+        }
+
+        //owner only, the next record not in use. stolen jobs finish out of
+        //order, so one still running doesn't hold up the ones behind it.
+        //null when every record is in use
+        Job* record() {
+            for (int i = 0; i < THREAD_POOL_DEQUE; i++) {
+                Job* job = &records[cursor++ & (THREAD_POOL_DEQUE - 1)];
+                if (!job->busy.load(std::memory_order_acquire)) return job;
+            }
+            return nullptr;
+        }
+
+        //owner only
+        void push(Job* job) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            slots[b & (THREAD_POOL_DEQUE - 1)].store(job, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        //owner only, newest first
+        Job* pop() {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job* job = slots[b & (THREAD_POOL_DEQUE - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                //the last one, a thief may be taking it too
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        //any thread, oldest first
+        Job* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) return nullptr;
+            Job* job = slots[t & (THREAD_POOL_DEQUE - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+            return job;
+        }
+    };
+
+    struct SharedJob {
+        std::function<void()> fn;
+        JobCounter* counter = nullptr;
+    };
+
+    struct ForState {
+        const std::function<void(int, int)>* body = nullptr;
+        int grain = 0;
+        int count = 0;
+        int participants = 0;
+        std::atomic<int> next{ 0 };
+        std::atomic<int> done{ 0 };
+        std::atomic<int> users{ 0 };
+    };
+
+    //which queue of which pool the calling thread owns
+    struct ThreadSlot {
+        const ThreadPool* pool = nullptr;
+        int queue = -1;
+        unsigned random = 0;
+    };
+
+    static ThreadSlot& currentSlot() {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    //the calling thread's queue, or -1 when it has none here
+    int ownQueue() const {
+        ThreadSlot& slot = currentSlot();
+        if (slot.pool == this) return slot.queue;
+        if (std::this_thread::get_id() == owner) {
+            slot.pool = this;
+            slot.queue = 0;
+            return 0;
+        }
+        return -1;
+    }
+
+    static void pinThread(std::thread& thread, int core) {
+#ifdef _WIN32
+        SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)core;
+#endif
+    }
+
+    //queues without touching the counter, submit and then have counted already
+    void schedule(std::function<void()> job, JobCounter* counter, ForState* helps = nullptr) {
+        if (workers.empty()) {
+            job();
+            finish(counter);
+            return;
+        }
+        int own = ownQueue();
+        //a thread with every record in use spills into the shared ring, which grows
+        Job* record = own >= 0 ? queues[own]->record() : nullptr;
+        if (record) {
+            record->fn = std::move(job);
+            record->counter = counter;
+            record->helps = helps;
+            record->busy.store(true, std::memory_order_relaxed);
+            queues[own]->push(record);
+        } else {
+            std::lock_guard<std::mutex> lock(mutex);
+            pushShared(std::move(job), counter);
+        }
+        queued.fetch_add(1);
+        if (sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    //a job counted on counter has finished, the last one queues the continuation.
+    //whether there is one is part of the count, a counter that is done may be
+    //gone already and can't be looked at again
+    void finish(JobCounter* counter) {
+        if (!counter) return;
+        if (counter->pending.fetch_sub(1) != (JOB_COUNTER_CHAINED | 1)) return;
+        std::function<void()> job = std::move(counter->continuation);
+        counter->continuation = nullptr;
+        JobCounter* next = counter->continuationCounter;
+        counter->continuationCounter = nullptr;
+        counter->pending.fetch_and(~JOB_COUNTER_CHAINED);
+        schedule(std::move(job), next);
+    }
+
+    //own queue first, then the shared ring, then the other queues from a random one on
+    bool runOne() {
+        int own = ownQueue();
+        Job* job = own >= 0 ? queues[own]->pop() : nullptr;
+        if (!job && sharedCount.load(std::memory_order_relaxed) > 0) {
+            SharedJob taken;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (sharedCount > 0) {
+                    taken = std::move(shared[sharedHead]);
+                    shared[sharedHead] = SharedJob();
+                    sharedHead = (sharedHead + 1) % shared.size();
+                    sharedCount.store(sharedCount.load() - 1);
+                }
+            }
+            if (taken.fn) {
+                queued.fetch_sub(1);
+                taken.fn();
+                finish(taken.counter);
+                return true;
+            }
+        }
+        if (!job) {
+            ThreadSlot& slot = currentSlot();
+            slot.random = slot.random * 1664525u + 1013904223u;
+            int n = (int)queues.size();
+            int start = (int)((slot.random >> 8) % (unsigned)n);
+            for (int i = 0; i < n && !job; i++) {
+                int victim = (start + i) % n;
+                if (victim != own) job = queues[victim]->steal();
+            }
+        }
+        if (!job) return false;
+        queued.fetch_sub(1);
+        JobCounter* counter = job->counter;
+        job->fn();
+        job->fn = nullptr;
+        job->helps = nullptr;
+        job->busy.store(false, std::memory_order_release);
+        finish(counter);
+        return true;
+    }
+
+    //helpers nobody stole are still on top of the caller's queue once its
+    //parallelFor is done, they are dropped there instead of being left to
+    //wake a worker for nothing and hold on to the state until then
+    void reclaimHelpers(ForState* state) {
+        int own = ownQueue();
+        if (own < 0) return;
+        WorkQueue& queue = *queues[own];
+        while (Job* job = queue.pop()) {
+            if (job->helps != state) {
+                queue.push(job);
+                return;
+            }
+            queued.fetch_sub(1);
+            job->fn = nullptr;
+            job->helps = nullptr;
+            job->busy.store(false, std::memory_order_release);
+            leaveState(state);
+        }
+    }
+
+    //claims ranges of about remaining / (2 * participants) until none are left
+    void runChunks(ForState* state) {
+        TRACE_ZONE("parallelFor");
+        int begin = state->next.load();
+        for (;;) {
+            if (begin >= state->count) return;
+            int size = (state->count - begin) / (2 * state->participants);
+            if (size < state->grain) size = state->grain;
+            int end = begin + size < state->count ? begin + size : state->count;
+            if (!state->next.compare_exchange_weak(begin, end)) continue;
+            (*state->body)(begin, end);
+            state->done.fetch_add(end - begin);
+            begin = state->next.load();
+        }
+    }
+
+    ForState* acquireState() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeStates.empty()) {
+            states.emplace_back(new ForState());
+            return states.back().get();
+        }
+        ForState* state = freeStates.back();
+        freeStates.pop_back();
+        return state;
+    }
+
+    void leaveState(ForState* state) {
+        if (state->users.fetch_sub(1) != 1) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        freeStates.push_back(state);
+    }
+
+    //call with the mutex held, the ring doubles when full
+    void pushShared(std::function<void()> job, JobCounter* counter) {
+        size_t count = sharedCount.load();
+        if (count == shared.size()) {
+            std::vector<SharedJob> grown(shared.empty() ? 16 : shared.size() * 2);
+            for (size_t i = 0; i < count; i++) grown[i] = std::move(shared[(sharedHead + i) % shared.size()]);
+            shared.swap(grown);
+            sharedHead = 0;
+        }
+        SharedJob& slot = shared[(sharedHead + count) % shared.size()];
+        slot.fn = std::move(job);
+        slot.counter = counter;
+        sharedCount.store(count + 1);
+    }
+
+    void workerLoop(int queue) {
+        char name[32];
+        SDL_snprintf(name, sizeof(name), "worker %d", queue);
+        TraceSetThreadName(name);
+        ThreadSlot& slot = currentSlot();
+        slot.pool = this;
+        slot.queue = queue;
+        slot.random = (unsigned)queue * 2654435761u;
+        for (;;) {
+            bool ran = false;
+            for (int spin = 0; spin < THREAD_POOL_SPINS && !ran; spin++) {
+                ran = runOne();
+                if (!ran) std::this_thread::yield();
+            }
+            if (ran) continue;
+            //a submit after the check below sees sleeping and notifies under the mutex
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.fetch_add(1);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+    std::thread::id owner;
+    std::vector<std::unique_ptr<WorkQueue>> queues; //0 is the owner's, then one a worker
+    std::vector<std::thread> workers;
+    std::vector<SharedJob> shared;
+    size_t sharedHead = 0;
+    std::atomic<size_t> sharedCount{ 0 }; //written under the mutex, peeked at without it
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> sleeping{ 0 };
+    std::vector<std::unique_ptr<ForState>> states;
+    std::vector<ForState*> freeStates;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+struct ThreadPoolSettings {
+    int threads = 0; //0 for one a core
+    bool pin = false;
+};
+
+inline ThreadPoolSettings& ThreadPoolConfig()
+{
+    static ThreadPoolSettings settings;
+    return settings;
+}
+
+//--threads N counts the caller too, --threads 1 runs everything on it.
+//--pin pins the workers. call before anything uses GlobalThreadPool
+inline void ThreadPoolConfigure(int argc, char* argv[])
+{
+    ThreadPoolSettings& s = ThreadPoolConfig();
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--threads") == 0 && i + 1 < argc) s.threads = SDL_atoi(argv[++i]);
+        else if (SDL_strcmp(argv[i], "--pin") == 0) s.pin = true;
+    }
+}
+
+//shared pool, created on first use
+inline ThreadPool& GlobalThreadPool()
+{
+    static ThreadPool pool(ThreadPoolConfig().threads - 1, ThreadPoolConfig().pin);
+    return pool;
+}
+
+//runs work on pools of 1, 2, 4 ... threads up to every core, or --threads
+//when that is more, and logs the time and speedup over one thread
+inline void ThreadPoolScaling(const char* label, const std::function<void(ThreadPool&)>& work)
+{
+    int cores = SDL_GetNumLogicalCPUCores();
+    int most = ThreadPoolConfig().threads > cores ? ThreadPoolConfig().threads : cores;
+    double serial = 0.0;
+    for (int threads = 1;; threads = threads * 2 < most ? threads * 2 : most) {
+        ThreadPool pool(threads - 1, ThreadPoolConfig().pin);
+        work(pool);
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < THREAD_POOL_SCALING_REPS; i++) work(pool);
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / THREAD_POOL_SCALING_REPS;
+        if (threads == 1) serial = ms;
+        double speedup = ms > 0.0 ? serial / ms : 0.0;
+        SDL_Log("Scaling: %s on %d of %d cores: %.3f ms, x%.2f, %.0f%% efficiency", label, threads, cores, ms, speedup, speedup * 100.0 / threads);
+        if (threads == most) break;
+    }
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+//scoped trace zones for chrome://tracing and ui.perfetto.dev. TRACE_ZONE("name")
+//records the rest of the block as one complete event into a ring owned by the
+//calling thread. the owner is the only writer, so recording takes no lock,
+//and a full ring overwrites its oldest events: a long session keeps the last
+//TRACE_RING_EVENTS per thread. tracing is off until --trace file.json is
+//passed to TraceConfigure and a zone costs one branch until then. the file is
+//written on TRACE_KEY and again by TraceShutdown. zone names have to outlive
+//the trace, string literals and __func__ do. define TRACE_DISABLED to
+//compile the zones out
+
+#define TRACE_RING_EVENTS 65536 //power of two
+#define TRACE_KEY SDLK_F4
+
+struct TraceEvent {
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+};
+
+struct TraceRing {
+    TraceEvent events[TRACE_RING_EVENTS];
+    std::atomic<uint64_t> written{ 0 };
+    int thread = 0;
+    char name[32] = "";
+};
+
+struct TraceState {
+    std::atomic<bool> enabled{ false };
+    const char* path = NULL;
+    Uint64 origin = 0;
+    std::mutex mutex; //ring list, recording only takes it for a thread's first event
+    std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+inline TraceState& Trace()
+{
+    static TraceState state;
+    return state;
+}
+
+inline bool TraceEnabled()
+{
+    return Trace().enabled.load(std::memory_order_relaxed);
+}
+
+//the calling thread's name as it shows in the viewer, set it before the thread's first zone
+inline char* TraceThreadName()
+{
+    static thread_local char name[32] = "";
+    return name;
+}
+
+inline void TraceSetThreadName(const char* name)
+{
+    SDL_strlcpy(TraceThreadName(), name, 32);
+}
+
+//made on a thread's first event and kept after it exits so its events still get written
+inline TraceRing* TraceThreadRing()
+{
+    static thread_local TraceRing* ring = nullptr;
+    if (ring) return ring;
+    TraceState& trace = Trace();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    trace.rings.emplace_back(new TraceRing());
+    ring = trace.rings.back().get();
+    ring->thread = (int)trace.rings.size();
+    SDL_strlcpy(ring->name, TraceThreadName(), sizeof(ring->name));
+    return ring;
+}
+
+inline void TraceRecord(const char* name, Uint64 start, Uint64 end)
+{
+    TraceRing* ring = TraceThreadRing();
+    uint64_t n = ring->written.load(std::memory_order_relaxed);
+    TraceEvent& e = ring->events[n & (TRACE_RING_EVENTS - 1)];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    ring->written.store(n + 1, std::memory_order_release);
+}
+
+inline void TraceWriteString(SDL_IOStream* io, const char* s)
+{
+    SDL_WriteIO(io, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') SDL_WriteIO(io, "\\", 1);
+        if ((unsigned char)*s >= 0x20) SDL_WriteIO(io, s, 1);
+    }
+    SDL_WriteIO(io, "\"", 1);
+}
+
+//snapshot of every ring as a trace event json file, the threads keep recording.
+//a ring is copied between two reads of its counter and whatever the owner may
+//have overwritten in the meantime is dropped
+inline bool TraceWrite(const char* path)
+{
+    TraceState& trace = Trace();
+    SDL_IOStream* io = SDL_IOFromFile(path, "w");
+    if (!io) {
+        SDL_Log("Couldn't write trace %s: %s", path, SDL_GetError());
+        return false;
+    }
+    double usPerTick = 1e6 / SDL_GetPerformanceFrequency();
+    std::vector<TraceEvent> events;
+    size_t total = 0;
+    bool first = true;
+    SDL_IOprintf(io, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    for (const std::unique_ptr<TraceRing>& ring : trace.rings) {
+        uint64_t end = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+        events.clear();
+        for (uint64_t i = begin; i < end; i++) events.push_back(ring->events[i & (TRACE_RING_EVENTS - 1)]);
+        uint64_t now = ring->written.load(std::memory_order_acquire);
+        size_t stale = now > TRACE_RING_EVENTS && now - TRACE_RING_EVENTS > begin ? (size_t)(now - TRACE_RING_EVENTS - begin) : 0;
+        if (stale > events.size()) stale = events.size();
+
+        SDL_IOprintf(io, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", ring->thread);
+        char fallback[32];
+        SDL_snprintf(fallback, sizeof(fallback), "thread %d", ring->thread);
+        TraceWriteString(io, ring->name[0] ? ring->name : fallback);
+        SDL_IOprintf(io, "}}");
+        first = false;
+        for (size_t i = stale; i < events.size(); i++) {
+            const TraceEvent& e = events[i];
+            SDL_IOprintf(io, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", ring->thread,
+                (double)(Sint64)(e.start - trace.origin) * usPerTick, (double)(e.end - e.start) * usPerTick);
+            TraceWriteString(io, e.name);
+            SDL_IOprintf(io, "}");
+        }
+        total += events.size() - stale;
+    }
+    SDL_IOprintf(io, "\n]}\n");
+    bool ok = SDL_CloseIO(io);
+    if (ok) SDL_Log("Trace: wrote %d events from %d threads to %s", (int)total, (int)trace.rings.size(), path);
+    return ok;
+}
+
+//--trace file.json turns tracing on, call first thing in SDL_AppInit
+inline void TraceConfigure(int argc, char* argv[])
+{
+    TraceState& trace = Trace();
+    for (int i = 1; i + 1 < argc; i++)
+        if (SDL_strcmp(argv[i], "--trace") == 0) trace.path = argv[++i];
+    if (!trace.path) return;
+    trace.origin = SDL_GetPerformanceCounter();
+    TraceSetThreadName("main");
+    trace.enabled.store(true);
+}
+
+//writes the trace on TRACE_KEY, true when the event was used
+inline bool TraceHandleEvent(const SDL_Event* event)
+{
+    if (!TraceEnabled() || event->type != SDL_EVENT_KEY_DOWN || event->key.key != TRACE_KEY || event->key.repeat) return false;
+    TraceWrite(Trace().path);
+    return true;
+}
+
+//final write, for SDL_AppQuit
+inline void TraceShutdown()
+{
+    if (!TraceEnabled()) return;
+    TraceWrite(Trace().path);
+    Trace().enabled.store(false);
+}
+
+//innermost zone of the calling thread, alloc_tracker.h charges allocations to
+//it. only kept in ALLOC_TRACKING builds
+inline const char*& TraceCurrentZone()
+{
+    static thread_local const char* zone = nullptr;
+    return zone;
+}
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name) : name(name), start(TraceEnabled() ? SDL_GetPerformanceCounter() : 0) {
+#if defined(ALLOC_TRACKING)
+        parent = TraceCurrentZone();
+        TraceCurrentZone() = name;
+#endif
+    }
+    ~TraceZone() {
+        if (start) TraceRecord(name, start, SDL_GetPerformanceCounter());
+#if defined(ALLOC_TRACKING)
+        TraceCurrentZone() = parent;
+#endif
+    }
+
+private:
+    const char* name;
+    Uint64 start;
+#if defined(ALLOC_TRACKING)
+    const char* parent;
+#endif
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if defined(TRACE_DISABLED)
+#define TRACE_ZONE(name) ((void)0)
+#else
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#endif
+#define TRACE_FUNCTION() TRACE_ZONE(__func__)
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "thread_pool.h"
+
+//kinematic car shared by the player and the traffic: turn, then move along
+//the heading (angle 0 drives towards +x, angle pi/2 towards -z).
+//throttle and steer in -1..1, speeds per 1/60 s like processInput
+inline void CarKinematicStep(float* x, float* z, float* angle, float throttle, float steer, float moveSpeed, float turnSpeed)
+{
+    const float twoPi = 6.28318531f;
+    *angle += steer * turnSpeed;
+    if (*angle >= twoPi) *angle -= twoPi;
+    if (*angle < 0.0f) *angle += twoPi;
+    *x += moveSpeed * throttle * cosf(*angle);
+    *z -= moveSpeed * throttle * sinf(*angle);
+}
+
+//ai traffic on a square road grid, one road every blockSize units in x and z
+//with a lane per direction (right-hand traffic). cars steer at a point a bit
+//ahead on their lane and pick a new direction at every intersection.
+//they slow down for whatever is in front of them in their lane, found
+//through a spatial hash rebuilt every step, and yield to crossing cars with
+//a lower index so waiting chains can not loop (cars stuck for too long stop
+//yielding). all per-car state is in flat arrays, a step reads the old
+//positions and writes new ones, so cars update in parallel chunks in any order.
+
+struct TrafficSettings {
+    int cars;
+    int gridSize;         //intersections per side
+    float blockSize;
+    float laneOffset;     //lane center from the road center
+    float moveSpeed;      //at full throttle, per step
+    float turnSpeed;      //radians per step
+    float followDistance; //start braking for a car this far ahead
+    float minGap;         //stop this far behind it
+    uint32_t seed;
+};
+
+class TrafficSim {
+public:
+    void init(const TrafficSettings& settings) {
+        this->settings = settings;
+        int n = settings.cars;
+        posX.resize(n); posZ.resize(n); angle.resize(n); speed.resize(n);
+        nextX.resize(n); nextZ.resize(n); nextAngle.resize(n); nextSpeed.resize(n);
+        cruise.resize(n); fromX.resize(n); fromZ.resize(n); dir.resize(n);
+        rng.resize(n); stuck.resize(n);
+
+        //spread the cars over every lane of the grid
+        uint32_t state = settings.seed ? settings.seed : 1u;
+        for (int i = 0; i < n; i++) {
+            rng[i] = random(&state) | 1u;
+            fromX[i] = (int)(random(&state) % (uint32_t)settings.gridSize);
+            fromZ[i] = (int)(random(&state) % (uint32_t)settings.gridSize);
+            dir[i] = (uint8_t)(random(&state) % 4);
+            if (!validDir(fromX[i], fromZ[i], dir[i])) dir[i] = (uint8_t)((dir[i] + 2) % 4);
+
+            float along = (random(&state) % 1000) / 1000.0f * settings.blockSize * 0.8f;
+            float lx, lz;
+            lanePoint(i, along, &lx, &lz);
+            posX[i] = lx;
+            posZ[i] = lz;
+            angle[i] = dir[i] * 1.57079633f;
+            cruise[i] = 0.7f + (random(&state) % 1000) / 1000.0f * 0.3f;
+            speed[i] = 0.0f;
+            stuck[i] = 0;
+        }
+
+        int buckets = 1;
+        while (buckets < n * 2) buckets *= 2;
+        bucketMask = (uint32_t)buckets - 1;
+        bucketStart.resize(buckets + 1);
+        bucketOf.resize(n);
+        sorted.resize(n);
+        steps = 0;
+    }
+
+    //advances every car by one 1/60 s step, serially when pool is null
+    void step(ThreadPool* pool) {
+        int n = settings.cars;
+        buildHash();
+        if (pool) {
+            pool->parallelFor(n, 1024, [this](int begin, int end) {
+                for (int i = begin; i < end; i++) updateCar(i);
+            });
+        }
+        else {
+            for (int i = 0; i < n; i++) updateCar(i);
+        }
+        posX.swap(nextX);
+        posZ.swap(nextZ);
+        angle.swap(nextAngle);
+        speed.swap(nextSpeed);
+        steps++;
+    }
+
+    int count() const { return settings.cars; }
+    uint64_t stepCount() const { return steps; }
+    float x(int i) const { return posX[i]; }
+    float z(int i) const { return posZ[i]; }
+    float heading(int i) const { return angle[i]; }
+
+private:
+    static uint32_t random(uint32_t* state) {
+        uint32_t s = *state;
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        *state = s;
+        return s;
+    }
+
+    //directions follow the heading angle: +x, -z, -x, +z
+    static int dirX(int d) { return d == 0 ? 1 : d == 2 ? -1 : 0; }
+    static int dirZ(int d) { return d == 1 ? -1 : d == 3 ? 1 : 0; }
+
+    bool validDir(int nodeX, int nodeZ, int d) const {
+        int nx = nodeX + dirX(d), nz = nodeZ + dirZ(d);
+        return nx >= 0 && nz >= 0 && nx < settings.gridSize && nz < settings.gridSize;
+    }
+
+    //point on car i's lane, along units past its last intersection
+    void lanePoint(int i, float along, float* outX, float* outZ) const {
+        int d = dir[i];
+        float rightX = (float)-dirZ(d), rightZ = (float)dirX(d);
+        *outX = fromX[i] * settings.blockSize + rightX * settings.laneOffset + dirX(d) * along;
+        *outZ = fromZ[i] * settings.blockSize + rightZ * settings.laneOffset + dirZ(d) * along;
+    }
+
+    uint32_t bucket(float x, float z) const {
+        int cx = (int)floorf(x / settings.followDistance), cz = (int)floorf(z / settings.followDistance);
+        uint32_t h = (uint32_t)cx * 73856093u ^ (uint32_t)cz * 19349663u;
+        return h & bucketMask;
+    }
+
+    //counting sort of the cars by bucket
+    void buildHash() {
+        int n = settings.cars;
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for (int i = 0; i < n; i++) {
+            bucketOf[i] = bucket(posX[i], posZ[i]);
+            bucketStart[bucketOf[i] + 1]++;
+        }
+        for (size_t b = 1; b < bucketStart.size(); b++) bucketStart[b] += bucketStart[b - 1];
+        cursor.assign(bucketStart.begin(), bucketStart.end() - 1);
+        for (int i = 0; i < n; i++) sorted[cursor[bucketOf[i]]++] = i;
+    }
+
+    void updateCar(int i) {
+        float x = posX[i], z = posZ[i], a = angle[i];
+        float hx = cosf(a), hz = -sinf(a);
+
+        //past the turn point pick the next road, no u-turns unless it is a dead end
+        int d = dir[i];
+        float along = (x - fromX[i] * settings.blockSize) * dirX(d) + (z - fromZ[i] * settings.blockSize) * dirZ(d);
+        if (along > settings.blockSize - settings.laneOffset * 2.0f) {
+            int nodeX = fromX[i] + dirX(d), nodeZ = fromZ[i] + dirZ(d);
+            uint32_t r = random(&rng[i]) % 10;
+            int turn = r < 6 ? 0 : r < 8 ? 1 : 3;
+            const int order[4] = { turn, 0, 1, 3 };
+            int next = (d + 2) % 4;
+            for (int k = 0; k < 4; k++) {
+                if (validDir(nodeX, nodeZ, (d + order[k]) % 4)) {
+                    next = (d + order[k]) % 4;
+                    break;
+                }
+            }
+            fromX[i] = nodeX;
+            fromZ[i] = nodeZ;
+            dir[i] = (uint8_t)next;
+            d = next;
+            along = (x - fromX[i] * settings.blockSize) * dirX(d) + (z - fromZ[i] * settings.blockSize) * dirZ(d);
+        }
+
+        //steer at a point a little ahead on the lane
+        float tx, tz;
+        lanePoint(i, std::max(along, 0.0f) + 3.0f, &tx, &tz);
+        float want = atan2f(-(tz - z), tx - x);
+        float diff = want - a;
+        while (diff > 3.14159265f) diff -= 6.28318531f;
+        while (diff < -3.14159265f) diff += 6.28318531f;
+        float steer = std::min(std::max(diff / settings.turnSpeed, -1.0f), 1.0f);
+
+        //brake for the closest car in the way
+        float limit = cruise[i] * (fabsf(steer) > 0.5f ? 0.6f : 1.0f);
+        bool yieldCrossing = stuck[i] < 180;
+        for (int oz = -1; oz <= 1; oz++) {
+            for (int ox = -1; ox <= 1; ox++) {
+                uint32_t b = bucket(x + ox * settings.followDistance, z + oz * settings.followDistance);
+                for (int k = bucketStart[b]; k < bucketStart[b + 1]; k++) {
+                    int j = sorted[k];
+                    if (j == i) continue;
+                    float rx = posX[j] - x, rz = posZ[j] - z;
+                    float ahead = rx * hx + rz * hz;
+                    if (ahead <= 0.0f || ahead >= settings.followDistance) continue;
+                    if (fabsf(rx * hz - rz * hx) > settings.laneOffset * 0.8f) continue;
+                    float facing = cosf(angle[j]) * hx - sinf(angle[j]) * hz;
+                    if (facing < -0.5f) continue;
+                    if (facing < 0.5f && (j > i || !yieldCrossing)) continue;
+                    float room = (ahead - settings.minGap) / (settings.followDistance - settings.minGap);
+                    limit = std::min(limit, std::max(room, 0.0f) * cruise[i]);
+                }
+            }
+        }
+
+        //brake at once, pick up speed gently
+        float s = speed[i];
+        s = limit < s ? limit : std::min(limit, s + 0.02f);
+        stuck[i] = s < 0.05f ? stuck[i] + 1 : 0;
+
+        CarKinematicStep(&x, &z, &a, s, steer, settings.moveSpeed, settings.turnSpeed);
+        nextX[i] = x;
+        nextZ[i] = z;
+        nextAngle[i] = a;
+        nextSpeed[i] = s;
+    }
+
+    TrafficSettings settings = {};
+    uint64_t steps = 0;
+
+    //read by neighbours, double buffered
+    std::vector<float> posX, posZ, angle, speed;
+    std::vector<float> nextX, nextZ, nextAngle, nextSpeed;
+    //only touched by the car itself
+    std::vector<float> cruise;
+    std::vector<int> fromX, fromZ;
+    std::vector<uint8_t> dir;
+    std::vector<uint32_t> rng;
+    std::vector<int> stuck;
+
+    uint32_t bucketMask = 0;
+    std::vector<int> bucketStart;
+    std::vector<int> cursor;
+    std::vector<uint32_t> bucketOf;
+    std::vector<int> sorted;
+};
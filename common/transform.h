@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "math3d.h"
+#include "thread_pool.h"
+
+#define TRANSFORM_NONE UINT32_MAX
+
+//parent/child transforms with cached world matrices. local translation,
+//rotation and scale sit in flat per-component arrays, the setters only queue
+//the node, and update() recomputes the queued nodes and everything below
+//them: first the local matrices four at a time, then world = parent * local
+//in id order. a parent is always created before its children, so id order is
+//already a topological order and a static scene costs nothing per frame
+class TransformHierarchy {
+public:
+    void reserve(size_t n) {
+        px.reserve(n); py.reserve(n); pz.reserve(n);
+        rx.reserve(n); ry.reserve(n); rz.reserve(n); rw.reserve(n);
+        sx.reserve(n); sy.reserve(n); sz.reserve(n);
+        parents.reserve(n); firstChild.reserve(n); nextSibling.reserve(n);
+        state.reserve(n); worlds.reserve(n);
+    }
+
+    void clear() {
+        *this = TransformHierarchy();
+    }
+
+    //identity transform below parent (or a root)
+    uint32_t create(uint32_t parent = TRANSFORM_NONE) {
+        uint32_t id = (uint32_t)parents.size();
+        px.push_back(0.0f); py.push_back(0.0f); pz.push_back(0.0f);
+        rx.push_back(0.0f); ry.push_back(0.0f); rz.push_back(0.0f); rw.push_back(1.0f);
+        sx.push_back(1.0f); sy.push_back(1.0f); sz.push_back(1.0f);
+        parents.push_back(TRANSFORM_NONE);
+        firstChild.push_back(TRANSFORM_NONE);
+        nextSibling.push_back(TRANSFORM_NONE);
+        state.push_back(0);
+        worlds.push_back(Mat4Identity());
+        if (parent != TRANSFORM_NONE) link(id, parent);
+        markDirty(id);
+        return id;
+    }
+
+    size_t count() const { return parents.size(); }
+    uint32_t parent(uint32_t id) const { return parents[id]; }
+
+    //only parents created earlier keep id order topological, anything else is refused
+    bool setParent(uint32_t id, uint32_t parent) {
+        if (parent != TRANSFORM_NONE && parent >= id) return false;
+        if (parents[id] == parent) return true;
+        unlink(id);
+        if (parent != TRANSFORM_NONE) link(id, parent);
+        markDirty(id);
+        return true;
+    }
+
+    void setPosition(uint32_t id, Vec3 p) {
+        px[id] = p.x; py[id] = p.y; pz[id] = p.z;
+        markDirty(id);
+    }
+
+    void setRotation(uint32_t id, Quat q) {
+        rx[id] = q.x; ry[id] = q.y; rz[id] = q.z; rw[id] = q.w;
+        markDirty(id);
+    }
+
+    void setScale(uint32_t id, Vec3 s) {
+        sx[id] = s.x; sy[id] = s.y; sz[id] = s.z;
+        markDirty(id);
+    }
+
+    void setLocal(uint32_t id, Vec3 p, Quat q, Vec3 s) {
+        px[id] = p.x; py[id] = p.y; pz[id] = p.z;
+        rx[id] = q.x; ry[id] = q.y; rz[id] = q.z; rw[id] = q.w;
+        sx[id] = s.x; sy[id] = s.y; sz[id] = s.z;
+        markDirty(id);
+    }
+
+    Vec3 position(uint32_t id) const { return MakeVec3(px[id], py[id], pz[id]); }
+    Vec3 scale(uint32_t id) const { return MakeVec3(sx[id], sy[id], sz[id]); }
+
+    Quat rotation(uint32_t id) const {
+        Quat q = { rx[id], ry[id], rz[id], rw[id] };
+        return q;
+    }
+
+    //as of the last update()
+    const Mat4& world(uint32_t id) const { return worlds[id]; }
+    const Mat4* worldMatrices() const { return worlds.data(); }
+
+    //recomputes the queued nodes and their subtrees, returns how many.
+    //with nothing queued it returns at once, so calling it every frame is free
+    size_t update(ThreadPool* pool = nullptr) {
+        if (dirtyRoots.empty()) return 0;
+        //walking the subtrees pays off while they are a small part of the
+        //scene, past that one pass in id order pushes the flag down instead
+        size_t n = parents.size(), budget = n / 16;
+        bool dense = false;
+        work.clear();
+        std::vector<uint32_t>& stack = scratch;
+        for (size_t r = 0; r < dirtyRoots.size() && !dense; r++) {
+            stack.assign(1, dirtyRoots[r]);
+            while (!stack.empty() && !dense) {
+                uint32_t id = stack.back();
+                stack.pop_back();
+                if (state[id] & COLLECTED) continue;
+                state[id] = COLLECTED;
+                work.push_back(id);
+                for (uint32_t c = firstChild[id]; c != TRANSFORM_NONE; c = nextSibling[c]) stack.push_back(c);
+                dense = work.size() > budget;
+            }
+        }
+
+        if (dense) {
+            for (uint32_t root : dirtyRoots) state[root] = COLLECTED;
+            work.clear();
+            for (size_t id = 0; id < n; id++) {
+                uint32_t parent = parents[id];
+                if (parent != TRANSFORM_NONE && (state[parent] & COLLECTED)) state[id] = COLLECTED;
+                if (state[id] & COLLECTED) work.push_back((uint32_t)id);
+            }
+        }
+        else {
+            std::sort(work.begin(), work.end());
+        }
+        dirtyRoots.clear();
+        for (uint32_t id : work) state[id] = 0;
+        compose(work.data(), work.size(), pool);
+        return work.size();
+    }
+
+    //every node from scratch, for comparisons
+    size_t updateAll(ThreadPool* pool = nullptr) {
+        for (uint32_t id : dirtyRoots) state[id] = 0;
+        dirtyRoots.clear();
+        work.resize(parents.size());
+        for (size_t id = 0; id < work.size(); id++) work[id] = (uint32_t)id;
+        compose(work.data(), work.size(), pool);
+        return work.size();
+    }
+
+private:
+    enum : uint8_t { QUEUED = 1, COLLECTED = 2 };
+
+    void markDirty(uint32_t id) {
+        if (state[id] & QUEUED) return;
+        state[id] |= QUEUED;
+        dirtyRoots.push_back(id);
+    }
+
+    //new children go first, sibling order does not matter for anything
+    void link(uint32_t id, uint32_t parent) {
+        parents[id] = parent;
+        nextSibling[id] = firstChild[parent];
+        firstChild[parent] = id;
+    }
+
+    void unlink(uint32_t id) {
+        uint32_t parent = parents[id];
+        if (parent == TRANSFORM_NONE) return;
+        uint32_t* link = &firstChild[parent];
+        while (*link != id) link = &nextSibling[*link];
+        *link = nextSibling[id];
+        nextSibling[id] = TRANSFORM_NONE;
+        parents[id] = TRANSFORM_NONE;
+    }
+
+    //ids ascending: locals are independent and go wide, the parent products
+    //then run in order since a parent always comes before its children
+    void compose(const uint32_t* ids, size_t count, ThreadPool* pool) {
+        auto locals = [this, ids](int begin, int end) {
+            int i = begin;
+#if defined(MATH3D_SSE)
+            for (; i + 4 <= end; i += 4) localBatch(ids + i);
+#endif
+            for (; i < end; i++) {
+                uint32_t id = ids[i];
+                worlds[id] = Mat4Trs(position(id), rotation(id), scale(id));
+            }
+        };
+        if (pool && count >= 4096) pool->parallelFor((int)count, 1024, locals);
+        else locals(0, (int)count);
+
+        for (size_t i = 0; i < count; i++) {
+            uint32_t id = ids[i], parent = parents[id];
+            if (parent != TRANSFORM_NONE) worlds[id] = Mat4Mul(worlds[parent], worlds[id]);
+        }
+    }
+
+#if defined(MATH3D_SSE)
+    //Mat4Trs for four nodes at once, one lane per node, transposed on the way out
+    void localBatch(const uint32_t* ids) {
+        uint32_t a = ids[0], b = ids[1], c = ids[2], d = ids[3];
+        __m128 x = _mm_setr_ps(rx[a], rx[b], rx[c], rx[d]);
+        __m128 y = _mm_setr_ps(ry[a], ry[b], ry[c], ry[d]);
+        __m128 z = _mm_setr_ps(rz[a], rz[b], rz[c], rz[d]);
+        __m128 w = _mm_setr_ps(rw[a], rw[b], rw[c], rw[d]);
+        __m128 scaleX = _mm_setr_ps(sx[a], sx[b], sx[c], sx[d]);
+        __m128 scaleY = _mm_setr_ps(sy[a], sy[b], sy[c], sy[d]);
+        __m128 scaleZ = _mm_setr_ps(sz[a], sz[b], sz[c], sz[d]);
+        __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 c0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX),
+            zero,
+        };
+        __m128 c1[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY),
+            zero,
+        };
+        __m128 c2[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ),
+            zero,
+        };
+        __m128 c3[4] = {
+            _mm_setr_ps(px[a], px[b], px[c], px[d]),
+            _mm_setr_ps(py[a], py[b], py[c], py[d]),
+            _mm_setr_ps(pz[a], pz[b], pz[c], pz[d]),
+            one,
+        };
+        __m128* columns[4] = { c0, c1, c2, c3 };
+        for (int col = 0; col < 4; col++) {
+            __m128* v = columns[col];
+            _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+            _mm_storeu_ps(worlds[a].m + col * 4, v[0]);
+            _mm_storeu_ps(worlds[b].m + col * 4, v[1]);
+            _mm_storeu_ps(worlds[c].m + col * 4, v[2]);
+            _mm_storeu_ps(worlds[d].m + col * 4, v[3]);
+        }
+    }
+#endif
+
+    std::vector<float> px, py, pz;
+    std::vector<float> rx, ry, rz, rw;
+    std::vector<float> sx, sy, sz;
+    std::vector<uint32_t> parents, firstChild, nextSibling;
+    std::vector<uint8_t> state;
+    std::vector<Mat4> worlds;
+    std::vector<uint32_t> dirtyRoots;
+    std::vector<uint32_t> work;
+    std::vector<uint32_t> scratch;
+};
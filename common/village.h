@@ -0,0 +1,663 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "core_renderer.h"
+#include "gl_shader.h"
+#include "spatial_index.h"
+#include "thread_pool.h"
+
+//procedural village of house3d houses. every house is one instance of a
+//shared unit mesh (walls and floor in a 1x1x1 box, pyramid roof on top)
+//scaled, rotated, moved and colored by its per-instance attributes.
+//houses pick a level of detail from their size on screen, down to an
+//impostor quad and finally nothing, so the vertex count levels off as the
+//village grows. every level goes out in one instanced draw with the
+//CoreRenderer's camera, if the house programs don't link the meshes are
+//expanded on the cpu into one batch of the renderer's immediate mode.
+
+//layout of the per-instance vertex attributes
+struct HouseInstance {
+    float x, z, rotation, unused; //rotation in radians around +y, like glRotatef
+    float width, height, depth, roofHeight;
+    unsigned char wallColor[4];
+    unsigned char roofColor[4];
+};
+
+struct VillageSettings {
+    int houses;
+    float lotSize; //houses sit on a square grid of lots this wide
+    uint32_t seed;
+};
+
+//unit house: x and z in -0.5..0.5, y 0..1 scaled by height for the walls and
+//by roofHeight above the walls for the roof
+#define HOUSE_PART_WALL 0.0f
+#define HOUSE_PART_FLOOR 1.0f
+#define HOUSE_PART_ROOF 2.0f
+#define HOUSE_PART_WINDOW 3.0f
+#define HOUSE_PART_DOOR 4.0f
+
+struct HouseMeshVertex {
+    float x, y, z, part;
+};
+
+//levels of detail, picked per house from its size on screen
+enum HouseLod {
+    HOUSE_LOD_FULL,     //walls, floor, roof, door and windows
+    HOUSE_LOD_SIMPLE,   //box and roof
+    HOUSE_LOD_IMPOSTOR, //camera facing quad from the impostor atlas
+    HOUSE_LOD_HIDDEN,   //smaller than a couple of pixels
+    HOUSE_LOD_COUNT
+};
+
+//the meshes of the first three levels back to back. the impostor is two quads
+//spanning x -1..1 and y 0..1, one for the walls and one (part roof) for the
+//roof band above them. first[lod] and count[lod] index into vertices
+struct HouseMeshes {
+    std::vector<HouseMeshVertex> vertices;
+    int first[HOUSE_LOD_HIDDEN];
+    int count[HOUSE_LOD_HIDDEN];
+};
+
+inline void HouseQuad(std::vector<HouseMeshVertex>& out, const float* a, const float* b, const float* c, const float* d, float part)
+{
+    const float* corners[6] = { a, b, c, a, c, d };
+    for (const float* p : corners) {
+        HouseMeshVertex v = { p[0], p[1], p[2], part };
+        out.push_back(v);
+    }
+}
+
+inline void HouseBox(std::vector<HouseMeshVertex>& out, bool floor)
+{
+    const float fl[3] = { -0.5f, 0.0f, 0.5f }, fr[3] = { 0.5f, 0.0f, 0.5f }, bl[3] = { -0.5f, 0.0f, -0.5f }, br[3] = { 0.5f, 0.0f, -0.5f };
+    const float flt[3] = { -0.5f, 1.0f, 0.5f }, frt[3] = { 0.5f, 1.0f, 0.5f }, blt[3] = { -0.5f, 1.0f, -0.5f }, brt[3] = { 0.5f, 1.0f, -0.5f };
+    HouseQuad(out, fl, fr, frt, flt, HOUSE_PART_WALL);
+    HouseQuad(out, bl, br, brt, blt, HOUSE_PART_WALL);
+    HouseQuad(out, fl, bl, blt, flt, HOUSE_PART_WALL);
+    HouseQuad(out, fr, br, brt, frt, HOUSE_PART_WALL);
+    if (floor) HouseQuad(out, fl, fr, br, bl, HOUSE_PART_FLOOR);
+
+    //pyramid roof, y 0 is the top of the walls
+    const float peak[3] = { 0.0f, 1.0f, 0.0f };
+    const float* eaves[4][2] = { { fl, fr }, { bl, br }, { fl, bl }, { fr, br } };
+    for (int i = 0; i < 4; i++) {
+        const float* tri[3] = { eaves[i][0], peak, eaves[i][1] };
+        for (const float* p : tri) {
+            HouseMeshVertex v = { p[0], p == peak ? 1.0f : 0.0f, p[2], HOUSE_PART_ROOF };
+            out.push_back(v);
+        }
+    }
+}
+
+//a rectangle on a wall, just off its surface. u runs along the wall, v up
+inline void HouseWallPanel(std::vector<HouseMeshVertex>& out, int wall, float u0, float u1, float v0, float v1, float part)
+{
+    const float off = 0.51f;
+    float corners[4][3];
+    const float uv[4][2] = { { u0, v0 }, { u1, v0 }, { u1, v1 }, { u0, v1 } };
+    for (int i = 0; i < 4; i++) {
+        float u = uv[i][0], v = uv[i][1];
+        corners[i][1] = v;
+        if (wall == 0) { corners[i][0] = u; corners[i][2] = off; }       //front
+        else if (wall == 1) { corners[i][0] = u; corners[i][2] = -off; } //back
+        else if (wall == 2) { corners[i][0] = -off; corners[i][2] = u; } //left
+        else { corners[i][0] = off; corners[i][2] = u; }                 //right
+    }
+    HouseQuad(out, corners[0], corners[1], corners[2], corners[3], part);
+}
+
+inline const HouseMeshes& GetHouseMeshes()
+{
+    static const HouseMeshes meshes = [] {
+        HouseMeshes m;
+        m.first[HOUSE_LOD_FULL] = 0;
+        HouseBox(m.vertices, true);
+        HouseWallPanel(m.vertices, 0, -0.1f, 0.1f, 0.0f, 0.6f, HOUSE_PART_DOOR);
+        for (int wall = 0; wall < 2; wall++) {
+            HouseWallPanel(m.vertices, wall, -0.38f, -0.2f, 0.45f, 0.75f, HOUSE_PART_WINDOW);
+            HouseWallPanel(m.vertices, wall, 0.2f, 0.38f, 0.45f, 0.75f, HOUSE_PART_WINDOW);
+        }
+        HouseWallPanel(m.vertices, 2, -0.1f, 0.1f, 0.45f, 0.75f, HOUSE_PART_WINDOW);
+        HouseWallPanel(m.vertices, 3, -0.1f, 0.1f, 0.45f, 0.75f, HOUSE_PART_WINDOW);
+        m.count[HOUSE_LOD_FULL] = (int)m.vertices.size();
+
+        m.first[HOUSE_LOD_SIMPLE] = (int)m.vertices.size();
+        HouseBox(m.vertices, false);
+        m.count[HOUSE_LOD_SIMPLE] = (int)m.vertices.size() - m.first[HOUSE_LOD_SIMPLE];
+
+        m.first[HOUSE_LOD_IMPOSTOR] = (int)m.vertices.size();
+        const float q0[3] = { -1.0f, 0.0f, 0.0f }, q1[3] = { 1.0f, 0.0f, 0.0f }, q2[3] = { 1.0f, 1.0f, 0.0f }, q3[3] = { -1.0f, 1.0f, 0.0f };
+        HouseQuad(m.vertices, q0, q1, q2, q3, HOUSE_PART_WALL);
+        HouseQuad(m.vertices, q0, q1, q2, q3, HOUSE_PART_ROOF);
+        m.count[HOUSE_LOD_IMPOSTOR] = 12;
+        return m;
+    }();
+    return meshes;
+}
+
+//the single house house3d always drew
+inline HouseInstance DefaultHouse()
+{
+    HouseInstance h = { 0.0f, 0.0f, 0.0f, 0.0f, 5.0f, 3.0f, 5.0f, 3.0f, { 204, 153, 51, 255 }, { 230, 51, 26, 255 } };
+    return h;
+}
+
+inline uint32_t VillageHash(uint32_t seed, uint32_t index, uint32_t salt)
+{
+    uint32_t h = seed * 0x9e3779b9u ^ index * 0x85ebca6bu ^ salt * 0xc2b2ae35u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+inline float VillageRandom(uint32_t seed, uint32_t index, uint32_t salt)
+{
+    return (VillageHash(seed, index, salt) >> 8) / 16777216.0f;
+}
+
+//every house only depends on its index, so chunks can be generated on any thread
+inline void GenerateVillage(const VillageSettings& s, std::vector<HouseInstance>& out, ThreadPool* pool)
+{
+    static const unsigned char walls[6][3] = {
+        { 204, 153, 51 }, { 230, 220, 190 }, { 180, 90, 60 }, { 200, 200, 205 }, { 150, 170, 120 }, { 235, 200, 150 },
+    };
+    static const unsigned char roofs[4][3] = {
+        { 230, 51, 26 }, { 120, 60, 40 }, { 70, 70, 80 }, { 40, 90, 60 },
+    };
+    out.resize(s.houses);
+    int side = 1;
+    while (side * side < s.houses) side++;
+
+    auto generate = [&s, &out, side](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            uint32_t u = (uint32_t)i;
+            HouseInstance& h = out[i];
+            h.width = 4.0f + VillageRandom(s.seed, u, 1) * 3.0f;
+            h.depth = 4.0f + VillageRandom(s.seed, u, 2) * 3.0f;
+            h.height = 2.5f + VillageRandom(s.seed, u, 3) * 2.0f;
+            h.roofHeight = 1.5f + VillageRandom(s.seed, u, 4) * 2.0f;
+            //most houses face the street, some are turned any way
+            h.rotation = VillageRandom(s.seed, u, 5) < 0.8f ? (float)(VillageHash(s.seed, u, 6) % 4) * 1.57079633f
+                : VillageRandom(s.seed, u, 7) * 6.28318531f;
+            h.unused = 0.0f;
+
+            //jitter inside the lot as far as the footprint allows at any angle
+            float radius = sqrtf(h.width * h.width + h.depth * h.depth) * 0.5f;
+            float slack = s.lotSize * 0.5f - radius > 0.0f ? s.lotSize * 0.5f - radius : 0.0f;
+            h.x = ((i % side) - (side - 1) * 0.5f) * s.lotSize + (VillageRandom(s.seed, u, 8) * 2.0f - 1.0f) * slack;
+            h.z = ((i / side) - (side - 1) * 0.5f) * s.lotSize + (VillageRandom(s.seed, u, 9) * 2.0f - 1.0f) * slack;
+
+            const unsigned char* wall = walls[VillageHash(s.seed, u, 10) % 6];
+            const unsigned char* roof = roofs[VillageHash(s.seed, u, 11) % 4];
+            float shade = 0.85f + VillageRandom(s.seed, u, 12) * 0.15f;
+            for (int c = 0; c < 3; c++) {
+                h.wallColor[c] = (unsigned char)(wall[c] * shade);
+                h.roofColor[c] = roof[c];
+            }
+            h.wallColor[3] = h.roofColor[3] = 255;
+        }
+    };
+    if (pool) pool->parallelFor(s.houses, 4096, generate);
+    else generate(0, s.houses);
+}
+
+//box around the turned footprint, floor to roof peak
+inline Aabb HouseBounds(const HouseInstance& h)
+{
+    float c = fabsf(cosf(h.rotation)), s = fabsf(sinf(h.rotation));
+    float halfX = (c * h.width + s * h.depth) * 0.5f, halfZ = (s * h.width + c * h.depth) * 0.5f;
+    Aabb box = { { h.x - halfX, 0.0f, h.z - halfZ }, { h.x + halfX, h.height + h.roofHeight, h.z + halfZ } };
+    return box;
+}
+
+//the walls as an exact box, only for houses turned by a multiple of 90 degrees
+inline bool HouseWallBox(const HouseInstance& h, Aabb* box)
+{
+    float quarter = h.rotation / 1.57079633f;
+    int k = (int)floorf(quarter + 0.5f);
+    if (fabsf(quarter - k) > 1e-4f) return false;
+    float halfX = ((k & 1) ? h.depth : h.width) * 0.5f, halfZ = ((k & 1) ? h.width : h.depth) * 0.5f;
+    *box = AabbFromCenter(h.x, h.height * 0.5f, h.z, halfX, h.height * 0.5f, halfZ);
+    return true;
+}
+
+//screen sizes in pixels (bounding sphere diameter) where the level changes.
+//a house has to get hysteresis past a threshold before it switches back
+struct HouseLodSettings {
+    float simplePixels;
+    float impostorPixels;
+    float hiddenPixels;
+    float hysteresis;
+};
+
+inline HouseLodSettings DefaultHouseLodSettings()
+{
+    HouseLodSettings s = { 80.0f, 24.0f, 2.0f, 0.15f };
+    return s;
+}
+
+//level for a house of the given screen size that currently draws at current
+inline int SelectHouseLod(const HouseLodSettings& s, float pixels, int current)
+{
+    const float thresholds[3] = { s.simplePixels, s.impostorPixels, s.hiddenPixels };
+    int lod = 0;
+    for (int k = 0; k < 3; k++) {
+        float threshold = thresholds[k] * (current <= k ? 1.0f - s.hysteresis : 1.0f + s.hysteresis);
+        if (pixels < threshold) lod = k + 1;
+    }
+    return lod;
+}
+
+struct HouseDrawStats {
+    int houses[HOUSE_LOD_COUNT];
+    long long vertices;
+    int drawCalls;
+};
+
+//impostor atlas: one cell per view angle bucket around the house, seen from
+//the horizon like the house3d camera does. cells hold a color mask (red
+//walls, green roof, blue door and windows) that is tinted per instance.
+//the cells show the canonical house, any other proportions map onto it
+//exactly in these side-on views: a w x d footprint seen from a direction is
+//the square one seen from that direction squashed by (d, w), scaled by the
+//squashed length, and the walls and roof bands stretch to their own heights.
+//only the bucket angle is approximate
+#define HOUSE_IMPOSTOR_BUCKETS 16
+#define HOUSE_IMPOSTOR_COLUMNS 4
+#define HOUSE_IMPOSTOR_CELL 64
+
+class HouseRenderer {
+public:
+    //draws through renderer and its camera, falls back to immediate mode when the
+    //programs don't link or the renderer is headless and to the simple mesh for
+    //impostors without an atlas
+    void init(CoreRenderer* renderer) {
+        this->renderer = renderer;
+        if (renderer->isHeadless()) {
+            SDL_Log("Houses: immediate mode headless, no impostors");
+            return;
+        }
+        static const char* const attributes[] = { "basePosition", "place", "size", "wallColor", "roofColor" };
+        program = LinkProgram(meshVertexSource(), meshFragmentSource(), "house", attributes, 5);
+        instanced = program != 0;
+        if (instanced) {
+            glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Camera"), CORE_CAMERA_BINDING);
+            maskUniform = glGetUniformLocation(program, "mask");
+            const HouseMeshes& meshes = GetHouseMeshes();
+            GLuint buffers[2];
+            glGenBuffers(2, buffers);
+            meshBuffer = buffers[0];
+            instanceBuffer = buffers[1];
+            glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+            glBufferData(GL_ARRAY_BUFFER, meshes.vertices.size() * sizeof(HouseMeshVertex), meshes.vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            //the pointers move with every level's first instance, which attributes are on and per instance stays
+            glGenVertexArrays(1, &vertexArray);
+            glBindVertexArray(vertexArray);
+            for (GLuint a = 0; a < 5; a++) glEnableVertexAttribArray(a);
+            for (GLuint a = 1; a < 5; a++) glVertexAttribDivisor(a, 1);
+            glBindVertexArray(0);
+
+            if (LoadGLFramebufferExt() && buildAtlas()) {
+                impostorProgram = LinkProgram(impostorVertexSource(), impostorFragmentSource(), "house impostor", attributes, 5);
+                if (impostorProgram) glUniformBlockBinding(impostorProgram, glGetUniformBlockIndex(impostorProgram, "Camera"), CORE_CAMERA_BINDING);
+            }
+        }
+        SDL_Log("Houses: %s, %s", instanced ? "instanced draws" : "immediate mode, the house programs didn't link",
+            impostorProgram ? "impostors" : "no impostors");
+    }
+
+    void shutdown() {
+        if (program) glDeleteProgram(program);
+        if (impostorProgram) glDeleteProgram(impostorProgram);
+        if (atlas) glDeleteTextures(1, &atlas);
+        if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+        if (meshBuffer) {
+            GLuint buffers[2] = { meshBuffer, instanceBuffer };
+            glDeleteBuffers(2, buffers);
+        }
+        program = impostorProgram = atlas = vertexArray = meshBuffer = instanceBuffer = 0;
+    }
+
+    //with lod off every house draws the full mesh
+    void setLodEnabled(bool enabled) { lodEnabled = enabled; }
+    bool isLodEnabled() const { return lodEnabled; }
+    void setLodSettings(const HouseLodSettings& settings) { lodSettings = settings; }
+
+    //draws houses[visible[i]] for every i with the renderer's camera
+    void draw(const std::vector<HouseInstance>& houses, const std::vector<int>& visible) {
+        drawStats = HouseDrawStats();
+        lod.resize(houses.size(), HOUSE_LOD_FULL);
+        const float* eye = renderer->cameraBlock().eye;
+        float pixelScale = pixelsPerUnit();
+
+        //bucket the visible houses by level
+        for (int l = 0; l < HOUSE_LOD_COUNT; l++) byLod[l].clear();
+        for (int id : visible) {
+            const HouseInstance& h = houses[id];
+            int level = HOUSE_LOD_FULL;
+            if (lodEnabled) {
+                float top = h.height + h.roofHeight;
+                float dx = h.x - eye[0], dy = top * 0.5f - eye[1], dz = h.z - eye[2];
+                float distance = sqrtf(dx * dx + dy * dy + dz * dz) + 0.001f;
+                float diameter = sqrtf(h.width * h.width + h.depth * h.depth + top * top);
+                level = SelectHouseLod(lodSettings, diameter * pixelScale / distance, lod[id]);
+                //without impostors the simple mesh stands in all the way out
+                if (level == HOUSE_LOD_IMPOSTOR && !impostorProgram) level = HOUSE_LOD_SIMPLE;
+            }
+            lod[id] = (uint8_t)level;
+            byLod[level].push_back(id);
+        }
+        for (int l = 0; l < HOUSE_LOD_COUNT; l++) drawStats.houses[l] = (int)byLod[l].size();
+
+        if (instanced) drawInstanced(houses);
+        else drawImmediate(houses);
+    }
+
+    bool isInstanced() const { return instanced; }
+    const HouseDrawStats& stats() const { return drawStats; }
+
+private:
+    //pixels per unit at distance 1 from the projection and viewport height
+    float pixelsPerUnit() const {
+        int width, height;
+        renderer->viewportSize(&width, &height);
+        return renderer->cameraBlock().projection.m[5] * height * 0.5f;
+    }
+
+    //the instances of every level as the vao's per instance attributes, starting at first
+    void pointInstances(size_t first) {
+        size_t base = first * sizeof(HouseInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(HouseInstance), (const void*)(base + offsetof(HouseInstance, x)));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(HouseInstance), (const void*)(base + offsetof(HouseInstance, width)));
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HouseInstance), (const void*)(base + offsetof(HouseInstance, wallColor)));
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HouseInstance), (const void*)(base + offsetof(HouseInstance, roofColor)));
+        glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(HouseMeshVertex), (const void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void drawInstanced(const std::vector<HouseInstance>& houses) {
+        const HouseMeshes& meshes = GetHouseMeshes();
+        size_t total = byLod[HOUSE_LOD_FULL].size() + byLod[HOUSE_LOD_SIMPLE].size() + byLod[HOUSE_LOD_IMPOSTOR].size();
+        if (total == 0) return;
+        //whatever the renderer batched goes first, so draw order stays as issued
+        renderer->flush();
+
+        //one upload for every level, each draw starts at its level's first instance
+        staging.clear();
+        size_t start[HOUSE_LOD_HIDDEN];
+        for (int l = 0; l < HOUSE_LOD_HIDDEN; l++) {
+            start[l] = staging.size();
+            for (int id : byLod[l]) staging.push_back(houses[id]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, staging.size() * sizeof(HouseInstance), staging.data(), GL_STREAM_DRAW);
+
+        glBindVertexArray(vertexArray);
+        for (int l = 0; l < HOUSE_LOD_HIDDEN; l++) {
+            GLsizei instances = (GLsizei)byLod[l].size();
+            if (instances == 0) continue;
+            if (l == HOUSE_LOD_IMPOSTOR) {
+                glUseProgram(impostorProgram);
+                glBindTexture(GL_TEXTURE_2D, atlas);
+            }
+            else {
+                glUseProgram(program);
+                glUniform1f(maskUniform, 0.0f);
+            }
+            pointInstances(start[l]);
+            glDrawArraysInstanced(GL_TRIANGLES, meshes.first[l], meshes.count[l], instances);
+            drawStats.drawCalls++;
+            drawStats.vertices += (long long)meshes.count[l] * instances;
+        }
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glUseProgram(0);
+    }
+
+    //part colors of the meshes
+    static void partColor(float part, const HouseInstance& h, unsigned char out[4]) {
+        static const unsigned char floorColor[4] = { 128, 128, 128, 255 }, windowColor[4] = { 64, 77, 102, 255 },
+            doorColor[4] = { 89, 51, 26, 255 };
+        const unsigned char* c;
+        if (part == HOUSE_PART_WALL) c = h.wallColor;
+        else if (part == HOUSE_PART_ROOF) c = h.roofColor;
+        else if (part == HOUSE_PART_FLOOR) c = floorColor;
+        else if (part == HOUSE_PART_WINDOW) c = windowColor;
+        else c = doorColor;
+        for (int i = 0; i < 4; i++) out[i] = c[i];
+    }
+
+    //same transform as the mesh vertex shader, inside the caller's begin
+    void emitHouse(const HouseInstance& h, int lodLevel) {
+        const HouseMeshes& meshes = GetHouseMeshes();
+        float c = cosf(h.rotation), s = sinf(h.rotation);
+        float part = -1.0f;
+        for (int v = meshes.first[lodLevel]; v < meshes.first[lodLevel] + meshes.count[lodLevel]; v++) {
+            const HouseMeshVertex& p = meshes.vertices[v];
+            if (p.part != part) {
+                unsigned char color[4];
+                partColor(p.part, h, color);
+                renderer->color(color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, color[3] / 255.0f);
+                part = p.part;
+            }
+            float lx = p.x * h.width, lz = p.z * h.depth;
+            float y = p.part == HOUSE_PART_ROOF ? h.height + p.y * h.roofHeight : p.y * h.height;
+            renderer->vertex(h.x + lx * c + lz * s, y, h.z - lx * s + lz * c);
+        }
+    }
+
+    //every full and simple house in one batch, the houses are already in world space
+    void drawImmediate(const std::vector<HouseInstance>& houses) {
+        const HouseMeshes& meshes = GetHouseMeshes();
+        if (byLod[HOUSE_LOD_FULL].empty() && byLod[HOUSE_LOD_SIMPLE].empty()) return;
+        renderer->model().push();
+        renderer->model().loadIdentity();
+        renderer->begin(GL_TRIANGLES);
+        for (int l = HOUSE_LOD_FULL; l <= HOUSE_LOD_SIMPLE; l++) {
+            for (int id : byLod[l]) emitHouse(houses[id], l);
+            drawStats.vertices += (long long)meshes.count[l] * byLod[l].size();
+        }
+        renderer->end();
+        renderer->model().pop();
+        drawStats.drawCalls = 1;
+    }
+
+    //renders the canonical house (the default house scaled to width 1) from
+    //every bucket angle into the atlas through a framebuffer object, with the
+    //mesh program's mask colors. the renderer's camera, viewport and the gl
+    //state touched here are put back after
+    bool buildAtlas() {
+        const int size = HOUSE_IMPOSTOR_CELL * HOUSE_IMPOSTOR_COLUMNS;
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        //benchmark runs draw into a framebuffer of their own
+        GLint previous = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        GLuint framebuffer, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (complete) {
+            CoreCameraBlock saved = renderer->cameraBlock();
+            int viewportWidth, viewportHeight;
+            renderer->viewportSize(&viewportWidth, &viewportHeight);
+            GLfloat clearColor[4];
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+            GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+            glViewport(0, 0, size, size);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glEnable(GL_DEPTH_TEST);
+
+            HouseInstance canonical = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.6f, 1.0f, 0.6f, {}, {} };
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(HouseInstance), &canonical, GL_STREAM_DRAW);
+            glBindVertexArray(vertexArray);
+            pointInstances(0);
+            const HouseMeshes& meshes = GetHouseMeshes();
+            //same extents as the impostor quad: half the footprint diagonal, floor to peak
+            Mat4 projection = Mat4Ortho(-0.70710678f, 0.70710678f, 0.0f, 1.2f, -2.0f, 2.0f);
+            for (int b = 0; b < HOUSE_IMPOSTOR_BUCKETS; b++) {
+                int column = b % HOUSE_IMPOSTOR_COLUMNS, row = b / HOUSE_IMPOSTOR_COLUMNS;
+                //turn the side the bucket looks from towards +z
+                renderer->setCamera(Mat4Rotate(-6.28318531f * b / HOUSE_IMPOSTOR_BUCKETS, MakeVec3(0.0f, 1.0f, 0.0f)), projection);
+                glViewport(column * HOUSE_IMPOSTOR_CELL, row * HOUSE_IMPOSTOR_CELL, HOUSE_IMPOSTOR_CELL, HOUSE_IMPOSTOR_CELL);
+                glUseProgram(program);
+                glUniform1f(maskUniform, 1.0f);
+                glDrawArraysInstanced(GL_TRIANGLES, meshes.first[HOUSE_LOD_FULL], meshes.count[HOUSE_LOD_FULL], 1);
+            }
+            glBindVertexArray(0);
+            glUseProgram(0);
+
+            renderer->setCamera(saved.view, saved.projection);
+            glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+            if (!depthTest) glDisable(GL_DEPTH_TEST);
+            renderer->setViewport(viewportWidth, viewportHeight);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depth);
+        if (!complete) {
+            SDL_Log("Couldn't render the impostor atlas, framebuffer incomplete");
+            glDeleteTextures(1, &atlas);
+            atlas = 0;
+        }
+        return complete;
+    }
+
+    //mask draws the atlas colors: red walls, green roof, blue door and windows
+    static const char* meshVertexSource() {
+        return
+            "#version 330 core\n"
+            CORE_CAMERA_GLSL
+            "uniform float mask;\n"
+            "in vec4 basePosition;\n"
+            "in vec4 place;\n"
+            "in vec4 size;\n"
+            "in vec4 wallColor;\n"
+            "in vec4 roofColor;\n"
+            "out vec4 color;\n"
+            "void main() {\n"
+            "    float part = basePosition.w;\n"
+            "    bool roof = part > 1.5 && part < 2.5;\n"
+            "    float y = roof ? size.y + basePosition.y * size.w : basePosition.y * size.y;\n"
+            "    vec2 local = basePosition.xz * size.xz;\n"
+            "    float c = cos(place.z), s = sin(place.z);\n"
+            "    vec3 world = vec3(place.x + local.x * c + local.y * s, y, place.y - local.x * s + local.y * c);\n"
+            "    gl_Position = viewProjection * vec4(world, 1.0);\n"
+            "    if (part > 3.5) color = mask > 0.5 ? vec4(0.0, 0.0, 1.0, 1.0) : vec4(0.35, 0.2, 0.1, 1.0);\n"
+            "    else if (part > 2.5) color = mask > 0.5 ? vec4(0.0, 0.0, 1.0, 1.0) : vec4(0.25, 0.3, 0.4, 1.0);\n"
+            "    else if (roof) color = mask > 0.5 ? vec4(0.0, 1.0, 0.0, 1.0) : roofColor;\n"
+            "    else if (part > 0.5) color = vec4(0.5, 0.5, 0.5, 1.0);\n"
+            "    else color = mask > 0.5 ? vec4(1.0, 0.0, 0.0, 1.0) : wallColor;\n"
+            "}\n";
+    }
+
+    static const char* meshFragmentSource() {
+        return
+            "#version 330 core\n"
+            "in vec4 color;\n"
+            "out vec4 fragColor;\n"
+            "void main() {\n"
+            "    fragColor = color;\n"
+            "}\n";
+    }
+
+    //turns the quad towards the eye around +y and picks the atlas cell from
+    //the eye direction in the house's own frame, squashed onto the square
+    //footprint the atlas shows
+    static const char* impostorVertexSource() {
+        return
+            "#version 330 core\n"
+            "#define BUCKETS 16.0\n"
+            "#define COLUMNS 4.0\n"
+            "#define CELL 64.0\n"
+            CORE_CAMERA_GLSL
+            "in vec4 basePosition;\n"
+            "in vec4 place;\n"
+            "in vec4 size;\n"
+            "in vec4 wallColor;\n"
+            "in vec4 roofColor;\n"
+            "out vec2 uv;\n"
+            "out vec4 wall;\n"
+            "out vec4 roof;\n"
+            "void main() {\n"
+            "    vec2 toEye = eye.xz - place.xy;\n"
+            "    toEye /= max(length(toEye), 0.001);\n"
+            "    float c = cos(place.z), s = sin(place.z);\n"
+            "    vec2 local = vec2(toEye.x * c - toEye.y * s, toEye.x * s + toEye.y * c);\n"
+            "    vec2 squashed = vec2(local.x * size.z, local.y * size.x);\n"
+            "    float bucket = mod(floor(atan(squashed.x, squashed.y) / 6.2831853 * BUCKETS + 0.5), BUCKETS);\n"
+            "    vec2 right = vec2(toEye.y, -toEye.x);\n"
+            "    float halfWidth = 0.70710678 * length(squashed);\n"
+            "    vec2 xz = place.xy + right * basePosition.x * halfWidth;\n"
+            "    bool roofBand = basePosition.w > 1.5;\n"
+            "    float y = roofBand ? size.y + basePosition.y * size.w : basePosition.y * size.y;\n"
+            "    gl_Position = viewProjection * vec4(xz.x, y, xz.y, 1.0);\n"
+            "    vec2 cell = vec2(mod(bucket, COLUMNS), floor(bucket / COLUMNS));\n"
+            "    vec2 t = vec2(basePosition.x * 0.5 + 0.5, (basePosition.y + (roofBand ? 1.0 : 0.0)) * 0.5);\n"
+            "    uv = (cell + (0.5 + t * (CELL - 1.0)) / CELL) / COLUMNS;\n"
+            "    wall = wallColor;\n"
+            "    roof = roofColor;\n"
+            "}\n";
+    }
+
+    static const char* impostorFragmentSource() {
+        return
+            "#version 330 core\n"
+            "uniform sampler2D atlas;\n"
+            "in vec2 uv;\n"
+            "in vec4 wall;\n"
+            "in vec4 roof;\n"
+            "out vec4 fragColor;\n"
+            "void main() {\n"
+            "    vec4 mask = texture(atlas, uv);\n"
+            "    if (mask.a < 0.5) discard;\n"
+            "    vec3 color = wall.rgb * mask.r + roof.rgb * mask.g + vec3(0.3, 0.3, 0.35) * mask.b;\n"
+            "    fragColor = vec4(color / max(mask.r + mask.g + mask.b, 0.001), 1.0);\n"
+            "}\n";
+    }
+
+    CoreRenderer* renderer = nullptr;
+    bool instanced = false;
+    bool lodEnabled = true;
+    HouseLodSettings lodSettings = DefaultHouseLodSettings();
+    GLuint program = 0;
+    GLuint impostorProgram = 0;
+    GLint maskUniform = -1;
+    GLuint atlas = 0;
+    GLuint vertexArray = 0;
+    GLuint meshBuffer = 0;
+    GLuint instanceBuffer = 0;
+    std::vector<uint8_t> lod; //per house, kept between frames for the hysteresis
+    std::vector<int> byLod[HOUSE_LOD_COUNT];
+    std::vector<HouseInstance> staging;
+    HouseDrawStats drawStats = {};
+};
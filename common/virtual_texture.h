@@ -0,0 +1,375 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_opengl.h>
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "core_renderer.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+#include "spatial_index.h"
+#include "thread_pool.h"
+
+//sparse virtual texture for a big square ground.
+//the whole ground texture is cut into a quadtree of fixed-size tiles (every
+//level halves the tile count per side) stored in one tile file that is memory
+//mapped. each frame the quadtree is refined around the camera, the tiles it
+//picks are copied into slots of a fixed physical cache texture (lru eviction,
+//a few uploads per frame) and a per-level page table maps tile -> slot.
+//tiles that are not resident yet are drawn from their closest resident
+//ancestor, the single root tile is always resident.
+//the page table is looked up on the cpu: every visible quadtree leaf becomes
+//a quad whose uvs point into its slot.
+
+#define VT_MAGIC 0x31545456u //"VTT1"
+#define VT_VERSION 1u
+#define VT_MAX_LEVELS 16
+
+struct VtFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tileSize;   //inner texels per side
+    uint32_t border;     //texels copied from the neighbours on every side
+    uint32_t levels;
+    uint32_t tilesPerSide; //at level 0
+    uint64_t levelOffset[VT_MAX_LEVELS];
+};
+
+inline uint32_t VtSlotSize(const VtFileHeader& h)
+{
+    return h.tileSize + 2 * h.border;
+}
+
+inline size_t VtTileBytes(const VtFileHeader& h)
+{
+    return (size_t)VtSlotSize(h) * VtSlotSize(h) * 3;
+}
+
+//builds the tile file from a color function over the ground (u, v in 0..1).
+//level 0 is sampled, every coarser level is a gamma-correct box downsample
+//of the one below, so tiles of all levels line up exactly.
+inline bool VtGenerateFile(const char* path, uint32_t tilesPerSide, uint32_t tileSize, uint32_t border,
+    const std::function<void(float u, float v, unsigned char rgb[3])>& sample)
+{
+    VtFileHeader header = {};
+    header.magic = VT_MAGIC;
+    header.version = VT_VERSION;
+    header.tileSize = tileSize;
+    header.border = border;
+    header.tilesPerSide = tilesPerSide;
+    header.levels = 1;
+    while ((tilesPerSide >> (header.levels - 1)) > 1 && header.levels < VT_MAX_LEVELS) header.levels++;
+
+    uint64_t offset = sizeof(VtFileHeader);
+    for (uint32_t l = 0; l < header.levels; l++) {
+        header.levelOffset[l] = offset;
+        uint64_t tiles = (uint64_t)(tilesPerSide >> l) * (tilesPerSide >> l);
+        offset += tiles * VtTileBytes(header);
+    }
+
+    char tmpPath[512];
+    SDL_snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    SDL_IOStream* io = SDL_IOFromFile(tmpPath, "wb");
+    if (!io) return false;
+    bool ok = SDL_WriteIO(io, &header, sizeof(header)) == sizeof(header);
+
+    int size = (int)(tilesPerSide * tileSize);
+    std::vector<unsigned char> level((size_t)size * size * 3);
+    GlobalThreadPool().parallelFor(size, 16, [&](int begin, int end) {
+        for (int y = begin; y < end; y++)
+            for (int x = 0; x < size; x++)
+                sample((x + 0.5f) / size, (y + 0.5f) / size, &level[((size_t)y * size + x) * 3]);
+    });
+
+    int slot = (int)VtSlotSize(header);
+    std::vector<unsigned char> tile(VtTileBytes(header));
+    for (uint32_t l = 0; l < header.levels && ok; l++) {
+        int tiles = (int)(tilesPerSide >> l);
+        for (int ty = 0; ty < tiles && ok; ty++) {
+            for (int tx = 0; tx < tiles && ok; tx++) {
+                for (int y = 0; y < slot; y++) {
+                    int sy = std::min(std::max(ty * (int)tileSize + y - (int)border, 0), size - 1);
+                    for (int x = 0; x < slot; x++) {
+                        int sx = std::min(std::max(tx * (int)tileSize + x - (int)border, 0), size - 1);
+                        const unsigned char* src = &level[((size_t)sy * size + sx) * 3];
+                        unsigned char* dst = &tile[((size_t)y * slot + x) * 3];
+                        dst[0] = src[0];
+                        dst[1] = src[1];
+                        dst[2] = src[2];
+                    }
+                }
+                ok = SDL_WriteIO(io, tile.data(), tile.size()) == tile.size();
+            }
+        }
+
+        if (l + 1 < header.levels) {
+            int half = size / 2;
+            std::vector<unsigned char> next((size_t)half * half * 3);
+            MipLevel src = { size, size, level.data() };
+            MipLevel dst = { half, half, next.data() };
+            MipDownsample(src, dst, 3, MakeMipKernel(MIP_FILTER_BOX), false);
+            level.swap(next);
+            size = half;
+        }
+    }
+
+    ok = SDL_CloseIO(io) && ok;
+    if (ok) {
+        SDL_RemovePath(path);
+        ok = SDL_RenamePath(tmpPath, path);
+    }
+    if (!ok) SDL_RemovePath(tmpPath);
+    return ok;
+}
+
+class VirtualTexture {
+public:
+    //lodDistance: a node is split while the camera is closer than lodDistance * its size.
+    //the cache texture belongs to renderer, which also draws the ground
+    bool open(CoreRenderer* renderer, const char* path, float worldSize, int slotsPerSide, float lodDistance) {
+        if (!MapFile(path, &file)) return false;
+        header = (const VtFileHeader*)file.data;
+        if (file.size < sizeof(VtFileHeader) || header->magic != VT_MAGIC || header->version != VT_VERSION ||
+            header->levels == 0 || header->levels > VT_MAX_LEVELS) {
+            close();
+            return false;
+        }
+        uint32_t last = header->levels - 1;
+        uint64_t lastTiles = (uint64_t)(header->tilesPerSide >> last) * (header->tilesPerSide >> last);
+        if (header->levelOffset[last] + lastTiles * VtTileBytes(*header) > file.size) {
+            close();
+            return false;
+        }
+
+        this->renderer = renderer;
+        this->worldSize = worldSize;
+        this->slotsPerSide = slotsPerSide;
+        this->lodDistance = lodDistance;
+        slotSize = (int)VtSlotSize(*header);
+        cacheSize = slotsPerSide * slotSize;
+
+        pageTable.resize(header->levels);
+        for (uint32_t l = 0; l < header->levels; l++)
+            pageTable[l].assign((size_t)tilesAt(l) * tilesAt(l), -1);
+        slots.assign((size_t)slotsPerSide * slotsPerSide, Slot());
+
+        renderer->createTexture(&cacheTexture, cacheSize, cacheSize, 3, NULL, GL_CLAMP_TO_EDGE);
+
+        //the root is the fallback for everything, it never leaves the cache
+        upload(last, 0, 0);
+        slots[pageTable[last][0]].pinned = true;
+        return true;
+    }
+
+    void close() {
+        if (renderer) renderer->destroyTexture(&cacheTexture);
+        renderer = nullptr;
+        UnmapFile(&file);
+        header = nullptr;
+    }
+
+    //picks the tiles for this camera position and streams in up to maxUploads of them.
+    //with a frustum (in the space draw() is called in, ground at groundY) nodes
+    //out of view are neither drawn nor streamed
+    void update(float cameraX, float cameraY, float cameraZ, int maxUploads, const Frustum* frustum = nullptr, float groundY = 0.0f) {
+        frame++;
+        leaves.clear();
+        requests.clear();
+        Uint64 start = SDL_GetPerformanceCounter();
+        cull.objects = 0;
+        cull.nodesTested = 0;
+        this->frustum = frustum;
+        this->groundY = groundY;
+        selectNode(header->levels - 1, 0, 0, cameraX, cameraY, cameraZ);
+        cull.visible = (int)leaves.size();
+        cull.milliseconds = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        //coarse tiles first so fallbacks get sharper quickly, then nearest first
+        std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+            return a.level != b.level ? a.level > b.level : a.distance < b.distance;
+        });
+        uploadsLastFrame = 0;
+        for (const Request& r : requests) {
+            if (uploadsLastFrame >= maxUploads) break;
+            if (pageTable[r.level][index(r.level, r.x, r.y)] >= 0) continue;
+            if (!upload(r.level, r.x, r.y)) break;
+            uploadsLastFrame++;
+        }
+        missingLastFrame = (int)requests.size() - uploadsLastFrame;
+    }
+
+    //one quad per selected leaf on the plane y = height, centered on the origin
+    //of the renderer's current model matrix
+    void draw(float height) {
+        renderer->bindTexture(&cacheTexture);
+        renderer->begin(GL_QUADS);
+        for (const Leaf& leaf : leaves) {
+            //walk up until a resident tile covers the leaf
+            uint32_t level = leaf.level;
+            int x = leaf.x, y = leaf.y;
+            while (pageTable[level][index(level, x, y)] < 0) {
+                level++;
+                x >>= 1;
+                y >>= 1;
+            }
+            int slot = pageTable[level][index(level, x, y)];
+            slots[slot].lastUsed = frame;
+
+            //part of the ancestor tile the leaf covers
+            float scale = 1.0f / (float)(1 << (level - leaf.level));
+            float fx = (leaf.x * scale - x), fy = (leaf.y * scale - y);
+            float s0 = slotOrigin(slot % slotsPerSide), t0 = slotOrigin(slot / slotsPerSide);
+            float inner = (float)header->tileSize / cacheSize;
+            float u0 = s0 + fx * inner, u1 = u0 + scale * inner;
+            float v0 = t0 + fy * inner, v1 = v0 + scale * inner;
+
+            float nodeSize = worldSize / tilesAt(leaf.level);
+            float x0 = -worldSize * 0.5f + leaf.x * nodeSize, x1 = x0 + nodeSize;
+            float z0 = -worldSize * 0.5f + leaf.y * nodeSize, z1 = z0 + nodeSize;
+            renderer->texCoord(u0, v0); renderer->vertex(x0, height, z0);
+            renderer->texCoord(u0, v1); renderer->vertex(x0, height, z1);
+            renderer->texCoord(u1, v1); renderer->vertex(x1, height, z1);
+            renderer->texCoord(u1, v0); renderer->vertex(x1, height, z0);
+        }
+        renderer->end();
+        renderer->bindTexture(nullptr);
+    }
+
+    int residentTiles() const { return resident; }
+    int drawnTiles() const { return (int)leaves.size(); }
+    int uploadsLastFrameCount() const { return uploadsLastFrame; }
+    int missingLastFrameCount() const { return missingLastFrame; }
+    //objects: leaves plus subtrees dropped by the frustum, visible: leaves kept
+    const CullStats& cullStats() const { return cull; }
+    //physical cache bytes, independent of the world size
+    size_t cacheBytes() const { return (size_t)cacheSize * cacheSize * 3; }
+
+private:
+    struct Slot {
+        int level = -1, x = 0, y = 0;
+        uint32_t lastUsed = 0;
+        bool pinned = false;
+    };
+    struct Leaf {
+        uint32_t level;
+        int x, y;
+    };
+    struct Request {
+        uint32_t level;
+        int x, y;
+        float distance;
+    };
+
+    int tilesAt(uint32_t level) const { return (int)(header->tilesPerSide >> level); }
+    size_t index(uint32_t level, int x, int y) const { return (size_t)y * tilesAt(level) + x; }
+    float slotOrigin(int slot) const { return (float)(slot * slotSize + (int)header->border) / cacheSize; }
+
+    void selectNode(uint32_t level, int x, int y, float cx, float cy, float cz) {
+        float nodeSize = worldSize / tilesAt(level);
+        float centerX = -worldSize * 0.5f + (x + 0.5f) * nodeSize;
+        float centerZ = -worldSize * 0.5f + (y + 0.5f) * nodeSize;
+        float dx = std::max(fabsf(cx - centerX) - nodeSize * 0.5f, 0.0f);
+        float dz = std::max(fabsf(cz - centerZ) - nodeSize * 0.5f, 0.0f);
+        float distance = sqrtf(dx * dx + cy * cy + dz * dz);
+        bool split = level > 0 && distance < lodDistance * nodeSize;
+
+        if (frustum) {
+            cull.nodesTested++;
+            float x0 = -worldSize * 0.5f + x * nodeSize, z0 = -worldSize * 0.5f + y * nodeSize;
+            Aabb box = { { x0, groundY, z0 }, { x0 + nodeSize, groundY, z0 + nodeSize } };
+            if (FrustumTestAabb(*frustum, box) == FRUSTUM_OUTSIDE) {
+                cull.objects++;
+                return;
+            }
+        }
+        if (!split) cull.objects++;
+
+        if (split) {
+            for (int i = 0; i < 4; i++)
+                selectNode(level - 1, x * 2 + (i & 1), y * 2 + (i >> 1), cx, cy, cz);
+            return;
+        }
+        leaves.push_back({ level, x, y });
+        int slot = pageTable[level][index(level, x, y)];
+        if (slot >= 0) {
+            slots[slot].lastUsed = frame;
+        }
+        else {
+            requests.push_back({ level, x, y, distance });
+            touchFallback(level, x, y);
+        }
+    }
+
+    //marks the resident ancestor draw() falls back to as used, so this
+    //frame's uploads don't evict the tile the leaf is about to be drawn with
+    void touchFallback(uint32_t level, int x, int y) {
+        while (level + 1 < header->levels) {
+            level++;
+            x >>= 1;
+            y >>= 1;
+            int slot = pageTable[level][index(level, x, y)];
+            if (slot >= 0) {
+                slots[slot].lastUsed = frame;
+                return;
+            }
+        }
+    }
+
+    //copies a tile from the mapping into the least recently used slot
+    bool upload(uint32_t level, int x, int y) {
+        int victim = -1;
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (slots[i].level < 0) {
+                victim = i;
+                break;
+            }
+            if (slots[i].pinned || slots[i].lastUsed == frame) continue;
+            if (victim < 0 || slots[i].lastUsed < slots[victim].lastUsed) victim = i;
+        }
+        //everything is in use this frame, the rest keeps its fallback
+        if (victim < 0) return false;
+
+        Slot& s = slots[victim];
+        if (s.level >= 0) {
+            pageTable[s.level][index(s.level, s.x, s.y)] = -1;
+            resident--;
+        }
+        s.level = (int)level;
+        s.x = x;
+        s.y = y;
+        s.lastUsed = frame;
+        pageTable[level][index(level, x, y)] = victim;
+        resident++;
+
+        const unsigned char* src = file.data + header->levelOffset[level] + index(level, x, y) * VtTileBytes(*header);
+        renderer->updateTexture(&cacheTexture, (victim % slotsPerSide) * slotSize, (victim / slotsPerSide) * slotSize,
+            slotSize, slotSize, 3, src);
+        return true;
+    }
+
+    MappedFile file;
+    const VtFileHeader* header = nullptr;
+    float worldSize = 0.0f;
+    float lodDistance = 2.0f;
+    int slotsPerSide = 0;
+    int slotSize = 0;
+    int cacheSize = 0;
+    CoreRenderer* renderer = nullptr;
+    CoreTexture cacheTexture;
+    uint32_t frame = 0;
+    int resident = 0;
+    int uploadsLastFrame = 0;
+    int missingLastFrame = 0;
+    const Frustum* frustum = nullptr;
+    float groundY = 0.0f;
+    CullStats cull = {};
+
+    std::vector<std::vector<int>> pageTable; //per level, tile -> slot or -1
+    std::vector<Slot> slots;
+    std::vector<Leaf> leaves;
+    std::vector<Request> requests;
+};
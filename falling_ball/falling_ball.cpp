@@ -6,102 +6,120 @@
 #include <stdbool.h>
 #include <corecrt_math_defines.h>
 
+#include "../common/core_renderer.h"
+#include "../common/sim_thread.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define BALL_RADIUS 20.0f
+#define SIM_STEP (1.0f / 60.0f)
 
-//initial value (middle of screen)
-float ballY = WINDOW_HEIGHT / 3.0f;
-float velocityY = 0.0f;
+//stepped on the sim thread, drawn from its snapshots
+struct Ball {
+    float y = WINDOW_HEIGHT / 3.0f; //initial value (middle of screen)
+    float velocityY = 0.0f;
+};
 
 const float GRAVITY = -9.81f;
 const float GROUND_Y = -WINDOW_HEIGHT / 2.0f + 50;
 
 SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
-Uint64 previousTime, currentTime;
+CoreRenderer renderer;
+SimThread<Ball> sim;
 
-void drawBall() {
-    glColor3f(1.0f, 0.5f, 0.0f);
+void drawBall(const Ball& ball) {
+    renderer.color(1.0f, 0.5f, 0.0f);
 
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(0.0f, ballY);
+    renderer.begin(GL_TRIANGLE_FAN);
+    renderer.vertex(0.0f, ball.y);
 
     for (int i = 0; i <= 360; i += 10) {
         float angle = i * M_PI / 180.0f;
         float x = BALL_RADIUS * cosf(angle);
         float y = BALL_RADIUS * sinf(angle);
-        glVertex2f(x, ballY + y);
+        renderer.vertex(x, ball.y + y);
     }
 
-    glEnd();
+    renderer.end();
 }
 
 void drawGround() {
-    glColor3f(0.3f, 0.3f, 0.3f);
-    glBegin(GL_QUADS);
-    glVertex2f(-WINDOW_WIDTH / 2.0f, GROUND_Y);
-    glVertex2f(WINDOW_WIDTH / 2.0f, GROUND_Y);
-    glVertex2f(WINDOW_WIDTH / 2.0f, GROUND_Y - 20.0f);
-    glVertex2f(-WINDOW_WIDTH / 2.0f, GROUND_Y - 20.0f);
-    glEnd();
+    renderer.color(0.3f, 0.3f, 0.3f);
+    renderer.begin(GL_QUADS);
+    renderer.vertex(-WINDOW_WIDTH / 2.0f, GROUND_Y);
+    renderer.vertex(WINDOW_WIDTH / 2.0f, GROUND_Y);
+    renderer.vertex(WINDOW_WIDTH / 2.0f, GROUND_Y - 20.0f);
+    renderer.vertex(-WINDOW_WIDTH / 2.0f, GROUND_Y - 20.0f);
+    renderer.end();
 }
 
-void updatePhysics(float dt) {
-    ballY += velocityY * dt + 0.5f * GRAVITY * dt * dt;
-    velocityY += GRAVITY * dt;
+void updatePhysics(Ball& ball, float dt) {
+    TRACE_FUNCTION();
+    PerfCounterScope counters("updatePhysics");
+    ball.y += ball.velocityY * dt + 0.5f * GRAVITY * dt * dt;
+    ball.velocityY += GRAVITY * dt;
 
-    if (ballY - BALL_RADIUS < GROUND_Y) {
-        ballY = GROUND_Y + BALL_RADIUS;
-        velocityY *= -0.7f;
+    if (ball.y - BALL_RADIUS < GROUND_Y) {
+        ball.y = GROUND_Y + BALL_RADIUS;
+        ball.velocityY *= -0.7f;
     }
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     SDL_Init(SDL_INIT_VIDEO);
 
-    window = SDL_CreateWindow("Gravity Ball", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.0f, 0.0f, 0.2f, 1.0f);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
+    window = renderer.createWindow("Gravity Ball", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    if (!window) return SDL_APP_FAILURE;
+    renderer.setClearColor(0.0f, 0.0f, 0.2f, 1.0f);
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
         -WINDOW_HEIGHT / 2.0f, WINDOW_HEIGHT / 2.0f,
-        -1.0f, 1.0f);
-    glMatrixMode(GL_MODELVIEW);
+        -1.0f, 1.0f));
 
-    previousTime = SDL_GetTicks();
+    //fixed 60 hz steps on a thread of their own, offscreen runs step once a frame here
+    sim.start(Ball(), SIM_STEP, [](Ball&, const SimInput&) {}, updatePhysics, !renderer.isOffscreen());
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    currentTime = SDL_GetTicks();
-    float dt = (currentTime - previousTime) / 1000.0f; // seconds
-    previousTime = currentTime;
-
-    updatePhysics(dt);
+    TRACE_FUNCTION();
+    if (renderer.isOffscreen()) {
+        PerfScope scope(renderer.perf(), "update");
+        sim.advance();
+    }
+    const Ball& ball = sim.newest();
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    glLoadIdentity();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(false);
+        renderer.model().loadIdentity();
 
-    drawGround();
-    drawBall();
+        drawGround();
+        drawBall(ball);
+    }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     SDL_Delay(16); // ~60 FPS
 
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    sim.stop();
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
\ No newline at end of file
@@ -5,13 +5,16 @@
 #include <math.h>
 #include <corecrt_math_defines.h>
 
+#include "../common/core_renderer.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 #define BOARD_SIZE 300
 #define SQUARE_SIZE (BOARD_SIZE / 3)
 
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
 
 int activeRow = 1;
 int activeCol = 1;
@@ -22,47 +25,47 @@ int board[3][3] = { 0 };
 void drawSymbol(int type, float x, float y) {
     if (type == 1) {
         //x
-        glColor3f(1, 0, 0);
-        glLineWidth(4);
-        glBegin(GL_LINES);
-        glVertex2f(x + 10, y + 10);
-        glVertex2f(x + SQUARE_SIZE - 10, y + SQUARE_SIZE - 10);
-        glVertex2f(x + SQUARE_SIZE - 10, y + 10);
-        glVertex2f(x + 10, y + SQUARE_SIZE - 10);
-        glEnd();
+        renderer.color(1, 0, 0);
+        renderer.lineWidth(4);
+        renderer.begin(GL_LINES);
+        renderer.vertex(x + 10, y + 10);
+        renderer.vertex(x + SQUARE_SIZE - 10, y + SQUARE_SIZE - 10);
+        renderer.vertex(x + SQUARE_SIZE - 10, y + 10);
+        renderer.vertex(x + 10, y + SQUARE_SIZE - 10);
+        renderer.end();
     }
     else if (type == 2) {
         //O
-        glColor3f(0, 0, 1);
-        glLineWidth(4);
+        renderer.color(0, 0, 1);
+        renderer.lineWidth(4);
         float cx = x + SQUARE_SIZE / 2;
         float cy = y + SQUARE_SIZE / 2;
         float radius = SQUARE_SIZE / 2 - 10;
-        glBegin(GL_LINE_LOOP);
+        renderer.begin(GL_LINE_LOOP);
         for (int i = 0; i < 100; ++i) {
             float angle = i * 2.0f * M_PI / 100;
-            glVertex2f(cx + cosf(angle) * radius, cy + sinf(angle) * radius);
+            renderer.vertex(cx + cosf(angle) * radius, cy + sinf(angle) * radius);
         }
-        glEnd();
+        renderer.end();
     }
 }
 
 void drawBoard() {
-    glClear(GL_COLOR_BUFFER_BIT);
-    glLoadIdentity();
+    renderer.clear(false);
+    renderer.model().loadIdentity();
 
     //grid
-    glColor3f(1, 1, 1);
-    glLineWidth(2);
-    glBegin(GL_LINES);
+    renderer.color(1, 1, 1);
+    renderer.lineWidth(2);
+    renderer.begin(GL_LINES);
     for (int i = 1; i < 3; i++) {
         float offset = -BOARD_SIZE / 2 + i * SQUARE_SIZE;
-        glVertex2f(offset, -BOARD_SIZE / 2);
-        glVertex2f(offset, BOARD_SIZE / 2);
-        glVertex2f(-BOARD_SIZE / 2, offset);
-        glVertex2f(BOARD_SIZE / 2, offset);
+        renderer.vertex(offset, -BOARD_SIZE / 2);
+        renderer.vertex(offset, BOARD_SIZE / 2);
+        renderer.vertex(-BOARD_SIZE / 2, offset);
+        renderer.vertex(BOARD_SIZE / 2, offset);
     }
-    glEnd();
+    renderer.end();
 
     //squares and active highlight
     for (int row = 0; row < 3; row++) {
@@ -72,13 +75,13 @@ void drawBoard() {
 
             //active square
             if (row == activeRow && col == activeCol) {
-                glColor3f(0.3f, 0.8f, 0.3f);
-                glBegin(GL_QUADS);
-                glVertex2f(x, y);
-                glVertex2f(x + SQUARE_SIZE, y);
-                glVertex2f(x + SQUARE_SIZE, y + SQUARE_SIZE);
-                glVertex2f(x, y + SQUARE_SIZE);
-                glEnd();
+                renderer.color(0.3f, 0.8f, 0.3f);
+                renderer.begin(GL_QUADS);
+                renderer.vertex(x, y);
+                renderer.vertex(x + SQUARE_SIZE, y);
+                renderer.vertex(x + SQUARE_SIZE, y + SQUARE_SIZE);
+                renderer.vertex(x, y + SQUARE_SIZE);
+                renderer.end();
             }
 
             //draw symbol
@@ -90,6 +93,7 @@ void drawBoard() {
 }
 
 void handleKey(SDL_Keycode key) {
+    TRACE_FUNCTION();
     if (key == SDLK_UP && activeRow > 0) activeRow--;
     if (key == SDLK_DOWN && activeRow < 2) activeRow++;
     if (key == SDLK_LEFT && activeCol > 0) activeCol--;
@@ -101,26 +105,25 @@ void handleKey(SDL_Keycode key) {
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     if (SDL_Init(SDL_INIT_VIDEO) < 0) return SDL_APP_FAILURE;
 
-    window = SDL_CreateWindow("Tic-Tac-Toe", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    window = renderer.createWindow("Tic-Tac-Toe", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
     if (!window) return SDL_APP_FAILURE;
 
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(-WINDOW_WIDTH / 2, WINDOW_WIDTH / 2, -WINDOW_HEIGHT / 2, WINDOW_HEIGHT / 2, -1, 1);
+    renderer.setClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(-WINDOW_WIDTH / 2, WINDOW_WIDTH / 2, -WINDOW_HEIGHT / 2, WINDOW_HEIGHT / 2, -1, 1));
 
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) return SDL_APP_SUCCESS;
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
     if (event->type == SDL_EVENT_KEY_DOWN) {
         handleKey(event->key.key);
     }
@@ -128,14 +131,19 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    drawBoard();
-    SDL_GL_SwapWindow(window);
+    TRACE_FUNCTION();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        drawBoard();
+    }
+    if (!renderer.present()) return renderer.runResult();
 	SDL_Delay(16); //~60 FPS
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
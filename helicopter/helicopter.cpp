@@ -4,56 +4,68 @@
 #include <SDL3/SDL_opengl.h>
 #include <stdio.h>
 
+#include "../common/core_renderer.h"
+#include "../common/input_latency.h"
+#include "../common/sim_thread.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
+#define SIM_STEP (1.0f / 60.0f) //the game was tuned for one step a 60 hz frame
 
 SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
+
+// Game variables, stepped on the sim thread and drawn from its snapshots
+struct Game {
+    float birdY = 240.0f;        // Bird Y position (middle of screen)
+    float birdVelocity = 0.0f;   // Bird falling/jumping speed
+    float pipeX = 640.0f;        // Pipe X position (starts off-screen right)
+    float pipeGapY = 240.0f;     // Y position of gap center
+    int gameOver = 0;
+    int score = 0;
+};
 
-// Game variables
-float birdY = 240.0f;        // Bird Y position (middle of screen)
-float birdVelocity = 0.0f;   // Bird falling/jumping speed
-float pipeX = 640.0f;        // Pipe X position (starts off-screen right)
-float pipeGap = 120.0f;      // Gap between top and bottom pipes
-float pipeGapY = 240.0f;     // Y position of gap center
-int gameOver = 0;
-int score = 0;
+const float pipeGap = 120.0f;    // Gap between top and bottom pipes
+SimThread<Game> sim;
 
 void DrawRect(float x, float y, float width, float height) {
-    glBegin(GL_QUADS);
-    glVertex2f(x, y);
-    glVertex2f(x + width, y);
-    glVertex2f(x + width, y + height);
-    glVertex2f(x, y + height);
-    glEnd();
+    renderer.begin(GL_QUADS);
+    renderer.vertex(x, y);
+    renderer.vertex(x + width, y);
+    renderer.vertex(x + width, y + height);
+    renderer.vertex(x, y + height);
+    renderer.end();
 }
 
-void DrawBird() {
-    glColor3f(1.0f, 1.0f, 0.0f); // Yellow bird
-    DrawRect(100.0f, birdY - 15.0f, 30.0f, 30.0f);
+void DrawBird(const Game& g) {
+    renderer.color(1.0f, 1.0f, 0.0f); // Yellow bird
+    DrawRect(100.0f, g.birdY - 15.0f, 30.0f, 30.0f);
 }
 
-void DrawPipes() {
-    glColor3f(0.0f, 0.8f, 0.0f); // Green pipes
+void DrawPipes(const Game& g) {
+    renderer.color(0.0f, 0.8f, 0.0f); // Green pipes
 
     // Top pipe
-    DrawRect(pipeX, 0.0f, 60.0f, pipeGapY - pipeGap / 2);
+    DrawRect(g.pipeX, 0.0f, 60.0f, g.pipeGapY - pipeGap / 2);
 
     // Bottom pipe
-    DrawRect(pipeX, pipeGapY + pipeGap / 2, 60.0f, WINDOW_HEIGHT - (pipeGapY + pipeGap / 2));
+    DrawRect(g.pipeX, g.pipeGapY + pipeGap / 2, 60.0f, WINDOW_HEIGHT - (g.pipeGapY + pipeGap / 2));
 }
 
 void DrawBackground() {
-    glColor3f(0.5f, 0.8f, 1.0f); // Sky blue
+    renderer.color(0.5f, 0.8f, 1.0f); // Sky blue
     DrawRect(0.0f, 0.0f, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
-int CheckCollision() {
+int CheckCollision(const Game& g) {
+    TRACE_FUNCTION();
+    PerfCounterScope counters("CheckCollision");
     // Bird boundaries
     float birdLeft = 100.0f;
     float birdRight = 130.0f;
-    float birdTop = birdY - 15.0f;
-    float birdBottom = birdY + 15.0f;
+    float birdTop = g.birdY - 15.0f;
+    float birdBottom = g.birdY + 15.0f;
 
     // Check ground/ceiling collision
     if (birdTop <= 0.0f || birdBottom >= WINDOW_HEIGHT) {
@@ -61,9 +73,9 @@ int CheckCollision() {
     }
 
     // Check pipe collision
-    if (birdRight > pipeX && birdLeft < pipeX + 60.0f) {
+    if (birdRight > g.pipeX && birdLeft < g.pipeX + 60.0f) {
         // Bird is horizontally aligned with pipe
-        if (birdTop < pipeGapY - pipeGap / 2 || birdBottom > pipeGapY + pipeGap / 2) {
+        if (birdTop < g.pipeGapY - pipeGap / 2 || birdBottom > g.pipeGapY + pipeGap / 2) {
             return 1; // Hit pipe
         }
     }
@@ -71,106 +83,132 @@ int CheckCollision() {
     return 0;
 }
 
-void ResetGame() {
-    birdY = 240.0f;
-    birdVelocity = 0.0f;
-    pipeX = 640.0f;
-    pipeGapY = 150.0f + (float)(rand() % 180); // Random gap position
-    gameOver = 0;
-    score = 0;
+void ResetGame(Game& g) {
+    g = Game();
+    g.pipeGapY = 150.0f + (float)(rand() % 180); // Random gap position
+}
+
+//space or a click flaps, or starts over after a crash
+void HandleInput(Game& g, const SimInput& in) {
+    bool flap = (in.event.type == SDL_EVENT_KEY_DOWN && in.event.key.key == SDLK_SPACE) || in.event.type == SDL_EVENT_MOUSE_BUTTON_DOWN;
+    if (!flap) return;
+    if (g.gameOver) {
+        ResetGame(g);
+    }
+    else {
+        g.birdVelocity = -8.0f; // Jump up (negative Y is up)
+    }
+}
+
+//the constants are per 60 hz frame, what the game was tuned at
+void UpdateGame(Game& g, float dt) {
+    if (g.gameOver) return;
+    float frames = dt * 60.0f;
+
+    // Apply gravity
+    g.birdVelocity += 0.5f * frames; // Gravity acceleration
+    g.birdY += g.birdVelocity * frames;
+
+    // Move pipe left
+    g.pipeX -= 3.0f * frames;
+
+    // Reset pipe when it goes off screen
+    if (g.pipeX < -60.0f) {
+        g.pipeX = 640.0f;
+        g.pipeGapY = 150.0f + (float)(rand() % 180); // Random gap position
+        g.score++;
+    }
+
+    // Check for collisions
+    if (CheckCollision(g)) {
+        g.gameOver = 1;
+    }
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     if (SDL_Init(SDL_INIT_VIDEO) < 0) return SDL_APP_FAILURE;
 
-    window = SDL_CreateWindow("Flappy Bird", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    window = renderer.createWindow("Flappy Bird", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
     if (!window) return SDL_APP_FAILURE;
 
-    glcontext = SDL_GL_CreateContext(window);
 
     // Set up 2D orthographic projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, -1, 1); // Flip Y axis
-    glMatrixMode(GL_MODELVIEW);
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, -1, 1)); // Flip Y axis
+
+    renderer.setDepthTest(false); // We don't need depth testing for 2D
 
-    glDisable(GL_DEPTH_TEST); // We don't need depth testing for 2D
+    //offscreen runs step once a frame on this thread so they repeat exactly
+    Game initial;
+    ResetGame(initial);
+    sim.start(initial, SIM_STEP, HandleInput, UpdateGame, !renderer.isOffscreen());
 
-    ResetGame();
+    //--input-probe flaps every few frames offscreen
+    SDL_Event flap = {};
+    flap.type = SDL_EVENT_KEY_DOWN;
+    flap.key.key = SDLK_SPACE;
+    renderer.setInputProbe(flap);
 
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
 
-    if (event->type == SDL_EVENT_KEY_DOWN) {
-        if (event->key.key == SDLK_SPACE) {
-            if (gameOver) {
-                ResetGame();
-            }
-            else {
-                birdVelocity = -8.0f; // Jump up (negative Y is up)
-            }
-        }
-    }
-
-    if (event->type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
-        if (gameOver) {
-            ResetGame();
-        }
-        else {
-            birdVelocity = -8.0f; // Jump up
-        }
+    if ((event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_SPACE) || event->type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
+        Uint64 arrival = InputArrival(event);
+        if (sim.post(event, arrival)) renderer.latency().arrived(arrival);
     }
 
     return SDL_APP_CONTINUE;
 }
 
+//--late-latch changes nothing here. input only shows once a sim step has
+//applied it: the sim thread takes whatever was posted right before each
+//step whatever the frame is doing, and a frame can't show a step that hasn't
+//run. offscreen runs step right at the start of the frame, after the events
+//were handled, and everything drawn depends on that step
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    if (!gameOver) {
-        // Apply gravity
-        birdVelocity += 0.5f; // Gravity acceleration
-        birdY += birdVelocity;
-
-        // Move pipe left
-        pipeX -= 3.0f;
-
-        // Reset pipe when it goes off screen
-        if (pipeX < -60.0f) {
-            pipeX = 640.0f;
-            pipeGapY = 150.0f + (float)(rand() % 180); // Random gap position
-            score++;
-        }
-
-        // Check for collisions
-        if (CheckCollision()) {
-            gameOver = 1;
-        }
+    TRACE_FUNCTION();
+    if (renderer.isOffscreen()) {
+        PerfScope scope(renderer.perf(), "update");
+        sim.advance();
     }
+    const Game& game = sim.newest();
+    renderer.latency().sampled(sim.newestInputArrival());
+
+    {
+        PerfScope scope(renderer.perf(), "draw");
 
-    // Clear screen
-    glClear(GL_COLOR_BUFFER_BIT);
-    glLoadIdentity();
+        // Clear screen
+        renderer.clear(false);
+        renderer.model().loadIdentity();
 
-    // Draw everything
-    DrawBackground();
-    DrawPipes();
-    DrawBird();
+        // Draw everything
+        DrawBackground();
+        DrawPipes(game);
+        DrawBird(game);
 
-    // Draw game over text (simple representation)
-    if (gameOver) {
-        glColor3f(1.0f, 0.0f, 0.0f); // Red
-        DrawRect(200.0f, 200.0f, 240.0f, 80.0f); // Game over "text"
+        // Draw game over text (simple representation)
+        if (game.gameOver) {
+            renderer.color(1.0f, 0.0f, 0.0f); // Red
+            DrawRect(200.0f, 200.0f, 240.0f, 80.0f); // Game over "text"
+        }
     }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    sim.stop();
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
 }
\ No newline at end of file
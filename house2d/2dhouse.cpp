@@ -3,6 +3,8 @@
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_opengl.h>
 
+#include "../common/math3d.h"
+
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 #define STEP_RATE_IN_MILLISECONDS  25
@@ -14,9 +16,8 @@ float angle_of_rotation = 0.0f;
 
 /* Replace gluPerspective with this helper */
 void setPerspective(float fovY, float aspect, float zNear, float zFar) {
-    float ymax = 1;
-    float xmax = ymax * aspect;
-    glFrustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
+    Mat4 projection = Mat4Perspective(fovY * 0.0174532925f, aspect, zNear, zFar);
+    glMultMatrixf(projection.m);
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
@@ -39,7 +40,8 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    setPerspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 1.0f, 500.0f);  // replaces gluPerspective
+    //90 degrees is what the old helper (always +-1 at the near plane) showed
+    setPerspective(90.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 1.0f, 500.0f);  // replaces gluPerspective
 
     glMatrixMode(GL_MODELVIEW);
     glEnable(GL_DEPTH_TEST);
@@ -3,20 +3,25 @@
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_opengl.h>
 
+#include "../common/core_renderer.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    window = SDL_CreateWindow("OpenGL House", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+    window = renderer.createWindow("OpenGL House", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_Log("Couldn't create window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -24,51 +29,54 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
     SDL_SetAppMetadata("OpenGL House", "1.0", "com.bohdanstarunskyi.house2d");
 
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.5f, 0.7f, 1.0f, 1.0f);
+    renderer.setClearColor(0.5f, 0.7f, 1.0f, 1.0f);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1));
 
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event)
 {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+    TRACE_FUNCTION();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(true);
+        renderer.model().loadIdentity();
 
-    glBegin(GL_QUADS);
-    glColor3f(0.8f, 0.6f, 0.2f);
-    glVertex2f(100.0f, 100.0f);
-    glVertex2f(200.0f, 100.0f);
-    glVertex2f(200.0f, 200.0f);
-    glVertex2f(100.0f, 200.0f);
-    glEnd();
+        renderer.begin(GL_QUADS);
+        renderer.color(0.8f, 0.6f, 0.2f);
+        renderer.vertex(100.0f, 100.0f);
+        renderer.vertex(200.0f, 100.0f);
+        renderer.vertex(200.0f, 200.0f);
+        renderer.vertex(100.0f, 200.0f);
+        renderer.end();
 
-    glBegin(GL_TRIANGLES);
-    glColor3f(0.8f, 0.2f, 0.2f);
-    glVertex2d(100.0f, 200.0f);
-    glVertex2d(150.0f, 250.0f);
-    glVertex2d(200.0f, 200.0f);
-    glEnd();
-    SDL_GL_SwapWindow(window);
+        renderer.begin(GL_TRIANGLES);
+        renderer.color(0.8f, 0.2f, 0.2f);
+        renderer.vertex(100.0f, 200.0f);
+        renderer.vertex(150.0f, 250.0f);
+        renderer.vertex(200.0f, 200.0f);
+        renderer.end();
+    }
+    if (!renderer.present()) return renderer.runResult();
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result)
 {
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
-    SDL_GL_DestroyContext(glcontext);
 }
\ No newline at end of file
@@ -1,31 +1,225 @@
 #define SDL_MAIN_USE_CALLBACKS 1
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
-#include <SDL3/SDL_opengl.h>
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include "../common/core_renderer.h"
+#include "../common/math3d.h"
+#include "../common/mesh.h"
+#include "../common/occlusion.h"
+#include "../common/spatial_index.h"
+#include "../common/transform.h"
+#include "../common/village.h"
+#include "../common/trace.h"
 
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 #define STEP_RATE_IN_MILLISECONDS  25
+#define HOUSE_LOT_SIZE 12.0f
+#define VILLAGE_SEED 1234u
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 192
+#define OCCLUSION_OCCLUDERS 48
+#define TRANSFORM_BENCH_FRAMES 240
 
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
 Uint64 previousTime, currentTime;
 float rotationAngle = 0.0f;
 
-void setPerspective(float fovY, float aspect, float zNear, float zFar) {
-    float ymax = 1;
-    float xmax = ymax * aspect;
-    glFrustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
+//--houses N generates a village of N houses, one plain house by default
+std::vector<HouseInstance> houses;
+HouseRenderer houseRenderer;
+
+//--house-model file.obj swaps the procedural house for a model, fitted to
+//every house's size, drawn one house at a time. each house is a node with
+//the fitted model below it, nothing moves so the matrices are built once.
+//the camera is a pivot turning around +y with the eye 15 back and 1 up
+//below it, only the pivot is set as the angle steps so update() redoes two
+//nodes whatever the size of the village
+StaticMesh houseModel;
+TransformHierarchy sceneTransforms;
+std::vector<uint32_t> houseModelNodes;
+uint32_t cameraPivot, cameraNode;
+Bvh houseIndex;
+std::vector<int> visibleHouses;
+CullReport cullReport("Houses");
+
+//o toggles the software occlusion pass and l the levels of detail so both can be compared
+OcclusionBuffer occlusion(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+bool occlusionEnabled = true;
+std::vector<int> occluderCandidates;
+std::vector<unsigned char> occlusionVisible;
+
+struct VillageStats {
+    Uint64 start;
+    int frames;
+    long long inFrustum, occluded, drawn;
+    double occlusionMs, frameMs;
+    long long drawCalls, vertices;
+    long long lod[HOUSE_LOD_COUNT];
+};
+VillageStats villageStats = {};
+
+//the nearest houses in view occlude with their walls only, a box around the
+//pyramid roof would hide more than the roof does. turned houses have no
+//exact wall box and are skipped. every house in view is then tested against
+//the resulting depth
+void occlusionCull()
+{
+    TRACE_FUNCTION();
+    float eyeX = renderer.cameraBlock().eye[0], eyeZ = renderer.cameraBlock().eye[2];
+    auto distance = [eyeX, eyeZ](int id) {
+        float dx = houses[id].x - eyeX, dz = houses[id].z - eyeZ;
+        return dx * dx + dz * dz;
+    };
+    occluderCandidates = visibleHouses;
+    size_t count = std::min(occluderCandidates.size(), (size_t)OCCLUSION_OCCLUDERS);
+    std::nth_element(occluderCandidates.begin(), occluderCandidates.begin() + (count - 1), occluderCandidates.end(),
+        [&distance](int a, int b) { return distance(a) < distance(b); });
+
+    occlusion.begin(renderer.cameraBlock().viewProjection.m);
+    for (size_t i = 0; i < count; i++) {
+        Aabb walls;
+        if (HouseWallBox(houses[occluderCandidates[i]], &walls)) occlusion.addOccluder(walls);
+    }
+    occlusion.rasterize(&GlobalThreadPool());
+
+    occlusionVisible.resize(visibleHouses.size());
+    GlobalThreadPool().parallelFor((int)visibleHouses.size(), 64, [](int begin, int end) {
+        for (int i = begin; i < end; i++) occlusionVisible[i] = occlusion.isVisible(houseIndex.objectBounds(visibleHouses[i]));
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < visibleHouses.size(); i++)
+        if (occlusionVisible[i]) visibleHouses[kept++] = visibleHouses[i];
+    visibleHouses.resize(kept);
+}
+
+//a node per house and one below it for the fitted model, like --house-model
+void buildHouseTransforms(TransformHierarchy& transforms, std::vector<uint32_t>& modelNodes, const std::vector<HouseInstance>& village)
+{
+    transforms.clear();
+    transforms.reserve(village.size() * 2 + 1);
+    modelNodes.resize(village.size());
+    uint32_t root = transforms.create();
+    for (size_t i = 0; i < village.size(); i++) {
+        const HouseInstance& h = village[i];
+        uint32_t house = transforms.create(root);
+        transforms.setPosition(house, MakeVec3(h.x, 0.0f, h.z));
+        transforms.setRotation(house, QuatFromAxisAngle(MakeVec3(0.0f, 1.0f, 0.0f), h.rotation));
+
+        float scale[3] = { 1.0f, 1.0f, 1.0f }, offset[3] = {};
+        if (houseModel.isLoaded()) houseModel.fitTransform(h.width, h.height + h.roofHeight, h.depth, scale, offset);
+        modelNodes[i] = transforms.create(house);
+        transforms.setLocal(modelNodes[i], MakeVec3(offset[0], offset[1], offset[2]), QuatIdentity(),
+            MakeVec3(scale[0], scale[1], scale[2]));
+    }
+}
+
+//--transform-bench N: a village of N houses where 1% of them turn every frame,
+//the dirty update against recomputing every node, no window needed
+void runTransformBenchmark(int houseCount)
+{
+    std::vector<HouseInstance> village;
+    VillageSettings settings = { houseCount, HOUSE_LOT_SIZE, VILLAGE_SEED };
+    GenerateVillage(settings, village, &GlobalThreadPool());
+    TransformHierarchy transforms;
+    std::vector<uint32_t> modelNodes;
+    buildHouseTransforms(transforms, modelNodes, village);
+    transforms.update(&GlobalThreadPool());
+
+    int moving = houseCount / 100 > 0 ? houseCount / 100 : 1;
+    double dirtyMs = 0.0, allMs = 0.0;
+    long long updated = 0;
+    double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+    for (int frame = 0; frame < TRANSFORM_BENCH_FRAMES; frame++) {
+        for (int k = 0; k < moving; k++) {
+            uint32_t house = transforms.parent(modelNodes[((unsigned)frame * 7919u + (unsigned)k * 104729u) % (unsigned)houseCount]);
+            transforms.setRotation(house, QuatFromAxisAngle(MakeVec3(0.0f, 1.0f, 0.0f), frame * 0.01f));
+        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        updated += (long long)transforms.update(&GlobalThreadPool());
+        Uint64 mid = SDL_GetPerformanceCounter();
+        transforms.updateAll(&GlobalThreadPool());
+        allMs += (SDL_GetPerformanceCounter() - mid) * toMs;
+        dirtyMs += (mid - start) * toMs;
+    }
+    SDL_Log("Transforms: %d nodes, %d houses moving: %.0f updated in %.3f ms, all in %.3f ms (x%.1f)",
+        (int)transforms.count(), moving, (double)updated / TRANSFORM_BENCH_FRAMES, dirtyMs / TRANSFORM_BENCH_FRAMES,
+        allMs / TRANSFORM_BENCH_FRAMES, dirtyMs > 0.0 ? allMs / dirtyMs : 0.0);
+}
+
+//--scaling-bench N: generating a village of N houses and updating all of its
+//transforms on 1, 2, 4 ... threads, no window needed
+void runScalingBenchmark(int houseCount)
+{
+    std::vector<HouseInstance> village;
+    VillageSettings settings = { houseCount, HOUSE_LOT_SIZE, VILLAGE_SEED };
+    ThreadPoolScaling("village generation", [&](ThreadPool& pool) {
+        GenerateVillage(settings, village, &pool);
+    });
+    TransformHierarchy transforms;
+    std::vector<uint32_t> modelNodes;
+    buildHouseTransforms(transforms, modelNodes, village);
+    ThreadPoolScaling("transform update", [&](ThreadPool& pool) {
+        transforms.updateAll(&pool);
+    });
+}
+
+void reportVillage(int inFrustum, double occlusionMs, double frameMs, const HouseDrawStats& draw)
+{
+    VillageStats& s = villageStats;
+    if (s.start == 0) s.start = SDL_GetTicks();
+    s.frames++;
+    s.inFrustum += inFrustum;
+    s.drawn += (long long)visibleHouses.size();
+    s.occluded += inFrustum - (long long)visibleHouses.size();
+    s.occlusionMs += occlusionMs;
+    s.frameMs += frameMs;
+    s.drawCalls += draw.drawCalls;
+    s.vertices += draw.vertices;
+    for (int l = 0; l < HOUSE_LOD_COUNT; l++) s.lod[l] += draw.houses[l];
+    if (SDL_GetTicks() - s.start < 1000) return;
+    SDL_Log("Village: %.0f in frustum, %.0f occluded, %.0f drawn in %.0f draw calls, %.3f ms occlusion, %.3f ms frame (occlusion %s)",
+        (double)s.inFrustum / s.frames, (double)s.occluded / s.frames, (double)s.drawn / s.frames,
+        (double)s.drawCalls / s.frames, s.occlusionMs / s.frames, s.frameMs / s.frames, occlusionEnabled ? "on" : "off");
+    SDL_Log("Village lod: %.0f full, %.0f simple, %.0f impostor, %.0f hidden, %.0f vertices (lod %s)",
+        (double)s.lod[HOUSE_LOD_FULL] / s.frames, (double)s.lod[HOUSE_LOD_SIMPLE] / s.frames,
+        (double)s.lod[HOUSE_LOD_IMPOSTOR] / s.frames, (double)s.lod[HOUSE_LOD_HIDDEN] / s.frames,
+        (double)s.vertices / s.frames, houseRenderer.isLodEnabled() ? "on" : "off");
+    s = VillageStats();
+    s.start = SDL_GetTicks();
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
+    MeshOptimizeConfigure(argc, argv);
+    int houseCount = 1;
+    const char* houseModelPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--transform-bench") == 0) {
+            runTransformBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 100000);
+            return SDL_APP_SUCCESS;
+        }
+        if (SDL_strcmp(argv[i], "--scaling-bench") == 0) {
+            runScalingBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 100000);
+            return SDL_APP_SUCCESS;
+        }
+        if (i + 1 >= argc) break;
+        if (SDL_strcmp(argv[i], "--houses") == 0) houseCount = SDL_atoi(argv[i + 1]);
+        if (SDL_strcmp(argv[i], "--house-model") == 0) houseModelPath = argv[i + 1];
+    }
+
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    window = SDL_CreateWindow("3D OpenGL House", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+    window = renderer.createWindow("3D OpenGL House", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_Log("Couldn't create window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -33,15 +227,36 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
     SDL_SetAppMetadata("3D OpenGL House", "1.0", "com.bohdanstarunskyi.house3d");
 
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.5f, 0.7f, 1.0f, 1.0f);
+    renderer.setClearColor(0.5f, 0.7f, 1.0f, 1.0f);
+    renderer.setDepthTest(true);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    setPerspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 1.0f, 500.0f);
+    houseRenderer.init(&renderer);
+    if (houseModelPath && !houseModel.load(renderer, houseModelPath)) {
+        SDL_Log("Keeping the built-in house");
+    }
 
-    glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_DEPTH_TEST);
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (houseCount > 1) {
+        VillageSettings settings = { houseCount, HOUSE_LOT_SIZE, VILLAGE_SEED };
+        GenerateVillage(settings, houses, &GlobalThreadPool());
+    }
+    else {
+        houses.assign(1, DefaultHouse());
+    }
+    Uint64 generated = SDL_GetPerformanceCounter();
+    for (const HouseInstance& house : houses) houseIndex.add(HouseBounds(house));
+    houseIndex.build();
+    if (houseModel.isLoaded()) buildHouseTransforms(sceneTransforms, houseModelNodes, houses);
+    cameraPivot = sceneTransforms.create();
+    cameraNode = sceneTransforms.create(cameraPivot);
+    sceneTransforms.setPosition(cameraNode, MakeVec3(0.0f, 1.0f, 15.0f));
+    sceneTransforms.update(&GlobalThreadPool());
+    if (houses.size() > 1) {
+        double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+        SDL_Log("Village: %d houses generated in %.2f ms on %d threads, bvh built in %.2f ms",
+            (int)houses.size(), (generated - start) * toMs, GlobalThreadPool().threadCount() + 1,
+            (SDL_GetPerformanceCounter() - generated) * toMs);
+    }
 
     previousTime = SDL_GetTicks();
     return SDL_APP_CONTINUE;
@@ -49,116 +264,97 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event)
 {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_O) {
+        occlusionEnabled = !occlusionEnabled;
+    }
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_L) {
+        houseRenderer.setLodEnabled(!houseRenderer.isLodEnabled());
+    }
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate)
 {
-    currentTime = SDL_GetTicks();
-    if (currentTime > previousTime + STEP_RATE_IN_MILLISECONDS) {
-        rotationAngle += 0.5f;
-        if (rotationAngle > 360.0f) {
-            rotationAngle -= 360.0f;
+    TRACE_FUNCTION();
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    {
+        PerfScope scope(renderer.perf(), "update");
+        currentTime = SDL_GetTicks();
+        //offscreen every frame is a step, so runs repeat exactly
+        if (renderer.isOffscreen() || currentTime > previousTime + STEP_RATE_IN_MILLISECONDS) {
+            rotationAngle += 0.5f;
+            if (rotationAngle > 360.0f) {
+                rotationAngle -= 360.0f;
+            }
+            previousTime = currentTime;
+            sceneTransforms.setRotation(cameraPivot, QuatFromAxisAngle(MakeVec3(0.0f, 1.0f, 0.0f), -rotationAngle * 0.0174532925f));
         }
-        previousTime = currentTime;
-    }
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-
-    glTranslatef(0.0f, -1.0f, -15.0f);
-
-    glRotatef(rotationAngle, 0.0f, 1.0f, 0.0f);
-
-    float width = 5.0f;   
-    float height = 3.0f;  
-    float depth = 5.0f;  
-    float halfWidth = width / 2.0f;
-    float halfDepth = depth / 2.0f;
-
-    float wallColor[3] = { 0.8f, 0.6f, 0.2f };  
-
-    //4 walls
-    glBegin(GL_QUADS);
-    glColor3fv(wallColor);
-
-    //front
-    glVertex3f(-halfWidth, 0.0f, halfDepth);       
-    glVertex3f(halfWidth, 0.0f, halfDepth);        
-    glVertex3f(halfWidth, height, halfDepth);      
-    glVertex3f(-halfWidth, height, halfDepth);    
-
-    //back
-    glColor3fv(wallColor);
-    glVertex3f(-halfWidth, 0.0f, -halfDepth);      
-    glVertex3f(halfWidth, 0.0f, -halfDepth);       
-    glVertex3f(halfWidth, height, -halfDepth);     
-    glVertex3f(-halfWidth, height, -halfDepth);   
-
-    //left
-    glColor3fv(wallColor);
-    glVertex3f(-halfWidth, 0.0f, halfDepth);       
-    glVertex3f(-halfWidth, 0.0f, -halfDepth);     
-    glVertex3f(-halfWidth, height, -halfDepth);    
-    glVertex3f(-halfWidth, height, halfDepth);     
-
-    //right
-    glColor3fv(wallColor);
-    glVertex3f(halfWidth, 0.0f, halfDepth);        
-    glVertex3f(halfWidth, 0.0f, -halfDepth);       
-    glVertex3f(halfWidth, height, -halfDepth);    
-    glVertex3f(halfWidth, height, halfDepth);  
-
-	//floor
-    glColor3f(0.5f, 0.5f, 0.5f);  
-    glVertex3f(-halfWidth, 0.0f, halfDepth);       
-    glVertex3f(halfWidth, 0.0f, halfDepth);       
-    glVertex3f(halfWidth, 0.0f, -halfDepth);       
-    glVertex3f(-halfWidth, 0.0f, -halfDepth); 
-
-    glEnd();
-
-    float roofHeight = 3.0f;
-    float roofPeak = height + roofHeight;
-    float roofColor[3] = { 0.9f, 0.2f, 0.1f }; 
-
-    //roof
-    glBegin(GL_TRIANGLES);
-    glColor3fv(roofColor);
-
-    //front roof
-    glVertex3f(-halfWidth, height, halfDepth);     
-    glVertex3f(0.0f, roofPeak, 0.0f);              
-    glVertex3f(halfWidth, height, halfDepth);   
-
-	//back roof
-    glColor3fv(roofColor);
-    glVertex3f(-halfWidth, height, -halfDepth);    
-    glVertex3f(0.0f, roofPeak, 0.0f);             
-    glVertex3f(halfWidth, height, -halfDepth);    
-
-	//left roof
-    glColor3fv(roofColor);
-    glVertex3f(-halfWidth, height, halfDepth);     
-    glVertex3f(0.0f, roofPeak, 0.0f);            
-    glVertex3f(-halfWidth, height, -halfDepth); 
-
-	//right roof
-    glColor3fv(roofColor);
-    glVertex3f(halfWidth, height, halfDepth);      
-    glVertex3f(0.0f, roofPeak, 0.0f);             
-    glVertex3f(halfWidth, height, -halfDepth);   
-    glEnd();
-
-    SDL_GL_SwapWindow(window);
+        sceneTransforms.update();
+
+        //90 degrees is what the old helper (always +-1 at the near plane) showed
+        int width, height;
+        renderer.viewportSize(&width, &height);
+        Mat4 projection = Mat4Perspective(90.0f * 0.0174532925f, (float)width / (float)height, 1.0f, 500.0f);
+        renderer.setCamera(Mat4RigidInverse(sceneTransforms.world(cameraNode)), projection);
+    }
+
+    int inFrustum;
+    double occlusionMs = 0.0;
+    {
+        PerfScope scope(renderer.perf(), "cull");
+        //bvh node bounds are in world space, the camera turns around them
+        Frustum frustum = FrustumFromMatrix(renderer.cameraBlock().viewProjection.m);
+        CullStats stats;
+        houseIndex.cull(frustum, visibleHouses, &stats);
+        if (houses.size() > 1) cullReport.add(stats);
+
+        inFrustum = (int)visibleHouses.size();
+        if (occlusionEnabled && visibleHouses.size() > 1) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            occlusionCull();
+            occlusionMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        }
+    }
+
+    HouseDrawStats drawStats = {};
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(true);
+        if (houseModel.isLoaded()) {
+            for (int id : visibleHouses) {
+                const HouseInstance& h = houses[id];
+                float color[3] = { h.wallColor[0] / 255.0f, h.wallColor[1] / 255.0f, h.wallColor[2] / 255.0f };
+                houseModel.draw(sceneTransforms.world(houseModelNodes[id]), color);
+            }
+            drawStats.houses[HOUSE_LOD_FULL] = (int)visibleHouses.size();
+            drawStats.drawCalls = (int)visibleHouses.size();
+            drawStats.vertices = (long long)visibleHouses.size() * houseModel.triangles() * 3;
+        }
+        else {
+            houseRenderer.draw(houses, visibleHouses);
+            drawStats = houseRenderer.stats();
+        }
+    }
+
+    if (!renderer.present()) return renderer.runResult();
+    if (houses.size() > 1) {
+        double frameMs = (double)(SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        reportVillage(inFrustum, occlusionMs, frameMs, drawStats);
+    }
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result)
 {
+    TraceShutdown();
+    houseRenderer.shutdown();
+    houseModel.release();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
-    SDL_GL_DestroyContext(glcontext);
-}
\ No newline at end of file
+}
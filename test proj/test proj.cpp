@@ -8,6 +8,10 @@
 #include <stdio.h>
 #include <corecrt_math_defines.h>
 
+#include "../common/core_renderer.h"
+#include "../common/input_latency.h"
+#include "../common/trace.h"
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
@@ -30,7 +34,7 @@ bool isGameOver = false;
 bool hasPrintedGameOverMessage = false;
 
 SDL_Window* window = NULL;
-SDL_GLContext glContext = NULL;
+CoreRenderer renderer;
 
 Uint64 previousTime = 0;
 Uint64 currentTime = 0;
@@ -50,60 +54,69 @@ void initPipes() {
 }
 
 void drawBird() {
-    glColor3f(0.918f, 0.675f, 0.545f);
-    glBegin(GL_TRIANGLE_FAN);
+    renderer.color(0.918f, 0.675f, 0.545f);
+    renderer.begin(GL_TRIANGLE_FAN);
     float birdX = -WINDOW_WIDTH / 4.0f;
-    glVertex2f(birdX, birdY);         
+    renderer.vertex(birdX, birdY);         
 
     for (int angleDeg = 0; angleDeg <= 360; angleDeg += 10) {
         float angleRad = angleDeg * M_PI / 180.0f;
         float x = BIRD_RADIUS * cosf(angleRad);
         float y = BIRD_RADIUS * sinf(angleRad);
-        glVertex2f(birdX + x, birdY + y);
+        renderer.vertex(birdX + x, birdY + y);
     }
-    glEnd();
+    renderer.end();
 }
 
 void drawPipes() {
-    glColor3f(0.427f, 0.349f, 0.478f);
+    renderer.color(0.427f, 0.349f, 0.478f);
 
     for (int i = 0; i < NUM_PIPES; ++i) {
         float x = pipes[i].x;
         float gapY = pipes[i].gapY;
 
         //top pipe
-        glBegin(GL_QUADS);
-        glVertex2f(x, gapY + PIPE_GAP / 2.0f);
-        glVertex2f(x + PIPE_WIDTH, gapY + PIPE_GAP / 2.0f);
-        glVertex2f(x + PIPE_WIDTH, WINDOW_HEIGHT / 2.0f);
-        glVertex2f(x, WINDOW_HEIGHT / 2.0f);
-        glEnd();
+        renderer.begin(GL_QUADS);
+        renderer.vertex(x, gapY + PIPE_GAP / 2.0f);
+        renderer.vertex(x + PIPE_WIDTH, gapY + PIPE_GAP / 2.0f);
+        renderer.vertex(x + PIPE_WIDTH, WINDOW_HEIGHT / 2.0f);
+        renderer.vertex(x, WINDOW_HEIGHT / 2.0f);
+        renderer.end();
 
         //bottom pipe
-        glBegin(GL_QUADS);
-        glVertex2f(x, -WINDOW_HEIGHT / 2.0f);
-        glVertex2f(x + PIPE_WIDTH, -WINDOW_HEIGHT / 2.0f);
-        glVertex2f(x + PIPE_WIDTH, gapY - PIPE_GAP / 2.0f);
-        glVertex2f(x, gapY - PIPE_GAP / 2.0f);
-        glEnd();
+        renderer.begin(GL_QUADS);
+        renderer.vertex(x, -WINDOW_HEIGHT / 2.0f);
+        renderer.vertex(x + PIPE_WIDTH, -WINDOW_HEIGHT / 2.0f);
+        renderer.vertex(x + PIPE_WIDTH, gapY - PIPE_GAP / 2.0f);
+        renderer.vertex(x, gapY - PIPE_GAP / 2.0f);
+        renderer.end();
     }
 }
 
 void drawGround() {
-    glColor3f(0.710f, 0.396f, 0.463f);
-
-    glBegin(GL_QUADS);
-    glVertex2f(-WINDOW_WIDTH / 2.0f, GROUND_Y);
-    glVertex2f(WINDOW_WIDTH / 2.0f, GROUND_Y);
-    glVertex2f(WINDOW_WIDTH / 2.0f, -WINDOW_HEIGHT + GROUND_Y);
-    glVertex2f(-WINDOW_WIDTH / 2.0f, -WINDOW_HEIGHT + GROUND_Y);
-    glEnd();
+    renderer.color(0.710f, 0.396f, 0.463f);
+
+    renderer.begin(GL_QUADS);
+    renderer.vertex(-WINDOW_WIDTH / 2.0f, GROUND_Y);
+    renderer.vertex(WINDOW_WIDTH / 2.0f, GROUND_Y);
+    renderer.vertex(WINDOW_WIDTH / 2.0f, -WINDOW_HEIGHT + GROUND_Y);
+    renderer.vertex(-WINDOW_WIDTH / 2.0f, -WINDOW_HEIGHT + GROUND_Y);
+    renderer.end();
 }
 
-void updatePhysics(float deltaTime) {
+void updateBird(float deltaTime) {
+    TRACE_FUNCTION();
     birdY += birdVelocityY * deltaTime;
     birdVelocityY += GRAVITY * deltaTime;
 
+    if (birdY - BIRD_RADIUS < GROUND_Y) {
+        birdY = GROUND_Y + BIRD_RADIUS;
+        birdVelocityY = 0.0f;
+    }
+}
+
+void updatePipes(float deltaTime) {
+    TRACE_FUNCTION();
     //update pipe posiions and reset if off-screen
     for (int i = 0; i < NUM_PIPES; ++i) {
         pipes[i].x -= PIPE_SPEED * deltaTime;
@@ -113,14 +126,10 @@ void updatePhysics(float deltaTime) {
             pipes[i].gapY = (rand() % 300) - 150;
         }
     }
-
-    if (birdY - BIRD_RADIUS < GROUND_Y) {
-        birdY = GROUND_Y + BIRD_RADIUS;
-        birdVelocityY = 0.0f;
-    }
 }
 
 void checkCollision() {
+    TRACE_FUNCTION();
     float birdX = -WINDOW_WIDTH / 4.0f;
 
     for (int i = 0; i < NUM_PIPES; ++i) {
@@ -158,39 +167,45 @@ void resetGame() {
 
 void drawGameOver() {
     //bg
-    glColor3f(0.110f, 0.114f, 0.129f);
-    glBegin(GL_QUADS);
-    glVertex2f(-200.0f, 200.0f);
-    glVertex2f(200.0f, 200.0f);
-    glVertex2f(200.0f, -200.0f);
-    glVertex2f(-200.0f, -200.0f);
-    glEnd();
+    renderer.color(0.110f, 0.114f, 0.129f);
+    renderer.begin(GL_QUADS);
+    renderer.vertex(-200.0f, 200.0f);
+    renderer.vertex(200.0f, 200.0f);
+    renderer.vertex(200.0f, -200.0f);
+    renderer.vertex(-200.0f, -200.0f);
+    renderer.end();
 
     //x
-    glLineWidth(10.0f);
-    glColor3f(0.733f, 0.608f, 0.690f);
-    glBegin(GL_LINES);
-    glVertex2f(-150.0f, -150.0f);
-    glVertex2f(150.0f, 150.0f);
-
-    glVertex2f(-150.0f, 150.0f);
-    glVertex2f(150.0f, -150.0f);
-    glEnd();
+    renderer.lineWidth(10.0f);
+    renderer.color(0.733f, 0.608f, 0.690f);
+    renderer.begin(GL_LINES);
+    renderer.vertex(-150.0f, -150.0f);
+    renderer.vertex(150.0f, 150.0f);
+
+    renderer.vertex(-150.0f, 150.0f);
+    renderer.vertex(150.0f, -150.0f);
+    renderer.end();
+    renderer.lineWidth(1.0f);
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
     SDL_Init(SDL_INIT_VIDEO);
 
-    window = SDL_CreateWindow("Flappy Bird Clone", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
-    glContext = SDL_GL_CreateContext(window);
+    window = renderer.createWindow("Flappy Bird Clone", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    if (!window) return SDL_APP_FAILURE;
 
-    glClearColor(0.208f, 0.314f, 0.439f, 1.0f);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
+    renderer.setClearColor(0.208f, 0.314f, 0.439f, 1.0f);
+    renderer.setCamera(Mat4Identity(), Mat4Ortho(-WINDOW_WIDTH / 2.0f, WINDOW_WIDTH / 2.0f,
         -WINDOW_HEIGHT / 2.0f, WINDOW_HEIGHT / 2.0f,
-        -1.0f, 1.0f);
-    glMatrixMode(GL_MODELVIEW);
+        -1.0f, 1.0f));
+
+    //--input-probe flaps every few frames offscreen
+    SDL_Event flap = {};
+    flap.type = SDL_EVENT_KEY_DOWN;
+    flap.key.key = SDLK_SPACE;
+    renderer.setInputProbe(flap);
 
     resetGame();
     previousTime = SDL_GetTicks();
@@ -198,12 +213,16 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
 
     if (event->type == SDL_EVENT_KEY_DOWN) {
         if (event->key.key == SDLK_SPACE) {
+            renderer.latency().arrived(InputArrival(event));
             if (isGameOver) {
                 resetGame();
             }
@@ -217,34 +236,60 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
+    TRACE_FUNCTION();
+    //late latching leaves the bird, the only thing input moves, until the
+    //pipes are updated and drawn, and takes the input that came in meanwhile
+    bool late = InputLatencyConfig().lateLatch;
+    if (!late) renderer.latency().sampled(SDL_GetTicksNS());
+
     currentTime = SDL_GetTicks();
-    float deltaTime = (currentTime - previousTime) / 1000.0f;
+    float deltaTime = renderer.frameTime((currentTime - previousTime) / 1000.0f);
     previousTime = currentTime;
 
     if (!isGameOver) {
-        updatePhysics(deltaTime);
-        checkCollision();
+        PerfScope scope(renderer.perf(), "update");
+        if (!late) updateBird(deltaTime);
+        updatePipes(deltaTime);
+        if (!late) checkCollision();
+    }
+
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(false);
+        renderer.model().loadIdentity();
+
+        drawGround();
+        drawPipes();
     }
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    glLoadIdentity();
+    if (late) {
+        InputLatchEvents([](SDL_Event* e) { SDL_AppEvent(NULL, e); });
+        renderer.latency().sampled(SDL_GetTicksNS());
+        if (!isGameOver) {
+            PerfScope scope(renderer.perf(), "update");
+            updateBird(deltaTime);
+            checkCollision();
+        }
+    }
 
-    drawGround();
-    drawPipes();
-    drawBird();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        drawBird();
 
-    if (isGameOver) {
-        drawGameOver();
+        if (isGameOver) {
+            drawGameOver();
+        }
     }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     SDL_Delay(16); //~60 FPS
 
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glContext);
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
@@ -5,25 +5,38 @@
 #include <vector>
 #include <algorithm>
 
+#include "../common/core_renderer.h"
+#include "../common/frame_arena.h"
+#include "../common/object_pool.h"
+#include "../common/trace.h"
+#include "../common/transform.h"
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
+#define BOARD_TOP 3.0f //where bricks spawn, a brick that lands up there ends the game
+#define BOARD_COLUMNS 3
+#define BOARD_ROWS 24 //brick heights from the floor to below BOARD_TOP
+#define BRICK_CAPACITY (BOARD_COLUMNS * BOARD_ROWS + 1) //a full board and the falling brick
+#define POOL_BENCH_STEPS 1000
 
 static SDL_Window* window = nullptr;
-SDL_GLContext glcontext = nullptr;
+CoreRenderer renderer;
 
-void setPerspective(float fovY, float aspect, float zNear, float zFar) {
-    float ymax = 1;
-    float xmax = ymax * aspect;
-    glFrustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
-}
+//the board is a node and every pool slot a node below it, placed when its
+//brick spawns or moves. only the falling brick moves, so update() redoes
+//one node a frame and the landed ones keep their cached matrices
+TransformHierarchy boardTransforms;
+uint32_t boardNode;
+std::vector<uint32_t> brickNodes;
 
 class Brick {
 public:
     float x = 0.0f;     
-    float y = 3.0f; 
+    float y = BOARD_TOP;
     float size = 0.2f;   //width/height
     int col = 0;//column index: -1=left, 0=center, 1=right
     bool falling = true;
+    uint32_t node = TRANSFORM_NONE; //its slot's node
 
     void update() {
         if (falling) y -= 0.02f;
@@ -43,27 +56,52 @@ public:
         }
     }
 
+    void place() const {
+        boardTransforms.setLocal(node, MakeVec3(x, y, 0.0f), QuatIdentity(), MakeVec3(size * 0.9f, size * 0.9f, 1.0f));
+    }
+
     void draw() const {
         //square
-        glPushMatrix();
-        glTranslatef(x, y, 0.0f);
-        glScalef(size * 0.9f, size * 0.9f, 1.0f);
-        glColor3f(1.0f, 0.0f, 0.0f);
-        glBegin(GL_QUADS);
-        glVertex2f(-0.5f, -0.5f);
-        glVertex2f(0.5f, -0.5f);
-        glVertex2f(0.5f, 0.5f);
-        glVertex2f(-0.5f, 0.5f);
-        glEnd();
-        glPopMatrix();
+        MatrixStack& model = renderer.model();
+        model.push();
+        model.load(boardTransforms.world(node));
+        renderer.color(1.0f, 0.0f, 0.0f);
+        renderer.begin(GL_QUADS);
+        renderer.vertex(-0.5f, -0.5f);
+        renderer.vertex(0.5f, -0.5f);
+        renderer.vertex(0.5f, 0.5f);
+        renderer.vertex(-0.5f, 0.5f);
+        renderer.end();
+        model.pop();
     }
 };
 
-//all bricks in game
-std::vector<Brick> bricks = { Brick() };
+//all bricks in game, the falling one is activeBrick
+ObjectPool<Brick> bricks(BRICK_CAPACITY);
+PoolHandle activeBrick;
+
+//never full: the board starts over before a column outgrows BOARD_ROWS
+PoolHandle spawnBrick() {
+    PoolHandle handle = bricks.spawn();
+    Brick* b = bricks.get(handle);
+    b->node = brickNodes[handle.slot];
+    b->place();
+    return handle;
+}
+
+void buildBoardTransforms() {
+    boardTransforms.reserve(BRICK_CAPACITY + 1);
+    boardNode = boardTransforms.create();
+    boardTransforms.setLocal(boardNode, MakeVec3(0.0f, 0.0f, -5.0f), QuatIdentity(), MakeVec3(3.0f, 1.0f, 1.0f));
+    brickNodes.resize(BRICK_CAPACITY);
+    for (uint32_t& node : brickNodes) node = boardTransforms.create(boardNode);
+}
 
 void clearFullRows() {
-    std::vector<float> rowYs;
+    TRACE_FUNCTION();
+    PerfCounterScope counters("clearFullRows");
+    ArenaVector<float> rowYs{ ArenaAllocator<float>(FrameScratch()) };
+    rowYs.reserve(bricks.size());
 
     for (const auto& b : bricks) {
         if (!b.falling) {
@@ -80,91 +118,160 @@ void clearFullRows() {
         }
 
         if (colFilled[0] && colFilled[1] && colFilled[2]) {
-            bricks.erase(std::remove_if(bricks.begin(), bricks.end(),
-                [=](const Brick& b) {
-                    return !b.falling && fabs(b.y - yCheck) < 0.01f;
-                }), bricks.end());
+            bricks.despawnIf([=](const Brick& b) {
+                return !b.falling && fabs(b.y - yCheck) < 0.01f;
+            });
+        }
+    }
+}
+
+//--pool-bench N: N bricks with a tenth of them replaced every step, erasing
+//from a vector the way the board used to against the pool, no window needed
+void runPoolBenchmark(int count) {
+    if (count < 10) count = 10;
+    int replaced = count / 10;
+    double ms[2] = { 0.0, 0.0 };
+    float checksum[2] = { 0.0f, 0.0f };
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<Brick> list;
+        ObjectPool<Brick> pool(count);
+        list.reserve(count);
+        for (int i = 0; i < count; i++) {
+            if (pass) pool.spawn();
+            else list.push_back(Brick());
+        }
+        Uint32 seed = 12345;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int step = 0; step < POOL_BENCH_STEPS; step++) {
+            for (int k = 0; k < replaced; k++) {
+                seed = seed * 1664525u + 1013904223u;
+                int victim = (int)((seed >> 8) % (Uint32)count);
+                if (pass) {
+                    pool.despawn(pool.handleAt(victim));
+                    pool.spawn();
+                } else {
+                    list.erase(list.begin() + victim);
+                    list.push_back(Brick());
+                }
+            }
+            if (pass) {
+                for (Brick& b : pool) b.update();
+            } else {
+                for (Brick& b : list) b.update();
+            }
+        }
+        ms[pass] = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / POOL_BENCH_STEPS;
+        if (pass) {
+            for (const Brick& b : pool) checksum[pass] += b.y;
+        } else {
+            for (const Brick& b : list) checksum[pass] += b.y;
         }
     }
+    SDL_Log("Pool: %d bricks, %d replaced a step: vector %.3f ms/step, pool %.3f ms/step (x%.2f), checksum vector %.1f, pool %.1f",
+        count, replaced, ms[0], ms[1], ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, checksum[0], checksum[1]);
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    TraceConfigure(argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--pool-bench") == 0) {
+            runPoolBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 10000);
+            return SDL_APP_SUCCESS;
+        }
+    }
+    renderer.configure(argc, argv);
     if (SDL_Init(SDL_INIT_VIDEO) < 0) return SDL_APP_FAILURE;
+    buildBoardTransforms();
+    activeBrick = spawnBrick();
 
-    window = SDL_CreateWindow("Mini Tetris", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    window = renderer.createWindow("Mini Tetris", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
     if (!window) return SDL_APP_FAILURE;
 
-    glcontext = SDL_GL_CreateContext(window);
-    glClearColor(0.9f, 0.9f, 1.0f, 1.0f);
+    renderer.setClearColor(0.9f, 0.9f, 1.0f, 1.0f);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    setPerspective(45, (double)WINDOW_WIDTH / WINDOW_HEIGHT, 1, 10);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glEnable(GL_DEPTH_TEST);
+    //90 degrees is what the old frustum (always +-1 at the near plane) showed
+    renderer.setCamera(Mat4Identity(), Mat4Perspective(90.0f * 0.0174532925f, (float)WINDOW_WIDTH / WINDOW_HEIGHT, 1, 10));
+    renderer.setDepthTest(true);
 
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) return SDL_APP_SUCCESS;
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
 
     if (event->type == SDL_EVENT_KEY_DOWN) {
-        Brick& b = bricks.back();
-        if (event->key.key == SDLK_LEFT) b.moveLeft();
-        if (event->key.key == SDLK_RIGHT) b.moveRight();
+        Brick* b = bricks.get(activeBrick);
+        if (b && event->key.key == SDLK_LEFT) b->moveLeft();
+        if (b && event->key.key == SDLK_RIGHT) b->moveRight();
     }
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-    glTranslatef(0.0f, 0.0f, -5.0f);
-    glScalef(3.0f, 1.0f, 1.0f); 
-
-    glBegin(GL_LINE_LOOP);
-    glColor3f(0, 0, 0);
-    glVertex2f(-1.5f, -2.0f);
-    glVertex2f(-1.5f, 3.0f);
-    glVertex2f(1.5f, 3.0f);
-    glVertex2f(1.5f, -2.0f);
-    glEnd();
-
-    Brick& active = bricks.back();
-    active.update();
-
-    if (active.y - active.size < -2.0f)
-        active.falling = false;
-
-    //check for collision with fixed bricks
-    for (const auto& b : bricks) {
-        if (&b == &active || b.falling) continue;
+    TRACE_FUNCTION();
+    FrameScratch().reset();
+    {
+        PerfScope scope(renderer.perf(), "update");
+        Brick& active = *bricks.get(activeBrick);
+        active.update();
 
-        if (active.falling && active.col == b.col &&
-            b.y < active.y && (active.y - b.y) < active.size) {
-            active.y = b.y + active.size;
+        if (active.y - active.size < -2.0f)
             active.falling = false;
+
+        //check for collision with fixed bricks
+        for (const auto& b : bricks) {
+            if (&b == &active || b.falling) continue;
+
+            if (active.falling && active.col == b.col &&
+                b.y < active.y && (active.y - b.y) < active.size) {
+                active.y = b.y + active.size;
+                active.falling = false;
+            }
         }
-    }
 
-    //spawn next
-    if (!active.falling) {
-        clearFullRows();
-        bricks.push_back(Brick());
+        active.place();
+
+        //spawn next
+        if (!active.falling) {
+            bool toppedOut = active.y > BOARD_TOP - active.size * 0.5f;
+            clearFullRows();
+            if (toppedOut) {
+                SDL_Log("Board full with %d bricks, starting over", bricks.size());
+                bricks.clear();
+            }
+            activeBrick = spawnBrick();
+        }
     }
 
-    for (auto& b : bricks)
-        b.draw();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(true);
+        boardTransforms.update();
+        renderer.model().load(boardTransforms.world(boardNode));
+
+        renderer.begin(GL_LINE_LOOP);
+        renderer.color(0, 0, 0);
+        renderer.vertex(-1.5f, -2.0f);
+        renderer.vertex(-1.5f, 3.0f);
+        renderer.vertex(1.5f, 3.0f);
+        renderer.vertex(1.5f, -2.0f);
+        renderer.end();
+
+        for (auto& b : bricks)
+            b.draw();
+    }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     SDL_Delay(16); // ~60 FPS
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-    SDL_GL_DestroyContext(glcontext);
+    TraceShutdown();
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
@@ -8,118 +8,496 @@
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 #define STEP_RATE_IN_MILLISECONDS 25
+#define TEXTURE_MIP_FILTER MIP_FILTER_KAISER
+#define TEXTURE_MAX_ANISOTROPY 8.0f
+#define TEXTURE_COMPRESSION 1 //bc1/bc3 when the driver has s3tc
+#define TEXTURE_BC_QUALITY BC_QUALITY_NORMAL
+#define TEXTURE_ATLAS 1
+#define ATLAS_PAGE_SIZE 4096
+#define ATLAS_GUTTER 16
+#define ATLAS_MIP_LEVELS 5 //box mips stay inside a 16 texel gutter down to level 4
+#define GROUND_VIRTUAL_TEXTURE 1
+#define GROUND_TILE_FILE "ground.vtiles"
+#define GROUND_WORLD_SIZE 1024.0f
+#define GROUND_TILES 64            //level 0 tiles per side, 16 m each
+#define GROUND_TILE_SIZE 62        //+1 texel border on each side = 64 texel slots
+#define GROUND_CACHE_SLOTS 16      //16x16 slots, a 1024x1024 cache whatever the world size
+#define GROUND_LOD_DISTANCE 2.0f
+#define GROUND_UPLOADS_PER_FRAME 8
 
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "../common/atlas.h"
+#include "../common/core_renderer.h"
+#include "../common/texture_cache.h"
+#include "../common/virtual_texture.h"
+#include "../common/trace.h"
+#include "../common/transform.h"
+
 static SDL_Window* window = NULL;
-SDL_GLContext glcontext = NULL;
+CoreRenderer renderer;
 Uint64 previousTime, currentTime;
 
 float rotationAngle = 0.0f;
 float posX = 0.0f, posZ = 0.0f;
 float moveSpeed = 0.1f;
 
-GLuint textureGrass = 0;
-GLuint textureWood = 0;
+//where an image ended up: its own texture, or a rect inside an atlas page
+//where an image ended up, the whole of its own texture until it is packed
+struct TexRegion {
+    CoreTexture texture;
+    AtlasRect rect = { 0, 0, 0, 0, 0, 0.0f, 0.0f, 1.0f, 1.0f };
+};
+
+TexRegion grassRegion;
+TexRegion woodRegion;
+
+//the cube and the small floor, built once their regions are known
+struct SceneVertex {
+    float x, y, z;
+    float u, v;
+};
+CoreMesh cubeMesh;
+CoreMesh groundMesh;
+
+//the cube and the ground are nodes at the origin. the camera is a pivot
+//turned against rotationAngle with the eye moved to (-posX, 0, 15 - posZ)
+//below it, both set again only on key presses
+TransformHierarchy sceneTransforms;
+uint32_t cubeNode, groundNode, cameraPivot, cameraNode;
+
+VirtualTexture groundTexture;
+bool groundVirtual = false;
+CullReport groundReport("Ground tiles");
+bool textureCompression = false;
+
+//uploads every mip level straight out of a cache blob (mapped file or freshly built)
+CoreTexture UploadTexture(const unsigned char* blob, GLint wrapMode)
+{
+    const TexCacheHeader* header = (const TexCacheHeader*)blob;
+    GLenum format = (header->format == TEXCACHE_RGBA8) ? GL_RGBA : GL_RGB;
+    GLenum compressedFormat = (header->format == TEXCACHE_BC3) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    CoreTexture texture;
+    //the software rasterizer samples nearest from level 0, compression is off headless
+    if (renderer.isHeadless()) {
+        const TexCacheLevel& level = header->levels[0];
+        renderer.createTexture(&texture, level.width, level.height, TexCacheChannels(header->format), blob + level.offset, wrapMode);
+        return texture;
+    }
+    texture.width = header->levels[0].width;
+    texture.height = header->levels[0].height;
+    glGenTextures(1, &texture.id);
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->levelCount - 1);
+
+    //the ground is seen at grazing angles, trilinear alone blurs it out
+    if (SDL_GL_ExtensionSupported("GL_EXT_texture_filter_anisotropic")) {
+        GLfloat maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+            maxAnisotropy < TEXTURE_MAX_ANISOTROPY ? maxAnisotropy : TEXTURE_MAX_ANISOTROPY);
+    }
 
-void setPerspective(float fovY, float aspect, float zNear, float zFar) {
-    float ymax = tanf((fovY * M_PI / 180.0f) * 0.5f) * zNear;
-    float xmax = ymax * aspect;
-    glFrustum(-xmax, xmax, -ymax, ymax, zNear, zFar);
+    //rgb rows are not 4-byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        const TexCacheLevel& level = header->levels[i];
+        if (TexCacheIsCompressed(header->format)) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, compressedFormat, level.width, level.height, 0, (GLsizei)level.size, blob + level.offset);
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, blob + level.offset);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
 }
 
-GLuint LoadTexture(const char* filename)
+//cache hit: no decode, levels go from the mapping to the driver.
+//miss: build() fills a raw blob, which is compressed, stored and uploaded
+CoreTexture LoadCachedTexture(const char* cachePath, uint64_t hash, uint64_t sourceSize, MipFilter filter, GLint wrapMode,
+    const std::function<bool(std::vector<unsigned char>&)>& build)
 {
-    int width, height, channels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(filename, &width, &height, &channels, 0);
-    if (!data) {
+    uint32_t compression = textureCompression ? TEXTURE_BC_QUALITY + 1 : 0;
+    TexCacheImage cached;
+    if (TexCacheOpen(cachePath, hash, sourceSize, filter, compression, &cached)) {
+        CoreTexture texture = UploadTexture(cached.file.data, wrapMode);
+        TexCacheClose(&cached);
+        return texture;
+    }
+
+    std::vector<unsigned char> blob;
+    if (!build(blob)) return CoreTexture();
+
+    //compressed once here, later runs map the bc blocks and skip the encoder too
+    if (textureCompression) {
+        std::vector<unsigned char> raw;
+        raw.swap(blob);
+        TexCacheCompress(raw, TEXTURE_BC_QUALITY, blob);
+    }
+
+    if (!TexCacheWrite(cachePath, blob)) {
+        SDL_Log("Couldn't write texture cache %s\n", cachePath);
+    }
+    return UploadTexture(blob.data(), wrapMode);
+}
+
+CoreTexture LoadTexture(const char* filename)
+{
+    TRACE_FUNCTION();
+    MappedFile source;
+    if (!MapFile(filename, &source)) {
         SDL_Log("Failed to load texture %s\n", filename);
-        return 0;
+        return CoreTexture();
     }
-    GLenum format = (channels == 3) ? GL_RGB : GL_RGBA;
-    GLuint texId;
-    glGenTextures(1, &texId);
-    glBindTexture(GL_TEXTURE_2D, texId);
+    uint64_t hash = TexCacheHash(source.data, source.size);
+
+    char cachePath[512];
+    TexCachePath(filename, cachePath, sizeof(cachePath));
+
+    CoreTexture texture = LoadCachedTexture(cachePath, hash, source.size, TEXTURE_MIP_FILTER, GL_REPEAT, [&](std::vector<unsigned char>& blob) {
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(true);
+        stbi_info_from_memory(source.data, (int)source.size, &width, &height, &channels);
+        int wanted = (channels == 2 || channels == 4) ? 4 : 3;
+        unsigned char* data = stbi_load_from_memory(source.data, (int)source.size, &width, &height, &channels, wanted);
+        if (!data) {
+            SDL_Log("Failed to load texture %s\n", filename);
+            return false;
+        }
+        //mips are built on the cpu in linear space so every driver samples the same chain
+        TexCacheBuild(hash, source.size, width, height, wanted == 4 ? TEXCACHE_RGBA8 : TEXCACHE_RGB8,
+            TEXTURE_MIP_FILTER, true, 0, data, blob);
+        stbi_image_free(data);
+        return true;
+    });
+    UnmapFile(&source);
+    return texture;
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+struct AtlasSource {
+    const char* file;
+    bool tiling; //gutters wrap around instead of repeating the edge
+    TexRegion* region;
+};
 
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    stbi_image_free(data);
-    return texId;
+//packs the images into as few pages as possible, so everything on a page is
+//drawn with one bind. the layout only depends on image sizes, which stb reads
+//from the headers, so a warm start never decodes anything.
+bool LoadAtlas(const AtlasSource* sources, int count)
+{
+    TRACE_FUNCTION();
+    std::vector<MappedFile> files(count);
+    std::vector<uint64_t> hashes(count);
+    std::vector<int> channels(count);
+    AtlasPacker packer(ATLAS_PAGE_SIZE, ATLAS_GUTTER);
+    uint64_t sourceSize = 0;
+    int pageChannels = 3;
+    bool ok = true;
+
+    for (int i = 0; i < count; i++) {
+        int width = 0, height = 0;
+        if (!MapFile(sources[i].file, &files[i]) ||
+            !stbi_info_from_memory(files[i].data, (int)files[i].size, &width, &height, &channels[i])) {
+            SDL_Log("Failed to load texture %s\n", sources[i].file);
+            ok = false;
+            break;
+        }
+        hashes[i] = TexCacheHash(files[i].data, files[i].size);
+        sourceSize += files[i].size;
+        if (channels[i] == 2 || channels[i] == 4) pageChannels = 4;
+        packer.add(width, height);
+    }
+    if (ok && !packer.pack()) {
+        SDL_Log("Atlas: an image is larger than a %dx%d page\n", ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+        ok = false;
+    }
+
+    if (ok) {
+        SDL_Log("Atlas: %d images in %d pages, %.1f%% of page texels used",
+            count, packer.pageCount(), packer.efficiency() * 100.0f);
+        //the pages also depend on how they were packed: page size, gutter,
+        //mip count, gutter wrapping and where each image ended up
+        for (int i = 0; i < count; i++) {
+            const AtlasRect& r = packer.rect(i);
+            int layout[6] = { r.page, r.x, r.y, r.width, r.height, sources[i].tiling ? 1 : 0 };
+            hashes.push_back(TexCacheHash((const unsigned char*)layout, sizeof(layout)));
+        }
+        int parameters[3] = { ATLAS_PAGE_SIZE, ATLAS_GUTTER, ATLAS_MIP_LEVELS };
+        hashes.push_back(TexCacheHash((const unsigned char*)parameters, sizeof(parameters)));
+        uint64_t hash = TexCacheHash((const unsigned char*)hashes.data(), hashes.size() * sizeof(uint64_t));
+
+        for (int p = 0; p < packer.pageCount() && ok; p++) {
+            char cachePath[64];
+            SDL_snprintf(cachePath, sizeof(cachePath), "atlas%d.texcache", p);
+            const AtlasPage& page = packer.page(p);
+
+            CoreTexture texture = LoadCachedTexture(cachePath, hash, sourceSize, MIP_FILTER_BOX, GL_CLAMP_TO_EDGE, [&](std::vector<unsigned char>& blob) {
+                std::vector<unsigned char> pixels((size_t)page.width * page.height * pageChannels, 0);
+                //the page's images decode in parallel, the blits stay in order
+                std::vector<unsigned char*> decoded(count, nullptr);
+                JobCounter decodes;
+                stbi_set_flip_vertically_on_load(true);
+                for (int i = 0; i < count; i++) {
+                    if (packer.rect(i).page != p) continue;
+                    GlobalThreadPool().submit([&, i] {
+                        int width, height, n;
+                        decoded[i] = stbi_load_from_memory(files[i].data, (int)files[i].size, &width, &height, &n, pageChannels);
+                    }, &decodes);
+                }
+                GlobalThreadPool().wait(decodes);
+                bool decodedAll = true;
+                for (int i = 0; i < count; i++) {
+                    if (packer.rect(i).page != p) continue;
+                    if (!decoded[i]) {
+                        SDL_Log("Failed to load texture %s\n", sources[i].file);
+                        decodedAll = false;
+                        continue;
+                    }
+                    packer.blit(i, decoded[i], pageChannels, sources[i].tiling, pixels.data(), pageChannels);
+                    stbi_image_free(decoded[i]);
+                }
+                if (!decodedAll) return false;
+                TexCacheBuild(hash, sourceSize, page.width, page.height, pageChannels == 4 ? TEXCACHE_RGBA8 : TEXCACHE_RGB8,
+                    MIP_FILTER_BOX, false, ATLAS_MIP_LEVELS, pixels.data(), blob);
+                return true;
+            });
+            if (!texture.id) {
+                ok = false;
+                break;
+            }
+
+            for (int i = 0; i < count; i++) {
+                const AtlasRect& r = packer.rect(i);
+                if (r.page != p) continue;
+                sources[i].region->texture = texture;
+                sources[i].region->rect = r;
+            }
+        }
+    }
+
+    for (auto& f : files) UnmapFile(&f);
+    return ok;
 }
 
-void DrawCube()
+//--bc-bench: encoder speed and quality on the demo textures, no window needed
+void RunCompressionBenchmark()
 {
-    glBindTexture(GL_TEXTURE_2D, textureWood);
-    glBegin(GL_QUADS);
+    const char* files[] = { "grass.jpg", "wood.jpg" };
+    for (const char* file : files) {
+        int width, height, channels;
+        unsigned char* data = stbi_load(file, &width, &height, &channels, 0);
+        if (!data) {
+            SDL_Log("Failed to load texture %s\n", file);
+            continue;
+        }
+        if (channels == 3 || channels == 4) {
+            BcBenchmark(file, data, width, height, channels);
+        }
+        stbi_image_free(data);
+    }
+}
+
+//maps the 0..1 uv of an image into wherever its region lives
+void TexVertex(std::vector<SceneVertex>& out, const TexRegion& r, float u, float v, float x, float y, float z)
+{
+    SceneVertex vertex = { x, y, z, u, v };
+    AtlasRemapUV(r.rect, u, v, &vertex.u, &vertex.v);
+    out.push_back(vertex);
+}
 
+//both append quads, four corners each
+void BuildCube(std::vector<SceneVertex>& out)
+{
     //top
-    glTexCoord2f(1, 1); glVertex3f(0.5f, 0.5f, -0.5f);
-    glTexCoord2f(0, 1); glVertex3f(-0.5f, 0.5f, -0.5f);
-    glTexCoord2f(0, 0); glVertex3f(-0.5f, 0.5f, 0.5f);
-    glTexCoord2f(1, 0); glVertex3f(0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 1, 0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 1, -0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 0, -0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 0, 0.5f, 0.5f, 0.5f);
 
     //bottom
-    glTexCoord2f(1, 1); glVertex3f(0.5f, -0.5f, 0.5f);
-    glTexCoord2f(0, 1); glVertex3f(-0.5f, -0.5f, 0.5f);
-    glTexCoord2f(0, 0); glVertex3f(-0.5f, -0.5f, -0.5f);
-    glTexCoord2f(1, 0); glVertex3f(0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 1, 0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 1, -0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 0, -0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 0, 0.5f, -0.5f, -0.5f);
 
     //front
-    glTexCoord2f(1, 1); glVertex3f(0.5f, 0.5f, 0.5f);
-    glTexCoord2f(0, 1); glVertex3f(-0.5f, 0.5f, 0.5f);
-    glTexCoord2f(0, 0); glVertex3f(-0.5f, -0.5f, 0.5f);
-    glTexCoord2f(1, 0); glVertex3f(0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 1, 0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 1, -0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 0, -0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 0, 0.5f, -0.5f, 0.5f);
 
     //back
-    glTexCoord2f(1, 1); glVertex3f(0.5f, -0.5f, -0.5f);
-    glTexCoord2f(0, 1); glVertex3f(-0.5f, -0.5f, -0.5f);
-    glTexCoord2f(0, 0); glVertex3f(-0.5f, 0.5f, -0.5f);
-    glTexCoord2f(1, 0); glVertex3f(0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 1, 0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 1, -0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 0, -0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 0, 0.5f, 0.5f, -0.5f);
 
     //left
-    glTexCoord2f(1, 1); glVertex3f(-0.5f, 0.5f, 0.5f);
-    glTexCoord2f(0, 1); glVertex3f(-0.5f, 0.5f, -0.5f);
-    glTexCoord2f(0, 0); glVertex3f(-0.5f, -0.5f, -0.5f);
-    glTexCoord2f(1, 0); glVertex3f(-0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 1, -0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 1, -0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 0, -0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 0, -0.5f, -0.5f, 0.5f);
 
     //right
-    glTexCoord2f(1, 1); glVertex3f(0.5f, 0.5f, -0.5f);
-    glTexCoord2f(0, 1); glVertex3f(0.5f, 0.5f, 0.5f);
-    glTexCoord2f(0, 0); glVertex3f(0.5f, -0.5f, 0.5f);
-    glTexCoord2f(1, 0); glVertex3f(0.5f, -0.5f, -0.5f);
+    TexVertex(out, woodRegion, 1, 1, 0.5f, 0.5f, -0.5f);
+    TexVertex(out, woodRegion, 0, 1, 0.5f, 0.5f, 0.5f);
+    TexVertex(out, woodRegion, 0, 0, 0.5f, -0.5f, 0.5f);
+    TexVertex(out, woodRegion, 1, 0, 0.5f, -0.5f, -0.5f);
+}
 
-    glEnd();
+//the grass repeats 10 times, one quad per repeat since an atlas region can't wrap
+void BuildGround(std::vector<SceneVertex>& out)
+{
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            float x0 = -10.0f + i * 2.0f, x1 = x0 + 2.0f;
+            float z0 = 10.0f - j * 2.0f, z1 = z0 - 2.0f;
+            TexVertex(out, grassRegion, 0.0f, 0.0f, x0, -0.5f, z0);
+            TexVertex(out, grassRegion, 1.0f, 0.0f, x1, -0.5f, z0);
+            TexVertex(out, grassRegion, 1.0f, 1.0f, x1, -0.5f, z1);
+            TexVertex(out, grassRegion, 0.0f, 1.0f, x0, -0.5f, z1);
+        }
+    }
 }
 
-void DrawGround()
+//two triangles per quad of corners, into a buffer the scene draws from every frame
+void CreateQuadMesh(CoreMesh* mesh, const std::vector<SceneVertex>& corners)
 {
-    glBindTexture(GL_TEXTURE_2D, textureGrass);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-10.0f, -0.5f, 10.0f);
-    glTexCoord2f(10.0f, 0.0f); glVertex3f(10.0f, -0.5f, 10.0f);
-    glTexCoord2f(10.0f, 10.0f); glVertex3f(10.0f, -0.5f, -10.0f);
-    glTexCoord2f(0.0f, 10.0f); glVertex3f(-10.0f, -0.5f, -10.0f);
-    glEnd();
+    std::vector<unsigned short> indices;
+    indices.reserve(corners.size() / 4 * 6);
+    static const unsigned short quad[6] = { 0, 1, 2, 0, 2, 3 };
+    for (size_t q = 0; q < corners.size() / 4; q++)
+        for (int k = 0; k < 6; k++) indices.push_back((unsigned short)(q * 4 + quad[k]));
+    static const CoreVertexLayout layout = { sizeof(SceneVertex), offsetof(SceneVertex, x), -1, -1, offsetof(SceneVertex, u) };
+    renderer.createMesh(mesh, layout, corners.data(), (int)corners.size(), indices.data(), (int)indices.size());
+}
+
+float GroundNoise(int x, int y)
+{
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)y * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (h ^ (h >> 16)) / 4294967295.0f;
+}
+
+//smooth value noise, one lattice cell per unit
+float GroundValueNoise(float x, float y)
+{
+    int ix = (int)floorf(x), iy = (int)floorf(y);
+    float fx = x - ix, fy = y - iy;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    float a = GroundNoise(ix, iy) + (GroundNoise(ix + 1, iy) - GroundNoise(ix, iy)) * fx;
+    float b = GroundNoise(ix, iy + 1) + (GroundNoise(ix + 1, iy + 1) - GroundNoise(ix, iy + 1)) * fx;
+    return a + (b - a) * fy;
+}
+
+//one-time bake of the unique ground: grass repeating every 2 m like the
+//old floor, broken up by dirt patches so no two places look the same
+bool GenerateGroundTiles(const char* path)
+{
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* grass = stbi_load("grass.jpg", &width, &height, &channels, 3);
+    if (!grass) {
+        SDL_Log("Failed to load texture grass.jpg\n");
+        return false;
+    }
+
+    SDL_Log("Baking %s, this only happens once", path);
+    bool ok = VtGenerateFile(path, GROUND_TILES, GROUND_TILE_SIZE, 1, [&](float u, float v, unsigned char rgb[3]) {
+        float wx = u * GROUND_WORLD_SIZE, wz = v * GROUND_WORLD_SIZE;
+        int gx = (int)(fmodf(wx * 0.5f, 1.0f) * width) % width;
+        int gz = (int)(fmodf(wz * 0.5f, 1.0f) * height) % height;
+        const unsigned char* g = grass + ((size_t)gz * width + gx) * 3;
+
+        float n = GroundValueNoise(wx / 40.0f, wz / 40.0f) * 0.7f + GroundValueNoise(wx / 9.0f, wz / 9.0f) * 0.3f;
+        float dirt = n < 0.55f ? 0.0f : (n > 0.7f ? 1.0f : (n - 0.55f) / 0.15f);
+        const float dirtColor[3] = { 120.0f, 90.0f, 60.0f };
+        for (int c = 0; c < 3; c++)
+            rgb[c] = (unsigned char)(g[c] + (dirtColor[c] * (0.8f + 0.4f * n) - g[c]) * dirt);
+    });
+    stbi_image_free(grass);
+    return ok;
+}
+
+bool LoadGroundTexture()
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (groundTexture.open(&renderer, GROUND_TILE_FILE, GROUND_WORLD_SIZE, GROUND_CACHE_SLOTS, GROUND_LOD_DISTANCE)) {
+            SDL_Log("Ground: %.0f m virtual texture, %.1f MB tile cache", GROUND_WORLD_SIZE,
+                groundTexture.cacheBytes() / (1024.0 * 1024.0));
+            return true;
+        }
+        if (attempt == 0 && !GenerateGroundTiles(GROUND_TILE_FILE)) break;
+    }
+    SDL_Log("Couldn't open %s, falling back to the small floor\n", GROUND_TILE_FILE);
+    return false;
+}
+
+//the cube and the small floor are a draw each out of their buffers, the
+//virtual ground streams its visible tiles through immediate mode
+void DrawScene()
+{
+    TRACE_FUNCTION();
+    renderer.drawMesh(cubeMesh, sceneTransforms.world(cubeNode), nullptr, &woodRegion.texture);
+    if (groundVirtual) {
+        renderer.model().load(sceneTransforms.world(groundNode));
+        groundTexture.draw(-0.5f);
+    }
+    else {
+        renderer.drawMesh(groundMesh, sceneTransforms.world(groundNode), nullptr, &grassRegion.texture);
+    }
+}
+
+void buildSceneTransforms()
+{
+    cubeNode = sceneTransforms.create();
+    groundNode = sceneTransforms.create();
+    cameraPivot = sceneTransforms.create();
+    cameraNode = sceneTransforms.create(cameraPivot);
+}
+
+void placeCamera()
+{
+    sceneTransforms.setRotation(cameraPivot, QuatFromAxisAngle(MakeVec3(0.0f, 1.0f, 0.0f), -rotationAngle * 0.0174532925f));
+    sceneTransforms.setPosition(cameraNode, MakeVec3(-posX, 0.0f, 15.0f - posZ));
 }
 
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 {
+    TraceConfigure(argc, argv);
+    renderer.configure(argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--bc-bench") == 0) {
+            RunCompressionBenchmark();
+            return SDL_APP_SUCCESS;
+        }
+        if (SDL_strcmp(argv[i], "--mip-bench") == 0) {
+            MipBenchmark(i + 1 < argc ? SDL_atoi(argv[i + 1]) : 4096);
+            return SDL_APP_SUCCESS;
+        }
+    }
+
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    window = SDL_CreateWindow("Textured Cube (SDL3 + OpenGL)", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+    window = renderer.createWindow("Textured Cube (SDL3 + OpenGL)", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_Log("Couldn't create window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -127,36 +505,48 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[])
 
     SDL_SetAppMetadata("Textured Cube Example", "1.0", "com.example.sdl3texturedcube");
 
-    glcontext = SDL_GL_CreateContext(window);
-    if (!glcontext) {
-        SDL_Log("Couldn't create OpenGL context: %s", SDL_GetError());
-        SDL_DestroyWindow(window);
-        return SDL_APP_FAILURE;
+    renderer.setClearColor(0.3f, 0.5f, 0.9f, 1.0f);
+    renderer.setDepthTest(true);
+
+    textureCompression = TEXTURE_COMPRESSION && !renderer.isHeadless() && SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") && LoadGLExt().compressedTextures;
+
+#if TEXTURE_ATLAS
+    AtlasSource atlasSources[] = {
+        { "grass.jpg", true, &grassRegion },
+        { "wood.jpg", false, &woodRegion },
+    };
+    LoadAtlas(atlasSources, 2);
+#else
+    grassRegion.texture = LoadTexture("grass.jpg");
+    woodRegion.texture = LoadTexture("wood.jpg");
+#endif
+#if GROUND_VIRTUAL_TEXTURE
+    groundVirtual = LoadGroundTexture();
+#endif
+    buildSceneTransforms();
+    placeCamera();
+    std::vector<SceneVertex> corners;
+    BuildCube(corners);
+    CreateQuadMesh(&cubeMesh, corners);
+    if (!groundVirtual) {
+        corners.clear();
+        BuildGround(corners);
+        CreateQuadMesh(&groundMesh, corners);
     }
 
-    glClearColor(0.3f, 0.5f, 0.9f, 1.0f);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    setPerspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 1.0f, 500.0f);
-
-    glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
-
-    textureGrass = LoadTexture("grass.jpg");
-    textureWood = LoadTexture("wood.jpg");
-
     previousTime = SDL_GetTicks();
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event)
 {
+    TRACE_FUNCTION();
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;
     }
-    else if (event->type == SDL_EVENT_KEY_DOWN) {
+    if (renderer.perf().handleEvent(event)) return SDL_APP_CONTINUE;
+    if (TraceHandleEvent(event)) return SDL_APP_CONTINUE;
+    if (event->type == SDL_EVENT_KEY_DOWN) {
         SDL_Keycode key = event->key.key;
         switch (key) {
             case SDLK_LEFT:
@@ -180,42 +570,59 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event)
                 break;
             }
         }
+        placeCamera();
     }
     return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppIterate(void* appstate)
 {
-    currentTime = SDL_GetTicks();
-    if (currentTime > previousTime + STEP_RATE_IN_MILLISECONDS) {
-        previousTime = currentTime;
+    TRACE_FUNCTION();
+    {
+        PerfScope scope(renderer.perf(), "update");
+        currentTime = SDL_GetTicks();
+        if (currentTime > previousTime + STEP_RATE_IN_MILLISECONDS) {
+            previousTime = currentTime;
+        }
+        int width, height;
+        renderer.viewportSize(&width, &height);
+        Mat4 projection = Mat4Perspective(45.0f * 0.0174532925f, (float)width / (float)height, 1.0f, 500.0f);
+        sceneTransforms.update();
+        renderer.setCamera(Mat4RigidInverse(sceneTransforms.world(cameraNode)), projection);
     }
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-
-    glTranslatef(0.0f, 0.0f, -15.0f);
-
-    glTranslatef(posX, 0.0f, posZ);
-    glRotatef(rotationAngle, 0.0f, 1.0f, 0.0f);
-
-    DrawCube();
+    //picks the ground tiles in view and streams the missing ones in
+    if (groundVirtual) {
+        PerfScope scope(renderer.perf(), "cull");
+        //eye position in the rotated world the ground is drawn in, the
+        //height stays where the old fixed camera put it
+        const float* eye = renderer.cameraBlock().eye;
+        Frustum frustum = FrustumFromMatrix(renderer.cameraBlock().viewProjection.m);
+        groundTexture.update(eye[0], 0.5f, eye[2], GROUND_UPLOADS_PER_FRAME, &frustum, -0.5f);
+        groundReport.add(groundTexture.cullStats());
+    }
 
-    DrawGround();
+    {
+        PerfScope scope(renderer.perf(), "draw");
+        renderer.clear(true);
+        DrawScene();
+    }
 
-    SDL_GL_SwapWindow(window);
+    if (!renderer.present()) return renderer.runResult();
     return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate, SDL_AppResult result)
 {
-    if (textureGrass) {
-        glDeleteTextures(1, &textureGrass);
-    }
-    if (textureWood) {
-        glDeleteTextures(1, &textureWood);
-    }
-    SDL_GL_DestroyContext(glcontext);
+    TraceShutdown();
+    groundTexture.close();
+    renderer.destroyMesh(&cubeMesh);
+    renderer.destroyMesh(&groundMesh);
+    //both regions hold the same page when they share one
+    if (woodRegion.texture.id == grassRegion.texture.id) woodRegion.texture = CoreTexture();
+    renderer.destroyTexture(&grassRegion.texture);
+    renderer.destroyTexture(&woodRegion.texture);
+    renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }